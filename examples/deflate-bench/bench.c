@@ -0,0 +1,353 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cutils/file.h>
+
+#include "../../src/websocket/deflate.h"
+#include "../../src/wrp/wrp_encode.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_COUNT 10000
+#define MAX_MSG_SIZE  (256 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct corpus {
+    size_t count;
+    size_t *len;
+    const uint8_t **msg;
+    uint8_t *data;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* A simple options parser helper. */
+static bool is_opt(const char *in, const char *s1, const char *s2)
+{
+    if (s1 && s2) {
+        return ((0 == strcmp(in, s1)) || (0 == strcmp(in, s2))) ? true : false;
+    } else if (s2) {
+        return (0 == strcmp(in, s2)) ? true : false;
+    } else if (s1) {
+        return (0 == strcmp(in, s1)) ? true : false;
+    }
+    return false;
+}
+
+void print_usage(char *name)
+{
+    printf(
+        "Usage: %s [options...]\n"
+        " -h, --help                       This help text.\n"
+        " -f  --file            <file>     Recorded WRP traffic: each message is\n"
+        "                                  preceded by its length as a 4 byte\n"
+        "                                  big endian integer.\n"
+        " -n  --count           <count>    Messages to generate when no file is\n"
+        "                                  given (default 10000).\n"
+        " -l  --level           <level>    zlib compression level (default 6).\n"
+        " -w  --window-bits     <bits>     Only measure this window size (9-15).\n"
+        "     --no-context-takeover        Only measure without context takeover.\n",
+        name);
+}
+
+
+static int64_t cpu_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* The websocket framing a client adds: header plus the 4 byte mask. */
+static size_t frame_overhead(size_t len)
+{
+    if (len < 126) {
+        return 2 + 4;
+    }
+    if (len < 65536) {
+        return 4 + 4;
+    }
+    return 10 + 4;
+}
+
+
+static bool corpus_alloc(struct corpus *c, size_t count)
+{
+    c->count = 0;
+    c->len   = calloc(count, sizeof(size_t));
+    c->msg   = calloc(count, sizeof(uint8_t *));
+
+    return (c->len && c->msg);
+}
+
+
+static bool corpus_load(struct corpus *c, const char *file)
+{
+    size_t len = 0;
+    size_t off = 0;
+    size_t max = 0;
+
+    if (0 != freadall(file, 0, (void **) &c->data, &len)) {
+        printf("Failed to open the file: %s\n", file);
+        return false;
+    }
+
+    /* Two passes: count, then index. */
+    for (int pass = 0; pass < 2; pass++) {
+        off = 0;
+        while (off + 4 <= len) {
+            size_t n = ((size_t) c->data[off] << 24) | ((size_t) c->data[off + 1] << 16)
+                     | ((size_t) c->data[off + 2] << 8) | (size_t) c->data[off + 3];
+
+            off += 4;
+            if (len - off < n) {
+                printf("Truncated message at offset %zu\n", off - 4);
+                return false;
+            }
+            if (1 == pass) {
+                c->len[c->count] = n;
+                c->msg[c->count] = &c->data[off];
+                c->count++;
+            } else {
+                max++;
+            }
+            off += n;
+        }
+
+        if (0 == pass && !corpus_alloc(c, max)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/* Produces traffic shaped like a typical device: a handful of services
+ * sending status events with small json payloads that mostly repeat. */
+static bool corpus_generate(struct corpus *c, size_t count)
+{
+    static const char *services[] = { "config", "telemetry", "wifi", "parodus", "fw" };
+    static const char *events[]   = { "online", "sample", "client-joined", "heartbeat" };
+    struct wrp_encoder *enc       = wrp_encoder_create("mac:112233445566", NULL);
+    size_t used                   = 0;
+    size_t cap                    = count * 512;
+
+    c->data = malloc(cap);
+    if (!enc || !c->data || !corpus_alloc(c, count)) {
+        wrp_encoder_destroy(enc);
+        return false;
+    }
+
+    srand(42);
+    for (size_t i = 0; i < count; i++) {
+        const char *svc = services[(size_t) rand() % 5];
+        const char *evt = events[(size_t) rand() % 4];
+        char dest[128];
+        char payload[256];
+        struct wrp_out msg;
+        int dest_len, payload_len;
+        size_t len;
+
+        dest_len    = snprintf(dest, sizeof(dest), "event:device-status/%s/%s", svc, evt);
+        payload_len = snprintf(payload, sizeof(payload),
+                               "{\"ts\":%zu,\"uptime\":%d,\"rssi\":%d,"
+                               "\"clients\":%d,\"state\":\"%s\"}",
+                               1700000000 + i, 3600 + (int) i, -40 - rand() % 40,
+                               rand() % 16, evt);
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_type         = WRP_MSG_TYPE__EVENT;
+        msg.service.s        = svc;
+        msg.service.len      = strlen(svc);
+        msg.dest.s           = dest;
+        msg.dest.len         = (size_t) dest_len;
+        msg.content_type.s   = "application/json";
+        msg.content_type.len = strlen(msg.content_type.s);
+        msg.payload          = payload;
+        msg.payload_len      = (size_t) payload_len;
+
+        len = wrp_encode(enc, &msg, &c->data[used], cap - used);
+        if (!len || cap - used < len) {
+            wrp_encoder_destroy(enc);
+            return false;
+        }
+
+        c->len[i] = len;
+        used += len;
+        c->count++;
+    }
+
+    /* Index once the buffer can no longer move. */
+    used = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        c->msg[i] = &c->data[used];
+        used += c->len[i];
+    }
+
+    wrp_encoder_destroy(enc);
+    return true;
+}
+
+
+static bool run(const struct corpus *c, int bits, bool takeover, int level)
+{
+    struct deflate_params tx = {
+        .client_max_window_bits     = bits,
+        .client_no_context_takeover = !takeover,
+    };
+    struct deflate_params rx = {
+        .server_max_window_bits     = bits,
+        .server_no_context_takeover = !takeover,
+    };
+    struct deflate_ctx *z = deflate_ctx_create(&tx, level, NULL);
+    struct deflate_ctx *u = deflate_ctx_create(&rx, level, NULL);
+    uint64_t raw = 0, plain_wire = 0, wire = 0;
+    int64_t start, cpu;
+    bool ok = (z && u);
+
+    start = cpu_now_ns();
+    for (size_t i = 0; ok && i < c->count; i++) {
+        const void *out;
+        size_t len;
+
+        ok = (XA_OK == deflate_compress(z, c->msg[i], c->len[i], &out, &len, NULL));
+
+        raw += c->len[i];
+        plain_wire += c->len[i] + frame_overhead(c->len[i]);
+        wire += len + frame_overhead(len);
+    }
+    cpu = cpu_now_ns() - start;
+
+    /* Make sure it all comes back out, outside of the timing. */
+    deflate_ctx_destroy(z);
+    z = deflate_ctx_create(&tx, level, NULL);
+    for (size_t i = 0; ok && z && i < c->count; i++) {
+        const void *out, *back;
+        size_t len, back_len;
+        uint8_t *copy;
+
+        ok = (XA_OK == deflate_compress(z, c->msg[i], c->len[i], &out, &len, NULL));
+        copy = (ok) ? malloc(len) : NULL;
+        ok   = (NULL != copy);
+        if (ok) {
+            memcpy(copy, out, len);
+            ok = (XA_OK == deflate_decompress(u, copy, len, MAX_MSG_SIZE, &back, &back_len, NULL))
+              && (back_len == c->len[i]) && (0 == memcmp(back, c->msg[i], back_len));
+        }
+        free(copy);
+    }
+
+    if (ok) {
+        printf("%4d  %-8s %12llu %12llu %12llu %7.1f%% %9.0f\n", bits,
+               (takeover) ? "yes" : "no", (unsigned long long) raw,
+               (unsigned long long) plain_wire, (unsigned long long) wire,
+               100.0 * (double) wire / (double) plain_wire,
+               (double) cpu / (double) c->count);
+    } else {
+        printf("%4d  %-8s failed\n", bits, (takeover) ? "yes" : "no");
+    }
+
+    deflate_ctx_destroy(z);
+    deflate_ctx_destroy(u);
+
+    return ok;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    struct corpus c;
+    const char *file = NULL;
+    size_t count     = DEFAULT_COUNT;
+    int level        = 6;
+    int only_bits    = 0;
+    bool only_no_ctx = false;
+    int rv           = 0;
+
+    memset(&c, 0, sizeof(c));
+
+    /* Very simple args parser. */
+    for (int i = 1; i < argc; i++) {
+        if (is_opt(argv[i], "-h", "--help")) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (is_opt(argv[i], "-f", "--file") && (i + 1 < argc)) {
+            i++;
+            file = argv[i];
+        } else if (is_opt(argv[i], "-n", "--count") && (i + 1 < argc)) {
+            i++;
+            count = (size_t) atol(argv[i]);
+        } else if (is_opt(argv[i], "-l", "--level") && (i + 1 < argc)) {
+            i++;
+            level = atoi(argv[i]);
+        } else if (is_opt(argv[i], "-w", "--window-bits") && (i + 1 < argc)) {
+            i++;
+            only_bits = atoi(argv[i]);
+        } else if (is_opt(argv[i], NULL, "--no-context-takeover")) {
+            only_no_ctx = true;
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if ((file) ? !corpus_load(&c, file) : !corpus_generate(&c, count)) {
+        printf("Unable to prepare the messages.\n");
+        return -1;
+    }
+
+    printf("messages: %zu (%s), level: %d\n\n", c.count, (file) ? file : "generated", level);
+    printf("bits  takeover    raw bytes   plain wire deflate wire   ratio cpu ns/msg\n");
+
+    for (int bits = DEFLATE_MAX_WINDOW_BITS; DEFLATE_MIN_WINDOW_BITS <= bits; bits--) {
+        if (only_bits && bits != only_bits) {
+            continue;
+        }
+        if (!only_no_ctx && !run(&c, bits, true, level)) {
+            rv = -1;
+        }
+        if (!run(&c, bits, false, level)) {
+            rv = -1;
+        }
+    }
+
+    free(c.len);
+    free(c.msg);
+    free(c.data);
+
+    return rv;
+}
@@ -0,0 +1,179 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/* Needed for gmtime_r() */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/logging/binlog.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define CHUNK (64 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static uint8_t buf[2 * CHUNK];
+static struct binlog_line line;
+static int digits = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void print_usage(const char *name)
+{
+    printf(
+        "Usage: %s [options...] [file...]\n"
+        " -h, --help              This help text.\n"
+        " -d, --digits  <digits>  Digits of the second to show, 0 to 9.\n"
+        "\n"
+        "Renders binary log records as text.  Reads stdin if no files are given.\n",
+        name);
+}
+
+
+static void print_line(const struct binlog_line *l)
+{
+    time_t when = (time_t) (l->when_ns / 1000000000ull);
+    struct tm utc;
+    char ts[32];
+
+    gmtime_r(&when, &utc);
+    strftime(ts, sizeof(ts) - 1, "%F %T", &utc);
+
+    if (digits) {
+        uint32_t frac = (uint32_t) (l->when_ns % 1000000000ull);
+
+        for (int i = digits; i < 9; i++) {
+            frac /= 10;
+        }
+        printf("%s.%0*luZ", ts, digits, (unsigned long) frac);
+    } else {
+        printf("%sZ", ts);
+    }
+
+    printf(" | %s | %.*s\n", binlog_level_name(l->level), (int) l->len, l->text);
+}
+
+
+static int decode(FILE *in, const char *name)
+{
+    struct binlog_reader *r = binlog_reader_create(NULL);
+    size_t have             = 0;
+    size_t offset           = 0;
+    int rv                  = 0;
+
+    if (!r) {
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
+    }
+
+    for (;;) {
+        size_t n  = fread(&buf[have], 1, sizeof(buf) - have, in);
+        size_t at = 0;
+
+        have += n;
+
+        while (at < have) {
+            size_t used = 0;
+
+            if (XA_OK != binlog_reader_next(r, &buf[at], have - at, &used, &line, NULL)) {
+                fprintf(stderr, "%s: corrupt record at offset %zu\n", name, offset + at);
+                rv = -1;
+                goto DONE;
+            }
+            if (0 == used) {
+                break;
+            }
+            if (line.valid) {
+                print_line(&line);
+            }
+            at += used;
+        }
+
+        memmove(buf, &buf[at], have - at);
+        have -= at;
+        offset += at;
+
+        if (0 == n) {
+            if (have) {
+                fprintf(stderr, "%s: %zu bytes left over at the end\n", name, have);
+                rv = -1;
+            }
+            break;
+        }
+        if (sizeof(buf) == have) {
+            fprintf(stderr, "%s: record at offset %zu is too large\n", name, offset);
+            rv = -1;
+            break;
+        }
+    }
+
+DONE:
+    binlog_reader_destroy(r);
+    return rv;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    int rv    = 0;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        FILE *f;
+
+        if ((0 == strcmp(argv[i], "-h")) || (0 == strcmp(argv[i], "--help"))) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if ((0 == strcmp(argv[i], "-d")) || (0 == strcmp(argv[i], "--digits"))) {
+            i++;
+            digits = (i < argc) ? atoi(argv[i]) : 0;
+            digits = (digits < 0) ? 0 : ((9 < digits) ? 9 : digits);
+            continue;
+        }
+        files++;
+
+        f = fopen(argv[i], "rb");
+        if (!f) {
+            fprintf(stderr, "Unable to open '%s'\n", argv[i]);
+            rv = 1;
+            continue;
+        }
+        if (0 != decode(f, argv[i])) {
+            rv = 1;
+        }
+        fclose(f);
+    }
+
+    if (0 == files) {
+        rv = (0 == decode(stdin, "stdin")) ? 0 : 1;
+    }
+
+    return rv;
+}
@@ -0,0 +1,347 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define _GNU_SOURCE /* sched_yield() alongside the socket headers */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../src/event_loop/event_loop.h"
+#include "../../src/ipc/ipc.h"
+#include "../../src/ipc/shm_ring.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_BYTES (256 * 1024 * 1024) /* moved per size and transport */
+#define DEFAULT_RING  (1024 * 1024)
+#define MIN_SIZE      64
+#define MAX_SIZE      (64 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct producer {
+    const char *path;
+    bool ring;
+    size_t ring_bytes;
+    size_t size;
+    size_t count;
+    bool ok;
+    bool done;
+};
+
+struct consumer {
+    size_t msgs;
+    size_t bytes;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* A simple options parser helper. */
+static bool is_opt(const char *in, const char *s1, const char *s2)
+{
+    if (s1 && s2) {
+        return ((0 == strcmp(in, s1)) || (0 == strcmp(in, s2))) ? true : false;
+    } else if (s2) {
+        return (0 == strcmp(in, s2)) ? true : false;
+    } else if (s1) {
+        return (0 == strcmp(in, s1)) ? true : false;
+    }
+    return false;
+}
+
+void print_usage(char *name)
+{
+    printf(
+        "Usage: %s [options...]\n"
+        " -h, --help                       This help text.\n"
+        " -b  --bytes           <bytes>    Bytes to move for each message size\n"
+        "                                  (default 256MiB).\n"
+        " -r  --ring            <bytes>    Ring size (default 1MiB).\n"
+        " -s  --size            <bytes>    Only measure this message size.\n",
+        name);
+}
+
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static bool write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+
+    while (len) {
+        ssize_t n = write(fd, p, len);
+
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return true;
+}
+
+
+static int dial(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    if ((0 <= fd) && (0 != connect(fd, (struct sockaddr *) &addr, sizeof(addr)))) {
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+
+static bool hand_over(int sock, struct shm_ring *r)
+{
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    uint8_t hdr[4] = { (uint8_t) (IPC_FRAME_RING >> 24), 0, 0, 0 };
+    struct iovec iov = { .iov_base = hdr, .iov_len = sizeof(hdr) };
+    int fds[2]       = { shm_ring_memfd(r), shm_ring_eventfd(r) };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctrl, 0, sizeof(ctrl));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    cmsg             = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return (sizeof(hdr) == sendmsg(sock, &msg, 0));
+}
+
+
+/* The local service: one write() per message, or one copy into the ring. */
+static void *produce(void *arg)
+{
+    struct producer *p = (struct producer *) arg;
+    struct shm_ring *r = NULL;
+    uint8_t *buf       = calloc(1, 4 + p->size);
+    int sock           = dial(p->path);
+
+    p->ok = (buf && (0 <= sock));
+
+    if (p->ok && p->ring) {
+        r     = shm_ring_create(p->ring_bytes, NULL);
+        p->ok = r && (p->size <= shm_ring_max_msg(r)) && hand_over(sock, r);
+    }
+
+    if (p->ok) {
+        buf[0] = (uint8_t) (p->size >> 24);
+        buf[1] = (uint8_t) (p->size >> 16);
+        buf[2] = (uint8_t) (p->size >> 8);
+        buf[3] = (uint8_t) p->size;
+    }
+
+    for (size_t i = 0; p->ok && i < p->count; i++) {
+        memcpy(&buf[4], &i, sizeof(i) < p->size ? sizeof(i) : p->size);
+
+        if (r) {
+            XAcode rv;
+
+            while (XA_INSUFFICIENT_RESOURCES == (rv = shm_ring_write(r, &buf[4], p->size, NULL))) {
+                sched_yield();
+            }
+            p->ok = (XA_OK == rv);
+        } else {
+            p->ok = write_all(sock, buf, 4 + p->size);
+        }
+    }
+
+    /* The agent drains whatever is left in the ring when we hang up. */
+    shm_ring_destroy(r);
+    if (0 <= sock) {
+        close(sock);
+    }
+    free(buf);
+
+    __atomic_store_n(&p->done, true, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+
+static void on_message(void *user, struct ipc_client *client, const void *buf,
+                       size_t len)
+{
+    struct consumer *c = (struct consumer *) user;
+
+    (void) client;
+    (void) buf;
+
+    c->msgs++;
+    c->bytes += len;
+}
+
+
+static void on_close(void *user, struct ipc_client *client)
+{
+    (void) user;
+    (void) client;
+}
+
+
+static bool run(const char *path, bool ring, size_t ring_bytes, size_t size,
+                size_t total)
+{
+    struct event_loop *loop = event_loop_create(NULL);
+    struct consumer c       = { 0 };
+    struct producer p       = {
+              .path       = path,
+              .ring       = ring,
+              .ring_bytes = ring_bytes,
+              .size       = size,
+              .count      = total / size,
+              .ok         = false,
+              .done       = false,
+    };
+    struct ipc_server_opts opts;
+    struct ipc_server *s;
+    pthread_t thread;
+    int64_t start, elapsed;
+    bool started;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.loop       = loop;
+    opts.path       = path;
+    opts.user       = &c;
+    opts.on_close   = on_close;
+    opts.on_message = on_message;
+
+    s = (loop) ? ipc_server_create(&opts, NULL) : NULL;
+    if (!s) {
+        event_loop_destroy(loop);
+        return false;
+    }
+
+    start   = now_ns();
+    started = (0 == pthread_create(&thread, NULL, produce, &p));
+    while (started && (c.msgs < p.count)
+           && !(__atomic_load_n(&p.done, __ATOMIC_ACQUIRE) && !ipc_server_clients(s)))
+    {
+        event_loop_run_once(loop, 100, NULL);
+    }
+    elapsed = now_ns() - start;
+
+    ipc_server_destroy(s);
+    if (started) {
+        pthread_join(thread, NULL);
+    }
+    event_loop_destroy(loop);
+
+    if (started && p.ok && (c.msgs == p.count) && (c.bytes == p.count * size)) {
+        printf("%-7s %8zu %10zu %12.0f %10.1f %9.0f\n", (ring) ? "ring" : "socket",
+               size, p.count, (double) p.count * 1e9 / (double) elapsed,
+               (double) c.bytes * 1e9 / (double) elapsed / (1024.0 * 1024.0),
+               (double) elapsed / (double) p.count);
+    } else {
+        printf("%-7s %8zu failed\n", (ring) ? "ring" : "socket", size);
+        return false;
+    }
+
+    return true;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+    char path[64];
+    size_t total      = DEFAULT_BYTES;
+    size_t ring_bytes = DEFAULT_RING;
+    size_t only_size  = 0;
+    int rv            = 0;
+
+    /* Very simple args parser. */
+    for (int i = 1; i < argc; i++) {
+        if (is_opt(argv[i], "-h", "--help")) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (is_opt(argv[i], "-b", "--bytes") && (i + 1 < argc)) {
+            i++;
+            total = (size_t) atol(argv[i]);
+        } else if (is_opt(argv[i], "-r", "--ring") && (i + 1 < argc)) {
+            i++;
+            ring_bytes = (size_t) atol(argv[i]);
+        } else if (is_opt(argv[i], "-s", "--size") && (i + 1 < argc)) {
+            i++;
+            only_size = (size_t) atol(argv[i]);
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    snprintf(path, sizeof(path), "/tmp/shm_bench_%d.sock", (int) getpid());
+
+    printf("bytes per run: %zu, ring: %zu\n\n", total, ring_bytes);
+    printf("         size       msgs       msgs/s      MiB/s    ns/msg\n");
+
+    for (size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+        if (only_size && size != only_size) {
+            continue;
+        }
+        if (!run(path, false, ring_bytes, size, total)) {
+            rv = -1;
+        }
+        if (!run(path, true, ring_bytes, size, total)) {
+            rv = -1;
+        }
+    }
+
+    return rv;
+}
@@ -191,7 +191,8 @@ static int easy_getinfo__off_t(CURLcode *rv, CURL *curl, CURLINFO info, curl_off
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
 /*----------------------------------------------------------------------------*/
-CURLcode auth_token_req(const struct auth_info *in, struct auth_response *r)
+CURL *auth_token_prepare(const struct auth_info *in, struct auth_response *r,
+                         struct curl_slist **headers)
 {
     CURLcode rv             = CURLE_OK;
     CURL *curl              = NULL;
@@ -203,6 +204,7 @@ CURLcode auth_token_req(const struct auth_info *in, struct auth_response *r)
     }
 
     memset(r, 0, sizeof(struct auth_response));
+    *headers = NULL;
 
     if (0 == build_header_list(in, &list)) {
         curl = curl_easy_init();
@@ -244,23 +246,8 @@ CURLcode auth_token_req(const struct auth_info *in, struct auth_response *r)
         && !set_verbose_opt(&rv, curl, in->verbose_stream)
         && !set_pointer_opt(&rv, curl, CURLOPT_HTTPHEADER, list))
     {
-        rv       = curl_easy_perform(curl);
-        r->state = REQ_STATE__PERFORMED;
-
-        if ((CURLE_OK == rv)
-            && !easy_getinfo_long(&rv, curl, CURLINFO_RESPONSE_CODE, &r->http_status)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_NAMELOOKUP_TIME, &r->namelookup)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_CONNECT_TIME, &r->connect)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_APPCONNECT_TIME, &r->appconnect)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_PRETRANSFER_TIME, &r->pretransfer)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_STARTTRANSFER_TIME, &r->starttransfer)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_TOTAL_TIME, &r->total)
-            && !easy_getinfo_double(&rv, curl, CURLINFO_REDIRECT_TIME, &r->redirect)
-            && !easy_getinfo__off_t(&rv, curl, CURLINFO_RETRY_AFTER, &r->retry_after))
-        {
-            /* We have a meaningful response */
-            r->state = REQ_STATE__COMPLETED;
-        }
+        *headers = list;
+        return curl;
     }
 
     curl_slist_free_all(list);
@@ -270,5 +257,45 @@ CURLcode auth_token_req(const struct auth_info *in, struct auth_response *r)
 
     r->curl_rv = rv;
 
-    return rv;
+    return NULL;
+}
+
+
+void auth_token_done(CURL *curl, CURLcode result, struct auth_response *r)
+{
+    CURLcode rv = result;
+
+    r->state = REQ_STATE__PERFORMED;
+
+    if ((CURLE_OK == rv)
+        && !easy_getinfo_long(&rv, curl, CURLINFO_RESPONSE_CODE, &r->http_status)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_NAMELOOKUP_TIME, &r->namelookup)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_CONNECT_TIME, &r->connect)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_APPCONNECT_TIME, &r->appconnect)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_PRETRANSFER_TIME, &r->pretransfer)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_STARTTRANSFER_TIME, &r->starttransfer)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_TOTAL_TIME, &r->total)
+        && !easy_getinfo_double(&rv, curl, CURLINFO_REDIRECT_TIME, &r->redirect)
+        && !easy_getinfo__off_t(&rv, curl, CURLINFO_RETRY_AFTER, &r->retry_after))
+    {
+        /* We have a meaningful response */
+        r->state = REQ_STATE__COMPLETED;
+    }
+
+    r->curl_rv = rv;
+}
+
+
+CURLcode auth_token_req(const struct auth_info *in, struct auth_response *r)
+{
+    struct curl_slist *list = NULL;
+    CURL *curl              = auth_token_prepare(in, r, &list);
+
+    if (curl) {
+        auth_token_done(curl, curl_easy_perform(curl), r);
+        curl_slist_free_all(list);
+        curl_easy_cleanup(curl);
+    }
+
+    return r->curl_rv;
 }
@@ -123,4 +123,34 @@ struct auth_response {
  */
 CURLcode auth_token_req(const struct auth_info *in, struct auth_response *r);
 
+
+/**
+ *  Sets up the same request as auth_token_req() without making it, so the
+ *  handle can be added to a curl multi handle instead of blocking.
+ *
+ *  @note r must stay valid until the transfer is complete, and the headers
+ *        until the handle has been cleaned up; free them with
+ *        curl_slist_free_all().
+ *
+ *  @param in      the input information needed
+ *  @param r       the resulting information (memory must be provided by the
+ *                 caller)
+ *  @param headers the request headers, owned by the caller
+ *
+ *  @return the easy handle, or NULL on failure with the reason in r->curl_rv
+ */
+CURL *auth_token_prepare(const struct auth_info *in, struct auth_response *r,
+                         struct curl_slist **headers);
+
+
+/**
+ *  Fills in the rest of r once the transfer of a handle from
+ *  auth_token_prepare() is complete.  The caller still owns the handle.
+ *
+ *  @param curl   the easy handle
+ *  @param result the result of the transfer
+ *  @param r      the resulting information
+ */
+void auth_token_done(CURL *curl, CURLcode result, struct auth_response *r);
+
 #endif
@@ -1,31 +1,97 @@
 /* SPDX-FileCopyrightText: 2021-2022 Comcast Cable Communications Management, LLC */
 /* SPDX-License-Identifier: Apache-2.0 */
 
+/* Needed for O_CLOEXEC */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <curl/curl.h>
+
 #include "../config/config.h"
+#include "../curl_loop/curl_loop.h"
+#include "../event_loop/event_loop.h"
+#include "../event_loop/timer_wheel.h"
+#include "../inbound/router.h"
+#include "../ipc/ipc.h"
+#include "../logging/dgram.h"
 #include "../logging/log.h"
+#include "../outbound/batch.h"
+#include "../outbound/journal.h"
+#include "../outbound/qos_queue.h"
+#include "../pool/pool.h"
+#include "../telemetry/introspect.h"
+#include "../telemetry/metrics.h"
+#include "../telemetry/msg_trace.h"
+#include "../telemetry/trace.h"
+#include "../websocket/ws_conn.h"
+#include "../wrp/wrp_encode.h"
+#include "../wrp/wrp_view.h"
 #include "config.h"
 #include "signals.h"
+#include "token.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+#define DEFAULT_PING_TICK_MS 250
+#define JOURNAL_SYNC_MS      1000
+#define LOG_FLUSH_MS         10000
+#define TRACE_EXPORT_MS      10000
+#define MAX_SERVICE_NAME     128
+#define STATUS_NO_SERVICE    531 /* WRP: the service isn't available */
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
-/* none */
+/* The subsystems messages move through, for the per subsystem counters. */
+enum subsystem {
+    SUBSYSTEM__WEBSOCKET = 0,
+    SUBSYSTEM__IPC,
+    SUBSYSTEM__ROUTER,
+    SUBSYSTEM__COUNT
+};
+
+struct msg_metrics {
+    struct metric *received[SUBSYSTEM__COUNT];
+    struct metric *sent[SUBSYSTEM__COUNT];
+    struct metric *dropped[SUBSYSTEM__COUNT];
+    struct metric *dispatch_us;
+};
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
-static volatile bool done;
+static struct event_loop *loop;
+static struct curl_loop *curl;
+static struct timer_wheel *wheel;
+static struct ws_conn *ws;
+static struct wrp_encoder *encoder; /* for the agent's own messages */
+static struct pool *pool;
+static struct batch *outbound;
+static struct qos_queue *queue;
+static struct journal *journal;
+static struct event_timer *journal_timer;
+static struct event_timer *log_timer;
+static struct log_dgram *log_sink;
+static struct trace *tracer;
+static struct msg_trace *msg_tracer;
+static struct event_timer *trace_timer;
+static int trace_fd = -1;
+static int delivering = -1; /* the message being routed, for its trace */
+static struct metrics *metrics;
+static struct msg_metrics counted;
+static struct introspect *introspect;
+static struct router *router;
+static struct ipc_server *ipc;
+static enum qos_level credit_level = QOS__LOW; /* of the last local message */
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
@@ -36,11 +102,673 @@ static volatile bool done;
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
 
+static const char *subsystem_name(enum subsystem s)
+{
+    static const char *names[SUBSYSTEM__COUNT] = { "websocket", "ipc", "router" };
+
+    return names[s];
+}
+
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+static int64_t read_error_count(void *user)
+{
+    return (int64_t) xa_error_count((XAcode) (uintptr_t) user);
+}
+
+
+static int64_t read_log_dropped(void *user)
+{
+    struct log_stats ls;
+
+    (void) user;
+    log_get_stats(&ls);
+    return (int64_t) ls.dropped;
+}
+
+
+static int64_t read_log_limited(void *user)
+{
+    struct log_stats ls;
+
+    (void) user;
+    log_get_stats(&ls);
+    return (int64_t) ls.limited;
+}
+
+
+static int64_t read_log_repeated(void *user)
+{
+    struct log_stats ls;
+
+    (void) user;
+    log_get_stats(&ls);
+    return (int64_t) ls.repeated;
+}
+
+
+static int64_t read_qos_evicted(void *user)
+{
+    struct qos_stats qs;
+
+    qos_queue_stats(queue, (enum qos_level) (uintptr_t) user, &qs);
+    return (int64_t) qs.evicted;
+}
+
+
+static int64_t read_qos_dropped(void *user)
+{
+    struct qos_stats qs;
+
+    qos_queue_stats(queue, (enum qos_level) (uintptr_t) user, &qs);
+    return (int64_t) qs.dropped;
+}
+
+
+static int64_t read_qos_depth(void *user)
+{
+    struct qos_stats qs;
+
+    qos_queue_stats(queue, (enum qos_level) (uintptr_t) user, &qs);
+    return (int64_t) qs.depth;
+}
+
+
+static int64_t read_qos_bytes(void *user)
+{
+    struct qos_stats qs;
+
+    qos_queue_stats(queue, (enum qos_level) (uintptr_t) user, &qs);
+    return (int64_t) qs.bytes;
+}
+
+
+static int64_t read_journal_depth(void *user)
+{
+    (void) user;
+    return (int64_t) journal_count(journal);
+}
+
+
+static int64_t read_batch_pending(void *user)
+{
+    (void) user;
+    return (int64_t) batch_pending(outbound);
+}
+
+
+static int64_t read_ipc_clients(void *user)
+{
+    (void) user;
+    return (int64_t) ipc_server_clients(ipc);
+}
+
+
+static int64_t read_token_expiry(void *user)
+{
+    (void) user;
+    return (int64_t) token_expires();
+}
+
+
+static int64_t read_journal_appended(void *user)
+{
+    struct journal_stats js;
+
+    (void) user;
+    journal_stats(journal, &js);
+    return (int64_t) js.appended;
+}
+
+
+static int64_t read_journal_lost(void *user)
+{
+    struct journal_stats js;
+
+    (void) user;
+    journal_stats(journal, &js);
+    return (int64_t) (js.overwritten + js.expired);
+}
+
+
+/* Families are registered together, one label value after another.  A
+ * metric that can't be registered is just not counted. */
+static void register_metrics(void)
+{
+    for (int i = XA_OK + 1; i < XA_LAST; i++) {
+        metrics_counter_fn(metrics, "xa_errors_total", "Errors by code.", "code",
+                           xa_error_to_string((XAcode) i), read_error_count,
+                           (void *) (uintptr_t) i);
+    }
+
+    for (int i = 0; i < SUBSYSTEM__COUNT; i++) {
+        if (SUBSYSTEM__ROUTER != i) {
+            counted.received[i] = metrics_counter(metrics, "xa_messages_received_total",
+                                                  "Messages received.", "subsystem",
+                                                  subsystem_name((enum subsystem) i));
+        }
+    }
+    for (int i = 0; i < SUBSYSTEM__COUNT; i++) {
+        if (SUBSYSTEM__ROUTER != i) {
+            counted.sent[i] = metrics_counter(metrics, "xa_messages_sent_total",
+                                              "Messages sent.", "subsystem",
+                                              subsystem_name((enum subsystem) i));
+        }
+    }
+    for (int i = 0; i < SUBSYSTEM__COUNT; i++) {
+        counted.dropped[i] = metrics_counter(metrics, "xa_messages_dropped_total",
+                                             "Messages dropped.", "subsystem",
+                                             subsystem_name((enum subsystem) i));
+    }
+    counted.dispatch_us = metrics_histogram(metrics, "xa_dispatch_us",
+                                            "Time to decode and route a message from the server.",
+                                            NULL, NULL);
+
+    for (int i = 0; i < QOS__COUNT; i++) {
+        metrics_counter_fn(metrics, "xa_qos_evicted_total",
+                           "Queued messages dropped for more important ones.",
+                           "level", qos_level_to_string((enum qos_level) i), read_qos_evicted,
+                           (void *) (uintptr_t) i);
+    }
+    for (int i = 0; i < QOS__COUNT; i++) {
+        metrics_counter_fn(metrics, "xa_qos_dropped_total",
+                           "Messages refused because the queue was full.",
+                           "level", qos_level_to_string((enum qos_level) i), read_qos_dropped,
+                           (void *) (uintptr_t) i);
+    }
+    for (int i = 0; i < QOS__COUNT; i++) {
+        metrics_gauge_fn(metrics, "xa_qos_depth", "Messages waiting to be sent.",
+                         "level", qos_level_to_string((enum qos_level) i), read_qos_depth,
+                         (void *) (uintptr_t) i);
+    }
+    for (int i = 0; i < QOS__COUNT; i++) {
+        metrics_gauge_fn(metrics, "xa_qos_bytes", "Bytes waiting to be sent.",
+                         "level", qos_level_to_string((enum qos_level) i), read_qos_bytes,
+                         (void *) (uintptr_t) i);
+    }
+    metrics_gauge_fn(metrics, "xa_batch_pending", "Messages in the batch being sent.",
+                     NULL, NULL, read_batch_pending, NULL);
+
+    if (journal) {
+        metrics_gauge_fn(metrics, "xa_journal_depth", "Journaled messages waiting.",
+                         NULL, NULL, read_journal_depth, NULL);
+        metrics_counter_fn(metrics, "xa_journal_appended_total",
+                           "Messages journaled while offline.", NULL, NULL,
+                           read_journal_appended, NULL);
+        metrics_counter_fn(metrics, "xa_journal_lost_total",
+                           "Journaled messages overwritten or expired.", NULL, NULL,
+                           read_journal_lost, NULL);
+    }
+
+    if (ipc) {
+        metrics_gauge_fn(metrics, "xa_ipc_clients", "Local services connected.",
+                         NULL, NULL, read_ipc_clients, NULL);
+    }
+    metrics_gauge_fn(metrics, "xa_token_expiry_seconds",
+                     "When the auth token expires, since the epoch; 0 if unknown.",
+                     NULL, NULL, read_token_expiry, NULL);
+
+    metrics_counter_fn(metrics, "xa_log_suppressed_total", "Log lines not written.",
+                       "reason", "dropped", read_log_dropped, NULL);
+    metrics_counter_fn(metrics, "xa_log_suppressed_total", "Log lines not written.",
+                       "reason", "limited", read_log_limited, NULL);
+    metrics_counter_fn(metrics, "xa_log_suppressed_total", "Log lines not written.",
+                       "reason", "repeated", read_log_repeated, NULL);
+}
+
+
+/* What support wants to see first on a live device. */
+static void describe_state(void *user, struct introspect_state *s)
+{
+    const config_t *c = (const config_t *) user;
+    uint64_t expires  = token_expires();
+    char key[32];
+
+    introspect_str(s, "websocket.state", ws_state_to_string(ws_conn_state(ws)));
+    introspect_str(s, "websocket.interface", ws_conn_interface(ws));
+    introspect_str(s, "websocket.url", c->behavior.url.s);
+
+    introspect_int(s, "token.expires", (int64_t) expires);
+    if (expires) {
+        introspect_int(s, "token.expires_in", (int64_t) expires - (int64_t) time(NULL));
+    }
+
+    /* The TXT lookup isn't made yet, so there is nothing cached. */
+    introspect_str(s, "dns_txt.base_fqdn", c->behavior.dns_txt.base_fqdn.s);
+    introspect_str(s, "dns_txt.token", NULL);
+
+    for (int i = 0; i < QOS__COUNT; i++) {
+        struct qos_stats qs;
+
+        qos_queue_stats(queue, (enum qos_level) i, &qs);
+        snprintf(key, sizeof(key), "queue.%s.depth", qos_level_to_string((enum qos_level) i));
+        introspect_int(s, key, (int64_t) qs.depth);
+        snprintf(key, sizeof(key), "queue.%s.bytes", qos_level_to_string((enum qos_level) i));
+        introspect_int(s, key, (int64_t) qs.bytes);
+    }
+    introspect_int(s, "batch.pending", (int64_t) batch_pending(outbound));
+    if (journal) {
+        introspect_int(s, "journal.depth", (int64_t) journal_count(journal));
+    }
+    if (ipc) {
+        introspect_int(s, "ipc.clients", (int64_t) ipc_server_clients(ipc));
+        introspect_int(s, "ipc.credit", (int64_t) ipc_server_credit(ipc));
+    }
+}
+
+
 static void handle_lifecycle_command(enum signals_command e)
 {
-    (void) e;
+    switch (e) {
+        case SIG_EVENT__RELOAD:
+            log_info("configuration reloading is not supported, ignoring");
+            break;
+        default:
+            event_loop_stop(loop);
+            break;
+    }
+}
+
+
+static void on_token(void *user, const char *token)
+{
+    ws_conn_set_token((struct ws_conn *) user, token);
+}
+
+
+static void get_token(void *user, struct ws_conn *conn, const char *interface,
+                      bool refresh, struct trace_span *parent)
+{
+    token_get((const config_t *) user, interface, refresh, parent, on_token, conn);
+}
+
+
+static void cancel_token(void *user)
+{
+    (void) user;
+
+    token_cancel();
+}
+
+
+/* One batch per line, the way the collector's file receiver reads them. */
+static void export_traces(void *user, const char *json, size_t len)
+{
+    struct iovec iov[2];
+
+    (void) user;
+
+    iov[0].iov_base = (void *) json;
+    iov[0].iov_len  = len;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len  = 1;
+
+    if ((ssize_t) (len + 1) != writev(trace_fd, iov, 2)) {
+        log_warn("unable to export %zu bytes of traces", len);
+    }
+}
+
+
+static void on_trace_timer(struct event_timer *t, void *user)
+{
+    (void) t;
+    (void) user;
+
+    msg_trace_expire(msg_tracer);
+    msg_trace_export(msg_tracer, tracer);
+    trace_flush(tracer);
+}
+
+
+/* Finds the response to a traced request as it goes into the batch. */
+static void trace_batched(const void *buf, size_t len)
+{
+    struct wrp_view msg;
+    int h = -1;
+
+    if (msg_trace_waiting(msg_tracer, MSG_STAGE__RESPONSE)
+        && (XA_OK == wrp_view_decode(&msg, buf, len, NULL)))
+    {
+        h = msg_trace_find(msg_tracer, MSG_STAGE__RESPONSE,
+                           msg.transaction_uuid.s, msg.transaction_uuid.len);
+    }
+    msg_trace_batched(msg_tracer, h);
+}
+
+
+/* Replays from the journal (and syncs it) outside of any batch callback. */
+static void journal_kick(void)
+{
+    if (journal_timer) {
+        event_timer_start(journal_timer, 0, JOURNAL_SYNC_MS);
+    }
+}
+
+
+static void on_connect(void *user, const char *interface)
+{
+    (void) user;
+    (void) interface;
+
+    batch_flush(outbound);
+    journal_kick();
+}
+
+
+static size_t send_batch(void *user, const struct iovec *msgs, size_t count)
+{
+    size_t sent = ws_conn_sendv(ws, msgs, count);
+
+    (void) user;
+
+    msg_trace_sent(msg_tracer, sent);
+    metric_add(counted.sent[SUBSYSTEM__WEBSOCKET], sent);
+
+    /* The batch has room again. */
+    if (sent) {
+        if (journal_count(journal)) {
+            journal_kick();
+        } else {
+            qos_queue_kick(queue);
+        }
+    }
+
+    return sent;
+}
+
+
+static bool replay_to_batch(void *user, const void *buf, size_t len)
+{
+    (void) user;
+
+    if (XA_OK != batch_add_encoded(outbound, buf, len, NULL)) {
+        return false;
+    }
+    trace_batched(buf, len);
+
+    return true;
+}
+
+
+/* Lines that keep repeating are only reported when something flushes them. */
+static void on_log_timer(struct event_timer *t, void *user)
+{
+    (void) t;
+    (void) user;
+
+    log_flush_suppressed();
+}
+
+
+static void on_journal_timer(struct event_timer *t, void *user)
+{
+    (void) t;
+    (void) user;
+
+    if (WS_STATE__CONNECTED == ws_conn_state(ws)) {
+        journal_replay(journal, (uint64_t) time(NULL), replay_to_batch, NULL);
+
+        /* Newer messages may only follow once the journal is empty. */
+        if (!journal_count(journal)) {
+            qos_queue_kick(queue);
+        }
+    }
+
+    journal_sync(journal);
+}
+
+
+/* Local services may send as much as the queue has room for at the level of
+ * the last message they sent.  When the uplink is slow or down the queue stops
+ * draining, the credit runs out and they are paused until it catches up.  The
+ * credit is worked out afresh after each message, so only what the queue kept
+ * uses it up. */
+static void update_credit(void)
+{
+    ipc_server_set_credit(ipc, qos_queue_level_room(queue, credit_level));
+}
+
+
+static void on_queue_room(void *user)
+{
+    (void) user;
+
+    update_credit();
+}
+
+
+static bool to_batch(void *user, enum qos_level level, const void *buf, size_t len)
+{
+    (void) user;
+
+    /* Important messages go to disk while offline, and keep going there until
+     * the backlog has been replayed so they stay in order. */
+    if (journal && (QOS__HIGH <= level)
+        && ((WS_STATE__CONNECTED != ws_conn_state(ws)) || journal_count(journal)))
+    {
+        XAcode err = XA_OK;
+
+        if (XA_OK == journal_append(journal, buf, len, (uint64_t) time(NULL), &err)) {
+            return true;
+        }
+        log_warn("unable to journal a %zu byte message: %s", len, xa_error_to_string(err));
+    }
+
+    if (XA_OK != batch_add_encoded(outbound, buf, len, NULL)) {
+        return false;
+    }
+    trace_batched(buf, len);
+
+    return true;
+}
+
+
+/* The server waits for a response to these. */
+static bool wants_response(enum wrp_msg_type type)
+{
+    return (WRP_MSG_TYPE__REQ == type)
+           || ((WRP_MSG_TYPE__CREATE <= type) && (type <= WRP_MSG_TYPE__DELETE));
+}
+
+
+/* Tells the server right away that nobody is there to answer, instead of
+ * leaving it to time out. */
+static void reply_no_service(const struct wrp_view *in)
+{
+    XAcode err = XA_OK;
+    struct wrp_out out;
+
+    if (!encoder) {
+        return;
+    }
+
+    memset(&out, 0, sizeof(out));
+    out.msg_type         = in->msg_type;
+    out.service          = router_dest_service(&in->dest);
+    out.dest             = in->source;
+    out.transaction_uuid = in->transaction_uuid;
+    out.path             = in->path;
+    out.has_status       = true;
+    out.status           = STATUS_NO_SERVICE;
+    if (!out.service.len) {
+        out.service.s = NULL;
+    }
+
+    if (XA_OK != qos_queue_push(queue, encoder, &out, (int) in->qos, &err)) {
+        log_warn("unable to answer for a missing service: %s", xa_error_to_string(err));
+    }
+}
+
+
+static void on_binary(void *user, const void *buf, size_t len)
+{
+    XAcode err     = XA_OK;
+    uint64_t start = now_us();
+    struct wrp_view msg;
+    int h = msg_trace_begin(msg_tracer);
+
+    (void) user;
+
+    metric_add(counted.received[SUBSYSTEM__WEBSOCKET], 1);
+    if (XA_OK != wrp_view_decode(&msg, buf, len, &err)) {
+        log_warn("dropping a %zu byte message: %s", len, xa_error_to_string(err));
+        metric_add(counted.dropped[SUBSYSTEM__WEBSOCKET], 1);
+        msg_trace_end(msg_tracer, h, err);
+        return;
+    }
+    msg_trace_stamp(msg_tracer, h, MSG_STAGE__DECODE);
+    msg_trace_describe(msg_tracer, h, (int) msg.msg_type, msg.dest.s, msg.dest.len);
+
+    log_debug("received %s message for '%.*s' (%zu byte payload)",
+              wrp_msg_type_to_string(msg.msg_type), (int) msg.dest.len,
+              (msg.dest.s) ? msg.dest.s : "", msg.payload.len);
+
+    delivering = h;
+    if (XA_OK != router_dispatch(router, &msg, buf, len, &err)) {
+        log_debug("no local service for '%.*s', dropping it", (int) msg.dest.len,
+                  (msg.dest.s) ? msg.dest.s : "");
+        metric_add(counted.dropped[SUBSYSTEM__ROUTER], 1);
+        if ((XA_NO_ROUTE == err) && wants_response(msg.msg_type)) {
+            reply_no_service(&msg);
+        }
+    }
+    delivering = -1;
+    metric_observe(counted.dispatch_us, now_us() - start);
+
+    /* Delivery may have ended it already. */
+    if ((XA_OK == err) && wants_response(msg.msg_type)) {
+        msg_trace_await(msg_tracer, h, msg.transaction_uuid.s, msg.transaction_uuid.len);
+    } else {
+        msg_trace_end(msg_tracer, h, err);
+    }
+}
+
+
+static void to_local(void *user, const struct wrp_view *msg, const void *buf,
+                     size_t len)
+{
+    XAcode err = XA_OK;
+
+    (void) msg;
+
+    msg_trace_stamp(msg_tracer, delivering, MSG_STAGE__ROUTE);
+    if (XA_OK != ipc_client_send((struct ipc_client *) user, buf, len, &err)) {
+        log_warn("unable to deliver a %zu byte message locally: %s", len,
+                 xa_error_to_string(err));
+        metric_add(counted.dropped[SUBSYSTEM__IPC], 1);
+        msg_trace_end(msg_tracer, delivering, err);
+        return;
+    }
+    metric_add(counted.sent[SUBSYSTEM__IPC], 1);
+    msg_trace_stamp(msg_tracer, delivering, MSG_STAGE__DELIVER);
+}
+
+
+static void on_local_close(void *user, struct ipc_client *client)
+{
+    (void) user;
+
+    router_unregister_user(router, client);
+}
+
+
+static void local_message(struct ipc_client *client, const void *buf, size_t len)
+{
+    char name[MAX_SERVICE_NAME];
+    XAcode err = XA_OK;
+    struct wrp_view msg;
+    int h;
+
+    metric_add(counted.received[SUBSYSTEM__IPC], 1);
+    if (XA_OK != wrp_view_decode(&msg, buf, len, &err)) {
+        log_warn("dropping a %zu byte local message: %s", len, xa_error_to_string(err));
+        metric_add(counted.dropped[SUBSYSTEM__IPC], 1);
+        return;
+    }
+
+    switch (msg.msg_type) {
+        case WRP_MSG_TYPE__SVC_REG:
+            if (!msg.service_name.s || (sizeof(name) <= msg.service_name.len)) {
+                log_warn("ignoring a registration without a valid service name");
+                return;
+            }
+            memcpy(name, msg.service_name.s, msg.service_name.len);
+            name[msg.service_name.len] = '\0';
+
+            if (XA_OK != router_register(router, name, to_local, client, &err)) {
+                log_warn("unable to register local service '%s': %s", name,
+                         xa_error_to_string(err));
+                return;
+            }
+            log_info("local service '%s' registered", name);
+            break;
+        case WRP_MSG_TYPE__SVC_ALIVE:
+            break;
+        default:
+            h = msg_trace_find(msg_tracer, MSG_STAGE__DELIVER, msg.transaction_uuid.s,
+                               msg.transaction_uuid.len);
+            msg_trace_stamp(msg_tracer, h, MSG_STAGE__RESPONSE);
+
+            credit_level = qos_level_from_value((int) msg.qos);
+            if (XA_OK != qos_queue_push_encoded(queue, buf, len, (int) msg.qos, &err)) {
+                log_warn("dropping a %zu byte local message: %s", len,
+                         xa_error_to_string(err));
+                metric_add(counted.dropped[SUBSYSTEM__IPC], 1);
+                msg_trace_end(msg_tracer, h, err);
+            }
+            break;
+    }
+}
+
+
+static void on_local_message(void *user, struct ipc_client *client,
+                             const void *buf, size_t len)
+{
+    (void) user;
 
-    done = true;
+    local_message(client, buf, len);
+    update_credit();
+}
+
+
+static void log_pool_stats(void)
+{
+    for (size_t i = 0; pool && (i <= POOL_CLASSES); i++) {
+        struct pool_stats ps;
+
+        pool_stats(pool, i, &ps);
+        if (ps.allocs) {
+            log_debug("pool %6zu: high water %zu, %llu allocations, %llu misses",
+                      ps.size, ps.high_water, (unsigned long long) ps.allocs,
+                      (unsigned long long) ps.misses);
+        }
+    }
+}
+
+
+/* Maps behavior.verbosity_level onto a log level: 0 is info, each step up
+ * adds a more detailed level and each step down removes one. */
+static enum log_level verbosity_to_level(int verbosity)
+{
+    int level = (int) LOG_LEVEL__INFO - verbosity;
+
+    if (level < (int) LOG_LEVEL__TRACE) {
+        return LOG_LEVEL__TRACE;
+    }
+    if ((int) LOG_LEVEL__FATAL < level) {
+        return LOG_LEVEL__FATAL;
+    }
+
+    return (enum log_level) level;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -50,6 +778,12 @@ int main(int argc, char *argv[])
 {
     XAcode xa_rv = XA_OK;
     config_t *c  = NULL;
+    int rv       = -1;
+    uint64_t tick_ms;
+    struct ws_conn_opts opts;
+    struct batch_opts bopts;
+    struct qos_queue_opts qopts;
+    struct log_limits limits;
 
     /* Handle args */
     log_info("hello, world");
@@ -58,21 +792,324 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    signals_config(&handle_lifecycle_command);
+    log_set_level(verbosity_to_level(c->behavior.verbosity_level));
+    log_set_subsecond(c->behavior.logging.subsecond_digits);
+
+    memset(&limits, 0, sizeof(limits));
+    if (0 < c->behavior.logging.rate_limit) {
+        limits.rate = (unsigned) c->behavior.logging.rate_limit;
+    }
+    if (0 < c->behavior.logging.rate_burst) {
+        limits.burst = (unsigned) c->behavior.logging.rate_burst;
+    }
+    limits.repeats = c->behavior.logging.repeats;
+    log_set_limits(&limits);
+
+    if (LOG_SINK__STDOUT != c->behavior.logging.sink) {
+        struct log_dgram_opts dopts;
+
+        memset(&dopts, 0, sizeof(dopts));
+        dopts.proto = LOG_DGRAM__JOURNALD;
+        if (LOG_SINK__SYSLOG == c->behavior.logging.sink) {
+            dopts.proto = LOG_DGRAM__SYSLOG;
+        }
+        dopts.path = c->behavior.logging.sink_path.s;
+
+        /* Without the daemon the lines still go to stdout. */
+        log_sink = log_dgram_create(&dopts, &xa_rv);
+        if (!log_sink) {
+            log_error_code(xa_rv, "Unable to open the log socket: %s", xa_error_to_string(xa_rv));
+        } else {
+            log_set_sink(log_dgram_send, log_sink, NULL);
+        }
+    }
+
+    if (0 < c->behavior.logging.async_lines) {
+        struct log_async_opts lopts;
+
+        memset(&lopts, 0, sizeof(lopts));
+        lopts.lines    = (size_t) c->behavior.logging.async_lines;
+        lopts.overflow = c->behavior.logging.overflow;
+        lopts.format   = c->behavior.logging.format;
+
+        /* Logging synchronously is better than not starting. */
+        if (XA_OK != log_async_start(&lopts, &xa_rv)) {
+            log_error_code(xa_rv, "Unable to start async logging: %s", xa_error_to_string(xa_rv));
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    /* Everything else counts into this, so it comes first. */
+    metrics = metrics_create(0, &xa_rv);
+    if (!metrics) {
+        log_fatal_code(xa_rv, "Unable to create the metrics registry: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    loop = event_loop_create(&xa_rv);
+    if (!loop) {
+        log_fatal_code(xa_rv, "Unable to create the event loop: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    if (XA_OK != signals_config(loop, &handle_lifecycle_command, &xa_rv)) {
+        log_fatal_code(xa_rv, "Unable to configure the signals: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    log_timer = event_timer_create(loop, on_log_timer, NULL, &xa_rv);
+    if (!log_timer) {
+        log_fatal_code(xa_rv, "Unable to create the log timer: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+    event_timer_start(log_timer, LOG_FLUSH_MS, LOG_FLUSH_MS);
+
+    curl = curl_loop_create(loop, &xa_rv);
+    if (!curl) {
+        log_fatal_code(xa_rv, "Unable to create the curl loop: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    if (XA_OK != token_setup(loop, curl, &xa_rv)) {
+        log_fatal_code(xa_rv, "Unable to set up the token requests: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    tick_ms = DEFAULT_PING_TICK_MS;
+    if (0 < c->behavior.ping_tick) {
+        tick_ms = (uint64_t) c->behavior.ping_tick;
+    }
+
+    wheel = timer_wheel_create(loop, tick_ms, &xa_rv);
+    if (!wheel) {
+        log_fatal_code(xa_rv, "Unable to create the timer wheel: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    /* Without a device id the agent can't send messages of its own. */
+    encoder = wrp_encoder_create(c->identity.device_id.s, &xa_rv);
+    if (!encoder) {
+        log_warn("no valid identity.device_id, so requests for missing services go unanswered");
+    }
+
+    pool = pool_create(NULL, &xa_rv);
+    if (!pool) {
+        log_fatal_code(xa_rv, "Unable to create the buffer pool: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    memset(&bopts, 0, sizeof(bopts));
+    bopts.loop = loop;
+    bopts.send = send_batch;
+    if (0 < c->behavior.outbound.batch_window) {
+        bopts.window_ms = (uint64_t) c->behavior.outbound.batch_window;
+    }
+    if (0 < c->behavior.outbound.batch_bytes) {
+        bopts.max_bytes = (size_t) c->behavior.outbound.batch_bytes;
+    }
+
+    outbound = batch_create(&bopts, &xa_rv);
+    if (!outbound) {
+        log_fatal_code(xa_rv, "Unable to create the outbound batch: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    memset(&qopts, 0, sizeof(qopts));
+    qopts.loop    = loop;
+    qopts.sink    = to_batch;
+    qopts.on_room = on_queue_room;
+    qopts.pool    = pool;
+    if (0 < c->behavior.outbound.queue_bytes) {
+        qopts.max_bytes = (size_t) c->behavior.outbound.queue_bytes;
+    }
+
+    queue = qos_queue_create(&qopts, &xa_rv);
+    if (!queue) {
+        log_fatal_code(xa_rv, "Unable to create the outbound queues: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    if (c->behavior.outbound.journal_path.s) {
+        struct journal_opts jopts;
+
+        memset(&jopts, 0, sizeof(jopts));
+        jopts.path = c->behavior.outbound.journal_path.s;
+        if (0 < c->behavior.outbound.journal_bytes) {
+            jopts.max_bytes = (size_t) c->behavior.outbound.journal_bytes;
+        }
+        if (0 < c->behavior.outbound.journal_retention) {
+            jopts.retention_s = (uint64_t) c->behavior.outbound.journal_retention;
+        }
+
+        /* Running without the journal beats not running at all. */
+        journal = journal_open(&jopts, &xa_rv);
+        if (!journal) {
+            log_error_code(xa_rv, "Unable to open the outbound journal '%s': %s",
+                           jopts.path, xa_error_to_string(xa_rv));
+        } else {
+            journal_timer = event_timer_create(loop, on_journal_timer, NULL, &xa_rv);
+            if (!journal_timer) {
+                log_fatal_code(xa_rv, "Unable to create the journal timer: %s", xa_error_to_string(xa_rv));
+                goto CLEANUP;
+            }
+            event_timer_start(journal_timer, JOURNAL_SYNC_MS, JOURNAL_SYNC_MS);
+            log_info("%zu journaled messages waiting", journal_count(journal));
+        }
+    }
 
-    done = false;
+    router = router_create(&xa_rv);
+    if (!router) {
+        log_fatal_code(xa_rv, "Unable to create the routing table: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
 
-    while (!done) {
-        /* Get auth JWT */
+    if (c->behavior.ipc.path.s) {
+        struct ipc_server_opts iopts;
 
-        /* Perform DNS TXT lookup */
+        memset(&iopts, 0, sizeof(iopts));
+        iopts.loop       = loop;
+        iopts.path       = c->behavior.ipc.path.s;
+        iopts.pool       = pool;
+        iopts.on_close   = on_local_close;
+        iopts.on_message = on_local_message;
 
-        /* Connect the websocket */
-        sleep(1);
+        ipc = ipc_server_create(&iopts, &xa_rv);
+        if (!ipc) {
+            log_fatal_code(xa_rv, "Unable to listen on '%s': %s", iopts.path, xa_error_to_string(xa_rv));
+            goto CLEANUP;
+        }
+        on_queue_room(NULL);
     }
 
-    /* Clean up */
+    if (c->behavior.tracing.path.s) {
+        struct trace_opts topts;
+        struct msg_trace_opts mopts;
+        uint64_t export_ms = TRACE_EXPORT_MS;
+
+        /* Tracing is nice to have, so carry on without it. */
+        trace_fd = open(c->behavior.tracing.path.s,
+                        O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (trace_fd < 0) {
+            log_error_code(XA_FAILED_TO_OPEN_FILE, "Unable to open the trace file '%s'",
+                           c->behavior.tracing.path.s);
+        } else {
+            memset(&topts, 0, sizeof(topts));
+            topts.export = export_traces;
+            if (0 < c->behavior.tracing.max_spans) {
+                topts.max_spans = (size_t) c->behavior.tracing.max_spans;
+            }
+            if (0 < c->behavior.tracing.export_interval) {
+                export_ms = (uint64_t) c->behavior.tracing.export_interval * 1000;
+            }
+
+            tracer = trace_create(&topts, &xa_rv);
+            if (!tracer) {
+                log_fatal_code(xa_rv, "Unable to create the tracer: %s", xa_error_to_string(xa_rv));
+                goto CLEANUP;
+            }
+
+            trace_timer = event_timer_create(loop, on_trace_timer, NULL, &xa_rv);
+            if (!trace_timer) {
+                log_fatal_code(xa_rv, "Unable to create the trace timer: %s", xa_error_to_string(xa_rv));
+                goto CLEANUP;
+            }
+            event_timer_start(trace_timer, export_ms, export_ms);
+
+            memset(&mopts, 0, sizeof(mopts));
+            if (0 < c->behavior.tracing.sample_every) {
+                mopts.sample_every = (uint32_t) c->behavior.tracing.sample_every;
+            }
+            if (0 < c->behavior.tracing.slow_ms) {
+                mopts.slow_ms = (uint64_t) c->behavior.tracing.slow_ms;
+            }
+
+            msg_tracer = msg_trace_create(&mopts, &xa_rv);
+            if (!msg_tracer) {
+                log_fatal_code(xa_rv, "Unable to create the message tracer: %s", xa_error_to_string(xa_rv));
+                goto CLEANUP;
+            }
+        }
+    }
+
+    register_metrics();
+
+    /* Perform DNS TXT lookup */
+
+    /* Connect the websocket */
+    memset(&opts, 0, sizeof(opts));
+    opts.loop         = loop;
+    opts.curl         = curl;
+    opts.wheel        = wheel;
+    opts.config       = c;
+    opts.trace        = tracer;
+    opts.metrics      = metrics;
+    opts.user         = c;
+    opts.get_token    = get_token;
+    opts.cancel_token = cancel_token;
+    opts.on_connect   = on_connect;
+    opts.on_binary    = on_binary;
+
+    ws = ws_conn_create(&opts, &xa_rv);
+    if (!ws || (XA_OK != ws_conn_start(ws, &xa_rv))) {
+        log_fatal_code(xa_rv, "Unable to start the websocket: %s", xa_error_to_string(xa_rv));
+        goto CLEANUP;
+    }
+
+    if (c->behavior.introspection.path.s) {
+        struct introspect_opts nopts;
+
+        memset(&nopts, 0, sizeof(nopts));
+        nopts.loop    = loop;
+        nopts.path    = c->behavior.introspection.path.s;
+        nopts.metrics = metrics;
+        nopts.state   = describe_state;
+        nopts.user    = c;
+
+        /* Being able to look inside is nice to have, so carry on without. */
+        introspect = introspect_create(&nopts, &xa_rv);
+        if (!introspect) {
+            log_error_code(xa_rv, "Unable to listen on '%s': %s", nopts.path,
+                           xa_error_to_string(xa_rv));
+        }
+    }
+
+    if (XA_OK == event_loop_run(loop, &xa_rv)) {
+        rv = 0;
+    }
+
+CLEANUP:
+    introspect_destroy(introspect);
+    ws_conn_destroy(ws);
+    event_timer_destroy(trace_timer);
+    msg_trace_export(msg_tracer, tracer);
+    msg_trace_destroy(msg_tracer);
+    trace_destroy(tracer);
+    if (0 <= trace_fd) {
+        close(trace_fd);
+    }
+    ipc_server_destroy(ipc);
+    router_destroy(router);
+    event_timer_destroy(journal_timer);
+    journal_close(journal);
+    qos_queue_destroy(queue);
+    log_pool_stats();
+    pool_destroy(pool);
+    batch_destroy(outbound);
+    wrp_encoder_destroy(encoder);
+    timer_wheel_destroy(wheel);
+    token_cleanup();
+    curl_loop_destroy(curl);
+    signals_cleanup();
+    event_timer_destroy(log_timer);
+    event_loop_destroy(loop);
+    log_flush_suppressed();
+    log_async_stop();
+    log_set_sink(NULL, NULL, NULL);
+    log_dgram_destroy(log_sink);
+    metrics_destroy(metrics);
     config_destroy(c);
+    curl_global_cleanup();
 
-    return 0;
+    return rv;
 }
@@ -3,8 +3,11 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <signal.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 
 #include "../logging/log.h"
 #include "signals.h"
@@ -24,6 +27,13 @@
 /*----------------------------------------------------------------------------*/
 typedef void (*command_t)(enum signals_command);
 
+struct sig_map {
+    int sig;
+    bool lifecycle;
+    enum signals_command cmd;
+    const char *name;
+};
+
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
@@ -36,38 +46,58 @@ static void default_shutdown(enum signals_command);
 /*----------------------------------------------------------------------------*/
 static command_t command_fn = &default_shutdown;
 
+static int sfd                 = -1;
+static struct event_watch *sfw = NULL;
+
+// clang-format off
+static const struct sig_map sig_map[] = {
+    { .sig = SIGINT,  .lifecycle = true,  .cmd = SIG_EVENT__STOP,                 .name = "STOP" },
+    { .sig = SIGQUIT, .lifecycle = true,  .cmd = SIG_EVENT__STOP,                 .name = "STOP" },
+    { .sig = SIGTERM, .lifecycle = true,  .cmd = SIG_EVENT__TERMINATE,            .name = "TERMINATE" },
+    { .sig = SIGUSR1, .lifecycle = true,  .cmd = SIG_EVENT__SYSTEM_IS_RESTARTING, .name = "SYSTEM IS RESTARTING" },
+    { .sig = SIGHUP,  .lifecycle = true,  .cmd = SIG_EVENT__RELOAD,               .name = "RELOAD" },
+    { .sig = SIGUSR2, .lifecycle = false },
+    { .sig = SIGCHLD, .lifecycle = false },
+    { .sig = SIGALRM, .lifecycle = false },
+};
+// clang-format on
+
 
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
-static void sig_ignore(int sig)
+static void handle_signal(int sig)
 {
-    log_trace("ignoring signal: '%s' (%d)", strsignal(sig), sig);
-    signal(sig, sig_ignore);
+    for (size_t i = 0; i < sizeof(sig_map) / sizeof(struct sig_map); i++) {
+        if (sig != sig_map[i].sig) {
+            continue;
+        }
+
+        if (!sig_map[i].lifecycle) {
+            log_trace("ignoring signal: '%s' (%d)", strsignal(sig), sig);
+            return;
+        }
+
+        log_fatal("handling signal: '%s' (%d)", strsignal(sig), sig);
+        log_fatal("lifecycle command(%s) received", sig_map[i].name);
+        (*command_fn)(sig_map[i].cmd);
+        return;
+    }
 }
 
 
-static void sig_stop(int sig)
+static void on_signalfd(struct event_watch *w, int fd, unsigned events, void *user)
 {
-    log_fatal("handling signal: '%s' (%d)", strsignal(sig), sig);
-    log_fatal("lifecycle command(STOP) received");
-    (*command_fn)(SIG_EVENT__STOP);
-}
-
+    struct signalfd_siginfo si;
 
-static void sig_usr1(int sig)
-{
-    log_fatal("handling signal: '%s' (%d)", strsignal(sig), sig);
-    log_fatal("lifecycle command(SYSTEM IS RESTARTING) received");
-    (*command_fn)(SIG_EVENT__SYSTEM_IS_RESTARTING);
-}
+    (void) w;
+    (void) events;
+    (void) user;
 
-
-static void sig_term(int sig)
-{
-    log_fatal("handling signal: '%s' (%d)", strsignal(sig), sig);
-    log_fatal("lifecycle command(TERMINATE) received");
-    (*command_fn)(SIG_EVENT__TERMINATE);
+    /* Drain everything that is pending so a burst is handled in one pass. */
+    while (sizeof(si) == read(fd, &si, sizeof(si))) {
+        handle_signal((int) si.ssi_signo);
+    }
 }
 
 
@@ -81,27 +111,69 @@ static void default_shutdown(enum signals_command e)
 
 
 /*----------------------------------------------------------------------------*/
-/*                             Internal functions                             */
+/*                             External Functions                             */
 /*----------------------------------------------------------------------------*/
-void signals_config(void (*f)(enum signals_command))
+XAcode signals_config(struct event_loop *loop,
+                      void (*f)(enum signals_command), XAcode *err)
 {
+    struct sigaction sa;
+    sigset_t mask;
+
+    if (!loop) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
     if (f) {
         command_fn = f;
     }
 
-    signal(SIGINT, sig_stop);
-    signal(SIGTERM, sig_term);
-    signal(SIGUSR1, sig_usr1);
-    signal(SIGQUIT, sig_stop);
+    /* Nothing needs to know about SIGPIPE, the write() calls see EPIPE. */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, NULL);
 
-    signal(SIGUSR2, sig_ignore);
-    signal(SIGCHLD, sig_ignore);
-    signal(SIGPIPE, sig_ignore);
-    signal(SIGALRM, sig_ignore);
-    signal(SIGHUP, sig_ignore);
+    sigemptyset(&mask);
+    for (size_t i = 0; i < sizeof(sig_map) / sizeof(struct sig_map); i++) {
+        sigaddset(&mask, sig_map[i].sig);
+    }
+
+    if (0 != pthread_sigmask(SIG_BLOCK, &mask, NULL)) {
+        return xa_set_error(err, XA_EVENT_LOOP_ERROR);
+    }
+
+    sfd = signalfd(sfd, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sfd < 0) {
+        return xa_set_error(err, XA_EVENT_LOOP_ERROR);
+    }
+
+    if (!sfw) {
+        XAcode e = XA_OK;
+
+        sfw = event_loop_watch(loop, sfd, EVENT__READABLE, on_signalfd, NULL, &e);
+        if (!sfw) {
+            close(sfd);
+            sfd = -1;
+            return xa_pass_error(err, e);
+        }
+    }
 
 #ifdef INCLUDE_BREAKPAD
     /* breakpad handles the signals SIGSEGV, SIGBUS, SIGFPE, and SIGILL */
     breakpad_ExceptionHandler();
 #endif
+
+    return XA_OK;
+}
+
+
+void signals_cleanup(void)
+{
+    event_watch_remove(sfw);
+    sfw = NULL;
+
+    if (0 <= sfd) {
+        close(sfd);
+        sfd = -1;
+    }
 }
@@ -4,17 +4,36 @@
 #ifndef __SIGNALS_H__
 #define __SIGNALS_H__
 
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
 
 enum signals_command {
     SIG_EVENT__STOP,
     SIG_EVENT__TERMINATE,
-    SIG_EVENT__SYSTEM_IS_RESTARTING
+    SIG_EVENT__SYSTEM_IS_RESTARTING,
+    SIG_EVENT__RELOAD
 };
 
 /**
  *  config_signals() configures the signals to call the provided handler with
  *  the information about what the system is telling us to do.
+ *
+ *  The signals are blocked and delivered through a signalfd watched by the
+ *  event loop, so the handler is called from the loop thread like any other
+ *  callback and is free to log, allocate or take locks.
+ *
+ *  @note The signal mask is inherited by new threads, so this must be called
+ *        before any other threads are created.
+ *
+ *  @return XA_OK on success, XA_EVENT_LOOP_ERROR otherwise
  */
-void signals_config(void (*command)(enum signals_command));
+XAcode signals_config(struct event_loop *loop,
+                      void (*command)(enum signals_command), XAcode *err);
+
+
+/**
+ *  signals_cleanup() stops watching the signalfd and closes it.
+ */
+void signals_cleanup(void);
 
 #endif
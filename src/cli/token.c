@@ -0,0 +1,327 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cjson/cJSON.h>
+#include <cutils/strings.h>
+#include <trower-base64/base64.h>
+
+#include "../logging/log.h"
+#include "token.h"
+
+#ifdef AUTH_TOKEN_SUPPORT
+#include "../auth_token/auth_token.h"
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+#ifdef AUTH_TOKEN_SUPPORT
+/* The issuer request in progress, at most one. */
+struct fetch {
+    CURL *easy;
+    struct curl_slist *headers;
+    struct auth_response r;
+    CURLcode result;
+    struct trace_span *span;
+    token_fn fn;
+    void *user;
+};
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static char *token      = NULL;
+static uint64_t expires = 0;
+
+static struct curl_loop *curl = NULL;
+static struct event_timer *finish_timer = NULL;
+
+#ifdef AUTH_TOKEN_SUPPORT
+static struct fetch fetching;
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+#ifdef AUTH_TOKEN_SUPPORT
+static long to_curl_tls(enum tls_version v)
+{
+    switch (v) {
+        case TLS_VERSION__1_0: return CURL_SSLVERSION_TLSv1_0;
+        case TLS_VERSION__1_1: return CURL_SSLVERSION_TLSv1_1;
+        case TLS_VERSION__1_2: return CURL_SSLVERSION_TLSv1_2;
+        case TLS_VERSION__1_3: return CURL_SSLVERSION_TLSv1_3;
+        default: break;
+    }
+
+    return 0;
+}
+
+
+static void trace_response(struct trace_span *s, const struct auth_response *r)
+{
+    trace_span_int(s, "http.response.status_code", r->http_status);
+    trace_span_int(s, "curl.code", r->curl_rv);
+    trace_span_double(s, "curl.namelookup_s", r->namelookup);
+    trace_span_double(s, "curl.connect_s", r->connect);
+    trace_span_double(s, "curl.appconnect_s", r->appconnect);
+    trace_span_double(s, "curl.pretransfer_s", r->pretransfer);
+    trace_span_double(s, "curl.starttransfer_s", r->starttransfer);
+    trace_span_double(s, "curl.total_s", r->total);
+    trace_span_double(s, "curl.redirect_s", r->redirect);
+}
+
+
+/* Reads the exp claim from the JWT's payload without verifying it; it is only
+ * reported, never relied on. */
+static uint64_t exp_claim(const char *jwt)
+{
+    const char *payload = (jwt) ? strchr(jwt, '.') : NULL;
+    const char *end     = NULL;
+    uint64_t rv         = 0;
+    uint8_t *claims     = NULL;
+    cJSON *json         = NULL;
+    const cJSON *exp;
+    size_t len;
+
+    if (!payload) {
+        return 0;
+    }
+    payload++;
+    end = strchr(payload, '.');
+    len = (end) ? (size_t) (end - payload) : strlen(payload);
+
+    claims = malloc(b64_url_get_decoded_buffer_size(len));
+    if (!claims) {
+        return 0;
+    }
+
+    len  = b64_url_decode((const uint8_t *) payload, len, claims);
+    json = (len) ? cJSON_ParseWithLength((const char *) claims, len) : NULL;
+    exp  = cJSON_GetObjectItemCaseSensitive(json, "exp");
+    if (cJSON_IsNumber(exp) && (0 < exp->valuedouble)
+        && (exp->valuedouble < (double) UINT64_MAX))
+    {
+        rv = (uint64_t) exp->valuedouble;
+    }
+
+    cJSON_Delete(json);
+    free(claims);
+
+    return rv;
+}
+
+
+/* Releases the request; the cached token is left alone. */
+static void release(const char *error)
+{
+    if (!fetching.easy) {
+        return;
+    }
+
+    event_timer_stop(finish_timer);
+    if (error) {
+        trace_span_error(fetching.span, XA_NOT_CONNECTED, error);
+    }
+    trace_span_end(fetching.span);
+
+    curl_loop_remove(curl, fetching.easy);
+    curl_easy_cleanup(fetching.easy);
+    curl_slist_free_all(fetching.headers);
+    if (fetching.r.payload) {
+        free(fetching.r.payload);
+    }
+
+    memset(&fetching, 0, sizeof(fetching));
+}
+
+
+/* The transfer can't be removed from inside curl's callback, so the rest
+ * happens from the timer. */
+static void on_fetched(CURL *easy, CURLcode result, void *user)
+{
+    (void) easy;
+    (void) user;
+
+    fetching.result = result;
+    event_timer_start(finish_timer, 0, 0);
+}
+
+
+static void on_finish(struct event_timer *t, void *user)
+{
+    struct auth_response *r = &fetching.r;
+    token_fn fn             = fetching.fn;
+    void *fn_user           = fetching.user;
+
+    (void) t;
+    (void) user;
+
+    if (!fetching.easy) {
+        return;
+    }
+
+    auth_token_done(fetching.easy, fetching.result, r);
+    trace_response(fetching.span, r);
+
+    if ((REQ_STATE__COMPLETED == r->state) && (200 == r->http_status) && r->payload) {
+        token   = cu_must_strndup((const char *) r->payload, r->len);
+        expires = exp_claim(token);
+        release(NULL);
+    } else {
+        log_error("issuer request failed: curl %d, http %ld", r->curl_rv, r->http_status);
+        release("issuer request failed");
+    }
+
+    fn(fn_user, token);
+}
+
+
+static bool fetch(const config_t *c, const char *interface,
+                  struct trace_span *parent, token_fn fn, void *user)
+{
+    struct auth_info in;
+
+    memset(&in, 0, sizeof(in));
+    in.url                   = c->behavior.issuer.url.s;
+    in.interface             = interface;
+    in.timeout               = c->behavior.issuer.request_timeout;
+    in.max_redirects         = c->behavior.issuer.max_redirects;
+    in.client_cert_path      = c->behavior.issuer.mtls.cert_path.s;
+    in.private_key_path      = c->behavior.issuer.mtls.private_key_path.s;
+    in.ca_bundle_path        = c->behavior.issuer.ca_bundle_path.s;
+    in.tls_version           = to_curl_tls(c->behavior.issuer.tls_version);
+    in.serial_number         = c->hardware.serial_number.s;
+    in.partner_id            = c->identity.partner_id.s;
+    in.hardware_model        = c->hardware.model.s;
+    in.hardware_manufacturer = c->hardware.manufacturer.s;
+    in.firmware_name         = c->firmware.name.s;
+    in.last_reboot_reason    = c->hardware.last_reboot_reason.s;
+
+    fetching.span = trace_span_child(parent, "issuer request", TRACE_KIND__CLIENT);
+    trace_span_str(fetching.span, "url.full", in.url);
+
+    fetching.easy = auth_token_prepare(&in, &fetching.r, &fetching.headers);
+    if (!fetching.easy) {
+        log_error("unable to set up the issuer request: curl %d", fetching.r.curl_rv);
+        trace_span_error(fetching.span, XA_NOT_CONNECTED, "unable to set up the request");
+        trace_span_end(fetching.span);
+        memset(&fetching, 0, sizeof(fetching));
+        return false;
+    }
+
+    if (XA_OK != curl_loop_add(curl, fetching.easy, on_fetched, NULL, NULL)) {
+        log_error("unable to start the issuer request");
+        release("unable to start the request");
+        return false;
+    }
+
+    fetching.fn   = fn;
+    fetching.user = user;
+
+    return true;
+}
+#endif
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+XAcode token_setup(struct event_loop *loop, struct curl_loop *cl, XAcode *err)
+{
+#ifdef AUTH_TOKEN_SUPPORT
+    XAcode e = XA_OK;
+#endif
+
+    if (!loop || !cl) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+#ifdef AUTH_TOKEN_SUPPORT
+    finish_timer = event_timer_create(loop, on_finish, NULL, &e);
+    if (!finish_timer) {
+        return xa_pass_error(err, e);
+    }
+#endif
+    curl = cl;
+
+    return XA_OK;
+}
+
+
+void token_get(const config_t *c, const char *interface, bool refresh,
+               struct trace_span *parent, token_fn fn, void *user)
+{
+    token_cancel();
+
+    if (token && !refresh) {
+        fn(user, token);
+        return;
+    }
+
+    expires = 0;
+    if (token) {
+        free(token);
+        token = NULL;
+    }
+
+#ifdef AUTH_TOKEN_SUPPORT
+    if (c->behavior.issuer.url.s && curl
+        && fetch(c, interface, parent, fn, user))
+    {
+        return;
+    }
+#else
+    (void) c;
+    (void) interface;
+    (void) parent;
+#endif
+
+    fn(user, NULL);
+}
+
+
+uint64_t token_expires(void)
+{
+    return expires;
+}
+
+
+void token_cancel(void)
+{
+#ifdef AUTH_TOKEN_SUPPORT
+    release("cancelled");
+#endif
+}
+
+
+void token_cleanup(void)
+{
+    token_cancel();
+    event_timer_destroy(finish_timer);
+    finish_timer = NULL;
+    curl         = NULL;
+
+    expires = 0;
+    if (token) {
+        free(token);
+        token = NULL;
+    }
+}
@@ -0,0 +1,70 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __CLI_TOKEN_H__
+#define __CLI_TOKEN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../config/config.h"
+#include "../curl_loop/curl_loop.h"
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+#include "../telemetry/trace.h"
+
+/**
+ *  Called with the auth token, or NULL if there is none.  The token is valid
+ *  until the next call to token_get() or token_cleanup().
+ */
+typedef void (*token_fn)(void *user, const char *token);
+
+
+/**
+ *  token_setup() gives the issuer requests the loop they are made on.  Call
+ *  it once, before token_get().
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT or XA_OUT_OF_MEMORY otherwise
+ */
+XAcode token_setup(struct event_loop *loop, struct curl_loop *curl, XAcode *err);
+
+
+/**
+ *  token_get() gives fn the cached auth token, fetching a new one from
+ *  behavior.issuer.url if there isn't one yet or refresh is set.  The token
+ *  is NULL if no issuer is configured or the request failed.
+ *
+ *  The request is made on the curl loop, so nothing blocks: fn is called
+ *  before token_get() returns when there is nothing to fetch, and from the
+ *  loop once the request is complete otherwise.  There is only one request at
+ *  a time; calling token_get() again cancels the one in progress without
+ *  calling its fn.
+ *
+ *  A request to the issuer is traced as a child of parent, if there is one.
+ */
+void token_get(const config_t *c, const char *interface, bool refresh,
+               struct trace_span *parent, token_fn fn, void *user);
+
+
+/**
+ *  token_cancel() abandons the request in progress, if any, without calling
+ *  its fn.
+ */
+void token_cancel(void);
+
+
+/**
+ *  token_expires() returns when the cached token expires in seconds since the
+ *  epoch, from its exp claim, or 0 if there is no token or it doesn't say.
+ *  The signature isn't checked; that is the server's job.
+ */
+uint64_t token_expires(void);
+
+
+/**
+ *  token_cleanup() cancels any request and releases the cached token.  Call
+ *  it before the loops are destroyed.
+ */
+void token_cleanup(void);
+
+#endif
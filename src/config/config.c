@@ -56,6 +56,31 @@ static const struct config_map tls_map[] = {
     { .s = NULL,                      .val = 0},
 };
 
+static const struct config_map format_map[] = {
+    {.s = "text",   .val = (int) LOG_FORMAT__TEXT  },
+    {.s = "binary", .val = (int) LOG_FORMAT__BINARY},
+    {.s = NULL,     .val = 0                       },
+};
+
+static const struct config_map overflow_map[] = {
+    {.s = "drop",  .val = (int) LOG_OVERFLOW__DROP },
+    {.s = "block", .val = (int) LOG_OVERFLOW__BLOCK},
+    {.s = NULL,    .val = 0                        },
+};
+
+static const struct config_map repeats_map[] = {
+    {.s = "keep",     .val = (int) LOG_REPEATS__KEEP    },
+    {.s = "collapse", .val = (int) LOG_REPEATS__COLLAPSE},
+    {.s = NULL,       .val = 0                          },
+};
+
+static const struct config_map sink_map[] = {
+    {.s = "stdout",   .val = (int) LOG_SINK__STDOUT  },
+    {.s = "journald", .val = (int) LOG_SINK__JOURNALD},
+    {.s = "syslog",   .val = (int) LOG_SINK__SYSLOG  },
+    {.s = NULL,       .val = 0                       },
+};
+
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
@@ -234,7 +259,7 @@ static const cJSON *process_obj(const cJSON *json, struct config_ctx *ctx,
         }
         ctx->obj[ctx->depth] = name;
         ctx->depth++;
-        log_info("ctx->depth: %d\n", ctx->depth);
+        log_trace("ctx->depth: %zu", ctx->depth);
     }
 
     return obj;
@@ -382,13 +407,20 @@ static XAcode json_to_config(const cJSON *json, struct config_ctx *ctx,
 
     obj = process_obj(json, ctx, "behavior");
     if (obj) {
-        const cJSON *dns_txt = NULL;
-        const cJSON *issuer  = NULL;
+        const cJSON *dns_txt  = NULL;
+        const cJSON *issuer   = NULL;
+        const cJSON *ipc      = NULL;
+        const cJSON *outbound = NULL;
+        const cJSON *logging  = NULL;
+        const cJSON *tracing  = NULL;
+        const cJSON *intro    = NULL;
 
         process_string(obj, ctx, "url", &cfg->c->behavior.url, rv);
         process_int___(obj, ctx, "ping_timeout", &cfg->c->behavior.ping_timeout, rv);
+        process_int___(obj, ctx, "ping_tick", &cfg->c->behavior.ping_tick, rv);
         process_int___(obj, ctx, "backoff_max", &cfg->c->behavior.backoff_max, rv);
         process_int___(obj, ctx, "force_ip", &cfg->c->behavior.force_ip, rv);
+        process_int___(obj, ctx, "verbosity_level", &cfg->c->behavior.verbosity_level, rv);
 
         process_interfaces(obj, ctx, cfg, rv);
 
@@ -426,6 +458,53 @@ static XAcode json_to_config(const cJSON *json, struct config_ctx *ctx,
             end_obj(ctx);
         }
 
+        ipc = process_obj(obj, ctx, "ipc");
+        if (ipc) {
+            process_string(ipc, ctx, "path", &cfg->c->behavior.ipc.path, rv);
+            end_obj(ctx);
+        }
+
+        outbound = process_obj(obj, ctx, "outbound");
+        if (outbound) {
+            process_int___(outbound, ctx, "batch_window", &cfg->c->behavior.outbound.batch_window, rv);
+            process_int___(outbound, ctx, "batch_bytes", &cfg->c->behavior.outbound.batch_bytes, rv);
+            process_int___(outbound, ctx, "queue_bytes", &cfg->c->behavior.outbound.queue_bytes, rv);
+            process_string(outbound, ctx, "journal_path", &cfg->c->behavior.outbound.journal_path, rv);
+            process_int___(outbound, ctx, "journal_bytes", &cfg->c->behavior.outbound.journal_bytes, rv);
+            process_int___(outbound, ctx, "journal_retention", &cfg->c->behavior.outbound.journal_retention, rv);
+            end_obj(ctx);
+        }
+
+        logging = process_obj(obj, ctx, "logging");
+        if (logging) {
+            process_int___(logging, ctx, "async_lines", &cfg->c->behavior.logging.async_lines, rv);
+            process_enum__(logging, ctx, "overflow", (int *) &cfg->c->behavior.logging.overflow, overflow_map, rv);
+            process_enum__(logging, ctx, "format", (int *) &cfg->c->behavior.logging.format, format_map, rv);
+            process_int___(logging, ctx, "subsecond_digits", &cfg->c->behavior.logging.subsecond_digits, rv);
+            process_int___(logging, ctx, "rate_limit", &cfg->c->behavior.logging.rate_limit, rv);
+            process_int___(logging, ctx, "rate_burst", &cfg->c->behavior.logging.rate_burst, rv);
+            process_enum__(logging, ctx, "repeats", (int *) &cfg->c->behavior.logging.repeats, repeats_map, rv);
+            process_enum__(logging, ctx, "sink", (int *) &cfg->c->behavior.logging.sink, sink_map, rv);
+            process_string(logging, ctx, "sink_path", &cfg->c->behavior.logging.sink_path, rv);
+            end_obj(ctx);
+        }
+
+        tracing = process_obj(obj, ctx, "tracing");
+        if (tracing) {
+            process_string(tracing, ctx, "path", &cfg->c->behavior.tracing.path, rv);
+            process_int___(tracing, ctx, "export_interval", &cfg->c->behavior.tracing.export_interval, rv);
+            process_int___(tracing, ctx, "max_spans", &cfg->c->behavior.tracing.max_spans, rv);
+            process_int___(tracing, ctx, "sample_every", &cfg->c->behavior.tracing.sample_every, rv);
+            process_int___(tracing, ctx, "slow_ms", &cfg->c->behavior.tracing.slow_ms, rv);
+            end_obj(ctx);
+        }
+
+        intro = process_obj(obj, ctx, "introspection");
+        if (intro) {
+            process_string(intro, ctx, "path", &cfg->c->behavior.introspection.path, rv);
+            end_obj(ctx);
+        }
+
         end_obj(ctx);
     }
 
@@ -593,6 +672,16 @@ void config_destroy(config_t *c)
         free_string(&c->behavior.issuer.mtls.cert_path);
         free_string(&c->behavior.issuer.mtls.private_key_path);
 
+        free_string(&c->behavior.ipc.path);
+
+        free_string(&c->behavior.outbound.journal_path);
+
+        free_string(&c->behavior.logging.sink_path);
+
+        free_string(&c->behavior.tracing.path);
+
+        free_string(&c->behavior.introspection.path);
+
         free(c);
     }
 }
@@ -9,6 +9,7 @@
 #include <stddef.h>
 
 #include "../error/codes.h"
+#include "../logging/log.h"
 #include "../string.h"
 
 enum tls_version {
@@ -19,6 +20,12 @@ enum tls_version {
     TLS_VERSION__1_3
 };
 
+enum log_sink {
+    LOG_SINK__STDOUT = 0,
+    LOG_SINK__JOURNALD,
+    LOG_SINK__SYSLOG
+};
+
 struct interface {
     struct xa_string name;
     int cost;
@@ -48,9 +55,10 @@ typedef struct {
     struct {
         struct xa_string url;
         int ping_timeout;
+        int ping_tick; /* keepalive precision in ms */
         int backoff_max;
         int force_ip;
-        int verbosity_level;
+        int verbosity_level; /* 0 logs info and up, 1 adds debug, 2 trace, -1 only warn and up */
 
         size_t interface_count;
         struct interface *interfaces;
@@ -77,6 +85,44 @@ typedef struct {
                 struct xa_string private_key_path;
             } mtls;
         } issuer;
+
+        struct {
+            struct xa_string path; /* local service socket, unset disables it */
+        } ipc;
+
+        struct {
+            int batch_window; /* ms to wait for more messages */
+            int batch_bytes;  /* flush once this many bytes are waiting */
+            int queue_bytes;  /* total memory for the qos queues */
+
+            struct xa_string journal_path; /* unset disables the journal */
+            int journal_bytes;             /* size of the on-disk ring */
+            int journal_retention;         /* seconds to keep messages */
+        } outbound;
+
+        struct {
+            int async_lines; /* ring slots for async logging, 0 logs synchronously */
+            enum log_overflow overflow;
+            enum log_format format; /* binary needs async logging */
+            int subsecond_digits;   /* 0 to 9 digits of the second in timestamps */
+            int rate_limit;         /* lines per second per call site, 0 for no limit */
+            int rate_burst;         /* lines a call site may log at once */
+            enum log_repeats repeats;
+            enum log_sink sink;
+            struct xa_string sink_path; /* unset uses the usual socket */
+        } logging;
+
+        struct {
+            struct xa_string path; /* OTLP/JSON lines file, unset disables tracing */
+            int export_interval;   /* seconds between exports */
+            int max_spans;         /* open or waiting to be exported */
+            int sample_every;      /* trace 1 in N WRP messages */
+            int slow_ms;           /* and every one that takes this long */
+        } tracing;
+
+        struct {
+            struct xa_string path; /* metrics and state socket, unset disables it */
+        } introspection;
     } behavior;
 } config_t;
 
@@ -52,8 +52,10 @@ void config_print(const config_t *c)
         log_debug(COLOR "-- behavior --------------------------------------" RST);
         log_debug("%-*s: '%s'", offset, ".behavior.url", c->behavior.url.s);
         log_debug("%-*s: %d", offset, ".behavior.ping_timeout", c->behavior.ping_timeout);
+        log_debug("%-*s: %d", offset, ".behavior.ping_tick", c->behavior.ping_tick);
         log_debug("%-*s: %d", offset, ".behavior.backoff_max", c->behavior.backoff_max);
         log_debug("%-*s: %d", offset, ".behavior.force_ip", c->behavior.force_ip);
+        log_debug("%-*s: %d", offset, ".behavior.verbosity_level", c->behavior.verbosity_level);
         log_debug(COLOR "-- behavior.interface ----------------------------" RST);
         for (size_t i = 0; i < c->behavior.interface_count; i++) {
             log_debug(".behavior.interface[%zd].name: '%s'", i, c->behavior.interfaces[i].name.s);
@@ -67,6 +69,33 @@ void config_print(const config_t *c)
         }
         log_debug(COLOR "-- behavior.issuer -------------------------------" RST);
         log_debug("%-*s: '%s'", offset, ".behavior.issuer.url", c->behavior.issuer.url.s);
+        log_debug(COLOR "-- behavior.ipc ----------------------------------" RST);
+        log_debug("%-*s: '%s'", offset, ".behavior.ipc.path", c->behavior.ipc.path.s);
+        log_debug(COLOR "-- behavior.outbound -----------------------------" RST);
+        log_debug("%-*s: %d", offset, ".behavior.outbound.batch_window", c->behavior.outbound.batch_window);
+        log_debug("%-*s: %d", offset, ".behavior.outbound.batch_bytes", c->behavior.outbound.batch_bytes);
+        log_debug("%-*s: %d", offset, ".behavior.outbound.queue_bytes", c->behavior.outbound.queue_bytes);
+        log_debug("%-*s: '%s'", offset, ".behavior.outbound.journal_path", c->behavior.outbound.journal_path.s);
+        log_debug("%-*s: %d", offset, ".behavior.outbound.journal_bytes", c->behavior.outbound.journal_bytes);
+        log_debug("%-*s: %d", offset, ".behavior.outbound.journal_retention", c->behavior.outbound.journal_retention);
+        log_debug(COLOR "-- behavior.logging ------------------------------" RST);
+        log_debug("%-*s: %d", offset, ".behavior.logging.async_lines", c->behavior.logging.async_lines);
+        log_debug("%-*s: %d", offset, ".behavior.logging.overflow", c->behavior.logging.overflow);
+        log_debug("%-*s: %d", offset, ".behavior.logging.format", c->behavior.logging.format);
+        log_debug("%-*s: %d", offset, ".behavior.logging.subsecond_digits", c->behavior.logging.subsecond_digits);
+        log_debug("%-*s: %d", offset, ".behavior.logging.rate_limit", c->behavior.logging.rate_limit);
+        log_debug("%-*s: %d", offset, ".behavior.logging.rate_burst", c->behavior.logging.rate_burst);
+        log_debug("%-*s: %d", offset, ".behavior.logging.repeats", c->behavior.logging.repeats);
+        log_debug("%-*s: %d", offset, ".behavior.logging.sink", c->behavior.logging.sink);
+        log_debug("%-*s: '%s'", offset, ".behavior.logging.sink_path", c->behavior.logging.sink_path.s);
+        log_debug(COLOR "-- behavior.tracing ------------------------------" RST);
+        log_debug("%-*s: '%s'", offset, ".behavior.tracing.path", c->behavior.tracing.path.s);
+        log_debug("%-*s: %d", offset, ".behavior.tracing.export_interval", c->behavior.tracing.export_interval);
+        log_debug("%-*s: %d", offset, ".behavior.tracing.max_spans", c->behavior.tracing.max_spans);
+        log_debug("%-*s: %d", offset, ".behavior.tracing.sample_every", c->behavior.tracing.sample_every);
+        log_debug("%-*s: %d", offset, ".behavior.tracing.slow_ms", c->behavior.tracing.slow_ms);
+        log_debug(COLOR "-- behavior.introspection ------------------------" RST);
+        log_debug("%-*s: '%s'", offset, ".behavior.introspection.path", c->behavior.introspection.path.s);
         log_debug(COLOR "--------------------------------------------------" RST);
     }
 }
@@ -0,0 +1,298 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <curl/curl.h>
+
+#include "curl_loop.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct tracked {
+    CURL *easy;
+    curl_loop_done_fn fn;
+    void *user;
+    struct tracked *next;
+};
+
+struct curl_sock {
+    struct curl_loop *cl;
+    struct event_watch *w;
+};
+
+struct curl_loop {
+    struct event_loop *loop;
+    CURLM *multi;
+    struct event_timer *timer;
+    struct tracked *tracked;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void check_done(struct curl_loop *cl)
+{
+    CURLMsg *msg;
+    int left;
+
+    while (NULL != (msg = curl_multi_info_read(cl->multi, &left))) {
+        if (CURLMSG_DONE != msg->msg) {
+            continue;
+        }
+
+        for (struct tracked *t = cl->tracked; t; t = t->next) {
+            if (t->easy == msg->easy_handle) {
+                t->fn(t->easy, msg->data.result, t->user);
+                break;
+            }
+        }
+    }
+}
+
+
+static void on_socket(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct curl_sock *cs = (struct curl_sock *) user;
+    struct curl_loop *cl = cs->cl;
+    int flags            = 0;
+    int running;
+
+    (void) w;
+
+    if (EVENT__READABLE & events) {
+        flags |= CURL_CSELECT_IN;
+    }
+    if (EVENT__WRITABLE & events) {
+        flags |= CURL_CSELECT_OUT;
+    }
+    if ((EVENT__ERROR | EVENT__HANGUP) & events) {
+        flags |= CURL_CSELECT_ERR;
+    }
+
+    /* cs may be released by socket_cb() during this call. */
+    curl_multi_socket_action(cl->multi, fd, flags, &running);
+    check_done(cl);
+}
+
+
+static void on_timeout(struct event_timer *t, void *user)
+{
+    struct curl_loop *cl = (struct curl_loop *) user;
+    int running;
+
+    (void) t;
+
+    curl_multi_socket_action(cl->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_done(cl);
+}
+
+
+static int socket_cb(CURL *easy, curl_socket_t s, int what, void *userp,
+                     void *socketp)
+{
+    struct curl_loop *cl = (struct curl_loop *) userp;
+    struct curl_sock *cs = (struct curl_sock *) socketp;
+    unsigned events      = 0;
+
+    (void) easy;
+
+    if (CURL_POLL_REMOVE == what) {
+        if (cs) {
+            event_watch_remove(cs->w);
+            curl_multi_assign(cl->multi, s, NULL);
+            free(cs);
+        }
+        return 0;
+    }
+
+    if (CURL_POLL_IN & what) {
+        events |= EVENT__READABLE;
+    }
+    if (CURL_POLL_OUT & what) {
+        events |= EVENT__WRITABLE;
+    }
+
+    if (cs) {
+        event_watch_modify(cs->w, events, NULL);
+        return 0;
+    }
+
+    cs = calloc(1, sizeof(struct curl_sock));
+    if (!cs) {
+        return -1;
+    }
+    cs->cl = cl;
+    cs->w  = event_loop_watch(cl->loop, s, events, on_socket, cs, NULL);
+    if (!cs->w) {
+        free(cs);
+        return -1;
+    }
+    curl_multi_assign(cl->multi, s, cs);
+
+    return 0;
+}
+
+
+static int timer_cb(CURLM *multi, long timeout_ms, void *userp)
+{
+    struct curl_loop *cl = (struct curl_loop *) userp;
+
+    (void) multi;
+
+    if (timeout_ms < 0) {
+        event_timer_stop(cl->timer);
+    } else {
+        event_timer_start(cl->timer, (uint64_t) timeout_ms, 0);
+    }
+
+    return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct curl_loop *curl_loop_create(struct event_loop *loop, XAcode *err)
+{
+    struct curl_loop *cl = NULL;
+    XAcode e             = XA_OK;
+
+    if (!loop) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    cl = calloc(1, sizeof(struct curl_loop));
+    if (!cl) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    cl->loop  = loop;
+    cl->timer = event_timer_create(loop, on_timeout, cl, &e);
+    if (!cl->timer) {
+        curl_loop_destroy(cl);
+        xa_pass_error(err, e);
+        return NULL;
+    }
+
+    cl->multi = curl_multi_init();
+    if (!cl->multi) {
+        curl_loop_destroy(cl);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    curl_multi_setopt(cl->multi, CURLMOPT_SOCKETFUNCTION, socket_cb);
+    curl_multi_setopt(cl->multi, CURLMOPT_SOCKETDATA, cl);
+    curl_multi_setopt(cl->multi, CURLMOPT_TIMERFUNCTION, timer_cb);
+    curl_multi_setopt(cl->multi, CURLMOPT_TIMERDATA, cl);
+
+    return cl;
+}
+
+
+void curl_loop_destroy(struct curl_loop *cl)
+{
+    if (cl) {
+        while (cl->tracked) {
+            struct tracked *t = cl->tracked;
+            cl->tracked       = t->next;
+            free(t);
+        }
+        if (cl->multi) {
+            curl_multi_cleanup(cl->multi);
+        }
+        event_timer_destroy(cl->timer);
+        free(cl);
+    }
+}
+
+
+CURLM *curl_loop_multi(struct curl_loop *cl)
+{
+    return cl->multi;
+}
+
+
+XAcode curl_loop_track(struct curl_loop *cl, CURL *easy, curl_loop_done_fn fn,
+                       void *user, XAcode *err)
+{
+    struct tracked *t = NULL;
+
+    if (!cl || !easy || !fn) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    t = calloc(1, sizeof(struct tracked));
+    if (!t) {
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    t->easy     = easy;
+    t->fn       = fn;
+    t->user     = user;
+    t->next     = cl->tracked;
+    cl->tracked = t;
+
+    return XA_OK;
+}
+
+
+void curl_loop_untrack(struct curl_loop *cl, CURL *easy)
+{
+    struct tracked **p = &cl->tracked;
+
+    while (*p) {
+        if ((*p)->easy == easy) {
+            struct tracked *t = *p;
+            *p                = t->next;
+            free(t);
+            return;
+        }
+        p = &(*p)->next;
+    }
+}
+
+
+XAcode curl_loop_add(struct curl_loop *cl, CURL *easy, curl_loop_done_fn fn,
+                     void *user, XAcode *err)
+{
+    XAcode e = XA_OK;
+
+    if (XA_OK != curl_loop_track(cl, easy, fn, user, &e)) {
+        return xa_pass_error(err, e);
+    }
+
+    if (CURLM_OK != curl_multi_add_handle(cl->multi, easy)) {
+        curl_loop_untrack(cl, easy);
+        return xa_set_error(err, XA_INSUFFICIENT_RESOURCES);
+    }
+
+    return XA_OK;
+}
+
+
+void curl_loop_remove(struct curl_loop *cl, CURL *easy)
+{
+    curl_loop_untrack(cl, easy);
+    curl_multi_remove_handle(cl->multi, easy);
+}
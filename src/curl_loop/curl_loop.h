@@ -0,0 +1,79 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __CURL_LOOP_H__
+#define __CURL_LOOP_H__
+
+#include <curl/curl.h>
+
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+
+/* Drives a curl multi handle from the event loop using the multi socket API,
+ * so every curl based transfer (websocket, issuer requests, exporters) shares
+ * the one loop instead of blocking or polling. */
+
+struct curl_loop;
+
+/**
+ *  Called on the loop thread when a tracked transfer is complete.
+ *
+ *  @note Don't remove or cleanup the easy handle from inside this callback,
+ *        defer that work with a timer or event_loop_post().
+ */
+typedef void (*curl_loop_done_fn)(CURL *easy, CURLcode result, void *user);
+
+
+/**
+ *  Creates the multi handle and attaches it to the loop.
+ *
+ *  @return the curl_loop or NULL on failure
+ */
+struct curl_loop *curl_loop_create(struct event_loop *loop, XAcode *err);
+
+
+/**
+ *  Releases the multi handle.  All transfers must have been removed first.
+ */
+void curl_loop_destroy(struct curl_loop *cl);
+
+
+/**
+ *  Returns the multi handle so libraries that add their own easy handles
+ *  (curlws) can be attached.
+ */
+CURLM *curl_loop_multi(struct curl_loop *cl);
+
+
+/**
+ *  Registers interest in when the easy handle's transfer completes.  The
+ *  handle must be added to the multi handle separately.
+ *
+ *  @return XA_OK on success, XA_OUT_OF_MEMORY or XA_INVALID_INPUT otherwise
+ */
+XAcode curl_loop_track(struct curl_loop *cl, CURL *easy, curl_loop_done_fn fn,
+                       void *user, XAcode *err);
+
+
+/**
+ *  Stops tracking the easy handle.  An untracked handle is fine.
+ */
+void curl_loop_untrack(struct curl_loop *cl, CURL *easy);
+
+
+/**
+ *  Adds the easy handle to the multi handle and tracks it.
+ *
+ *  @return XA_OK on success, XA_OUT_OF_MEMORY or XA_INVALID_INPUT otherwise
+ */
+XAcode curl_loop_add(struct curl_loop *cl, CURL *easy, curl_loop_done_fn fn,
+                     void *user, XAcode *err);
+
+
+/**
+ *  Untracks and removes the easy handle from the multi handle.  The caller
+ *  still owns the easy handle.
+ */
+void curl_loop_remove(struct curl_loop *cl, CURL *easy);
+
+#endif
@@ -91,10 +91,10 @@ static XAcode skip_question(const struct dns_response *resp, int *i, XAcode *err
             *i += 4;
             return XA_OK;
         }
-        e = XA_DNS_RECORD_TOO_SHORT;
+        return xa_set_error(err, XA_DNS_RECORD_TOO_SHORT);
     }
 
-    return xa_set_error(err, e);
+    return xa_pass_error(err, e);
 }
 
 
@@ -371,7 +371,7 @@ XAcode dns_txt_fetch(const char *fqdn, struct dns_response **resp, XAcode *err)
 
     if (XA_OK != process_dns_response(p, &e)) {
         dns_destroy_response(p);
-        return xa_set_error(err, e);
+        return xa_pass_error(err, e);
     }
 
     *resp = p;
@@ -419,11 +419,11 @@ XAcode dns_token_assemble(const struct dns_response *resp,
         return XA_OK;
     }
 
-    e = XA_OUT_OF_MEMORY;
+    xa_set_error(&e, XA_OUT_OF_MEMORY);
 
 ERROR:
     if (t.buf) {
         free(t.buf);
     }
-    return xa_set_error(err, e);
+    return xa_pass_error(err, e);
 }
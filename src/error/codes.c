@@ -11,6 +11,8 @@
         .code = entry, .desc = #entry, \
     }
 
+#define CACHE_LINE 64
+
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
@@ -19,6 +21,12 @@ struct error_map {
     const char *desc;
 };
 
+/* Padded so threads failing with different codes don't contend. */
+struct error_count {
+    uint64_t n;
+    uint8_t pad[CACHE_LINE - 8];
+};
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
@@ -46,8 +54,15 @@ static struct error_map map[] = {
     MAKE_ERROR_MAP_ENTRY(XA_CLI_ERROR),
     MAKE_ERROR_MAP_ENTRY(XA_CONFIG_FILE_ERROR),
     MAKE_ERROR_MAP_ENTRY(XA_INSUFFICIENT_RESOURCES),
+    MAKE_ERROR_MAP_ENTRY(XA_EVENT_LOOP_ERROR),
+    MAKE_ERROR_MAP_ENTRY(XA_WEBSOCKET_ERROR),
+    MAKE_ERROR_MAP_ENTRY(XA_NOT_CONNECTED),
+    MAKE_ERROR_MAP_ENTRY(XA_INVALID_WRP),
+    MAKE_ERROR_MAP_ENTRY(XA_NO_ROUTE),
 };
 
+static struct error_count counts[XA_LAST];
+
 // clang-format off
 // TODO: Once we have the internet, find how to assert that our struct matches
 // all the values in the enum at compile time.
@@ -74,9 +89,33 @@ XAcode xa_set_error(XAcode *err, XAcode e)
         *err = e;
     }
 
+    if ((XA_OK < e) && (e < XA_LAST)) {
+        __atomic_fetch_add(&counts[e].n, 1, __ATOMIC_RELAXED);
+    }
+
     return e;
 }
 
+
+XAcode xa_pass_error(XAcode *err, XAcode e)
+{
+    if (err) {
+        *err = e;
+    }
+
+    return e;
+}
+
+
+uint64_t xa_error_count(XAcode e)
+{
+    if ((e <= XA_OK) || (XA_LAST <= e)) {
+        return 0;
+    }
+
+    return __atomic_load_n(&counts[e].n, __ATOMIC_RELAXED);
+}
+
 const char *xa_error_to_string(XAcode e)
 {
     int e_int = (int) e;
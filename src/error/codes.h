@@ -4,6 +4,8 @@
 #ifndef __CODES_H__
 #define __CODES_H__
 
+#include <stdint.h>
+
 /* All possible error codes from all the xmidt-agent functions. Future versions
  * may return other values.
  *
@@ -33,6 +35,11 @@ typedef enum {
     XA_CLI_ERROR,              /* 19 */
     XA_CONFIG_FILE_ERROR,      /* 20 */
     XA_INSUFFICIENT_RESOURCES, /* 21 */
+    XA_EVENT_LOOP_ERROR,       /* 22 */
+    XA_WEBSOCKET_ERROR,        /* 23 */
+    XA_NOT_CONNECTED,          /* 24 */
+    XA_INVALID_WRP,            /* 25 */
+    XA_NO_ROUTE,               /* 26 */
 
     XA_LAST /* never use! */
 } XAcode;
@@ -48,6 +55,22 @@ typedef enum {
 XAcode xa_set_error(XAcode *err, XAcode e);
 
 
+/**
+ * Like xa_set_error(), but for handing on an error code that a call already
+ * set, so it isn't counted twice.
+ *
+ * return xa_pass_error(err, e);
+ */
+XAcode xa_pass_error(XAcode *err, XAcode e);
+
+
+/**
+ * Get how many times xa_set_error() has set the error code, from any thread,
+ * so errors can be counted even where they aren't logged.
+ */
+uint64_t xa_error_count(XAcode e);
+
+
 /**
  * Convert the XAcode into a string for logging purposes.
  */
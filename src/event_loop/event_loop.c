@@ -0,0 +1,755 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAX_EVENTS_PER_PASS 64
+#define NOT_ACTIVE          SIZE_MAX
+#define NS_PER_MS           1000000ULL
+#define NS_PER_S            1000000000ULL
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct event_watch {
+    struct event_loop *loop;
+    int fd;
+    unsigned events;
+    event_watch_fn fn;
+    void *user;
+    bool removed;
+
+    /* The list of all live watches (or the graveyard once removed). */
+    struct event_watch *prev;
+    struct event_watch *next;
+};
+
+struct event_timer {
+    struct event_loop *loop;
+    event_timer_fn fn;
+    void *user;
+
+    uint64_t deadline; /* absolute monotonic ns */
+    uint64_t interval; /* ns, 0 = one shot */
+    size_t index;      /* position in the heap or NOT_ACTIVE */
+
+    struct event_timer *prev;
+    struct event_timer *next;
+};
+
+struct posted {
+    event_call_fn fn;
+    void *user;
+    struct posted *next;
+};
+
+struct event_loop {
+    int epfd;
+    int tfd;
+    int efd;
+
+    /* Internal watches for the timerfd and eventfd. */
+    struct event_watch timer_watch;
+    struct event_watch wake_watch;
+
+    int stop;       /* accessed atomically */
+    uint64_t now;   /* cached monotonic ns */
+    uint64_t armed; /* the deadline the timerfd is armed for, 0 = none */
+
+    /* A binary min-heap of the active timers ordered by deadline. */
+    struct event_timer **heap;
+    size_t heap_len;
+    size_t heap_cap;
+    size_t timer_count;
+
+    struct event_watch *watches;
+    struct event_watch *graveyard;
+    struct event_timer *timers;
+
+    /* Callbacks posted from other threads. */
+    pthread_mutex_t lock;
+    struct posted *head;
+    struct posted *tail;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * NS_PER_S) + (uint64_t) ts.tv_nsec;
+}
+
+
+static uint32_t to_epoll(unsigned events)
+{
+    uint32_t rv = 0;
+
+    if (EVENT__READABLE & events) {
+        rv |= EPOLLIN;
+    }
+    if (EVENT__WRITABLE & events) {
+        rv |= EPOLLOUT;
+    }
+
+    return rv;
+}
+
+
+static unsigned from_epoll(uint32_t events)
+{
+    unsigned rv = 0;
+
+    if (EPOLLIN & events) {
+        rv |= EVENT__READABLE;
+    }
+    if (EPOLLOUT & events) {
+        rv |= EVENT__WRITABLE;
+    }
+    if (EPOLLERR & events) {
+        rv |= EVENT__ERROR;
+    }
+    if ((EPOLLHUP | EPOLLRDHUP) & events) {
+        rv |= EVENT__HANGUP;
+    }
+
+    return rv;
+}
+
+
+static int epoll_op(struct event_watch *w, int op)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = to_epoll(w->events);
+    ev.data.ptr = w;
+
+    return epoll_ctl(w->loop->epfd, op, w->fd, &ev);
+}
+
+
+/*-------------------------------- Timer heap --------------------------------*/
+
+static void heap_set(struct event_loop *loop, size_t i, struct event_timer *t)
+{
+    loop->heap[i] = t;
+    t->index      = i;
+}
+
+
+static void heap_up(struct event_loop *loop, size_t i)
+{
+    struct event_timer *t = loop->heap[i];
+
+    while (0 < i) {
+        size_t parent = (i - 1) / 2;
+
+        if (loop->heap[parent]->deadline <= t->deadline) {
+            break;
+        }
+        heap_set(loop, i, loop->heap[parent]);
+        i = parent;
+    }
+    heap_set(loop, i, t);
+}
+
+
+static void heap_down(struct event_loop *loop, size_t i)
+{
+    struct event_timer *t = loop->heap[i];
+
+    while (1) {
+        size_t child = (2 * i) + 1;
+
+        if (loop->heap_len <= child) {
+            break;
+        }
+        if (((child + 1) < loop->heap_len)
+            && (loop->heap[child + 1]->deadline < loop->heap[child]->deadline))
+        {
+            child++;
+        }
+        if (t->deadline <= loop->heap[child]->deadline) {
+            break;
+        }
+        heap_set(loop, i, loop->heap[child]);
+        i = child;
+    }
+    heap_set(loop, i, t);
+}
+
+
+static void heap_remove(struct event_loop *loop, struct event_timer *t)
+{
+    size_t i = t->index;
+
+    t->index = NOT_ACTIVE;
+    loop->heap_len--;
+
+    if (i != loop->heap_len) {
+        struct event_timer *moved = loop->heap[loop->heap_len];
+
+        heap_set(loop, i, moved);
+        heap_down(loop, i);
+        heap_up(loop, moved->index);
+    }
+}
+
+
+/**
+ *  The heap always has room for every timer that exists (see
+ *  event_timer_create()) so inserting can't fail.
+ */
+static void heap_insert(struct event_loop *loop, struct event_timer *t)
+{
+    heap_set(loop, loop->heap_len, t);
+    loop->heap_len++;
+    heap_up(loop, t->index);
+}
+
+
+static bool heap_reserve(struct event_loop *loop, size_t count)
+{
+    if (loop->heap_cap < count) {
+        size_t cap                = (loop->heap_cap) ? (2 * loop->heap_cap) : 16;
+        struct event_timer **heap = realloc(loop->heap, cap * sizeof(struct event_timer *));
+
+        if (!heap) {
+            return false;
+        }
+        loop->heap     = heap;
+        loop->heap_cap = cap;
+    }
+
+    return true;
+}
+
+
+/**
+ *  Makes sure the timerfd will fire no later than the nearest deadline.  The
+ *  timerfd is only re-armed when the nearest deadline moves earlier, so a
+ *  stopped timer may produce one spurious (and harmless) wakeup.
+ */
+static void arm(struct event_loop *loop)
+{
+    struct itimerspec its;
+    uint64_t deadline;
+
+    if (0 == loop->heap_len) {
+        return;
+    }
+
+    deadline = loop->heap[0]->deadline;
+    if ((0 != loop->armed) && (loop->armed <= deadline)) {
+        return;
+    }
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = (time_t) (deadline / NS_PER_S);
+    its.it_value.tv_nsec = (long) (deadline % NS_PER_S);
+
+    if (0 == timerfd_settime(loop->tfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+        loop->armed = deadline;
+    }
+}
+
+
+static void run_timers(struct event_loop *loop)
+{
+    /* Bound the work so a timer that keeps restarting itself with no delay
+     * can't starve the rest of the loop. */
+    size_t budget = loop->heap_len;
+
+    while ((0 < budget) && (0 < loop->heap_len)
+           && (loop->heap[0]->deadline <= loop->now))
+    {
+        struct event_timer *t = loop->heap[0];
+
+        heap_remove(loop, t);
+        if (0 != t->interval) {
+            t->deadline += t->interval;
+            if (t->deadline <= loop->now) {
+                /* We fell behind; don't try to catch up with a burst. */
+                t->deadline = loop->now + t->interval;
+            }
+            heap_insert(loop, t);
+        }
+
+        /* The timer may be restarted, stopped or destroyed by the callback
+         * so it must not be touched afterwards. */
+        t->fn(t, t->user);
+        budget--;
+    }
+}
+
+
+static void on_timerfd(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct event_loop *loop = (struct event_loop *) user;
+    uint64_t expirations;
+    ssize_t n;
+
+    (void) w;
+    (void) events;
+
+    n = read(fd, &expirations, sizeof(expirations));
+    (void) n;
+
+    loop->armed = 0;
+    run_timers(loop);
+    arm(loop);
+}
+
+
+static void on_eventfd(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct event_loop *loop = (struct event_loop *) user;
+    struct posted *list     = NULL;
+    uint64_t count;
+    ssize_t n;
+
+    (void) w;
+    (void) events;
+
+    n = read(fd, &count, sizeof(count));
+    (void) n;
+
+    pthread_mutex_lock(&loop->lock);
+    list       = loop->head;
+    loop->head = NULL;
+    loop->tail = NULL;
+    pthread_mutex_unlock(&loop->lock);
+
+    while (list) {
+        struct posted *p = list;
+        list             = list->next;
+
+        p->fn(p->user);
+        free(p);
+    }
+}
+
+
+static void internal_watch(struct event_loop *loop, struct event_watch *w,
+                           int fd, event_watch_fn fn)
+{
+    w->loop   = loop;
+    w->fd     = fd;
+    w->events = EVENT__READABLE;
+    w->fn     = fn;
+    w->user   = loop;
+}
+
+
+static void bury_the_dead(struct event_loop *loop)
+{
+    while (loop->graveyard) {
+        struct event_watch *w = loop->graveyard;
+        loop->graveyard       = w->next;
+        free(w);
+    }
+}
+
+
+static void unlink_watch(struct event_watch *w)
+{
+    if (w->prev) {
+        w->prev->next = w->next;
+    } else {
+        w->loop->watches = w->next;
+    }
+    if (w->next) {
+        w->next->prev = w->prev;
+    }
+    w->prev = NULL;
+    w->next = NULL;
+}
+
+
+static void unlink_timer(struct event_timer *t)
+{
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        t->loop->timers = t->next;
+    }
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct event_loop *event_loop_create(XAcode *err)
+{
+    struct event_loop *loop = calloc(1, sizeof(struct event_loop));
+
+    if (!loop) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->tfd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->efd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_init(&loop->lock, NULL);
+
+    internal_watch(loop, &loop->timer_watch, loop->tfd, on_timerfd);
+    internal_watch(loop, &loop->wake_watch, loop->efd, on_eventfd);
+
+    if ((loop->epfd < 0) || (loop->tfd < 0) || (loop->efd < 0)
+        || (0 != epoll_op(&loop->timer_watch, EPOLL_CTL_ADD))
+        || (0 != epoll_op(&loop->wake_watch, EPOLL_CTL_ADD)))
+    {
+        event_loop_destroy(loop);
+        xa_set_error(err, XA_EVENT_LOOP_ERROR);
+        return NULL;
+    }
+
+    loop->now = monotonic_ns();
+
+    return loop;
+}
+
+
+void event_loop_destroy(struct event_loop *loop)
+{
+    if (!loop) {
+        return;
+    }
+
+    while (loop->watches) {
+        event_watch_remove(loop->watches);
+    }
+    bury_the_dead(loop);
+
+    while (loop->timers) {
+        event_timer_destroy(loop->timers);
+    }
+    free(loop->heap);
+
+    while (loop->head) {
+        struct posted *p = loop->head;
+        loop->head       = p->next;
+        free(p);
+    }
+    pthread_mutex_destroy(&loop->lock);
+
+    if (0 <= loop->efd) {
+        close(loop->efd);
+    }
+    if (0 <= loop->tfd) {
+        close(loop->tfd);
+    }
+    if (0 <= loop->epfd) {
+        close(loop->epfd);
+    }
+
+    free(loop);
+}
+
+
+XAcode event_loop_run(struct event_loop *loop, XAcode *err)
+{
+    XAcode rv = XA_OK;
+
+    if (!loop) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    while (!__atomic_load_n(&loop->stop, __ATOMIC_ACQUIRE)) {
+        if (XA_OK != event_loop_run_once(loop, -1, &rv)) {
+            break;
+        }
+    }
+    __atomic_store_n(&loop->stop, 0, __ATOMIC_RELEASE);
+
+    return xa_pass_error(err, rv);
+}
+
+
+XAcode event_loop_run_once(struct event_loop *loop, int timeout_ms, XAcode *err)
+{
+    struct epoll_event events[MAX_EVENTS_PER_PASS];
+    int count;
+
+    if (!loop) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    count     = epoll_wait(loop->epfd, events, MAX_EVENTS_PER_PASS, timeout_ms);
+    loop->now = monotonic_ns();
+
+    if (count < 0) {
+        if (EINTR == errno) {
+            return XA_OK;
+        }
+        return xa_set_error(err, XA_EVENT_LOOP_ERROR);
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct event_watch *w = (struct event_watch *) events[i].data.ptr;
+
+        /* A previous callback in this pass may have removed the watch. */
+        if (!w->removed) {
+            w->fn(w, w->fd, from_epoll(events[i].events), w->user);
+        }
+    }
+
+    bury_the_dead(loop);
+
+    return XA_OK;
+}
+
+
+void event_loop_stop(struct event_loop *loop)
+{
+    if (loop) {
+        __atomic_store_n(&loop->stop, 1, __ATOMIC_RELEASE);
+        event_loop_wakeup(loop);
+    }
+}
+
+
+void event_loop_wakeup(struct event_loop *loop)
+{
+    uint64_t one = 1;
+    ssize_t n;
+
+    if (loop) {
+        /* Only write(2) so this stays async-signal-safe.  If the counter is
+         * saturated the loop is already going to wake up. */
+        n = write(loop->efd, &one, sizeof(one));
+        (void) n;
+    }
+}
+
+
+XAcode event_loop_post(struct event_loop *loop, event_call_fn fn, void *user,
+                       XAcode *err)
+{
+    struct posted *p = NULL;
+
+    if (!loop || !fn) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    p = calloc(1, sizeof(struct posted));
+    if (!p) {
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+    p->fn   = fn;
+    p->user = user;
+
+    pthread_mutex_lock(&loop->lock);
+    if (loop->tail) {
+        loop->tail->next = p;
+    } else {
+        loop->head = p;
+    }
+    loop->tail = p;
+    pthread_mutex_unlock(&loop->lock);
+
+    event_loop_wakeup(loop);
+
+    return XA_OK;
+}
+
+
+uint64_t event_loop_now_ms(const struct event_loop *loop)
+{
+    return loop->now / NS_PER_MS;
+}
+
+
+struct event_watch *event_loop_watch(struct event_loop *loop, int fd,
+                                     unsigned events, event_watch_fn fn,
+                                     void *user, XAcode *err)
+{
+    struct event_watch *w = NULL;
+
+    if (!loop || (fd < 0) || !fn) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    w = calloc(1, sizeof(struct event_watch));
+    if (!w) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    w->loop   = loop;
+    w->fd     = fd;
+    w->events = events & (EVENT__READABLE | EVENT__WRITABLE);
+    w->fn     = fn;
+    w->user   = user;
+
+    if (0 != epoll_op(w, EPOLL_CTL_ADD)) {
+        free(w);
+        xa_set_error(err, XA_EVENT_LOOP_ERROR);
+        return NULL;
+    }
+
+    w->next = loop->watches;
+    if (loop->watches) {
+        loop->watches->prev = w;
+    }
+    loop->watches = w;
+
+    return w;
+}
+
+
+XAcode event_watch_modify(struct event_watch *w, unsigned events, XAcode *err)
+{
+    if (!w || w->removed) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    events &= (EVENT__READABLE | EVENT__WRITABLE);
+    if (events == w->events) {
+        return XA_OK;
+    }
+
+    w->events = events;
+    if (0 != epoll_op(w, EPOLL_CTL_MOD)) {
+        return xa_set_error(err, XA_EVENT_LOOP_ERROR);
+    }
+
+    return XA_OK;
+}
+
+
+unsigned event_watch_events(const struct event_watch *w)
+{
+    return w->events;
+}
+
+
+void event_watch_remove(struct event_watch *w)
+{
+    struct event_loop *loop;
+
+    if (!w || w->removed) {
+        return;
+    }
+
+    loop = w->loop;
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, w->fd, NULL);
+    unlink_watch(w);
+
+    /* Events for this watch may still be pending in the current dispatch
+     * pass, so the memory is released once the pass is complete. */
+    w->removed      = true;
+    w->next         = loop->graveyard;
+    loop->graveyard = w;
+}
+
+
+struct event_timer *event_timer_create(struct event_loop *loop,
+                                       event_timer_fn fn, void *user,
+                                       XAcode *err)
+{
+    struct event_timer *t = NULL;
+
+    if (!loop || !fn) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    t = calloc(1, sizeof(struct event_timer));
+    if (!t || !heap_reserve(loop, loop->timer_count + 1)) {
+        free(t);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    loop->timer_count++;
+
+    t->loop  = loop;
+    t->fn    = fn;
+    t->user  = user;
+    t->index = NOT_ACTIVE;
+
+    t->next = loop->timers;
+    if (loop->timers) {
+        loop->timers->prev = t;
+    }
+    loop->timers = t;
+
+    return t;
+}
+
+
+void event_timer_start(struct event_timer *t, uint64_t delay_ms,
+                       uint64_t interval_ms)
+{
+    struct event_loop *loop = t->loop;
+
+    event_timer_stop(t);
+
+    t->deadline = monotonic_ns() + (delay_ms * NS_PER_MS);
+    t->interval = interval_ms * NS_PER_MS;
+
+    heap_insert(loop, t);
+    arm(loop);
+}
+
+
+void event_timer_stop(struct event_timer *t)
+{
+    if (NOT_ACTIVE != t->index) {
+        heap_remove(t->loop, t);
+    }
+}
+
+
+bool event_timer_is_active(const struct event_timer *t)
+{
+    return (NOT_ACTIVE != t->index);
+}
+
+
+void event_timer_destroy(struct event_timer *t)
+{
+    if (t) {
+        event_timer_stop(t);
+        unlink_timer(t);
+        t->loop->timer_count--;
+        free(t);
+    }
+}
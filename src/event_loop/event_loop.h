@@ -0,0 +1,204 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* The event loop is the single place the agent waits.  Everything that needs
+ * to react to a file descriptor, a deadline or a request from another thread
+ * registers here instead of polling.
+ *
+ * It is built on epoll, with one timerfd that is always armed for the nearest
+ * timer deadline and one eventfd used to wake the loop from other threads (or
+ * signal handlers).
+ *
+ * Unless noted otherwise, all functions must be called from the thread that
+ * runs the loop.
+ */
+
+struct event_loop;
+struct event_watch;
+struct event_timer;
+
+enum event_flags {
+    EVENT__READABLE = 0x01,
+    EVENT__WRITABLE = 0x02,
+    EVENT__ERROR    = 0x04, /* Only reported, never needs to be requested. */
+    EVENT__HANGUP   = 0x08, /* Only reported, never needs to be requested. */
+};
+
+/**
+ *  Called when the watched file descriptor is ready.
+ *
+ *  @param w      the watch that fired
+ *  @param fd     the file descriptor being watched
+ *  @param events the enum event_flags that are ready
+ *  @param user   the user pointer provided when the watch was made
+ */
+typedef void (*event_watch_fn)(struct event_watch *w, int fd, unsigned events,
+                               void *user);
+
+/**
+ *  Called when a timer expires.  It is safe to restart, stop or destroy the
+ *  timer from inside this callback.
+ */
+typedef void (*event_timer_fn)(struct event_timer *t, void *user);
+
+/**
+ *  Called on the loop thread as the result of event_loop_post().
+ */
+typedef void (*event_call_fn)(void *user);
+
+
+/**
+ *  Creates a new event loop.
+ *
+ *  @param err the error code if there was a failure
+ *
+ *  @return the loop or NULL on failure (XA_OUT_OF_MEMORY, XA_EVENT_LOOP_ERROR)
+ */
+struct event_loop *event_loop_create(XAcode *err);
+
+
+/**
+ *  Destroys the loop.  Any watches and timers still registered are released,
+ *  but the watched file descriptors are not closed.  Callbacks posted but not
+ *  yet run are discarded.
+ */
+void event_loop_destroy(struct event_loop *loop);
+
+
+/**
+ *  Runs the loop until event_loop_stop() is called.
+ *
+ *  @return XA_OK on a requested stop, XA_EVENT_LOOP_ERROR otherwise
+ */
+XAcode event_loop_run(struct event_loop *loop, XAcode *err);
+
+
+/**
+ *  Waits for at most timeout_ms (-1 = forever, 0 = don't wait) and dispatches
+ *  whatever is ready before returning.
+ *
+ *  @return XA_OK on success, XA_EVENT_LOOP_ERROR otherwise
+ */
+XAcode event_loop_run_once(struct event_loop *loop, int timeout_ms, XAcode *err);
+
+
+/**
+ *  Asks the loop to return from event_loop_run() after the current dispatch
+ *  pass.
+ *
+ *  @note This is thread safe and async-signal-safe.
+ */
+void event_loop_stop(struct event_loop *loop);
+
+
+/**
+ *  Wakes the loop so it completes a dispatch pass.
+ *
+ *  @note This is thread safe and async-signal-safe.
+ */
+void event_loop_wakeup(struct event_loop *loop);
+
+
+/**
+ *  Queues fn to be called on the loop thread and wakes the loop.  Callbacks
+ *  run in the order they were posted.
+ *
+ *  @note This is thread safe, but not async-signal-safe.
+ *
+ *  @return XA_OK on success, XA_OUT_OF_MEMORY or XA_INVALID_INPUT otherwise
+ */
+XAcode event_loop_post(struct event_loop *loop, event_call_fn fn, void *user,
+                       XAcode *err);
+
+
+/**
+ *  The monotonic time in milliseconds captured when the loop last woke up.
+ *  This is cheap enough to call for every message.
+ */
+uint64_t event_loop_now_ms(const struct event_loop *loop);
+
+
+/**
+ *  Starts watching fd for the requested events.  The fd is not owned by the
+ *  loop and must be removed before it is closed.
+ *
+ *  @param loop   the loop to add the watch to
+ *  @param fd     the file descriptor to watch
+ *  @param events the EVENT__READABLE and/or EVENT__WRITABLE flags
+ *  @param fn     the function to call when ready
+ *  @param user   the user pointer passed to fn
+ *  @param err    the error code if there was a failure
+ *
+ *  @return the watch or NULL on failure
+ */
+struct event_watch *event_loop_watch(struct event_loop *loop, int fd,
+                                     unsigned events, event_watch_fn fn,
+                                     void *user, XAcode *err);
+
+
+/**
+ *  Changes the events a watch is interested in.  Passing 0 keeps the watch
+ *  registered, but paused.
+ *
+ *  @return XA_OK on success, XA_EVENT_LOOP_ERROR otherwise
+ */
+XAcode event_watch_modify(struct event_watch *w, unsigned events, XAcode *err);
+
+
+/**
+ *  Returns the events a watch is currently interested in.
+ */
+unsigned event_watch_events(const struct event_watch *w);
+
+
+/**
+ *  Stops watching and releases the watch.  This is safe to call from inside
+ *  any callback, including the watch's own.  A NULL watch is fine.
+ */
+void event_watch_remove(struct event_watch *w);
+
+
+/**
+ *  Creates a timer that is not running.
+ *
+ *  @return the timer or NULL on failure (XA_OUT_OF_MEMORY, XA_INVALID_INPUT)
+ */
+struct event_timer *event_timer_create(struct event_loop *loop,
+                                       event_timer_fn fn, void *user,
+                                       XAcode *err);
+
+
+/**
+ *  (Re)starts the timer so it fires after delay_ms and then every interval_ms
+ *  if interval_ms is not 0.
+ */
+void event_timer_start(struct event_timer *t, uint64_t delay_ms,
+                       uint64_t interval_ms);
+
+
+/**
+ *  Stops the timer if it is running.
+ */
+void event_timer_stop(struct event_timer *t);
+
+
+/**
+ *  Returns true if the timer is scheduled to fire.
+ */
+bool event_timer_is_active(const struct event_timer *t);
+
+
+/**
+ *  Stops and releases the timer.  A NULL timer is fine.
+ */
+void event_timer_destroy(struct event_timer *t);
+
+#endif
@@ -0,0 +1,291 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "timer_wheel.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SLOT_MASK ((uint64_t) TIMER_WHEEL_SLOTS - 1)
+
+/* The furthest a timer can be placed; longer delays are clamped and simply
+ * re-armed by the owner when they fire early. */
+#define MAX_TICKS ((UINT64_C(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct timer_wheel {
+    struct event_loop *loop;
+    struct event_timer *ticker;
+
+    uint64_t tick_ms;
+    uint64_t origin_ms;
+    uint64_t now; /* the last tick processed */
+    size_t armed;
+
+    /* Each slot is the sentinel of a circular doubly linked list. */
+    struct wheel_timer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void list_init(struct wheel_timer *head)
+{
+    head->next = head;
+    head->prev = head;
+}
+
+
+static void unlink_timer(struct wheel_timer *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next       = NULL;
+    t->prev       = NULL;
+}
+
+
+static void place(struct timer_wheel *w, struct wheel_timer *t)
+{
+    uint64_t delta = t->expires - w->now;
+    struct wheel_timer *head;
+    int level = 0;
+
+    while ((level < (TIMER_WHEEL_LEVELS - 1))
+           && ((UINT64_C(1) << (TIMER_WHEEL_BITS * (level + 1))) <= delta))
+    {
+        level++;
+    }
+
+    head = &w->slots[level][(t->expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+
+    t->prev          = head->prev;
+    t->next          = head;
+    head->prev->next = t;
+    head->prev       = t;
+}
+
+
+/* Moves every timer in the slot down to the level that now fits it. */
+static void cascade(struct timer_wheel *w, int level, uint64_t slot)
+{
+    struct wheel_timer *head = &w->slots[level][slot];
+    struct wheel_timer list;
+
+    if (head->next == head) {
+        return;
+    }
+
+    list.next       = head->next;
+    list.prev       = head->prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    list_init(head);
+
+    while (list.next != &list) {
+        struct wheel_timer *t = list.next;
+        unlink_timer(t);
+        place(w, t);
+    }
+}
+
+
+static void tick(struct timer_wheel *w)
+{
+    struct wheel_timer *head;
+    struct wheel_timer list;
+
+    w->now++;
+
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t below = w->now >> (TIMER_WHEEL_BITS * (level - 1));
+        if (0 != (below & SLOT_MASK)) {
+            break;
+        }
+        cascade(w, level, (w->now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    }
+
+    head = &w->slots[0][w->now & SLOT_MASK];
+    if (head->next == head) {
+        return;
+    }
+
+    /* Detach the expired timers first so callbacks can freely re-arm. */
+    list.next       = head->next;
+    list.prev       = head->prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    list_init(head);
+
+    while (list.next != &list) {
+        struct wheel_timer *t = list.next;
+        unlink_timer(t);
+        w->armed--;
+        t->fn(t, t->user);
+    }
+}
+
+
+static void on_tick(struct event_timer *t, void *user)
+{
+    struct timer_wheel *w = (struct timer_wheel *) user;
+
+    timer_wheel_advance(w, event_loop_now_ms(w->loop) - w->origin_ms);
+
+    if (0 == w->armed) {
+        event_timer_stop(t);
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct timer_wheel *timer_wheel_create(struct event_loop *loop,
+                                       uint64_t tick_ms, XAcode *err)
+{
+    struct timer_wheel *w = NULL;
+
+    if (!loop || (0 == tick_ms)) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    w = calloc(1, sizeof(struct timer_wheel));
+    if (!w) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    w->ticker = event_timer_create(loop, on_tick, w, err);
+    if (!w->ticker) {
+        free(w);
+        return NULL;
+    }
+
+    w->loop      = loop;
+    w->tick_ms   = tick_ms;
+    w->origin_ms = event_loop_now_ms(loop);
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&w->slots[level][slot]);
+        }
+    }
+
+    return w;
+}
+
+
+void timer_wheel_destroy(struct timer_wheel *w)
+{
+    if (w) {
+        for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+            for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+                struct wheel_timer *head = &w->slots[level][slot];
+                while (head->next != head) {
+                    struct wheel_timer *t = head->next;
+                    unlink_timer(t);
+                    t->wheel = NULL;
+                }
+            }
+        }
+        event_timer_destroy(w->ticker);
+        free(w);
+    }
+}
+
+
+uint64_t timer_wheel_now(const struct timer_wheel *w)
+{
+    return w->now;
+}
+
+
+uint64_t timer_wheel_tick_ms(const struct timer_wheel *w)
+{
+    return w->tick_ms;
+}
+
+
+void timer_wheel_advance(struct timer_wheel *w, uint64_t now_ms)
+{
+    uint64_t target = now_ms / w->tick_ms;
+
+    /* Nothing can fire, so skip the idle ticks entirely. */
+    if ((0 == w->armed) && (w->now < target)) {
+        w->now = target;
+    }
+
+    while (w->now < target) {
+        tick(w);
+    }
+}
+
+
+void wheel_timer_init(struct wheel_timer *t, wheel_timer_fn fn, void *user)
+{
+    memset(t, 0, sizeof(struct wheel_timer));
+    t->fn   = fn;
+    t->user = user;
+}
+
+
+void wheel_timer_set(struct timer_wheel *w, struct wheel_timer *t,
+                     uint64_t ticks)
+{
+    bool rearm = (NULL != t->next);
+
+    if (rearm) {
+        unlink_timer(t);
+    } else if (0 == w->armed) {
+        /* Catch up with the time spent idle before placing anything. */
+        timer_wheel_advance(w, event_loop_now_ms(w->loop) - w->origin_ms);
+        event_timer_start(w->ticker, w->tick_ms, w->tick_ms);
+    }
+
+    if (0 == ticks) {
+        ticks = 1;
+    }
+    if (MAX_TICKS < ticks) {
+        ticks = MAX_TICKS;
+    }
+
+    t->wheel   = w;
+    t->expires = w->now + ticks;
+    place(w, t);
+
+    if (!rearm) {
+        w->armed++;
+    }
+}
+
+
+void wheel_timer_cancel(struct wheel_timer *t)
+{
+    if (t->next) {
+        unlink_timer(t);
+        t->wheel->armed--;
+    }
+}
+
+
+bool wheel_timer_is_active(const struct wheel_timer *t)
+{
+    return (NULL != t->next);
+}
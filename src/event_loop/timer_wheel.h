@@ -0,0 +1,109 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "event_loop.h"
+
+/* A hierarchical timer wheel for the large number of coarse timeouts that are
+ * pushed back far more often than they ever expire (keepalives, idle
+ * timeouts).  Arming, re-arming and cancelling are O(1) and never touch the
+ * kernel; the wheel only costs one event loop timer ticking at the configured
+ * resolution, and only while something is armed.
+ *
+ * Timers are intrusive: the caller owns the struct wheel_timer (typically
+ * embedded in a larger object) and nothing is allocated per timer.
+ */
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SLOTS  (1 << TIMER_WHEEL_BITS)
+
+struct timer_wheel;
+struct wheel_timer;
+
+/**
+ *  Called when a wheel timer expires.  It is safe to re-arm or cancel any
+ *  timer (including this one) from inside this callback.
+ */
+typedef void (*wheel_timer_fn)(struct wheel_timer *t, void *user);
+
+/* Treat as opaque, it is only public so it can be embedded. */
+struct wheel_timer {
+    struct wheel_timer *next;
+    struct wheel_timer *prev;
+    struct timer_wheel *wheel;
+    uint64_t expires; /* in ticks */
+    wheel_timer_fn fn;
+    void *user;
+};
+
+
+/**
+ *  Creates a wheel that advances every tick_ms on the loop.  Timers fire on
+ *  the first tick at or after their deadline, so tick_ms is the precision.
+ *
+ *  @return the wheel or NULL on failure
+ */
+struct timer_wheel *timer_wheel_create(struct event_loop *loop,
+                                       uint64_t tick_ms, XAcode *err);
+
+
+/**
+ *  Destroys the wheel.  Any armed timers are left unarmed.
+ */
+void timer_wheel_destroy(struct timer_wheel *w);
+
+
+/**
+ *  Returns the current tick of the wheel.  This is a plain load, so it is the
+ *  cheap way to timestamp frequent events relative to the wheel.
+ */
+uint64_t timer_wheel_now(const struct timer_wheel *w);
+
+
+/**
+ *  Returns the wheel resolution in milliseconds.
+ */
+uint64_t timer_wheel_tick_ms(const struct timer_wheel *w);
+
+
+/**
+ *  Processes every tick up to now_ms (milliseconds since the wheel was
+ *  created).  The loop does this automatically; it is exposed for tests.
+ */
+void timer_wheel_advance(struct timer_wheel *w, uint64_t now_ms);
+
+
+/**
+ *  Prepares a timer for use.  Must be called once before anything else.
+ */
+void wheel_timer_init(struct wheel_timer *t, wheel_timer_fn fn, void *user);
+
+
+/**
+ *  Arms (or re-arms) the timer to expire after the given number of ticks.  A
+ *  value of 0 is treated as 1 (the next tick).  A timer must stay on the
+ *  same wheel while it is armed.
+ */
+void wheel_timer_set(struct timer_wheel *w, struct wheel_timer *t,
+                     uint64_t ticks);
+
+
+/**
+ *  Disarms the timer.  Disarming an unarmed timer is fine.
+ */
+void wheel_timer_cancel(struct wheel_timer *t);
+
+
+/**
+ *  Returns if the timer is armed.
+ */
+bool wheel_timer_is_active(const struct wheel_timer *t);
+
+#endif
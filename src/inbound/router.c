@@ -0,0 +1,283 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/hashmap.h>
+#include <cutils/strings.h>
+
+#include "router.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct route {
+    char *service; /* the hashmap key points here */
+    size_t len;
+    route_fn fn;
+    void *user;
+};
+
+struct router {
+    hashmap_t services;
+    struct route *wildcard;
+};
+
+struct user_match {
+    const void *user;
+    size_t removed;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void route_destroy(struct route *route)
+{
+    if (route) {
+        free(route->service);
+        free(route);
+    }
+}
+
+
+static int free_route(void *const ctx, struct hashmap_element *const e)
+{
+    (void) ctx;
+
+    route_destroy((struct route *) e->data);
+
+    return -1; /* remove the element */
+}
+
+
+static int free_user_route(void *const ctx, struct hashmap_element *const e)
+{
+    struct user_match *m = (struct user_match *) ctx;
+    struct route *route  = (struct route *) e->data;
+
+    if (route->user != m->user) {
+        return 0;
+    }
+
+    route_destroy(route);
+    m->removed++;
+
+    return -1; /* remove the element */
+}
+
+
+static bool is_wildcard(const char *service)
+{
+    return (0 == strcmp(service, ROUTER_WILDCARD));
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct router *router_create(XAcode *err)
+{
+    struct router *r = calloc(1, sizeof(struct router));
+
+    if (!r) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    return r;
+}
+
+
+void router_destroy(struct router *r)
+{
+    if (r) {
+        hashmap_iterate_pairs(&r->services, &free_route, NULL);
+        hashmap_destroy(&r->services);
+        route_destroy(r->wildcard);
+        free(r);
+    }
+}
+
+
+XAcode router_register(struct router *r, const char *service, route_fn fn,
+                       void *user, XAcode *err)
+{
+    struct route *route;
+    size_t len;
+
+    if (!r || !service || !fn) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    /* A service name is a single path segment. */
+    len = strlen(service);
+    if (!len || strchr(service, '/')) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (is_wildcard(service)) {
+        if (r->wildcard) {
+            return xa_set_error(err, XA_INVALID_INPUT);
+        }
+    } else if (hashmap_get(&r->services, service, len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    route = calloc(1, sizeof(struct route));
+    if (!route) {
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    route->service = cu_strndup(service, len);
+    route->len     = len;
+    route->fn      = fn;
+    route->user    = user;
+
+    if (!route->service) {
+        route_destroy(route);
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    if (is_wildcard(service)) {
+        r->wildcard = route;
+    } else if (0 != hashmap_put(&r->services, route->service, route->len, route)) {
+        route_destroy(route);
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    return XA_OK;
+}
+
+
+bool router_unregister(struct router *r, const char *service)
+{
+    struct route *route;
+    size_t len;
+
+    if (!r || !service) {
+        return false;
+    }
+
+    if (is_wildcard(service)) {
+        route       = r->wildcard;
+        r->wildcard = NULL;
+        route_destroy(route);
+        return (NULL != route);
+    }
+
+    len   = strlen(service);
+    route = (struct route *) hashmap_get(&r->services, service, len);
+    if (!route) {
+        return false;
+    }
+
+    hashmap_remove(&r->services, service, len);
+    route_destroy(route);
+
+    return true;
+}
+
+
+size_t router_unregister_user(struct router *r, const void *user)
+{
+    struct user_match m = { .user = user, .removed = 0 };
+
+    if (!r) {
+        return 0;
+    }
+
+    hashmap_iterate_pairs(&r->services, &free_user_route, &m);
+
+    if (r->wildcard && (r->wildcard->user == user)) {
+        route_destroy(r->wildcard);
+        r->wildcard = NULL;
+        m.removed++;
+    }
+
+    return m.removed;
+}
+
+
+size_t router_count(const struct router *r)
+{
+    if (!r) {
+        return 0;
+    }
+
+    return hashmap_num_entries((hashmap_t *) &r->services);
+}
+
+
+struct xa_const_string router_dest_service(const struct xa_const_string *dest)
+{
+    struct xa_const_string rv = { .len = 0, .s = "" };
+    const char *p, *end, *start;
+
+    if (!dest || !dest->s) {
+        return rv;
+    }
+
+    p   = dest->s;
+    end = dest->s + dest->len;
+
+    /* Skip the "scheme:authority" part. */
+    while (p < end && '/' != *p) {
+        p++;
+    }
+    if (end <= p) {
+        return rv;
+    }
+
+    start = ++p;
+    while (p < end && '/' != *p) {
+        p++;
+    }
+
+    rv.s   = start;
+    rv.len = (size_t) (p - start);
+
+    return rv;
+}
+
+
+XAcode router_dispatch(struct router *r, const struct wrp_view *msg,
+                       const void *buf, size_t len, XAcode *err)
+{
+    struct xa_const_string service;
+    struct route *route = NULL;
+
+    if (!r || !msg) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    service = router_dest_service(&msg->dest);
+    if (service.len) {
+        route = (struct route *) hashmap_get(&r->services, service.s, service.len);
+    }
+
+    if (!route) {
+        route = r->wildcard;
+    }
+
+    if (!route) {
+        return xa_set_error(err, XA_NO_ROUTE);
+    }
+
+    route->fn(route->user, msg, buf, len);
+
+    return XA_OK;
+}
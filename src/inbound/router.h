@@ -0,0 +1,104 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __INBOUND_ROUTER_H__
+#define __INBOUND_ROUTER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../error/codes.h"
+#include "../string.h"
+#include "../wrp/wrp_view.h"
+
+/* Delivers inbound WRP messages to the local services that registered for
+ * them.
+ *
+ * The service is the first path segment of the dest locator, so a message
+ * for "mac:112233445566/config/foo" goes to the "config" service.  Lookups are
+ * a single hash probe on the service name straight out of the decoded view,
+ * regardless of how many services are registered.  Messages for services
+ * that are not registered (or that name no service) go to the wildcard
+ * route, if there is one. */
+
+#define ROUTER_WILDCARD "*"
+
+/**
+ *  Handles one inbound message.  Both the view and the raw encoded message
+ *  are only valid for the duration of the call.
+ */
+typedef void (*route_fn)(void *user, const struct wrp_view *msg,
+                         const void *buf, size_t len);
+
+struct router;
+
+
+/**
+ *  Creates an empty routing table.
+ *
+ *  @return the router or NULL on failure
+ */
+struct router *router_create(XAcode *err);
+
+
+/**
+ *  Releases the routing table.
+ */
+void router_destroy(struct router *r);
+
+
+/**
+ *  Registers the endpoint for a service, or for the wildcard route if the
+ *  service is ROUTER_WILDCARD.
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT if the name is invalid or
+ *          already registered, XA_OUT_OF_MEMORY otherwise
+ */
+XAcode router_register(struct router *r, const char *service, route_fn fn,
+                       void *user, XAcode *err);
+
+
+/**
+ *  Removes the endpoint for a service (or the wildcard route).
+ *
+ *  @return true if it was registered
+ */
+bool router_unregister(struct router *r, const char *service);
+
+
+/**
+ *  Removes every endpoint (including the wildcard) registered with the user
+ *  pointer, for example when the local service behind them goes away.
+ *
+ *  @return the number of endpoints removed
+ */
+size_t router_unregister_user(struct router *r, const void *user);
+
+
+/**
+ *  Returns the number of registered services, not counting the wildcard.
+ */
+size_t router_count(const struct router *r);
+
+
+/**
+ *  Extracts the service name from a dest locator.
+ *
+ *  @return the service, or an empty string if the locator names none
+ */
+struct xa_const_string router_dest_service(const struct xa_const_string *dest);
+
+
+/**
+ *  Hands a decoded message to the endpoint for its service.
+ *
+ *  @param msg the decoded message
+ *  @param buf the encoded message the view points into
+ *  @param len the length of the encoded message
+ *
+ *  @return XA_OK if it was delivered, XA_NO_ROUTE if no endpoint wants it
+ */
+XAcode router_dispatch(struct router *r, const struct wrp_view *msg,
+                       const void *buf, size_t len, XAcode *err);
+
+#endif
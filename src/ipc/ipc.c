@@ -0,0 +1,861 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _GNU_SOURCE /* accept4(), memfd_create() and the file seals */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ipc.h"
+#include "shm_ring.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX_MSG_BYTES     (16 * 1024 * 1024)
+#define DEFAULT_MAX_PENDING_BYTES (4 * 1024 * 1024)
+#define DEFAULT_LARGE_MSG_BYTES   (64 * 1024)
+
+#define RX_BUF_SIZE  (64 * 1024)
+#define READ_BUDGET  8  /* recvmsg() calls per wakeup, for fairness */
+#define MAX_FDS      16 /* passed descriptors waiting for their header */
+#define FDS_PER_MSG  8
+#define IOV_PER_MSG  64
+#define LISTEN_QUEUE 16
+#define RING_BUDGET  256 /* ring messages per wakeup, for fairness */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct frame {
+    struct frame *next;
+    int fd;      /* the memfd carrying the message until it is sent, or -1 */
+    size_t msg;  /* the message length, for the backlog */
+    size_t len;  /* bytes of data to write */
+    size_t off;  /* bytes of data already written */
+    uint8_t data[];
+};
+
+struct ipc_client {
+    struct ipc_client *next;
+    struct ipc_client *prev;
+    struct ipc_server *server;
+
+    int fd;
+    struct event_watch *watch;
+    bool closing;
+    bool hungup; /* drained regardless of credit, it can't send more */
+
+    uint8_t *rx;
+    size_t rx_size;
+    size_t rx_used;
+
+    int fds[MAX_FDS];
+    size_t fds_head;
+    size_t fds_count;
+
+    struct frame *head;
+    struct frame *tail;
+    size_t pending;
+
+    struct shm_ring *ring;
+    struct event_watch *ring_watch;
+};
+
+struct ipc_server {
+    struct ipc_server_opts opts;
+    char *path;
+
+    int fd;
+    struct event_watch *watch;
+
+    struct ipc_client *clients;
+    size_t count;
+
+    size_t credit;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void on_client(struct event_watch *w, int fd, unsigned events, void *user);
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+         | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+
+static void client_destroy(struct ipc_client *c)
+{
+    struct ipc_server *s = c->server;
+
+    if (s->opts.on_close) {
+        s->opts.on_close(s->opts.user, c);
+    }
+
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else {
+        s->clients = c->next;
+    }
+    if (c->next) {
+        c->next->prev = c->prev;
+    }
+    s->count--;
+
+    while (c->head) {
+        struct frame *f = c->head;
+
+        c->head = f->next;
+        if (0 <= f->fd) {
+            close(f->fd);
+        }
+        pool_free(s->opts.pool, f);
+    }
+
+    while (c->fds_count) {
+        close(c->fds[c->fds_head]);
+        c->fds_head = (c->fds_head + 1) % MAX_FDS;
+        c->fds_count--;
+    }
+
+    event_watch_remove(c->ring_watch);
+    shm_ring_destroy(c->ring);
+
+    event_watch_remove(c->watch);
+    close(c->fd);
+    free(c->rx);
+    free(c);
+}
+
+
+static bool may_deliver(const struct ipc_client *c)
+{
+    return c->hungup || (0 < c->server->credit);
+}
+
+
+static void deliver(struct ipc_client *c, const void *buf, size_t len)
+{
+    struct ipc_server *s = c->server;
+    size_t cost          = (len) ? len : 1;
+
+    if (IPC_CREDIT_UNLIMITED != s->credit) {
+        s->credit = (cost < s->credit) ? s->credit - cost : 0;
+    }
+
+    s->opts.on_message(s->opts.user, c, buf, len);
+}
+
+
+/* Makes sure the callback runs soon to either write or reap the client. */
+static void want_callback(struct ipc_client *c)
+{
+    event_watch_modify(c->watch, EVENT__READABLE | EVENT__WRITABLE, NULL);
+}
+
+
+static bool push_fd(struct ipc_client *c, int fd)
+{
+    if (MAX_FDS == c->fds_count) {
+        close(fd);
+        return false;
+    }
+
+    c->fds[(c->fds_head + c->fds_count) % MAX_FDS] = fd;
+    c->fds_count++;
+
+    return true;
+}
+
+
+static int pop_fd(struct ipc_client *c)
+{
+    int fd;
+
+    if (!c->fds_count) {
+        return -1;
+    }
+
+    fd          = c->fds[c->fds_head];
+    c->fds_head = (c->fds_head + 1) % MAX_FDS;
+    c->fds_count--;
+
+    return fd;
+}
+
+
+/* Delivers a message passed as a memfd, mapped instead of copied.  It must be
+ * sealed so the client can neither change it nor shrink it out from under the
+ * mapping while it is being read. */
+static bool deliver_fd(struct ipc_client *c, size_t len)
+{
+    int fd   = pop_fd(c);
+    int want = F_SEAL_SHRINK | F_SEAL_WRITE;
+    int seals;
+    struct stat st;
+    void *p;
+
+    if (fd < 0) {
+        return false;
+    }
+
+    /* Descriptors that can't be sealed at all report -1. */
+    seals = fcntl(fd, F_GET_SEALS);
+    if ((seals < 0) || (want != (want & seals))
+        || (0 != fstat(fd, &st)) || (st.st_size < 0) || ((size_t) st.st_size < len))
+    {
+        close(fd);
+        return false;
+    }
+
+    if (0 == len) {
+        deliver(c, "", 0);
+        close(fd);
+        return true;
+    }
+
+    p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == p) {
+        return false;
+    }
+
+    deliver(c, p, len);
+    munmap(p, len);
+
+    return true;
+}
+
+
+static bool ring_msg(void *user, const void *buf, size_t len)
+{
+    struct ipc_client *c = (struct ipc_client *) user;
+
+    if (c->closing || !may_deliver(c)) {
+        return false;
+    }
+
+    deliver(c, buf, len);
+
+    return true;
+}
+
+
+static void on_ring(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct ipc_client *c = (struct ipc_client *) user;
+    unsigned want        = EVENT__READABLE;
+    size_t count         = 0;
+
+    (void) fd;
+    (void) events;
+
+    if (c->closing) {
+        return;
+    }
+
+    if (may_deliver(c)
+        && (XA_OK != shm_ring_read(c->ring, RING_BUDGET, ring_msg, c, &count, NULL)))
+    {
+        ipc_client_close(c);
+        return;
+    }
+
+    /* Out of credit: leave the rest in the ring until there is more.  The
+     * producer sees the ring fill up. */
+    if (!may_deliver(c)) {
+        event_watch_modify(w, 0, NULL);
+        return;
+    }
+
+    /* Come back next iteration if there is more, otherwise sleep until the
+     * producer rings the doorbell. */
+    if ((RING_BUDGET == count) || shm_ring_arm(c->ring)) {
+        want |= EVENT__WRITABLE;
+    }
+    event_watch_modify(w, want, NULL);
+}
+
+
+/* Takes over the ring whose memfd and eventfd were passed with the frame. */
+static bool attach_ring(struct ipc_client *c)
+{
+    struct ipc_server *s = c->server;
+    int memfd            = pop_fd(c);
+    int efd              = pop_fd(c);
+
+    if (c->ring || (memfd < 0) || (efd < 0)) {
+        if (0 <= memfd) {
+            close(memfd);
+        }
+        if (0 <= efd) {
+            close(efd);
+        }
+        return false;
+    }
+
+    c->ring = shm_ring_attach(memfd, efd, NULL);
+    if (!c->ring) {
+        return false;
+    }
+
+    /* Start with a pass, as the producer may have written already. */
+    c->ring_watch = event_loop_watch(s->opts.loop, efd,
+                                     EVENT__READABLE | EVENT__WRITABLE,
+                                     on_ring, c, NULL);
+
+    return (NULL != c->ring_watch);
+}
+
+
+/* Hands every complete frame in the receive buffer to on_message. */
+static bool parse(struct ipc_client *c)
+{
+    struct ipc_server *s = c->server;
+    size_t off           = 0;
+    bool ok              = true;
+
+    while (ok && !c->closing && may_deliver(c) && (4 <= c->rx_used - off)) {
+        uint32_t word = get_be32(&c->rx[off]);
+        size_t len    = word & IPC_FRAME_LEN_MAX;
+
+        if (s->opts.max_msg_bytes < len) {
+            ok = false;
+        } else if (word & IPC_FRAME_RING) {
+            off += 4;
+            ok = (0 == len) && !(word & IPC_FRAME_FD) && attach_ring(c);
+        } else if (word & IPC_FRAME_FD) {
+            off += 4;
+            ok = deliver_fd(c, len);
+        } else if (len <= c->rx_used - off - 4) {
+            deliver(c, &c->rx[off + 4], len);
+            off += 4 + len;
+        } else {
+            /* Incomplete; make sure the whole frame will fit. */
+            if (c->rx_size < 4 + len) {
+                uint8_t *p = realloc(c->rx, 4 + len);
+
+                if (!p) {
+                    ok = false;
+                    break;
+                }
+                c->rx      = p;
+                c->rx_size = 4 + len;
+            }
+            break;
+        }
+    }
+
+    if (off) {
+        memmove(c->rx, &c->rx[off], c->rx_used - off);
+        c->rx_used -= off;
+    }
+
+    return ok;
+}
+
+
+static bool do_read(struct ipc_client *c)
+{
+    for (int i = 0; (i < READ_BUDGET) && !c->closing && may_deliver(c); i++) {
+        union {
+            char buf[CMSG_SPACE(FDS_PER_MSG * sizeof(int))];
+            struct cmsghdr align;
+        } ctrl;
+        struct iovec iov;
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+        ssize_t n;
+
+        iov.iov_base = &c->rx[c->rx_used];
+        iov.iov_len  = c->rx_size - c->rx_used;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+
+        n = recvmsg(c->fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (n < 0) {
+            return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if ((SOL_SOCKET == cmsg->cmsg_level) && (SCM_RIGHTS == cmsg->cmsg_type)) {
+                size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                bool ok      = true;
+
+                for (size_t j = 0; j < count; j++) {
+                    int fd;
+
+                    memcpy(&fd, CMSG_DATA(cmsg) + j * sizeof(int), sizeof(int));
+                    ok = push_fd(c, fd) && ok;
+                }
+                if (!ok) {
+                    return false;
+                }
+            }
+        }
+
+        /* Lost descriptors would misalign every later memfd frame. */
+        if ((0 == n) || (msg.msg_flags & MSG_CTRUNC)) {
+            return false;
+        }
+
+        c->rx_used += (size_t) n;
+        if (!parse(c)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/* Writes as much of the backlog as the socket takes. */
+static bool do_write(struct ipc_client *c)
+{
+    while (c->head) {
+        union {
+            char buf[CMSG_SPACE(FDS_PER_MSG * sizeof(int))];
+            struct cmsghdr align;
+        } ctrl;
+        struct iovec iov[IOV_PER_MSG];
+        int fds[FDS_PER_MSG];
+        size_t iov_count = 0;
+        size_t fd_count  = 0;
+        struct msghdr msg;
+        struct frame *f;
+        ssize_t n;
+
+        for (f = c->head; f && (iov_count < IOV_PER_MSG); f = f->next) {
+            if (0 <= f->fd) {
+                if (FDS_PER_MSG == fd_count) {
+                    break;
+                }
+                fds[fd_count++] = f->fd;
+            }
+            iov[iov_count].iov_base = &f->data[f->off];
+            iov[iov_count].iov_len  = f->len - f->off;
+            iov_count++;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = iov_count;
+        if (fd_count) {
+            struct cmsghdr *cmsg;
+
+            memset(&ctrl, 0, sizeof(ctrl));
+            msg.msg_control    = ctrl.buf;
+            msg.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+
+            cmsg             = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_RIGHTS;
+            cmsg->cmsg_len   = CMSG_LEN(fd_count * sizeof(int));
+            memcpy(CMSG_DATA(cmsg), fds, fd_count * sizeof(int));
+        }
+
+        n = sendmsg(c->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+        }
+
+        /* The descriptors went out with the first byte, even if the frames
+         * they belong to did not. */
+        f = c->head;
+        for (size_t i = 0; i < iov_count; i++, f = f->next) {
+            if (0 <= f->fd) {
+                close(f->fd);
+                f->fd = -1;
+            }
+        }
+
+        while (c->head && (0 < n)) {
+            f          = c->head;
+            size_t use = f->len - f->off;
+
+            if ((size_t) n < use) {
+                use = (size_t) n;
+            }
+            f->off += use;
+            n -= (ssize_t) use;
+
+            if (f->off < f->len) {
+                break;
+            }
+
+            c->head = f->next;
+            if (!c->head) {
+                c->tail = NULL;
+            }
+            c->pending -= f->msg;
+            pool_free(c->server->opts.pool, f);
+        }
+
+        if (c->head && (0 < c->head->off)) {
+            /* The socket is full. */
+            return true;
+        }
+    }
+
+    return true;
+}
+
+
+/* A sealed memfd holding the message, or -1 to send it inline. */
+static int make_memfd(const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+    int fd           = memfd_create("xa-ipc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    while (len) {
+        ssize_t n = write(fd, p, len);
+
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    if (0 != fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+static void on_client(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct ipc_client *c = (struct ipc_client *) user;
+    bool ok              = true;
+    unsigned want        = 0;
+
+    (void) w;
+    (void) fd;
+
+    if (events & (EVENT__HANGUP | EVENT__ERROR)) {
+        c->hungup = true;
+    }
+
+    /* Frames left over from a pause go first, then new ones. */
+    if (!c->closing && may_deliver(c)) {
+        ok = parse(c);
+        if (ok && (events & (EVENT__READABLE | EVENT__HANGUP | EVENT__ERROR))) {
+            ok = do_read(c);
+        }
+    }
+
+    if (ok && !c->closing && c->head) {
+        ok = do_write(c);
+    }
+
+    /* A producer may write to its ring and hang up straight away; the
+     * mapping outlives its side, so deliver what is left. */
+    if (!ok && !c->closing && c->ring) {
+        c->hungup = true;
+        shm_ring_read(c->ring, SIZE_MAX, ring_msg, c, NULL, NULL);
+    }
+
+    if (!ok || c->closing) {
+        client_destroy(c);
+        return;
+    }
+
+    /* While out of credit the socket is left to fill up, which blocks the
+     * client's writes instead of dropping its messages. */
+    if (may_deliver(c)) {
+        want |= EVENT__READABLE;
+    }
+    if (c->head) {
+        want |= EVENT__WRITABLE;
+    }
+    event_watch_modify(c->watch, want, NULL);
+}
+
+
+static void on_accept(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct ipc_server *s = (struct ipc_server *) user;
+
+    (void) w;
+    (void) events;
+
+    while (1) {
+        struct ipc_client *c;
+        int cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (cfd < 0) {
+            return;
+        }
+
+        c = calloc(1, sizeof(struct ipc_client));
+        if (c) {
+            c->rx_size = RX_BUF_SIZE;
+            c->rx      = malloc(c->rx_size);
+            c->fd      = cfd;
+            c->server  = s;
+            c->watch   = event_loop_watch(s->opts.loop, cfd, EVENT__READABLE,
+                                          on_client, c, NULL);
+        }
+
+        if (!c || !c->rx || !c->watch) {
+            if (c) {
+                free(c->rx);
+                free(c);
+            }
+            close(cfd);
+            continue;
+        }
+
+        c->next = s->clients;
+        if (s->clients) {
+            s->clients->prev = c;
+        }
+        s->clients = c;
+        s->count++;
+
+        if (s->opts.on_connect) {
+            s->opts.on_connect(s->opts.user, c);
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct ipc_server *ipc_server_create(const struct ipc_server_opts *opts,
+                                     XAcode *err)
+{
+    struct sockaddr_un addr;
+    struct ipc_server *s;
+
+    if (!opts || !opts->loop || !opts->path || !opts->on_message
+        || (sizeof(addr.sun_path) <= strlen(opts->path)))
+    {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    s = calloc(1, sizeof(struct ipc_server));
+    if (!s) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    s->opts   = *opts;
+    s->credit = IPC_CREDIT_UNLIMITED;
+    if (!s->opts.max_msg_bytes || (IPC_FRAME_LEN_MAX < s->opts.max_msg_bytes)) {
+        s->opts.max_msg_bytes = DEFAULT_MAX_MSG_BYTES;
+    }
+    if (!s->opts.max_pending_bytes) {
+        s->opts.max_pending_bytes = DEFAULT_MAX_PENDING_BYTES;
+    }
+    if (!s->opts.large_msg_bytes) {
+        s->opts.large_msg_bytes = DEFAULT_LARGE_MSG_BYTES;
+    }
+
+    s->path = malloc(strlen(opts->path) + 1);
+    if (!s->path) {
+        free(s);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    strcpy(s->path, opts->path);
+    s->opts.path = s->path;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, s->path);
+
+    s->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(s->path);
+    if ((s->fd < 0)
+        || (0 != bind(s->fd, (struct sockaddr *) &addr, sizeof(addr)))
+        || (0 != listen(s->fd, LISTEN_QUEUE)))
+    {
+        if (0 <= s->fd) {
+            close(s->fd);
+        }
+        free(s->path);
+        free(s);
+        xa_set_error(err, XA_FAILED_TO_OPEN_FILE);
+        return NULL;
+    }
+
+    s->watch = event_loop_watch(opts->loop, s->fd, EVENT__READABLE, on_accept, s, err);
+    if (!s->watch) {
+        close(s->fd);
+        unlink(s->path);
+        free(s->path);
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+
+void ipc_server_destroy(struct ipc_server *s)
+{
+    if (s) {
+        while (s->clients) {
+            client_destroy(s->clients);
+        }
+        event_watch_remove(s->watch);
+        close(s->fd);
+        unlink(s->path);
+        free(s->path);
+        free(s);
+    }
+}
+
+
+size_t ipc_server_clients(const struct ipc_server *s)
+{
+    return (s) ? s->count : 0;
+}
+
+
+void ipc_server_set_credit(struct ipc_server *s, size_t bytes)
+{
+    bool resume;
+
+    if (!s) {
+        return;
+    }
+
+    resume    = (0 == s->credit) && (0 < bytes);
+    s->credit = bytes;
+
+    if (resume) {
+        for (struct ipc_client *c = s->clients; c; c = c->next) {
+            want_callback(c);
+            if (c->ring_watch) {
+                event_watch_modify(c->ring_watch, EVENT__READABLE | EVENT__WRITABLE, NULL);
+            }
+        }
+    }
+}
+
+
+size_t ipc_server_credit(const struct ipc_server *s)
+{
+    return (s) ? s->credit : 0;
+}
+
+
+XAcode ipc_client_send(struct ipc_client *c, const void *buf, size_t len,
+                       XAcode *err)
+{
+    struct ipc_server *s;
+    struct frame *f;
+    int fd = -1;
+
+    if (!c || (!buf && len) || (IPC_FRAME_LEN_MAX < len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (c->closing) {
+        return xa_set_error(err, XA_NOT_CONNECTED);
+    }
+
+    s = c->server;
+    if (s->opts.max_pending_bytes < c->pending + len) {
+        return xa_set_error(err, XA_INSUFFICIENT_RESOURCES);
+    }
+
+    if (s->opts.large_msg_bytes <= len) {
+        fd = make_memfd(buf, len);
+    }
+
+    f = pool_alloc(s->opts.pool, sizeof(struct frame) + 4 + ((fd < 0) ? len : 0));
+    if (!f) {
+        if (0 <= fd) {
+            close(fd);
+        }
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    f->next = NULL;
+    f->fd   = fd;
+    f->msg  = len;
+    f->off  = 0;
+    if (fd < 0) {
+        put_be32(f->data, (uint32_t) len);
+        if (len) {
+            memcpy(&f->data[4], buf, len);
+        }
+        f->len = 4 + len;
+    } else {
+        put_be32(f->data, IPC_FRAME_FD | (uint32_t) len);
+        f->len = 4;
+    }
+
+    if (c->tail) {
+        c->tail->next = f;
+    } else {
+        c->head = f;
+        want_callback(c);
+    }
+    c->tail = f;
+    c->pending += len;
+
+    return XA_OK;
+}
+
+
+size_t ipc_client_pending(const struct ipc_client *c)
+{
+    return (c) ? c->pending : 0;
+}
+
+
+void ipc_client_close(struct ipc_client *c)
+{
+    if (c && !c->closing) {
+        c->closing = true;
+        want_callback(c);
+    }
+}
@@ -0,0 +1,144 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __IPC_IPC_H__
+#define __IPC_IPC_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+#include "../pool/pool.h"
+
+/* The local IPC server: local services connect to a unix stream socket and
+ * exchange msgpack encoded WRP messages with the agent.
+ *
+ * Framing:
+ *
+ *   Every message is preceded by a 4 byte big endian header.  The low 30
+ *   bits are the message length.  If the top bit (IPC_FRAME_FD) is clear the
+ *   message follows inline.  If it is set nothing follows; instead the
+ *   message is the content of a memfd passed with SCM_RIGHTS no later than
+ *   the header itself.  File descriptors are matched to headers in the order
+ *   they arrive.  The receiver maps the memfd read only, so the sender must
+ *   seal it (F_SEAL_SHRINK | F_SEAL_WRITE) before sending.
+ *
+ *   A header with only IPC_FRAME_RING set hands over a shared memory ring
+ *   (see shm_ring.h): the next two passed descriptors are its memfd and its
+ *   eventfd, in that order.  From then on the client may write messages into
+ *   the ring instead of the socket; the agent drains it in batches and
+ *   delivers each message through on_message like any other.  A client may
+ *   hand over one ring.
+ *
+ * Flow control:
+ *
+ *   The server can be given a credit of message bytes it may deliver before
+ *   it stops listening to its clients.  While the credit is used up nothing
+ *   more is read from the sockets or drained from the rings, so they fill up
+ *   and the clients block or see XA_INSUFFICIENT_RESOURCES; nothing already
+ *   sent is dropped.  Delivery resumes once the credit is topped up.  One
+ *   message may overshoot the credit, and a client that hung up is drained
+ *   regardless, as what it left behind is bounded by its buffers.
+ *
+ * Reads pull as many frames as fit in the receive buffer with each system
+ * call, and everything sent to a client during one loop iteration goes out
+ * in as few sendmsg() calls as possible.  Messages at least
+ * large_msg_bytes long are sent through a memfd instead of being copied
+ * through the socket. */
+
+#define IPC_FRAME_FD      0x80000000u
+#define IPC_FRAME_RING    0x40000000u
+#define IPC_FRAME_LEN_MAX 0x3fffffffu
+
+#define IPC_CREDIT_UNLIMITED SIZE_MAX
+
+struct ipc_server;
+struct ipc_client;
+
+struct ipc_server_opts {
+    struct event_loop *loop;
+    const char *path; /* the socket path, replaced if it exists */
+
+    size_t max_msg_bytes;     /* largest message accepted, 0 uses the default */
+    size_t max_pending_bytes; /* per client send backlog, 0 uses the default */
+    size_t large_msg_bytes;   /* send via memfd from this size, 0 uses the default */
+
+    struct pool *pool; /* optional, where queued sends are kept */
+
+    void *user;
+
+    /* Optional notifications. */
+    void (*on_connect)(void *user, struct ipc_client *client);
+    void (*on_close)(void *user, struct ipc_client *client);
+
+    /* Called for each message received.  The buffer is only valid for the
+     * duration of the call. */
+    void (*on_message)(void *user, struct ipc_client *client, const void *buf,
+                       size_t len);
+};
+
+
+/**
+ *  Creates the server and starts listening.
+ *
+ *  @return the server or NULL on failure (XA_INVALID_INPUT, XA_OUT_OF_MEMORY,
+ *          XA_FAILED_TO_OPEN_FILE or XA_EVENT_LOOP_ERROR)
+ */
+struct ipc_server *ipc_server_create(const struct ipc_server_opts *opts,
+                                     XAcode *err);
+
+
+/**
+ *  Disconnects every client, stops listening and removes the socket.
+ */
+void ipc_server_destroy(struct ipc_server *s);
+
+
+/**
+ *  Returns the number of connected clients.
+ */
+size_t ipc_server_clients(const struct ipc_server *s);
+
+
+/**
+ *  Sets how many more bytes of messages may be delivered to on_message, across
+ *  all clients, before the server stops reading.  Setting a credit when it was
+ *  used up resumes every client.  Starts at IPC_CREDIT_UNLIMITED.  Each
+ *  delivery is charged before on_message runs; setting the credit from
+ *  on_message replaces that, for example to charge only for what was kept.
+ */
+void ipc_server_set_credit(struct ipc_server *s, size_t bytes);
+
+
+/**
+ *  Returns the credit left.
+ */
+size_t ipc_server_credit(const struct ipc_server *s);
+
+
+/**
+ *  Queues a message to the client.  It is sent when the loop next runs.
+ *
+ *  @return XA_OK on success, XA_NOT_CONNECTED if the client is closing,
+ *          XA_INSUFFICIENT_RESOURCES if the client's backlog is full,
+ *          XA_INVALID_INPUT or XA_OUT_OF_MEMORY otherwise
+ */
+XAcode ipc_client_send(struct ipc_client *c, const void *buf, size_t len,
+                       XAcode *err);
+
+
+/**
+ *  Returns the number of bytes waiting to be sent to the client.
+ */
+size_t ipc_client_pending(const struct ipc_client *c);
+
+
+/**
+ *  Disconnects the client once the current callback returns.  on_close is
+ *  called as usual.
+ */
+void ipc_client_close(struct ipc_client *c);
+
+#endif
@@ -0,0 +1,379 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _GNU_SOURCE /* memfd_create() and the file seals */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define RING_MAGIC   0x58415352 /* "XASR" */
+#define RING_VERSION 1
+#define MAX_BYTES    (1u << 30)
+#define CACHE_LINE   64
+#define HDR_SIZE     4096 /* the data starts on its own page */
+#define WRAP_MARKER  UINT32_MAX
+#define REC_ALIGN    8
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The shared header.  Each index lives on its own cache line so the producer
+ * and consumer never write to the same line. */
+struct shm_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint8_t pad0[CACHE_LINE - 16];
+
+    uint64_t head; /* written by the producer */
+    uint8_t pad1[CACHE_LINE - 8];
+
+    uint64_t tail; /* written by the consumer */
+    uint8_t pad2[CACHE_LINE - 8];
+
+    uint32_t waiting; /* set by the consumer, cleared by the producer */
+    uint8_t pad3[CACHE_LINE - 4];
+};
+
+struct shm_ring {
+    struct shm_hdr *hdr;
+    uint8_t *data;
+    size_t map_len;
+
+    uint64_t capacity;
+    uint64_t mask;
+
+    /* Our own index; the other side only ever reads it. */
+    uint64_t index;
+
+    int memfd;
+    int eventfd;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static uint64_t record_size(uint64_t len)
+{
+    return (4 + len + REC_ALIGN - 1) & ~((uint64_t) REC_ALIGN - 1);
+}
+
+
+static bool map(struct shm_ring *r, size_t len)
+{
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, r->memfd, 0);
+
+    if (MAP_FAILED == p) {
+        return false;
+    }
+
+    r->hdr     = (struct shm_hdr *) p;
+    r->data    = (uint8_t *) p + HDR_SIZE;
+    r->map_len = len;
+
+    return true;
+}
+
+
+static struct shm_ring *fail(struct shm_ring *r, XAcode code, XAcode *err)
+{
+    shm_ring_destroy(r);
+    xa_set_error(err, code);
+    return NULL;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct shm_ring *shm_ring_create(size_t capacity, XAcode *err)
+{
+    struct shm_ring *r;
+    uint64_t cap = SHM_RING_MIN_BYTES;
+
+    if (MAX_BYTES < capacity) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    r = calloc(1, sizeof(struct shm_ring));
+    if (!r) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    r->memfd   = -1;
+    r->eventfd = -1;
+
+    r->memfd   = memfd_create("xa-shm-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    r->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((r->memfd < 0) || (r->eventfd < 0)) {
+        return fail(r, XA_INSUFFICIENT_RESOURCES, err);
+    }
+
+    /* The consumer relies on the size never changing under it. */
+    if ((0 != ftruncate(r->memfd, (off_t) (HDR_SIZE + cap)))
+        || (0 != fcntl(r->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL))
+        || !map(r, HDR_SIZE + cap))
+    {
+        return fail(r, XA_INSUFFICIENT_RESOURCES, err);
+    }
+
+    r->capacity = cap;
+    r->mask     = cap - 1;
+
+    r->hdr->magic    = RING_MAGIC;
+    r->hdr->version  = RING_VERSION;
+    r->hdr->capacity = cap;
+
+    return r;
+}
+
+
+struct shm_ring *shm_ring_attach(int memfd, int eventfd, XAcode *err)
+{
+    struct shm_ring *r = calloc(1, sizeof(struct shm_ring));
+    int want           = F_SEAL_SHRINK | F_SEAL_GROW;
+    int seals          = -1;
+    struct stat st;
+    uint64_t cap;
+
+    if (!r) {
+        close(memfd);
+        close(eventfd);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    r->memfd   = memfd;
+    r->eventfd = eventfd;
+
+    /* Descriptors that can't be sealed at all report -1. */
+    if (0 <= memfd) {
+        seals = fcntl(memfd, F_GET_SEALS);
+    }
+
+    if ((memfd < 0) || (eventfd < 0) || (0 != fstat(memfd, &st))
+        || (st.st_size < HDR_SIZE + SHM_RING_MIN_BYTES)
+        || ((off_t) (HDR_SIZE + MAX_BYTES) < st.st_size)
+        || (seals < 0) || (want != (want & seals)))
+    {
+        return fail(r, XA_INVALID_INPUT, err);
+    }
+
+    if (!map(r, (size_t) st.st_size)) {
+        return fail(r, XA_INSUFFICIENT_RESOURCES, err);
+    }
+
+    cap = r->hdr->capacity;
+    if ((RING_MAGIC != r->hdr->magic) || (RING_VERSION != r->hdr->version)
+        || (0 != (cap & (cap - 1))) || ((uint64_t) st.st_size != HDR_SIZE + cap))
+    {
+        return fail(r, XA_INVALID_INPUT, err);
+    }
+
+    r->capacity = cap;
+    r->mask     = cap - 1;
+    r->index    = __atomic_load_n(&r->hdr->tail, __ATOMIC_ACQUIRE);
+
+    return r;
+}
+
+
+void shm_ring_destroy(struct shm_ring *r)
+{
+    if (r) {
+        if (r->hdr) {
+            munmap(r->hdr, r->map_len);
+        }
+        if (0 <= r->memfd) {
+            close(r->memfd);
+        }
+        if (0 <= r->eventfd) {
+            close(r->eventfd);
+        }
+        free(r);
+    }
+}
+
+
+int shm_ring_memfd(const struct shm_ring *r)
+{
+    return (r) ? r->memfd : -1;
+}
+
+
+int shm_ring_eventfd(const struct shm_ring *r)
+{
+    return (r) ? r->eventfd : -1;
+}
+
+
+size_t shm_ring_max_msg(const struct shm_ring *r)
+{
+    /* Half the ring, so a wrap never leaves too little room for a maximal
+     * record. */
+    return (r) ? (size_t) (r->capacity / 2 - REC_ALIGN) : 0;
+}
+
+
+XAcode shm_ring_write(struct shm_ring *r, const void *buf, size_t len,
+                      XAcode *err)
+{
+    uint64_t head, tail, pos, rec, pad = 0;
+    uint32_t len32;
+
+    if (!r || (!buf && len) || (shm_ring_max_msg(r) < len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    head = r->index;
+    tail = __atomic_load_n(&r->hdr->tail, __ATOMIC_ACQUIRE);
+    pos  = head & r->mask;
+    rec  = record_size(len);
+
+    if (r->capacity - pos < rec) {
+        pad = r->capacity - pos;
+    }
+    if (r->capacity - (head - tail) < pad + rec) {
+        return xa_set_error(err, XA_INSUFFICIENT_RESOURCES);
+    }
+
+    if (pad) {
+        len32 = WRAP_MARKER;
+        memcpy(&r->data[pos], &len32, sizeof(len32));
+        head += pad;
+        pos = 0;
+    }
+
+    len32 = (uint32_t) len;
+    memcpy(&r->data[pos], &len32, sizeof(len32));
+    if (len) {
+        memcpy(&r->data[pos + 4], buf, len);
+    }
+    head += rec;
+
+    r->index = head;
+    __atomic_store_n(&r->hdr->head, head, __ATOMIC_RELEASE);
+
+    /* Pairs with the fence in shm_ring_arm(): either the consumer sees the
+     * new head, or we see that it is waiting. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->hdr->waiting, __ATOMIC_RELAXED)
+        && __atomic_exchange_n(&r->hdr->waiting, 0, __ATOMIC_ACQ_REL))
+    {
+        uint64_t one = 1;
+
+        if (sizeof(one) != write(r->eventfd, &one, sizeof(one))) {
+            /* The counter is saturated, so the consumer is awake anyway. */
+        }
+    }
+
+    return XA_OK;
+}
+
+
+XAcode shm_ring_read(struct shm_ring *r, size_t max, shm_ring_fn fn,
+                     void *user, size_t *count, XAcode *err)
+{
+    uint64_t tail, head;
+    size_t n  = 0;
+    XAcode rv = XA_OK;
+
+    if (count) {
+        *count = 0;
+    }
+
+    if (!r || !fn) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    tail = r->index;
+    head = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+    if (r->capacity < head - tail) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    while ((n < max) && (tail != head)) {
+        uint64_t pos    = tail & r->mask;
+        uint64_t avail  = head - tail;
+        uint64_t to_end = r->capacity - pos;
+        uint64_t rec;
+        uint32_t len;
+
+        /* Read the length once; the producer could change it under us. */
+        memcpy(&len, &r->data[pos], sizeof(len));
+
+        if (WRAP_MARKER == len) {
+            if (avail < to_end) {
+                rv = XA_INVALID_INPUT;
+                break;
+            }
+            tail += to_end;
+            continue;
+        }
+
+        rec = record_size(len);
+        if ((shm_ring_max_msg(r) < len) || (to_end < rec) || (avail < rec)) {
+            rv = XA_INVALID_INPUT;
+            break;
+        }
+
+        if (!fn(user, &r->data[pos + 4], len)) {
+            break;
+        }
+        tail += rec;
+        n++;
+    }
+
+    /* Hand the space back once for the whole batch. */
+    r->index = tail;
+    __atomic_store_n(&r->hdr->tail, tail, __ATOMIC_RELEASE);
+
+    if (count) {
+        *count = n;
+    }
+
+    return xa_set_error(err, rv);
+}
+
+
+bool shm_ring_arm(struct shm_ring *r)
+{
+    uint64_t value;
+
+    if (!r) {
+        return false;
+    }
+
+    if (sizeof(value) != read(r->eventfd, &value, sizeof(value))) {
+        /* Nothing pending. */
+    }
+
+    __atomic_store_n(&r->hdr->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return (r->index != __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE));
+}
@@ -0,0 +1,115 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __IPC_SHM_RING_H__
+#define __IPC_SHM_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* A single producer, single consumer ring of messages in shared memory, for
+ * local services that send faster than a system call per message allows.
+ *
+ * The producer (the local service) creates the ring, which is a memfd holding
+ * the indexes and the data, plus an eventfd used as a doorbell, and hands
+ * both to the agent over the IPC socket.  After that no system calls are
+ * needed to pass messages: the producer copies each message into the ring
+ * and publishes it by advancing its index.  The doorbell is only rung when
+ * the consumer has said it is about to sleep, so a busy ring is drained
+ * without any wakeups at all.
+ *
+ * Nothing in the shared memory is trusted by the consumer: every index and
+ * length is checked, and a ring that breaks the rules is reported as
+ * XA_INVALID_INPUT so it can be dropped. */
+
+#define SHM_RING_MIN_BYTES 4096
+
+struct shm_ring;
+
+/**
+ *  Called for each message drained.  The buffer points into the ring and is
+ *  only valid for the duration of the call.
+ *
+ *  @return true if the message was taken, false to leave it (and everything
+ *          after it) in the ring and stop
+ */
+typedef bool (*shm_ring_fn)(void *user, const void *buf, size_t len);
+
+
+/**
+ *  Creates a new ring (producer side).
+ *
+ *  @param capacity the data size in bytes, rounded up to a power of 2 and at
+ *                  least SHM_RING_MIN_BYTES
+ *
+ *  @return the ring or NULL on failure (XA_OUT_OF_MEMORY, XA_INVALID_INPUT or
+ *          XA_INSUFFICIENT_RESOURCES)
+ */
+struct shm_ring *shm_ring_create(size_t capacity, XAcode *err);
+
+
+/**
+ *  Maps a ring created by the other side (consumer side).  On success the
+ *  ring owns both descriptors; on failure they are closed.
+ *
+ *  @return the ring or NULL on failure
+ */
+struct shm_ring *shm_ring_attach(int memfd, int eventfd, XAcode *err);
+
+
+/**
+ *  Unmaps the ring and closes its descriptors.
+ */
+void shm_ring_destroy(struct shm_ring *r);
+
+
+/**
+ *  The descriptors to hand to the other side.
+ */
+int shm_ring_memfd(const struct shm_ring *r);
+int shm_ring_eventfd(const struct shm_ring *r);
+
+
+/**
+ *  The largest message the ring can hold.
+ */
+size_t shm_ring_max_msg(const struct shm_ring *r);
+
+
+/**
+ *  Copies one message into the ring and rings the doorbell if the consumer
+ *  is waiting (producer side).
+ *
+ *  @return XA_OK on success, XA_INSUFFICIENT_RESOURCES if the ring is full,
+ *          XA_INVALID_INPUT if the message can never fit
+ */
+XAcode shm_ring_write(struct shm_ring *r, const void *buf, size_t len,
+                      XAcode *err);
+
+
+/**
+ *  Drains up to max messages (consumer side).  The space is handed back to
+ *  the producer once, after the whole batch.
+ *
+ *  @param count set to the number of messages taken
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT if the producer corrupted the
+ *          ring
+ */
+XAcode shm_ring_read(struct shm_ring *r, size_t max, shm_ring_fn fn,
+                     void *user, size_t *count, XAcode *err);
+
+
+/**
+ *  Tells the producer the consumer is going to wait for the doorbell, and
+ *  clears the doorbell (consumer side).
+ *
+ *  @return true if messages arrived in the meantime and the consumer should
+ *          drain again instead of waiting
+ */
+bool shm_ring_arm(struct shm_ring *r);
+
+#endif
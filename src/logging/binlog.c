@@ -0,0 +1,830 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binlog.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define TYPE_FORMAT 'F'
+#define TYPE_ARGS   'A'
+#define TYPE_TEXT   'T'
+
+#define MAX_FORMATS (1u << 16)
+#define VARINT_MAX  10
+#define SPEC_MAX    32
+#define LEVELS      6
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* One conversion in a format string. */
+struct spec {
+    const char *start; /* the '%' */
+    size_t len;        /* through the conversion character */
+    size_t flags;      /* the number of flag characters */
+    bool width_star;
+    bool prec_star;
+    bool has_prec;
+    size_t prec; /* when has_prec and not prec_star */
+    char length; /* 0, 'H' (hh), 'h', 'l', 'q' (ll), 'j', 'z', 't' or 'L' */
+    char conv;
+};
+
+/* A cursor over encoded input that stops at the end instead of running off
+ * it. */
+struct cursor {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool bad;
+};
+
+struct binlog_reader {
+    bool header;
+    char **formats;
+    size_t count;
+    size_t cap;
+};
+
+enum encoded {
+    ENCODED,
+    NO_ROOM,
+    NOT_ENCODABLE,
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const char *levels[LEVELS] = {
+    "TRACE", "DEBUG", "INFO ", "WARN ", "ERROR", "FATAL",
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Finds the next conversion in a format.
+ *
+ *  @return true if one was found, false at the end of the format
+ */
+static bool next_spec(const char *p, struct spec *s)
+{
+    memset(s, 0, sizeof(*s));
+
+    p = strchr(p, '%');
+    if (!p) {
+        return false;
+    }
+    s->start = p++;
+
+    while (*p && strchr("-+ #0'", *p)) {
+        s->flags++;
+        p++;
+    }
+
+    if ('*' == *p) {
+        s->width_star = true;
+        p++;
+    } else {
+        while (('0' <= *p) && (*p <= '9')) {
+            p++;
+        }
+    }
+
+    if ('.' == *p) {
+        s->has_prec = true;
+        p++;
+        if ('*' == *p) {
+            s->prec_star = true;
+            p++;
+        } else {
+            while (('0' <= *p) && (*p <= '9')) {
+                s->prec = s->prec * 10 + (size_t) (*p - '0');
+                p++;
+            }
+        }
+    }
+
+    if (('h' == p[0]) && ('h' == p[1])) {
+        s->length = 'H';
+        p += 2;
+    } else if (('l' == p[0]) && ('l' == p[1])) {
+        s->length = 'q';
+        p += 2;
+    } else if (*p && strchr("hljztL", *p)) {
+        s->length = *p++;
+    }
+
+    s->conv = *p;
+    if (*p) {
+        p++;
+    }
+    s->len = (size_t) (p - s->start);
+
+    return true;
+}
+
+
+static bool is_signed(char conv)
+{
+    return ('d' == conv) || ('i' == conv);
+}
+
+
+static bool is_unsigned(char conv)
+{
+    return ('u' == conv) || ('o' == conv) || ('x' == conv) || ('X' == conv);
+}
+
+
+static bool is_double(char conv)
+{
+    return ('\0' != conv) && (NULL != strchr("eEfFgGaA", conv));
+}
+
+
+static size_t put_varint(uint8_t *buf, size_t size, uint64_t v)
+{
+    size_t i = 0;
+
+    do {
+        if (size <= i) {
+            return 0;
+        }
+        buf[i++] = (uint8_t) ((v & 0x7f) | ((0x7f < v) ? 0x80 : 0));
+        v >>= 7;
+    } while (v);
+
+    return i;
+}
+
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+
+static uint64_t get_varint(struct cursor *c)
+{
+    uint64_t v = 0;
+
+    for (int shift = 0; shift < 7 * VARINT_MAX; shift += 7) {
+        uint8_t b;
+
+        if (c->end <= c->p) {
+            break;
+        }
+        b = *c->p++;
+        v |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+
+    c->bad = true;
+    return 0;
+}
+
+
+static const uint8_t *get_bytes(struct cursor *c, uint64_t len)
+{
+    const uint8_t *p = c->p;
+
+    if (c->bad || ((uint64_t) (c->end - c->p) < len)) {
+        c->bad = true;
+        return NULL;
+    }
+    c->p += len;
+
+    return p;
+}
+
+
+static int64_t get_signed(char length, va_list *args)
+{
+    switch (length) {
+    case 'l':
+        return va_arg(*args, long);
+    case 'q':
+        return va_arg(*args, long long);
+    case 'j':
+        return va_arg(*args, intmax_t);
+    case 'z':
+        return (int64_t) va_arg(*args, size_t);
+    case 't':
+        return va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, int);
+    }
+}
+
+
+static uint64_t get_unsigned(char length, va_list *args)
+{
+    switch (length) {
+    case 'l':
+        return va_arg(*args, unsigned long);
+    case 'q':
+        return va_arg(*args, unsigned long long);
+    case 'j':
+        return va_arg(*args, uintmax_t);
+    case 'z':
+        return va_arg(*args, size_t);
+    case 't':
+        return (uint64_t) va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, unsigned int);
+    }
+}
+
+
+/**
+ *  Encodes the arguments for one conversion, adding the bytes used to *used.
+ */
+static enum encoded encode_spec(uint8_t *buf, size_t size, size_t *used,
+                                const struct spec *s, va_list *args)
+{
+    int64_t prec = (s->has_prec) ? (int64_t) s->prec : -1;
+    size_t at    = *used;
+    size_t n     = 1;
+
+    if ('%' == s->conv) {
+        return ENCODED;
+    }
+
+    if (('l' == s->length) && (('s' == s->conv) || ('c' == s->conv))) {
+        return NOT_ENCODABLE; /* wide characters */
+    }
+    if (!is_signed(s->conv) && !is_unsigned(s->conv) && !is_double(s->conv)
+        && (('\0' == s->conv) || !strchr("cpsn", s->conv)))
+    {
+        return NOT_ENCODABLE; /* there is no way to know the argument's type */
+    }
+
+    if (s->width_star) {
+        n = put_varint(&buf[at], size - at, zigzag(va_arg(*args, int)));
+        at += n;
+    }
+    if (n && s->prec_star) {
+        prec = va_arg(*args, int);
+        n    = put_varint(&buf[at], size - at, zigzag(prec));
+        at += n;
+    }
+    if (!n) {
+        return NO_ROOM;
+    }
+
+    if (is_signed(s->conv)) {
+        n = put_varint(&buf[at], size - at, zigzag(get_signed(s->length, args)));
+    } else if (is_unsigned(s->conv)) {
+        n = put_varint(&buf[at], size - at, get_unsigned(s->length, args));
+    } else if ('c' == s->conv) {
+        n = put_varint(&buf[at], size - at, (uint64_t) va_arg(*args, int));
+    } else if ('p' == s->conv) {
+        n = put_varint(&buf[at], size - at, (uintptr_t) va_arg(*args, void *));
+    } else if ('n' == s->conv) {
+        (void) va_arg(*args, void *); /* never written through */
+        *used = at;
+        return ENCODED;
+    } else if (is_double(s->conv)) {
+        double d = ('L' == s->length) ? (double) va_arg(*args, long double)
+                                      : va_arg(*args, double);
+        uint64_t bits;
+
+        if (size - at < 8) {
+            return NO_ROOM;
+        }
+        memcpy(&bits, &d, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            buf[at + i] = (uint8_t) (bits >> (8 * i));
+        }
+        n = 8;
+    } else {
+        const char *str = va_arg(*args, const char *);
+        size_t len      = 0;
+
+        if (str) {
+            len = strlen(str);
+            if ((0 <= prec) && ((uint64_t) prec < len)) {
+                len = (size_t) prec;
+            }
+        }
+        n = put_varint(&buf[at], size - at, (str) ? len + 1 : 0);
+        if (!n || (size - at - n < len)) {
+            return NO_ROOM;
+        }
+        if (len) {
+            memcpy(&buf[at + n], str, len);
+        }
+        n += len;
+    }
+
+    if (!n) {
+        return NO_ROOM;
+    }
+    *used = at + n;
+
+    return ENCODED;
+}
+
+
+/**
+ *  Writes everything in a line record up to the payload.
+ *
+ *  @return the bytes written, or 0 if there isn't room for the whole record
+ */
+static size_t put_header(uint8_t *buf, size_t size, char type, uint32_t id,
+                         int level, uint64_t when_ns, size_t len)
+{
+    size_t used = 1;
+    size_t n;
+
+    if (size < 1) {
+        return 0;
+    }
+    buf[0] = (uint8_t) type;
+
+    if (TYPE_ARGS == type) {
+        n = put_varint(&buf[used], size - used, id);
+        if (!n) {
+            return 0;
+        }
+        used += n;
+    }
+
+    if (size <= used) {
+        return 0;
+    }
+    buf[used++] = (uint8_t) level;
+
+    n = put_varint(&buf[used], size - used, when_ns);
+    if (!n) {
+        return 0;
+    }
+    used += n;
+
+    n = put_varint(&buf[used], size - used, len);
+    if (!n || (size - used - n < len)) {
+        return 0;
+    }
+
+    return used + n;
+}
+
+
+static void append(struct binlog_line *line, const char *fmt, ...)
+{
+    size_t left = sizeof(line->text) - line->len;
+    va_list args;
+    int n;
+
+    if (left <= 1) {
+        return;
+    }
+
+    va_start(args, fmt);
+    n = vsnprintf(&line->text[line->len], left, fmt, args);
+    va_end(args);
+
+    if (0 < n) {
+        line->len += ((size_t) n < left) ? (size_t) n : left - 1;
+    }
+}
+
+
+/**
+ *  Builds the conversion to hand to snprintf(): the same flags and
+ *  conversion, with any '*' replaced by its value and the length modifier
+ *  replaced by one that matches the decoded type.
+ */
+static void build_spec(char *out, const struct spec *s, int64_t width,
+                       int64_t prec, const char *length)
+{
+    const char *p = s->start + 1;
+    size_t len    = 0;
+
+    out[len++] = '%';
+    for (size_t i = 0; (i < s->flags) && (len < SPEC_MAX / 2); i++) {
+        out[len++] = *p++;
+    }
+    if (width < 0) {
+        out[len++] = '-';
+        width      = (width < -1000) ? 1000 : -width;
+    }
+    if (0 < width) {
+        len += (size_t) snprintf(&out[len], 12, "%d", (int) ((width < 1000) ? width : 1000));
+    }
+    if (0 <= prec) {
+        len += (size_t) snprintf(&out[len], 13, ".%d", (int) ((prec < 1000) ? prec : 1000));
+    }
+    while (*length) {
+        out[len++] = *length++;
+    }
+    out[len++] = s->conv;
+    out[len]   = '\0';
+}
+
+
+static int64_t spec_width(const struct spec *s)
+{
+    const char *p = s->start + 1 + s->flags;
+    int64_t width = 0;
+
+    while (('0' <= *p) && (*p <= '9')) {
+        width = width * 10 + (*p - '0');
+        p++;
+    }
+
+    return width;
+}
+
+
+static void render_spec(struct binlog_line *line, const struct spec *s,
+                        struct cursor *c)
+{
+    char fmt[SPEC_MAX];
+    int64_t width = spec_width(s);
+    int64_t prec  = (s->has_prec) ? (int64_t) s->prec : -1;
+
+    if ('%' == s->conv) {
+        append(line, "%%");
+        return;
+    }
+
+    if (s->width_star) {
+        width = unzigzag(get_varint(c));
+    }
+    if (s->prec_star) {
+        prec = unzigzag(get_varint(c));
+    }
+    if (c->bad) {
+        return;
+    }
+
+    if (is_signed(s->conv)) {
+        int64_t v = unzigzag(get_varint(c));
+
+        build_spec(fmt, s, width, prec, "j");
+        append(line, fmt, (intmax_t) v);
+    } else if (is_unsigned(s->conv)) {
+        uint64_t v = get_varint(c);
+
+        build_spec(fmt, s, width, prec, "j");
+        append(line, fmt, (uintmax_t) v);
+    } else if ('c' == s->conv) {
+        uint64_t v = get_varint(c);
+
+        build_spec(fmt, s, width, prec, "");
+        append(line, fmt, (int) v);
+    } else if ('p' == s->conv) {
+        uint64_t v = get_varint(c);
+
+        build_spec(fmt, s, width, prec, "");
+        append(line, fmt, (void *) (uintptr_t) v);
+    } else if (is_double(s->conv)) {
+        const uint8_t *p = get_bytes(c, 8);
+        uint64_t bits    = 0;
+        double d;
+
+        if (!p) {
+            return;
+        }
+        for (int i = 0; i < 8; i++) {
+            bits |= (uint64_t) p[i] << (8 * i);
+        }
+        memcpy(&d, &bits, sizeof(d));
+
+        build_spec(fmt, s, width, prec, "");
+        append(line, fmt, d);
+    } else if ('s' == s->conv) {
+        uint64_t len = get_varint(c);
+        const uint8_t *p;
+
+        if (c->bad) {
+            return;
+        }
+        if (0 == len) {
+            build_spec(fmt, s, width, -1, "");
+            append(line, fmt, "(null)");
+            return;
+        }
+        len--;
+        p = get_bytes(c, len);
+        if (!p) {
+            return;
+        }
+
+        /* The encoder already cut the string to the precision, and the
+         * precision keeps snprintf() from looking for a NUL. */
+        build_spec(fmt, s, width, (int64_t) ((len < 1000) ? len : 1000), "");
+        append(line, fmt, (const char *) p);
+    } else if ('n' != s->conv) {
+        c->bad = true;
+    }
+}
+
+
+static bool render(struct binlog_line *line, const char *format,
+                   struct cursor *c)
+{
+    const char *p = format;
+    struct spec s;
+
+    while (next_spec(p, &s)) {
+        append(line, "%.*s", (int) (s.start - p), p);
+        render_spec(line, &s, c);
+        if (c->bad) {
+            return false;
+        }
+        p = s.start + s.len;
+    }
+    append(line, "%s", p);
+
+    /* Every argument must be accounted for. */
+    return (c->p == c->end);
+}
+
+
+static bool read_format(struct binlog_reader *r, struct cursor *c)
+{
+    uint64_t id        = get_varint(c);
+    uint64_t len       = get_varint(c);
+    const uint8_t *str = get_bytes(c, len);
+    char *copy;
+
+    if (!str || (id != r->count) || (MAX_FORMATS <= id)) {
+        return false;
+    }
+
+    copy = malloc(len + 1);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    if (r->count == r->cap) {
+        size_t cap   = (r->cap) ? r->cap * 2 : 16;
+        char **grown = realloc(r->formats, cap * sizeof(char *));
+
+        if (!grown) {
+            free(copy);
+            return false;
+        }
+        r->formats = grown;
+        r->cap     = cap;
+    }
+    r->formats[r->count++] = copy;
+
+    return true;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+size_t binlog_put_header(uint8_t *buf, size_t size)
+{
+    if (size < BINLOG_HEADER_LEN) {
+        return 0;
+    }
+    memcpy(buf, BINLOG_MAGIC, 4);
+    buf[4] = BINLOG_VERSION;
+
+    return BINLOG_HEADER_LEN;
+}
+
+
+bool binlog_encode_args(uint8_t *buf, size_t size, size_t *len,
+                        const char *format, va_list args)
+{
+    const char *p = format;
+    size_t used   = 0;
+    bool rv       = true;
+    struct spec s;
+    va_list ap;
+
+    va_copy(ap, args);
+    while (rv && next_spec(p, &s)) {
+        rv = (ENCODED == encode_spec(buf, size, &used, &s, &ap));
+        p  = s.start + s.len;
+    }
+    va_end(ap);
+
+    *len = used;
+    return rv;
+}
+
+
+size_t binlog_put_format(uint8_t *buf, size_t size, uint32_t id,
+                         const char *format)
+{
+    size_t len  = strlen(format);
+    size_t used = 1;
+    size_t n;
+
+    if (size < 1) {
+        return 0;
+    }
+    buf[0] = TYPE_FORMAT;
+
+    n = put_varint(&buf[used], size - used, id);
+    if (!n) {
+        return 0;
+    }
+    used += n;
+
+    n = put_varint(&buf[used], size - used, len);
+    if (!n || (size - used - n < len)) {
+        return 0;
+    }
+    used += n;
+
+    memcpy(&buf[used], format, len);
+    return used + len;
+}
+
+
+size_t binlog_put_args(uint8_t *buf, size_t size, uint32_t id, int level,
+                       uint64_t when_ns, const uint8_t *args, size_t len)
+{
+    size_t used = put_header(buf, size, TYPE_ARGS, id, level, when_ns, len);
+
+    if (!used) {
+        return 0;
+    }
+    if (len) {
+        memcpy(&buf[used], args, len);
+    }
+
+    return used + len;
+}
+
+
+size_t binlog_put_text(uint8_t *buf, size_t size, int level,
+                       uint64_t when_ns, const char *text, size_t len)
+{
+    size_t used = put_header(buf, size, TYPE_TEXT, 0, level, when_ns, len);
+
+    if (!used) {
+        return 0;
+    }
+    if (len) {
+        memcpy(&buf[used], text, len);
+    }
+
+    return used + len;
+}
+
+
+struct binlog_reader *binlog_reader_create(XAcode *err)
+{
+    struct binlog_reader *r = calloc(1, sizeof(struct binlog_reader));
+
+    if (!r) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    return r;
+}
+
+
+void binlog_reader_destroy(struct binlog_reader *r)
+{
+    if (r) {
+        for (size_t i = 0; i < r->count; i++) {
+            free(r->formats[i]);
+        }
+        free(r->formats);
+        free(r);
+    }
+}
+
+
+XAcode binlog_reader_next(struct binlog_reader *r, const uint8_t *buf,
+                          size_t len, size_t *used, struct binlog_line *line,
+                          XAcode *err)
+{
+    struct cursor c = { .p = buf, .end = buf + len, .bad = false };
+    uint64_t id     = 0;
+    uint64_t size;
+    uint8_t type;
+
+    if (!r || !used || !line || (!buf && len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    *used       = 0;
+    line->valid = false;
+    line->len   = 0;
+
+    if (!r->header) {
+        if (len < BINLOG_HEADER_LEN) {
+            return XA_OK;
+        }
+        if ((0 != memcmp(buf, BINLOG_MAGIC, 4)) || (BINLOG_VERSION != buf[4])) {
+            return xa_set_error(err, XA_INVALID_INPUT);
+        }
+        r->header = true;
+        *used     = BINLOG_HEADER_LEN;
+        return XA_OK;
+    }
+
+    if (0 == len) {
+        return XA_OK;
+    }
+
+    /* Streams appended to the same file each start with their own header,
+     * and their own format ids. */
+    if (BINLOG_MAGIC[0] == buf[0]) {
+        if (len < BINLOG_HEADER_LEN) {
+            return XA_OK;
+        }
+        for (size_t i = 0; i < r->count; i++) {
+            free(r->formats[i]);
+        }
+        r->count  = 0;
+        r->header = false;
+        return binlog_reader_next(r, buf, len, used, line, err);
+    }
+
+    type = *c.p++;
+
+    if (TYPE_FORMAT == type) {
+        /* Peek at the lengths first, so a partial record just waits. */
+        struct cursor peek = c;
+
+        (void) get_varint(&peek);
+        size = get_varint(&peek);
+        if (peek.bad || ((uint64_t) (peek.end - peek.p) < size)) {
+            return XA_OK;
+        }
+        if (!read_format(r, &c)) {
+            return xa_set_error(err, XA_INVALID_INPUT);
+        }
+        *used = (size_t) (c.p - buf);
+        return XA_OK;
+    }
+
+    if ((TYPE_ARGS != type) && (TYPE_TEXT != type)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (TYPE_ARGS == type) {
+        id = get_varint(&c);
+    }
+    if (c.p < c.end) {
+        line->level = *c.p++;
+    } else {
+        c.bad = true;
+    }
+    line->when_ns = get_varint(&c);
+    size          = get_varint(&c);
+    if (c.bad || ((uint64_t) (c.end - c.p) < size)) {
+        /* Not all here yet; a varint cut off at the end looks the same. */
+        return XA_OK;
+    }
+
+    if (TYPE_TEXT == type) {
+        append(line, "%.*s", (int) ((size < BINLOG_LINE_MAX) ? size : BINLOG_LINE_MAX), c.p);
+    } else {
+        struct cursor args = { .p = c.p, .end = c.p + size, .bad = false };
+
+        if ((r->count <= id) || !render(line, r->formats[id], &args)) {
+            return xa_set_error(err, XA_INVALID_INPUT);
+        }
+    }
+
+    line->valid = true;
+    *used       = (size_t) (c.p + size - buf);
+
+    return XA_OK;
+}
+
+
+const char *binlog_level_name(int level)
+{
+    if ((0 <= level) && (level < LEVELS)) {
+        return levels[level];
+    }
+
+    return "?????";
+}
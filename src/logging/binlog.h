@@ -0,0 +1,137 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __LOGGING_BINLOG_H__
+#define __LOGGING_BINLOG_H__
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* Binary log records, so the printf style formatting of a line can be done
+ * later and somewhere else instead of on the device.
+ *
+ * A record holds an id for the format string plus the raw arguments; the
+ * format string itself is only written once per stream, the first time it
+ * is used.  A stream is the header followed by records:
+ *
+ *      header  "XALB" version(u8)
+ *      format  'F' id(varint) len(varint) text
+ *      args    'A' id(varint) level(u8) when_ns(varint) len(varint) args
+ *      text    'T' level(u8) when_ns(varint) len(varint) text
+ *
+ * Another header may follow any record; it starts a new stream with its own
+ * format ids, so restarts can append to the same file.
+ *
+ * Arguments are encoded in the order the format consumes them: integers as
+ * (zigzag for signed) LEB128 varints, doubles as 8 little endian bytes, and
+ * strings as a varint of length + 1 (0 for NULL) then the bytes, already cut
+ * to the precision.  A '*' width or precision is a signed varint.  Formats
+ * with conversions that can't be encoded (wide strings, for example) are
+ * sent as preformatted text records instead.
+ *
+ * The reader renders each record back into the text the format would have
+ * produced, checking every length against the input so a corrupt stream is
+ * reported rather than trusted. */
+
+#define BINLOG_MAGIC      "XALB"
+#define BINLOG_VERSION    1
+#define BINLOG_HEADER_LEN 5
+#define BINLOG_LINE_MAX   1024
+
+struct binlog_reader;
+
+struct binlog_line {
+    bool valid; /* false if the record only defined a format */
+    int level;
+    uint64_t when_ns;
+    size_t len;
+    char text[BINLOG_LINE_MAX];
+};
+
+
+/**
+ *  Writes the stream header.
+ *
+ *  @return the bytes written, or 0 if there isn't room
+ */
+size_t binlog_put_header(uint8_t *buf, size_t size);
+
+
+/**
+ *  Encodes the arguments for a format.
+ *
+ *  @param len set to the bytes used
+ *
+ *  @return true on success, false if the arguments don't fit or the format
+ *          has a conversion that can't be encoded
+ */
+bool binlog_encode_args(uint8_t *buf, size_t size, size_t *len,
+                        const char *format, va_list args);
+
+
+/**
+ *  Writes a format record.
+ *
+ *  @return the bytes written, or 0 if there isn't room
+ */
+size_t binlog_put_format(uint8_t *buf, size_t size, uint32_t id,
+                         const char *format);
+
+
+/**
+ *  Writes an args record for arguments from binlog_encode_args().
+ *
+ *  @return the bytes written, or 0 if there isn't room
+ */
+size_t binlog_put_args(uint8_t *buf, size_t size, uint32_t id, int level,
+                       uint64_t when_ns, const uint8_t *args, size_t len);
+
+
+/**
+ *  Writes a text record.
+ *
+ *  @return the bytes written, or 0 if there isn't room
+ */
+size_t binlog_put_text(uint8_t *buf, size_t size, int level,
+                       uint64_t when_ns, const char *text, size_t len);
+
+
+/**
+ *  Creates a reader for one stream.
+ *
+ *  @return the reader or NULL on failure (XA_OUT_OF_MEMORY)
+ */
+struct binlog_reader *binlog_reader_create(XAcode *err);
+
+
+/**
+ *  Releases the reader and the formats it has learned.
+ */
+void binlog_reader_destroy(struct binlog_reader *r);
+
+
+/**
+ *  Reads the next record from the stream.
+ *
+ *  @param buf  the unread part of the stream
+ *  @param used set to the bytes consumed, or 0 if buf doesn't hold a whole
+ *              record yet
+ *  @param line filled in when the record is a log line
+ *
+ *  @return XA_OK, or XA_INVALID_INPUT if the stream is corrupt
+ */
+XAcode binlog_reader_next(struct binlog_reader *r, const uint8_t *buf,
+                          size_t len, size_t *used, struct binlog_line *line,
+                          XAcode *err);
+
+
+/**
+ *  Gets the name of a log level, or "?????" if it is unknown.
+ */
+const char *binlog_level_name(int level);
+
+#endif
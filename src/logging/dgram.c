@@ -0,0 +1,311 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Needed for gmtime_r() and MSG_NOSIGNAL */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dgram.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define JOURNALD_PATH "/run/systemd/journal/socket"
+#define SYSLOG_PATH   "/dev/log"
+#define DEFAULT_IDENT "xmidt-agent"
+
+#define IDENT_MAX  64
+#define FIELD_MAX  200 /* longest file name or error string sent */
+#define HEAD_MAX   1024
+#define FACILITY   3 /* daemon */
+#define SD_ID      "xa@32473"
+#define NS_PER_S   1000000000ull
+#define NS_PER_US  1000u
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct log_dgram {
+    int fd;
+    enum log_dgram_proto proto;
+    struct sockaddr_un addr;
+    char ident[IDENT_MAX + 1];
+    int pid;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* The syslog severity for each log level. */
+static const int severity[] = { 7, 7, 6, 4, 3, 2 };
+
+static const char *level_name[] = { "trace", "debug", "info", "warn", "error", "fatal" };
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void put(char *buf, size_t *n, const char *format, ...)
+{
+    va_list args;
+    int rv;
+
+    if (HEAD_MAX <= *n) {
+        return;
+    }
+
+    va_start(args, format);
+    rv = vsnprintf(&buf[*n], HEAD_MAX - *n, format, args);
+    va_end(args);
+
+    if (0 < rv) {
+        *n += (size_t) rv;
+    }
+    if (HEAD_MAX < *n) {
+        *n = HEAD_MAX;
+    }
+}
+
+
+/**
+ *  Finds the module name in a file name: the base name without the
+ *  extension.
+ */
+static const char *module(const char *file, int *len)
+{
+    const char *base = strrchr(file, '/');
+    const char *dot;
+
+    base = (base) ? base + 1 : file;
+    dot  = strrchr(base, '.');
+    *len = (int) ((dot) ? (size_t) (dot - base) : strlen(base));
+    if (FIELD_MAX < *len) {
+        *len = FIELD_MAX;
+    }
+
+    return base;
+}
+
+
+static size_t journald_head(const struct log_dgram *d, const struct log_record *r,
+                            char *head)
+{
+    size_t n = 0;
+
+    put(head, &n, "PRIORITY=%d\nSYSLOG_IDENTIFIER=%s\n", severity[r->level], d->ident);
+
+    if (r->file) {
+        int len;
+        const char *m = module(r->file, &len);
+
+        put(head, &n, "CODE_FILE=%.*s\nCODE_LINE=%d\nXA_MODULE=%.*s\n",
+            FIELD_MAX, r->file, r->line, len, m);
+    }
+    if (XA_OK != r->code) {
+        put(head, &n, "XA_CODE=%d\nXA_ERROR=%.*s\n", (int) r->code, FIELD_MAX,
+            xa_error_to_string(r->code));
+    }
+
+    if (memchr(r->text, '\n', r->len)) {
+        /* The binary safe form: the name, then the length as 64 bits of
+         * little endian, then the value. */
+        uint64_t len = r->len;
+
+        put(head, &n, "MESSAGE\n");
+        for (int i = 0; (i < 8) && (n < HEAD_MAX); i++) {
+            head[n++] = (char) (len >> (8 * i));
+        }
+    } else {
+        put(head, &n, "MESSAGE=");
+    }
+
+    return n;
+}
+
+
+/* Adds an SD-PARAM, escaping the characters RFC 5424 says must be. */
+static void put_param(char *head, size_t *n, const char *name, const char *value,
+                      int len)
+{
+    put(head, n, " %s=\"", name);
+    for (int i = 0; (i < len) && value[i] && (*n < HEAD_MAX - 2); i++) {
+        if (('"' == value[i]) || ('\\' == value[i]) || (']' == value[i])) {
+            head[(*n)++] = '\\';
+        }
+        head[(*n)++] = value[i];
+    }
+    put(head, n, "\"");
+}
+
+
+static size_t syslog_head(const struct log_dgram *d, const struct log_record *r,
+                          char *head)
+{
+    time_t sec = (time_t) (r->when_ns / NS_PER_S);
+    size_t n   = 0;
+    char ts[32];
+    struct tm utc;
+
+    gmtime_r(&sec, &utc);
+    strftime(ts, sizeof(ts), "%FT%T", &utc);
+
+    put(head, &n, "<%d>1 %s.%06uZ - %s %d - [" SD_ID, FACILITY * 8 + severity[r->level],
+        ts, (unsigned) ((r->when_ns % NS_PER_S) / NS_PER_US), d->ident, d->pid);
+
+    put_param(head, &n, "level", level_name[r->level], FIELD_MAX);
+    if (r->file) {
+        char line[16];
+        int len;
+        const char *m = module(r->file, &len);
+
+        snprintf(line, sizeof(line), "%d", r->line);
+        put_param(head, &n, "module", m, len);
+        put_param(head, &n, "file", r->file, FIELD_MAX);
+        put_param(head, &n, "line", line, FIELD_MAX);
+    }
+    if (XA_OK != r->code) {
+        char code[16];
+
+        snprintf(code, sizeof(code), "%d", (int) r->code);
+        put_param(head, &n, "code", code, FIELD_MAX);
+        put_param(head, &n, "error", xa_error_to_string(r->code), FIELD_MAX);
+    }
+    put(head, &n, "] ");
+
+    return n;
+}
+
+
+/**
+ *  Sends without waiting, connecting again once if the daemon went away.
+ */
+static bool send_iov(struct log_dgram *d, struct iovec *iov, size_t count)
+{
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = count;
+
+    for (int tries = 0; tries < 2; tries++) {
+        if (0 <= sendmsg(d->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL)) {
+            return true;
+        }
+        if ((ECONNREFUSED != errno) && (ENOTCONN != errno)) {
+            return false; /* full, or the line is too big */
+        }
+        if (0 != connect(d->fd, (struct sockaddr *) &d->addr, sizeof(d->addr))) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct log_dgram *log_dgram_create(const struct log_dgram_opts *opts,
+                                   XAcode *err)
+{
+    struct log_dgram *d;
+    const char *path;
+    const char *ident;
+
+    if (!opts || ((LOG_DGRAM__JOURNALD != opts->proto) && (LOG_DGRAM__SYSLOG != opts->proto))) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    path  = opts->path;
+    ident = (opts->ident) ? opts->ident : DEFAULT_IDENT;
+    if (!path) {
+        path = (LOG_DGRAM__JOURNALD == opts->proto) ? JOURNALD_PATH : SYSLOG_PATH;
+    }
+
+    d = calloc(1, sizeof(struct log_dgram));
+    if (!d) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    if ((sizeof(d->addr.sun_path) <= strlen(path)) || (IDENT_MAX < strlen(ident))
+        || strpbrk(ident, " \n"))
+    {
+        free(d);
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    d->proto           = opts->proto;
+    d->pid             = (int) getpid();
+    d->addr.sun_family = AF_UNIX;
+    strcpy(d->addr.sun_path, path);
+    strcpy(d->ident, ident);
+
+    d->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ((d->fd < 0)
+        || (0 != connect(d->fd, (struct sockaddr *) &d->addr, sizeof(d->addr))))
+    {
+        if (0 <= d->fd) {
+            close(d->fd);
+        }
+        free(d);
+        xa_set_error(err, XA_FAILED_TO_OPEN_FILE);
+        return NULL;
+    }
+
+    return d;
+}
+
+
+void log_dgram_destroy(struct log_dgram *d)
+{
+    if (d) {
+        close(d->fd);
+        free(d);
+    }
+}
+
+
+bool log_dgram_send(const struct log_record *r, void *user)
+{
+    struct log_dgram *d = (struct log_dgram *) user;
+    char head[HEAD_MAX];
+    struct iovec iov[3];
+    size_t count = 2;
+
+    if (!d || !r || !r->text || (r->level < LOG_LEVEL__TRACE) || (LOG_LEVEL__FATAL < r->level)) {
+        return false;
+    }
+
+    if (LOG_DGRAM__JOURNALD == d->proto) {
+        iov[0].iov_len  = journald_head(d, r, head);
+        iov[2].iov_base = "\n";
+        iov[2].iov_len  = 1;
+        count           = 3;
+    } else {
+        iov[0].iov_len = syslog_head(d, r, head);
+    }
+    iov[0].iov_base = head;
+    iov[1].iov_base = (void *) r->text;
+    iov[1].iov_len  = r->len;
+
+    return send_iov(d, iov, count);
+}
@@ -0,0 +1,62 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __LOGGING_DGRAM_H__
+#define __LOGGING_DGRAM_H__
+
+#include <stdbool.h>
+
+#include "../error/codes.h"
+#include "log.h"
+
+/* Log sinks that send each line as one datagram to the local journald or
+ * syslog socket, with the level, module and XAcode as fields instead of
+ * colored text that has to be parsed again.
+ *
+ * journald gets its native protocol: PRIORITY, SYSLOG_IDENTIFIER, CODE_FILE,
+ * CODE_LINE, XA_MODULE, XA_CODE and XA_ERROR (when the line has a code),
+ * then MESSAGE.  syslog gets RFC 5424 with the same fields as structured
+ * data in the "xa@32473" element (32473 is the example enterprise number).
+ *
+ * The socket is non-blocking: a line that doesn't fit in it is lost and
+ * counted by log.c as unsent rather than holding up the writer.  If the
+ * daemon restarts, the socket is connected again on the next line. */
+
+enum log_dgram_proto {
+    LOG_DGRAM__JOURNALD = 0,
+    LOG_DGRAM__SYSLOG,
+};
+
+struct log_dgram;
+
+struct log_dgram_opts {
+    enum log_dgram_proto proto;
+    const char *path;  /* NULL for the usual socket of the protocol */
+    const char *ident; /* NULL for "xmidt-agent" */
+};
+
+
+/**
+ *  Opens the socket.
+ *
+ *  @return the sink or NULL on failure (XA_INVALID_INPUT, XA_OUT_OF_MEMORY
+ *          or XA_FAILED_TO_OPEN_FILE)
+ */
+struct log_dgram *log_dgram_create(const struct log_dgram_opts *opts,
+                                   XAcode *err);
+
+
+/**
+ *  Closes the socket.  The sink must not be in use by log.c anymore.
+ */
+void log_dgram_destroy(struct log_dgram *d);
+
+
+/**
+ *  Sends one line; this is the log_sink_fn, with the sink as user.
+ *
+ *  @return true if sent, false if the socket was full or gone
+ */
+bool log_dgram_send(const struct log_record *r, void *user);
+
+#endif
@@ -1,22 +1,29 @@
 /* SPDX-FileCopyrightText: 2021-2022 Comcast Cable Communications Management, LLC */
 /* SPDX-License-Identifier: Apache-2.0 */
 
-/* Needed for gmtime_r() */
-#define _POSIX_C_SOURCE 199309L
+/* Needed for gmtime_r() and the pthreads */
+#define _POSIX_C_SOURCE 200809L
 
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <cutils/printf.h>
 #include <otelc/time.h>
 
+#include "binlog.h"
 #include "log.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
 #define BOLD "\x1b[1m"
 #define DIM  "\x1b[2m"
 #define DRED "\x1b[31m"
@@ -25,18 +32,23 @@
 
 #define TS DIM WHT
 
+#define LINE_FMT "%s%s\x1b[0m | %s%s\x1b[0m | %s%s\x1b[0m\n"
+#define TS_LEN   32 /* "YYYY-MM-DD HH:MM:SS.nnnnnnnnnZ" */
+
+#define DEFAULT_LINES 256
+#define MAX_LINES     (1u << 20)
+#define CACHE_LINE    64
+#define BATCH_BYTES   (64 * 1024)
+#define LINE_BYTES    (LOG_LINE_MAX + 128) /* the text plus the decoration */
+#define IDLE_WAIT_MS  100
+#define NS_PER_S      1000000000ull
+#define RESYNC_NS     (10 * NS_PER_S) /* how often the clock offset is renewed */
+#define FNV_OFFSET    14695981039346656037ull
+#define FNV_PRIME     1099511628211ull
+
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
-enum level {
-    TRACE = 0,
-    DEBUG = 1,
-    INFO  = 2,
-    WARN  = 3,
-    ERROR = 4,
-    FATAL = 5,
-};
-
 struct log_opts {
     const char *ts_color;
     const char *level_color;
@@ -71,10 +83,85 @@ const struct log_opts _opts[6] = {
      .payload_color = ""},
 };
 
+/* A slot is free for the producer claiming position pos when seq == pos, and
+ * holds a finished line for the writer when seq == pos + 1. */
+struct slot {
+    uint64_t seq;
+    uint64_t when_ns;
+    enum log_level level;
+    const char *file;
+    int line;
+    XAcode code;
+    const char *format; /* set when text holds binary arguments */
+    size_t len;
+    char text[LOG_LINE_MAX];
+};
+
+/* Maps a format string (by address) to the id it has in the binary stream. */
+struct format_id {
+    const char *format;
+    uint32_t id;
+};
+
+struct async_log {
+    struct slot *slots;
+    uint64_t mask;
+    enum log_overflow overflow;
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char *batch;
+    bool binary;
+    log_sink_fn sink;
+    void *sink_user;
+
+    /* Only used by the writer, in binary mode. */
+    struct format_id *ids;
+    size_t ids_cap;
+    uint32_t ids_count;
+    uint8_t pad0[CACHE_LINE];
+
+    uint64_t enqueue; /* claimed by the producers */
+    uint8_t pad1[CACHE_LINE - 8];
+
+    uint64_t dequeue;  /* only touched by the writer */
+    uint64_t reported; /* the dropped count last logged */
+    uint8_t pad2[CACHE_LINE - 16];
+
+    uint32_t sleeping; /* set while the writer waits on cond */
+    uint32_t stopping;
+    uint8_t pad3[CACHE_LINE - 8];
+};
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static struct async_log *async = NULL;
+static uint64_t dropped         = 0;
+static uint64_t limited         = 0;
+static uint64_t repeated        = 0;
+static uint64_t unsent          = 0;
+
+int log_runtime_level = LOG_LEVEL__TRACE;
+
+static int subsecond_digits = 0;
+
+/* Lines are stamped from the monotonic clock plus an offset to the real time
+ * clock, so the times within a run never step backwards. */
+static int64_t realtime_offset_ns = 0;
+static uint64_t resync_at_ns      = 0;
+
+/* The per call site limits; an interval of 0 means no rate limit. */
+static uint64_t interval_ns  = 0;
+static uint64_t tolerance_ns = 0;
+static int collapse          = 0;
+
+/* Every call site that has suppressed a line, for log_flush_suppressed(). */
+static struct log_site *sites = NULL;
+
+static log_sink_fn sink = NULL;
+static void *sink_user  = NULL;
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
@@ -84,40 +171,779 @@ const struct log_opts _opts[6] = {
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
-static void _log(enum level level, const char *format, va_list args)
+static uint64_t clock_ns(clockid_t id)
 {
-    char ts[32];
-    time_t now;
-    struct tm utc;
-    char *payload      = NULL;
-    const char *no_mem = "Memory allocation failure during logging.";
-    const char *p      = no_mem;
+    struct timespec ts;
 
-    const struct log_opts *opt = &_opts[level];
+    clock_gettime(id, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_S + (uint64_t) ts.tv_nsec;
+}
 
-    /* Generate an RFC3339 timestamp string */
-    time(&now);
-    gmtime_r(&now, &utc);
-    strftime(ts, sizeof(ts) - 1, "%F %TZ", &utc);
 
-    payload = mvaprintf(format, args);
+static uint64_t now_ns(void)
+{
+    uint64_t mono = clock_ns(CLOCK_MONOTONIC);
+
+    /* Racing threads all compute about the same offset, so whichever store
+     * lands last is fine. */
+    if (__atomic_load_n(&resync_at_ns, __ATOMIC_RELAXED) <= mono) {
+        int64_t offset = (int64_t) (clock_ns(CLOCK_REALTIME) - mono);
+
+        __atomic_store_n(&realtime_offset_ns, offset, __ATOMIC_RELAXED);
+        __atomic_store_n(&resync_at_ns, mono + RESYNC_NS, __ATOMIC_RELAXED);
+    }
+
+    return mono + (uint64_t) __atomic_load_n(&realtime_offset_ns, __ATOMIC_RELAXED);
+}
+
+
+/**
+ *  Renders an RFC3339 timestamp string.  The calendar part only changes once
+ *  a second, so each thread keeps its last one and only adds the fraction.
+ */
+static void timestamp(uint64_t when_ns, char *buf)
+{
+    static __thread struct {
+        time_t sec;
+        size_t len;
+        char text[TS_LEN];
+    } cache;
+
+    time_t sec = (time_t) (when_ns / NS_PER_S);
+    int digits = __atomic_load_n(&subsecond_digits, __ATOMIC_RELAXED);
+    size_t len;
+
+    if ((0 == cache.len) || (cache.sec != sec)) {
+        struct tm utc;
+
+        gmtime_r(&sec, &utc);
+        cache.len = strftime(cache.text, sizeof(cache.text), "%F %T", &utc);
+        cache.sec = sec;
+    }
+
+    memcpy(buf, cache.text, cache.len);
+    len = cache.len;
+
+    if (digits) {
+        uint32_t frac = (uint32_t) (when_ns % NS_PER_S);
+
+        for (int i = digits; i < 9; i++) {
+            frac /= 10;
+        }
+        buf[len++] = '.';
+        for (int i = digits - 1; 0 <= i; i--) {
+            buf[len + (size_t) i] = (char) ('0' + frac % 10);
+            frac /= 10;
+        }
+        len += (size_t) digits;
+    }
+
+    buf[len++] = 'Z';
+    buf[len]   = '\0';
+}
+
+
+static void to_sink(log_sink_fn fn, void *user, const struct log_record *r)
+{
+    if (!fn(r, user)) {
+        __atomic_add_fetch(&unsent, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ *  Writes a line on the caller's thread.
+ *
+ *  @param r the level and call site of the line
+ */
+static void print_line(struct log_record *r, const char *text)
+{
+    const struct log_opts *opt = &_opts[r->level];
+    char ts[TS_LEN];
+
+    if (!text) {
+        text = "Memory allocation failure during logging.";
+    }
+    r->when_ns = now_ns();
+
+    if (sink) {
+        r->text = text;
+        r->len  = strlen(text);
+        to_sink(sink, sink_user, r);
+        return;
+    }
+
+    timestamp(r->when_ns, ts);
+    fprintf(stdout, LINE_FMT, opt->ts_color, ts, opt->level_color, opt->level,
+            opt->payload_color, text);
+}
+
+
+static void _log_sync(struct log_record *r, const char *format, va_list args)
+{
+    char *payload = mvaprintf(format, args);
+
+    print_line(r, payload);
+
     if (payload) {
-        p = payload;
+        free(payload);
+    }
+}
+
+
+static void wake_writer(struct async_log *a)
+{
+    /* Pairs with the fence in writer_wait(): either the writer sees the new
+     * line, or we see that it is sleeping. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&a->sleeping, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_signal(&a->cond);
+        pthread_mutex_unlock(&a->lock);
+    }
+}
+
+
+static void backoff(unsigned *spins)
+{
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000 };
+
+    if (*spins < 64) {
+        (*spins)++;
+        sched_yield();
+    } else {
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+/**
+ *  Claims the next slot.  The only shared write on the way in is the CAS on
+ *  the enqueue position.
+ *
+ *  @return the slot, or NULL if the ring was full and the line is dropped
+ */
+static struct slot *claim(struct async_log *a, const struct log_record *r,
+                          uint64_t *pos)
+{
+    bool block    = (LOG_OVERFLOW__BLOCK == a->overflow) || (LOG_LEVEL__FATAL == r->level);
+    unsigned spin = 0;
+    struct slot *s;
+
+    *pos = __atomic_load_n(&a->enqueue, __ATOMIC_RELAXED);
+    for (;;) {
+        int64_t diff;
+
+        s    = &a->slots[*pos & a->mask];
+        diff = (int64_t) (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - *pos);
+
+        if (0 == diff) {
+            if (__atomic_compare_exchange_n(&a->enqueue, pos, *pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        } else if (diff < 0) {
+            /* The ring is full. */
+            if (!block) {
+                __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+            wake_writer(a);
+            backoff(&spin);
+            *pos = __atomic_load_n(&a->enqueue, __ATOMIC_RELAXED);
+        } else {
+            *pos = __atomic_load_n(&a->enqueue, __ATOMIC_RELAXED);
+        }
+    }
+
+    s->when_ns = now_ns();
+    s->level   = r->level;
+    s->file    = r->file;
+    s->line    = r->line;
+    s->code    = r->code;
+
+    return s;
+}
+
+
+static void publish(struct async_log *a, struct slot *s, uint64_t pos)
+{
+    __atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+    wake_writer(a);
+}
+
+
+/**
+ *  Fills in the text of a slot: the encoded arguments in binary mode, if the
+ *  format can be encoded, otherwise the formatted line.
+ */
+static void render(struct async_log *a, struct slot *s, const char *format,
+                   va_list args)
+{
+    int n;
+
+    s->format = NULL;
+    if (a->binary && binlog_encode_args((uint8_t *) s->text, sizeof(s->text),
+                                        &s->len, format, args))
+    {
+        s->format = format;
+        return;
+    }
+
+    n = vsnprintf(s->text, sizeof(s->text), format, args);
+    if (n < 0) {
+        strcpy(s->text, "Formatting failure during logging.");
+        n = (int) strlen(s->text);
+    }
+    s->len = ((size_t) n < sizeof(s->text)) ? (size_t) n : sizeof(s->text) - 1;
+}
+
+
+/**
+ *  Formats the line straight into a slot and publishes it.
+ */
+static void _log_async(struct async_log *a, const struct log_record *r,
+                       const char *format, va_list args)
+{
+    uint64_t pos;
+    struct slot *s = claim(a, r, &pos);
+
+    if (s) {
+        render(a, s, format, args);
+        publish(a, s, pos);
+    }
+}
+
+
+static void _log(struct log_record *r, const char *format, va_list args)
+{
+    struct async_log *a;
+
+    /* The macros check this too; this covers the log_va_*() calls. */
+    if ((int) r->level < __atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    a = __atomic_load_n(&async, __ATOMIC_ACQUIRE);
+    if (a) {
+        _log_async(a, r, format, args);
+    } else {
+        _log_sync(r, format, args);
+    }
+}
+
+
+static void _log_plain(enum log_level level, const char *format, va_list args)
+{
+    struct log_record r;
+
+    memset(&r, 0, sizeof(r));
+    r.level = level;
+    _log(&r, format, args);
+}
+
+
+static void notice(struct log_site *site, const char *format, ...)
+{
+    struct log_record r;
+    va_list args;
+
+    memset(&r, 0, sizeof(r));
+    r.level = site->level;
+    r.file  = site->file;
+    r.line  = site->line;
+
+    va_start(args, format);
+    _log(&r, format, args);
+    va_end(args);
+}
+
+
+/**
+ *  Gives a call site another line from its token bucket, in the form of the
+ *  generic cell rate algorithm: tat is when the bucket would be full again.
+ *
+ *  @return true if the call site is over its rate
+ */
+static bool over_rate(struct log_site *site)
+{
+    uint64_t interval  = __atomic_load_n(&interval_ns, __ATOMIC_RELAXED);
+    uint64_t tolerance = __atomic_load_n(&tolerance_ns, __ATOMIC_RELAXED);
+    uint64_t now, tat, next;
+
+    if (!interval) {
+        return false;
+    }
+
+    now = clock_ns(CLOCK_MONOTONIC);
+    tat = __atomic_load_n(&site->tat, __ATOMIC_RELAXED);
+    do {
+        uint64_t start = (tat < now) ? now : tat;
+
+        if (now + tolerance < start) {
+            return true;
+        }
+        next = start + interval;
+    } while (!__atomic_compare_exchange_n(&site->tat, &tat, next, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return false;
+}
+
+
+static void suppress(struct log_site *site, uint32_t *count, uint64_t *total)
+{
+    __atomic_add_fetch(count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(total, 1, __ATOMIC_RELAXED);
+
+    /* Sites are static, so once listed they stay listed. */
+    if (0 == __atomic_exchange_n(&site->listed, 1, __ATOMIC_RELAXED)) {
+        site->next = __atomic_load_n(&sites, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&sites, &site->next, site, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+        }
     }
+}
 
-    fprintf(stdout, "%s%s\x1b[0m | %s%s\x1b[0m | %s%s\x1b[0m\n",
-            opt->ts_color, ts, opt->level_color, opt->level,
-            opt->payload_color, p);
+
+static uint64_t hash(const char *format, const char *text, size_t len)
+{
+    uint64_t h = FNV_OFFSET;
+
+    /* In binary mode the same arguments to another format are another line. */
+    for (size_t i = 0; format && (i < sizeof(format)); i++) {
+        h = (h ^ (uint8_t) ((uintptr_t) format >> (8 * i))) * FNV_PRIME;
+    }
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t) text[i]) * FNV_PRIME;
+    }
+
+    /* 0 is kept for no line at all. */
+    return (h) ? h : 1;
+}
+
+
+/**
+ *  Remembers the line as the last one from the call site.
+ *
+ *  @return true if it was the last one already, and was counted instead
+ */
+static bool is_repeat(struct log_site *site, uint64_t h)
+{
+    if (h == __atomic_exchange_n(&site->hash, h, __ATOMIC_RELAXED)) {
+        suppress(site, &site->repeated, &repeated);
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ *  Logs a notice for any lines the call site has suppressed since the last
+ *  one, at the level of the call site.
+ */
+static void report(struct log_site *site)
+{
+    uint32_t n;
+
+    if (!__atomic_load_n(&site->listed, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    n = __atomic_exchange_n(&site->repeated, 0, __ATOMIC_RELAXED);
+    if (n) {
+        notice(site, "%s:%d: last line repeated %u more times",
+               site->file, site->line, n);
+    }
+
+    n = __atomic_exchange_n(&site->limited, 0, __ATOMIC_RELAXED);
+    if (n) {
+        notice(site, "%s:%d: %u lines over the rate limit suppressed",
+               site->file, site->line, n);
+    }
+}
+
+
+static void _log_site_sync(struct log_site *site, struct log_record *r,
+                           const char *format, va_list args)
+{
+    char *payload = mvaprintf(format, args);
+
+    if (payload && is_repeat(site, hash(NULL, payload, strlen(payload)))) {
+        free(payload);
+        return;
+    }
+
+    report(site);
+    print_line(r, payload);
 
     if (payload) {
         free(payload);
     }
 }
 
+
+/**
+ *  Renders the line on the stack first, since the slot can't be given back
+ *  once claimed if it turns out to be a repeat.
+ */
+static void _log_site_async(struct async_log *a, struct log_site *site,
+                            const struct log_record *r, const char *format,
+                            va_list args)
+{
+    struct slot line;
+    struct slot *s;
+    uint64_t pos;
+
+    render(a, &line, format, args);
+    if (is_repeat(site, hash(line.format, line.text, line.len))) {
+        return;
+    }
+
+    report(site);
+
+    s = claim(a, r, &pos);
+    if (s) {
+        s->format = line.format;
+        s->len    = line.len;
+        memcpy(s->text, line.text, (line.format) ? line.len : line.len + 1);
+        publish(a, s, pos);
+    }
+}
+
+
+static void _log_site(struct log_site *site, XAcode code, const char *format,
+                      va_list args)
+{
+    struct async_log *a;
+    struct log_record r;
+
+    memset(&r, 0, sizeof(r));
+    r.level = site->level;
+    r.file  = site->file;
+    r.line  = site->line;
+    r.code  = code;
+
+    if (LOG_LEVEL__FATAL == site->level) {
+        _log(&r, format, args);
+        return;
+    }
+
+    if (over_rate(site)) {
+        suppress(site, &site->limited, &limited);
+        return;
+    }
+
+    if (!__atomic_load_n(&collapse, __ATOMIC_RELAXED)) {
+        report(site);
+        _log(&r, format, args);
+        return;
+    }
+
+    a = __atomic_load_n(&async, __ATOMIC_ACQUIRE);
+    if (a) {
+        _log_site_async(a, site, &r, format, args);
+    } else {
+        _log_site_sync(site, &r, format, args);
+    }
+}
+
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return; /* nowhere left to complain to */
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+}
+
+
+static size_t append_text(char *buf, enum log_level level, uint64_t when_ns,
+                          const char *text)
+{
+    const struct log_opts *opt = &_opts[level];
+    char ts[TS_LEN];
+    int n;
+
+    timestamp(when_ns, ts);
+    n = snprintf(buf, LINE_BYTES, LINE_FMT, opt->ts_color, ts,
+                 opt->level_color, opt->level, opt->payload_color, text);
+    if (n < 0) {
+        return 0;
+    }
+    if (LINE_BYTES <= n) {
+        /* Keep the line ending even when the text is cut short. */
+        buf[LINE_BYTES - 1] = '\n';
+        return LINE_BYTES;
+    }
+
+    return (size_t) n;
+}
+
+
+/**
+ *  Finds the id for a format, giving it the next one if it is new.
+ *
+ *  @return true if found, false if out of memory
+ */
+static bool format_id(struct async_log *a, const char *format, uint32_t *id,
+                      bool *is_new)
+{
+    size_t i;
+
+    if (a->ids_cap <= 2 * (size_t) a->ids_count) {
+        size_t cap            = (a->ids_cap) ? 2 * a->ids_cap : 64;
+        struct format_id *ids = calloc(cap, sizeof(struct format_id));
+
+        if (!ids) {
+            return false;
+        }
+        for (size_t j = 0; j < a->ids_cap; j++) {
+            if (a->ids[j].format) {
+                i = ((uintptr_t) a->ids[j].format >> 3) & (cap - 1);
+                while (ids[i].format) {
+                    i = (i + 1) & (cap - 1);
+                }
+                ids[i] = a->ids[j];
+            }
+        }
+        free(a->ids);
+        a->ids     = ids;
+        a->ids_cap = cap;
+    }
+
+    i = ((uintptr_t) format >> 3) & (a->ids_cap - 1);
+    while (a->ids[i].format && (a->ids[i].format != format)) {
+        i = (i + 1) & (a->ids_cap - 1);
+    }
+
+    *is_new = (NULL == a->ids[i].format);
+    if (*is_new) {
+        a->ids[i].format = format;
+        a->ids[i].id     = a->ids_count++;
+    }
+    *id = a->ids[i].id;
+
+    return true;
+}
+
+
+static size_t append_binary(struct async_log *a, size_t used,
+                            const struct slot *s)
+{
+    uint8_t *buf     = (uint8_t *) a->batch;
+    uint64_t when_ns = s->when_ns;
+    bool is_new      = false;
+    uint32_t id      = 0;
+    size_t n;
+
+    if (!s->format) {
+        return used + binlog_put_text(&buf[used], BATCH_BYTES - used, s->level,
+                                      when_ns, s->text, strlen(s->text));
+    }
+
+    if (!format_id(a, s->format, &id, &is_new)) {
+        __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+        return used;
+    }
+
+    if (is_new) {
+        n = binlog_put_format(&buf[used], BATCH_BYTES - used, id, s->format);
+        if (!n) {
+            write_all(a->fd, a->batch, used);
+            used = 0;
+            n    = binlog_put_format(buf, BATCH_BYTES, id, s->format);
+        }
+        used += n;
+        if (BATCH_BYTES - used < LINE_BYTES) {
+            write_all(a->fd, a->batch, used);
+            used = 0;
+        }
+    }
+
+    return used + binlog_put_args(&buf[used], BATCH_BYTES - used, id, s->level,
+                                  when_ns, (const uint8_t *) s->text, s->len);
+}
+
+
+/**
+ *  Adds a line to the batch, or hands it to the sink if there is one.
+ *
+ *  @param s the slot the line came from, or NULL for the writer's notices
+ */
+static size_t append(struct async_log *a, size_t used,
+                     const struct log_record *r, const struct slot *s)
+{
+    if (a->sink) {
+        to_sink(a->sink, a->sink_user, r);
+        return used;
+    }
+
+    if (BATCH_BYTES - used < LINE_BYTES) {
+        write_all(a->fd, a->batch, used);
+        used = 0;
+    }
+
+    if (s && a->binary) {
+        return append_binary(a, used, s);
+    }
+    if (a->binary) {
+        uint8_t *buf = (uint8_t *) a->batch;
+
+        return used + binlog_put_text(&buf[used], BATCH_BYTES - used, r->level,
+                                      r->when_ns, r->text, r->len);
+    }
+
+    return used + append_text(&a->batch[used], r->level, r->when_ns, r->text);
+}
+
+
+/**
+ *  Moves every finished line from the ring into the batch, writing the
+ *  batch whenever it fills up.
+ *
+ *  @return the number of bytes left in the batch
+ */
+static size_t drain(struct async_log *a, size_t used)
+{
+    uint64_t now_dropped;
+    struct log_record note;
+
+    for (;;) {
+        struct slot *s = &a->slots[a->dequeue & a->mask];
+        struct log_record r;
+
+        if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != a->dequeue + 1) {
+            break;
+        }
+
+        r = (struct log_record) {
+            .level   = s->level,
+            .when_ns = s->when_ns,
+            .file    = s->file,
+            .line    = s->line,
+            .code    = s->code,
+            .text    = s->text,
+            .len     = s->len,
+        };
+        used = append(a, used, &r, s);
+
+        /* Hand the slot back for the next lap. */
+        __atomic_store_n(&s->seq, a->dequeue + a->mask + 1, __ATOMIC_RELEASE);
+        a->dequeue++;
+    }
+
+    now_dropped = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    if (now_dropped != a->reported) {
+        char text[64];
+
+        memset(&note, 0, sizeof(note));
+        note.level   = LOG_LEVEL__WARN;
+        note.when_ns = now_ns();
+        note.text    = text;
+        note.len     = (size_t) snprintf(text, sizeof(text), "%llu log lines dropped",
+                                         (unsigned long long) (now_dropped - a->reported));
+        a->reported = now_dropped;
+
+        used = append(a, used, &note, NULL);
+    }
+
+    return used;
+}
+
+
+static bool ring_empty(struct async_log *a)
+{
+    struct slot *s = &a->slots[a->dequeue & a->mask];
+
+    return (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != a->dequeue + 1);
+}
+
+
+static void writer_wait(struct async_log *a)
+{
+    struct timespec until;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += IDLE_WAIT_MS * 1000000L;
+    if (1000000000L <= until.tv_nsec) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    __atomic_store_n(&a->sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (ring_empty(a) && !__atomic_load_n(&a->stopping, __ATOMIC_ACQUIRE)) {
+        pthread_cond_timedwait(&a->cond, &a->lock, &until);
+    }
+
+    __atomic_store_n(&a->sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&a->lock);
+}
+
+
+static void *writer(void *arg)
+{
+    struct async_log *a = (struct async_log *) arg;
+    size_t used         = 0;
+
+    if (a->binary) {
+        used = binlog_put_header((uint8_t *) a->batch, BATCH_BYTES);
+    }
+
+    for (;;) {
+        used = drain(a, used);
+
+        if (used) {
+            write_all(a->fd, a->batch, used);
+            used = 0;
+            continue;
+        }
+
+        /* Everything claimed before stopping has been written. */
+        if (__atomic_load_n(&a->stopping, __ATOMIC_ACQUIRE)
+            && (a->dequeue == __atomic_load_n(&a->enqueue, __ATOMIC_ACQUIRE)))
+        {
+            break;
+        }
+
+        writer_wait(a);
+    }
+
+    return NULL;
+}
+
+
+static void async_free(struct async_log *a)
+{
+    if (a) {
+        free(a->ids);
+        free(a->batch);
+        free(a->slots);
+        free(a);
+    }
+}
+
+
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
 /*----------------------------------------------------------------------------*/
-void log_trace(const char *format, ...)
+
+/* The names are in parentheses so the level checking macros in log.h aren't
+ * expanded here. */
+void (log_trace)(const char *format, ...)
 {
     va_list args;
 
@@ -127,7 +953,7 @@ void log_trace(const char *format, ...)
 }
 
 
-void log_debug(const char *format, ...)
+void (log_debug)(const char *format, ...)
 {
     va_list args;
 
@@ -137,7 +963,7 @@ void log_debug(const char *format, ...)
 }
 
 
-void log_info(const char *format, ...)
+void (log_info)(const char *format, ...)
 {
     va_list args;
 
@@ -147,7 +973,7 @@ void log_info(const char *format, ...)
 }
 
 
-void log_warn(const char *format, ...)
+void (log_warn)(const char *format, ...)
 {
     va_list args;
 
@@ -157,7 +983,7 @@ void log_warn(const char *format, ...)
 }
 
 
-void log_error(const char *format, ...)
+void (log_error)(const char *format, ...)
 {
     va_list args;
 
@@ -167,7 +993,7 @@ void log_error(const char *format, ...)
 }
 
 
-void log_fatal(const char *format, ...)
+void (log_fatal)(const char *format, ...)
 {
     va_list args;
 
@@ -177,37 +1003,242 @@ void log_fatal(const char *format, ...)
 }
 
 
+void log_at(struct log_site *site, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    _log_site(site, XA_OK, format, args);
+    va_end(args);
+}
+
+
+void log_at_code(struct log_site *site, XAcode code, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    _log_site(site, code, format, args);
+    va_end(args);
+}
+
+
 void log_va_trace(const char *format, va_list args)
 {
-    _log(TRACE, format, args);
+    _log_plain(LOG_LEVEL__TRACE, format, args);
 }
 
 
 void log_va_debug(const char *format, va_list args)
 {
-    _log(DEBUG, format, args);
+    _log_plain(LOG_LEVEL__DEBUG, format, args);
 }
 
 
 void log_va_info(const char *format, va_list args)
 {
-    _log(INFO, format, args);
+    _log_plain(LOG_LEVEL__INFO, format, args);
 }
 
 
 void log_va_warn(const char *format, va_list args)
 {
-    _log(WARN, format, args);
+    _log_plain(LOG_LEVEL__WARN, format, args);
 }
 
 
 void log_va_error(const char *format, va_list args)
 {
-    _log(ERROR, format, args);
+    _log_plain(LOG_LEVEL__ERROR, format, args);
 }
 
 
 void log_va_fatal(const char *format, va_list args)
 {
-    _log(FATAL, format, args);
+    _log_plain(LOG_LEVEL__FATAL, format, args);
+}
+
+
+XAcode log_async_start(const struct log_async_opts *opts, XAcode *err)
+{
+    struct async_log *a;
+    uint64_t lines = DEFAULT_LINES;
+    sigset_t all, old;
+    int rv;
+
+    if (__atomic_load_n(&async, __ATOMIC_ACQUIRE)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (opts && opts->lines) {
+        if (MAX_LINES < opts->lines) {
+            return xa_set_error(err, XA_INVALID_INPUT);
+        }
+        lines = 2;
+        while (lines < opts->lines) {
+            lines <<= 1;
+        }
+    }
+
+    a = calloc(1, sizeof(struct async_log));
+    if (!a) {
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    a->slots = calloc(lines, sizeof(struct slot));
+    a->batch = malloc(BATCH_BYTES);
+    if (!a->slots || !a->batch) {
+        async_free(a);
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    for (uint64_t i = 0; i < lines; i++) {
+        a->slots[i].seq = i;
+    }
+    a->mask      = lines - 1;
+    a->reported  = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    a->fd        = STDOUT_FILENO;
+    a->sink      = sink;
+    a->sink_user = sink_user;
+    if (opts) {
+        a->overflow = opts->overflow;
+        a->binary   = (LOG_FORMAT__BINARY == opts->format) && !sink;
+        if (0 < opts->fd) {
+            a->fd = opts->fd;
+        }
+    }
+
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->cond, NULL);
+
+    /* The writer starts with every signal blocked so they are only ever
+     * delivered to the threads that expect them, whenever this is called. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rv = pthread_create(&a->thread, NULL, writer, a);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (0 != rv) {
+        pthread_cond_destroy(&a->cond);
+        pthread_mutex_destroy(&a->lock);
+        async_free(a);
+        return xa_set_error(err, XA_INSUFFICIENT_RESOURCES);
+    }
+
+    /* Anything already buffered goes out before the writer's lines. */
+    fflush(stdout);
+    __atomic_store_n(&async, a, __ATOMIC_RELEASE);
+
+    return XA_OK;
+}
+
+
+void log_async_stop(void)
+{
+    struct async_log *a = __atomic_exchange_n(&async, NULL, __ATOMIC_ACQ_REL);
+
+    if (!a) {
+        return;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    __atomic_store_n(&a->stopping, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+
+    pthread_join(a->thread, NULL);
+
+    pthread_cond_destroy(&a->cond);
+    pthread_mutex_destroy(&a->lock);
+    async_free(a);
+}
+
+
+void log_set_level(enum log_level level)
+{
+    if ((level < LOG_LEVEL__TRACE) || (LOG_LEVEL__FATAL < level)) {
+        return;
+    }
+    __atomic_store_n(&log_runtime_level, (int) level, __ATOMIC_RELAXED);
+}
+
+
+enum log_level log_get_level(void)
+{
+    return (enum log_level) __atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED);
+}
+
+
+void log_set_subsecond(int digits)
+{
+    if (digits < 0) {
+        digits = 0;
+    }
+    if (9 < digits) {
+        digits = 9;
+    }
+    __atomic_store_n(&subsecond_digits, digits, __ATOMIC_RELAXED);
+}
+
+
+uint64_t log_dropped(void)
+{
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+
+void log_set_limits(const struct log_limits *limits)
+{
+    uint64_t interval = 0;
+    uint64_t burst    = 1;
+    int on            = 0;
+
+    if (limits) {
+        if (limits->rate) {
+            interval = NS_PER_S / limits->rate;
+        }
+        if (limits->burst) {
+            burst = limits->burst;
+        }
+        on = (LOG_REPEATS__COLLAPSE == limits->repeats);
+    }
+
+    __atomic_store_n(&interval_ns, interval, __ATOMIC_RELAXED);
+    __atomic_store_n(&tolerance_ns, interval * (burst - 1), __ATOMIC_RELAXED);
+    __atomic_store_n(&collapse, on, __ATOMIC_RELAXED);
+}
+
+
+void log_flush_suppressed(void)
+{
+    struct log_site *site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE);
+
+    while (site) {
+        report(site);
+        site = site->next;
+    }
+}
+
+
+void log_get_stats(struct log_stats *stats)
+{
+    if (stats) {
+        stats->dropped  = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+        stats->limited  = __atomic_load_n(&limited, __ATOMIC_RELAXED);
+        stats->repeated = __atomic_load_n(&repeated, __ATOMIC_RELAXED);
+        stats->unsent   = __atomic_load_n(&unsent, __ATOMIC_RELAXED);
+    }
+}
+
+
+XAcode log_set_sink(log_sink_fn fn, void *user, XAcode *err)
+{
+    if (__atomic_load_n(&async, __ATOMIC_ACQUIRE)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    sink      = fn;
+    sink_user = user;
+
+    return XA_OK;
 }
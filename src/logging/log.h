@@ -5,8 +5,122 @@
 #define __LOG_H__
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-/* Until otelc is able to adopt a better mechanism, this will do. */
+#include "../error/codes.h"
+
+/* Until otelc is able to adopt a better mechanism, this will do.
+ *
+ * By default every line is formatted and written to stdout on the caller's
+ * thread.  Once log_async_start() is called, callers instead format into a
+ * slot of a fixed size lock-free ring and a background writer drains it to
+ * the output with batched write() calls, so logging never blocks on the
+ * terminal or journal.  Lines longer than LOG_LINE_MAX are truncated in
+ * async mode.
+ *
+ * The async mode can also write binary records (see binlog.h) instead of
+ * text: callers only copy the format's arguments, and the formatting is done
+ * later by a decoder, off the device.  Binary mode keeps the address of each
+ * format string, so formats must be string literals.
+ *
+ * Lines logged through the macros below can be limited per call site, so a
+ * failure that repeats in a loop can't flood the output: a token bucket caps
+ * how fast each call site may log, and a line identical to the last one from
+ * the same call site is counted instead of written.  The counts come out as
+ * a notice before the next line from that call site, or when
+ * log_flush_suppressed() is called.
+ *
+ * Instead of the colored text, lines can go to a sink (see log_set_sink()),
+ * which gets each one as a record with the call site and the XAcode still
+ * attached; dgram.h has sinks for journald and syslog. */
+
+#define LOG_LINE_MAX 1024
+
+/* Levels below LOG_LEVEL_MIN (set by the log-level build option) are
+ * compiled out entirely, and levels below the runtime level set with
+ * log_set_level() cost one branch: the arguments aren't evaluated. */
+#ifndef LOG_LEVEL_MIN
+#define LOG_LEVEL_MIN 0
+#endif
+
+enum log_level {
+    LOG_LEVEL__TRACE = 0,
+    LOG_LEVEL__DEBUG,
+    LOG_LEVEL__INFO,
+    LOG_LEVEL__WARN,
+    LOG_LEVEL__ERROR,
+    LOG_LEVEL__FATAL,
+};
+
+enum log_format {
+    LOG_FORMAT__TEXT = 0,
+    LOG_FORMAT__BINARY, /* binlog records, rendered later by a decoder */
+};
+
+enum log_overflow {
+    LOG_OVERFLOW__DROP = 0, /* drop the line and count it */
+    LOG_OVERFLOW__BLOCK,    /* wait for the writer to make room */
+};
+
+enum log_repeats {
+    LOG_REPEATS__KEEP = 0,
+    LOG_REPEATS__COLLAPSE, /* count repeats of the last line from a call site */
+};
+
+struct log_async_opts {
+    size_t lines;               /* ring slots, rounded up to a power of 2 */
+    enum log_overflow overflow; /* fatal lines always block */
+    int fd;                     /* where the writer writes, 0 for stdout */
+    enum log_format format;
+};
+
+struct log_limits {
+    unsigned rate;  /* lines per second from each call site, 0 for no limit */
+    unsigned burst; /* lines a call site may log at once, at least 1 */
+    enum log_repeats repeats;
+};
+
+struct log_stats {
+    uint64_t dropped;  /* the async ring was full */
+    uint64_t limited;  /* over the rate of the call site */
+    uint64_t repeated; /* the same as the last line from the call site */
+    uint64_t unsent;   /* the sink couldn't take it */
+};
+
+/* One line, as given to a sink. */
+struct log_record {
+    enum log_level level;
+    uint64_t when_ns;  /* real time */
+    const char *file;  /* the call site, or NULL if not known */
+    int line;
+    XAcode code;       /* XA_OK unless logged with one of the _code macros */
+    const char *text;  /* not terminated by a newline */
+    size_t len;
+};
+
+/**
+ *  Sends a line somewhere.  It must not block and must not log.
+ *
+ *  @return true if the line was taken, false if it was lost
+ */
+typedef bool (*log_sink_fn)(const struct log_record *r, void *user);
+
+/* The state of one call site; only for the macros below. */
+struct log_site {
+    const char *file;
+    int line;
+    enum log_level level;
+    uint64_t tat;      /* when the bucket is next empty, in ns */
+    uint64_t hash;     /* of the last line, 0 for none */
+    uint32_t limited;  /* suppressed since the last notice */
+    uint32_t repeated; /* suppressed since the last notice */
+    uint32_t listed;
+    struct log_site *next;
+};
+
+#define LOG_SITE_INIT(level) { __FILE__, __LINE__, (level), 0, 0, 0, 0, 0, NULL }
 
 void log_trace(const char *format, ...);
 void log_debug(const char *format, ...);
@@ -22,4 +136,125 @@ void log_va_warn(const char *format, va_list args);
 void log_va_error(const char *format, va_list args);
 void log_va_fatal(const char *format, va_list args);
 
+void log_at(struct log_site *site, const char *format, ...);
+void log_at_code(struct log_site *site, XAcode code, const char *format, ...);
+
+/* Only for the macros below; use log_set_level() to change it. */
+extern int log_runtime_level;
+
+#define LOG_AT(level, ...)                                                          \
+    do {                                                                            \
+        if ((LOG_LEVEL_MIN <= (level))                                              \
+            && (__atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED) <= (level))) \
+        {                                                                           \
+            static struct log_site _log_site = LOG_SITE_INIT(level);                \
+            log_at(&_log_site, __VA_ARGS__);                                        \
+        }                                                                           \
+    } while (0)
+
+#define log_trace(...) LOG_AT(LOG_LEVEL__TRACE, __VA_ARGS__)
+#define log_debug(...) LOG_AT(LOG_LEVEL__DEBUG, __VA_ARGS__)
+#define log_info(...)  LOG_AT(LOG_LEVEL__INFO, __VA_ARGS__)
+#define log_warn(...)  LOG_AT(LOG_LEVEL__WARN, __VA_ARGS__)
+#define log_error(...) LOG_AT(LOG_LEVEL__ERROR, __VA_ARGS__)
+#define log_fatal(...) LOG_AT(LOG_LEVEL__FATAL, __VA_ARGS__)
+
+/* The same, with the XAcode the line is about attached for the sink. */
+#define LOG_AT_CODE(level, code, ...)                                               \
+    do {                                                                            \
+        if ((LOG_LEVEL_MIN <= (level))                                              \
+            && (__atomic_load_n(&log_runtime_level, __ATOMIC_RELAXED) <= (level))) \
+        {                                                                           \
+            static struct log_site _log_site = LOG_SITE_INIT(level);                \
+            log_at_code(&_log_site, (code), __VA_ARGS__);                           \
+        }                                                                           \
+    } while (0)
+
+#define log_warn_code(code, ...)  LOG_AT_CODE(LOG_LEVEL__WARN, code, __VA_ARGS__)
+#define log_error_code(code, ...) LOG_AT_CODE(LOG_LEVEL__ERROR, code, __VA_ARGS__)
+#define log_fatal_code(code, ...) LOG_AT_CODE(LOG_LEVEL__FATAL, code, __VA_ARGS__)
+
+
+/**
+ *  Sets the lowest level that is logged.  Levels below LOG_LEVEL_MIN stay
+ *  compiled out.
+ */
+void log_set_level(enum log_level level);
+
+
+/**
+ *  Gets the lowest level that is logged.
+ */
+enum log_level log_get_level(void);
+
+
+/**
+ *  Sets how many digits of the second (0 to 9) are added to the timestamps.
+ *  The default is 0.  In async mode it applies when the writer renders the
+ *  line, and binary records always keep the full time.
+ */
+void log_set_subsecond(int digits);
+
+
+/**
+ *  Sends every line to a sink instead of writing text to stdout.  In async
+ *  mode the writer thread calls it and binary records are turned off; in
+ *  sync mode the logging thread does.  Set it before logging starts from
+ *  other threads.
+ *
+ *  @param fn   the sink, or NULL for stdout again
+ *
+ *  @return XA_OK, or XA_INVALID_INPUT if async logging is running
+ */
+XAcode log_set_sink(log_sink_fn fn, void *user, XAcode *err);
+
+
+/**
+ *  Switches logging to the async ring and starts the writer thread.  The
+ *  writer never takes signals, so this may be called before or after they
+ *  are set up.
+ *
+ *  @param opts the options, or NULL for the defaults
+ *
+ *  @return XA_OK, XA_INVALID_INPUT if already started, XA_OUT_OF_MEMORY or
+ *          XA_INSUFFICIENT_RESOURCES if the thread can't be started
+ */
+XAcode log_async_start(const struct log_async_opts *opts, XAcode *err);
+
+
+/**
+ *  Writes out everything still in the ring, stops the writer and goes back
+ *  to synchronous logging.  No other thread may be logging while this runs.
+ */
+void log_async_stop(void);
+
+
+/**
+ *  Gets the number of lines dropped because the ring was full, over every
+ *  async run.
+ */
+uint64_t log_dropped(void);
+
+
+/**
+ *  Sets the per call site limits.  Fatal lines are never limited.
+ *
+ *  @param limits the limits, or NULL to turn them off (the default)
+ */
+void log_set_limits(const struct log_limits *limits);
+
+
+/**
+ *  Writes the notices for lines that were suppressed by the limits and not
+ *  yet reported, so a line that keeps repeating still shows up.  Call it
+ *  every few seconds.
+ */
+void log_flush_suppressed(void);
+
+
+/**
+ *  Gets the counts of the lines that weren't written.
+ */
+void log_get_stats(struct log_stats *stats);
+
 #endif
@@ -0,0 +1,243 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX_BYTES (64 * 1024)
+#define DEFAULT_MAX_MSGS  256
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct batch {
+    struct batch_opts opts;
+    struct event_timer *timer;
+
+    uint8_t *arena;
+    size_t used;
+
+    struct iovec *msgs;
+    size_t count;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void on_window(struct event_timer *t, void *user)
+{
+    (void) t;
+
+    batch_flush((struct batch *) user);
+}
+
+
+/* Drops the messages that were sent and slides the rest to the front. */
+static void consume(struct batch *b, size_t sent)
+{
+    size_t bytes;
+
+    if (0 == sent) {
+        return;
+    }
+
+    if (sent == b->count) {
+        b->count = 0;
+        b->used  = 0;
+        return;
+    }
+
+    bytes = (size_t) ((uint8_t *) b->msgs[sent].iov_base - b->arena);
+    memmove(b->arena, &b->arena[bytes], b->used - bytes);
+    b->used -= bytes;
+
+    b->count -= sent;
+    memmove(b->msgs, &b->msgs[sent], b->count * sizeof(struct iovec));
+    for (size_t i = 0; i < b->count; i++) {
+        b->msgs[i].iov_base = (uint8_t *) b->msgs[i].iov_base - bytes;
+    }
+}
+
+
+static size_t room(const struct batch *b)
+{
+    return b->opts.max_bytes - b->used;
+}
+
+
+/* Returns where to put len bytes, flushing first if needed. */
+static uint8_t *reserve(struct batch *b, size_t len)
+{
+    if ((room(b) < len) || (b->opts.max_msgs == b->count)) {
+        batch_flush(b);
+        if ((room(b) < len) || (b->opts.max_msgs == b->count)) {
+            return NULL;
+        }
+    }
+
+    return &b->arena[b->used];
+}
+
+
+static void commit(struct batch *b, size_t len)
+{
+    b->msgs[b->count].iov_base = &b->arena[b->used];
+    b->msgs[b->count].iov_len  = len;
+    b->used += len;
+    b->count++;
+
+    if ((0 == room(b)) || (b->opts.max_msgs == b->count)) {
+        batch_flush(b);
+    } else if ((1 == b->count) && !event_timer_is_active(b->timer)) {
+        event_timer_start(b->timer, b->opts.window_ms, 0);
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct batch *batch_create(const struct batch_opts *opts, XAcode *err)
+{
+    struct batch *b = NULL;
+
+    if (!opts || !opts->loop || !opts->send) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    b = calloc(1, sizeof(struct batch));
+    if (!b) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    b->opts = *opts;
+    if (0 == b->opts.max_bytes) {
+        b->opts.max_bytes = DEFAULT_MAX_BYTES;
+    }
+    if (0 == b->opts.max_msgs) {
+        b->opts.max_msgs = DEFAULT_MAX_MSGS;
+    }
+
+    b->arena = malloc(b->opts.max_bytes);
+    b->msgs  = calloc(b->opts.max_msgs, sizeof(struct iovec));
+    if (!b->arena || !b->msgs) {
+        batch_destroy(b);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    b->timer = event_timer_create(opts->loop, on_window, b, err);
+    if (!b->timer) {
+        batch_destroy(b);
+        return NULL;
+    }
+
+    return b;
+}
+
+
+void batch_destroy(struct batch *b)
+{
+    if (b) {
+        event_timer_destroy(b->timer);
+        free(b->msgs);
+        free(b->arena);
+        free(b);
+    }
+}
+
+
+XAcode batch_add(struct batch *b, const struct wrp_encoder *e,
+                 const struct wrp_out *msg, XAcode *err)
+{
+    uint8_t *p;
+    size_t len;
+
+    if (!b) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    len = wrp_encode(e, msg, NULL, 0);
+    if ((0 == len) || (b->opts.max_bytes < len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    p = reserve(b, len);
+    if (!p) {
+        return xa_set_error(err, XA_INSUFFICIENT_RESOURCES);
+    }
+
+    wrp_encode(e, msg, p, len);
+    commit(b, len);
+
+    return XA_OK;
+}
+
+
+XAcode batch_add_encoded(struct batch *b, const void *buf, size_t len,
+                         XAcode *err)
+{
+    uint8_t *p;
+
+    if (!b || !buf || (0 == len) || (b->opts.max_bytes < len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    p = reserve(b, len);
+    if (!p) {
+        return xa_set_error(err, XA_INSUFFICIENT_RESOURCES);
+    }
+
+    memcpy(p, buf, len);
+    commit(b, len);
+
+    return XA_OK;
+}
+
+
+size_t batch_flush(struct batch *b)
+{
+    size_t sent = 0;
+
+    if (!b) {
+        return 0;
+    }
+
+    event_timer_stop(b->timer);
+
+    if (b->count) {
+        sent = b->opts.send(b->opts.user, b->msgs, b->count);
+        consume(b, sent);
+    }
+
+    /* After a partial send the rest is tried again after another window.  A
+     * transport that took nothing is down; it flushes when it is back. */
+    if (sent && b->count) {
+        event_timer_start(b->timer, b->opts.window_ms, 0);
+    }
+
+    return b->count;
+}
+
+
+size_t batch_pending(const struct batch *b)
+{
+    return (b) ? b->count : 0;
+}
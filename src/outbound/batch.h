@@ -0,0 +1,102 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __OUTBOUND_BATCH_H__
+#define __OUTBOUND_BATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+#include "../wrp/wrp_encode.h"
+
+/* Coalesces outbound messages so a burst of small events becomes a single
+ * hand off to the transport instead of one per message.
+ *
+ * Messages are encoded straight into one contiguous arena.  The batch is
+ * flushed when the window that started with its first message closes, or as
+ * soon as the arena (the byte budget) or the message limit is reached,
+ * whichever comes first.
+ *
+ * Messages are always handed off in the order they were added, and a message
+ * is only handed off after every message added before it, so ordering per
+ * destination is preserved even when the transport only accepts part of a
+ * batch. */
+
+struct batch;
+
+/**
+ *  Hands a batch of encoded messages to the transport.  Each iovec is one
+ *  complete message.
+ *
+ *  @return how many messages (from the front) were accepted; the rest are
+ *          kept and offered again on the next flush, at the latest once
+ *          another window has passed if at least one was accepted; a
+ *          transport that accepts none must call batch_flush() once it can
+ */
+typedef size_t (*batch_send_fn)(void *user, const struct iovec *msgs,
+                                size_t count);
+
+struct batch_opts {
+    struct event_loop *loop;
+
+    uint64_t window_ms; /* 0 flushes on the next loop iteration */
+    size_t max_bytes;   /* the arena size, 0 uses the default */
+    size_t max_msgs;    /* 0 uses the default */
+
+    batch_send_fn send;
+    void *user;
+};
+
+
+/**
+ *  Creates the batching stage.
+ *
+ *  @return the batch or NULL on failure
+ */
+struct batch *batch_create(const struct batch_opts *opts, XAcode *err);
+
+
+/**
+ *  Releases the batch.  Pending messages are discarded.
+ */
+void batch_destroy(struct batch *b);
+
+
+/**
+ *  Encodes the message into the batch.
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT if the message can't be
+ *          encoded, XA_INSUFFICIENT_RESOURCES if the batch is full because the
+ *          transport is not taking messages
+ */
+XAcode batch_add(struct batch *b, const struct wrp_encoder *e,
+                 const struct wrp_out *msg, XAcode *err);
+
+
+/**
+ *  Copies an already encoded message into the batch.
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT or XA_INSUFFICIENT_RESOURCES
+ *          otherwise
+ */
+XAcode batch_add_encoded(struct batch *b, const void *buf, size_t len,
+                         XAcode *err);
+
+
+/**
+ *  Offers everything pending to the transport now.
+ *
+ *  @return the number of messages still pending
+ */
+size_t batch_flush(struct batch *b);
+
+
+/**
+ *  Returns the number of messages pending.
+ */
+size_t batch_pending(const struct batch *b);
+
+#endif
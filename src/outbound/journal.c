@@ -0,0 +1,497 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "journal.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX_BYTES (4 * 1024 * 1024)
+#define MIN_MAX_BYTES     4096
+
+#define JOURNAL_MAGIC   0x314a4158 /* "XAJ1" */
+#define JOURNAL_VERSION 1
+
+/* The data starts on its own page, after the two header slots. */
+#define DATA_OFFSET 4096
+
+/* A record length that means the rest of the ring is unused; go to 0. */
+#define WRAP_MARKER UINT32_MAX
+
+#define ALIGN8(x) (((x) + 7) & ~((size_t) 7))
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct slot {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t generation;
+    uint64_t head;
+    uint64_t head_seq;
+    uint32_t epoch; /* changes each time the journal is reset */
+    uint32_t crc;   /* of everything above */
+};
+
+struct record {
+    uint32_t len;
+    uint32_t crc; /* of the epoch, seq, time_s and the payload */
+    uint64_t seq;
+    uint64_t time_s;
+};
+
+struct journal {
+    int fd;
+    uint8_t *map;
+    size_t map_len;
+
+    struct slot *slots;
+    uint8_t *data;
+    size_t capacity;
+    uint64_t retention_s;
+
+    uint64_t generation;
+    uint32_t epoch;
+    size_t head;
+    size_t tail;
+    uint64_t head_seq;
+    size_t count;
+
+    bool dirty;
+    struct journal_stats stats;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static uint32_t crc32(uint32_t crc, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+
+    if (!crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+            }
+            crc_table[i] = c;
+        }
+        crc_table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+
+static uint32_t slot_crc(const struct slot *s)
+{
+    return crc32(0, s, offsetof(struct slot, crc));
+}
+
+
+/* The epoch keeps records left over from before a reset from being
+ * mistaken for current ones. */
+static uint32_t record_crc(uint32_t epoch, const struct record *r,
+                           const void *payload)
+{
+    uint32_t crc = crc32(0, &epoch, sizeof(epoch));
+
+    crc = crc32(crc, &r->seq, sizeof(r->seq) + sizeof(r->time_s));
+
+    return crc32(crc, payload, r->len);
+}
+
+
+static size_t record_size(size_t len)
+{
+    return ALIGN8(sizeof(struct record) + len);
+}
+
+
+/* Commits the head into the older of the two header slots. */
+static void write_head(struct journal *j)
+{
+    struct slot s;
+
+    j->generation++;
+
+    memset(&s, 0, sizeof(s));
+    s.magic      = JOURNAL_MAGIC;
+    s.version    = JOURNAL_VERSION;
+    s.capacity   = j->capacity;
+    s.generation = j->generation;
+    s.head       = j->head;
+    s.head_seq   = j->head_seq;
+    s.epoch      = j->epoch;
+    s.crc        = slot_crc(&s);
+
+    memcpy(&j->slots[j->generation & 1], &s, sizeof(s));
+    j->dirty = true;
+}
+
+
+static const struct slot *read_head(const struct journal *j)
+{
+    const struct slot *best = NULL;
+
+    for (int i = 0; i < 2; i++) {
+        const struct slot *s = &j->slots[i];
+
+        if ((JOURNAL_MAGIC != s->magic) || (JOURNAL_VERSION != s->version)
+            || (j->capacity != s->capacity) || (slot_crc(s) != s->crc)
+            || (j->capacity <= s->head) || (0 != (s->head & 7)))
+        {
+            continue;
+        }
+        if (!best || (best->generation < s->generation)) {
+            best = s;
+        }
+    }
+
+    return best;
+}
+
+
+static struct record *record_at(const struct journal *j, size_t pos)
+{
+    return (struct record *) &j->data[pos];
+}
+
+
+/* Moves pos past a wrap marker or the end of the ring. */
+static size_t normalize(const struct journal *j, size_t pos)
+{
+    if ((pos == j->capacity) || (WRAP_MARKER == record_at(j, pos)->len)) {
+        return 0;
+    }
+
+    return pos;
+}
+
+
+static void drop_head(struct journal *j)
+{
+    struct record *r = record_at(j, j->head);
+
+    j->head = normalize(j, j->head + record_size(r->len));
+    j->head_seq++;
+    j->count--;
+
+    if (0 == j->count) {
+        j->head = 0;
+        j->tail = 0;
+    }
+}
+
+
+/* Walks forward from the head to find the tail. */
+static void recover(struct journal *j)
+{
+    const struct slot *s = read_head(j);
+    size_t pos, scanned = 0;
+    uint64_t seq;
+
+    j->head     = 0;
+    j->tail     = 0;
+    j->head_seq = 0;
+    j->count    = 0;
+
+    if (!s) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        j->epoch      = (uint32_t) ts.tv_nsec ^ (uint32_t) ts.tv_sec ^ (uint32_t) getpid();
+        j->generation = 0;
+        write_head(j);
+        return;
+    }
+
+    j->generation = s->generation;
+    j->epoch      = s->epoch;
+    j->head_seq   = s->head_seq;
+
+    pos = s->head;
+    seq = s->head_seq;
+    while (scanned < j->capacity) {
+        size_t skip;
+        struct record *r;
+
+        if ((pos + sizeof(uint32_t)) <= j->capacity) {
+            pos = normalize(j, pos);
+        } else {
+            pos = 0;
+        }
+        if (0 == j->count) {
+            j->head = pos;
+        }
+
+        if ((j->capacity - pos) < sizeof(struct record)) {
+            break;
+        }
+        r = record_at(j, pos);
+        if ((r->seq != seq) || ((j->capacity - pos) < record_size(r->len))
+            || (r->crc != record_crc(j->epoch, r, &r[1])))
+        {
+            break;
+        }
+
+        skip = record_size(r->len);
+        pos += skip;
+        scanned += skip;
+        seq++;
+        j->count++;
+        j->tail = pos;
+    }
+
+    if (0 == j->count) {
+        j->head = 0;
+        j->tail = 0;
+    }
+    j->stats.count = j->count;
+}
+
+
+/* Finds room for a record of size need at the tail, dropping the oldest
+ * records as needed.  Returns where to write it. */
+static size_t make_room(struct journal *j, size_t need)
+{
+    size_t start = j->head;
+    bool dropped = false;
+    size_t pos;
+
+    while (true) {
+        if (0 == j->count) {
+            pos = 0;
+            break;
+        }
+
+        if (j->head < j->tail) {
+            if (need <= (j->capacity - j->tail)) {
+                pos = j->tail;
+                break;
+            }
+            if (need <= j->head) {
+                /* Mark the unused end of the ring and wrap. */
+                if (j->tail < j->capacity) {
+                    record_at(j, j->tail)->len = WRAP_MARKER;
+                }
+                pos = 0;
+                break;
+            }
+        } else if (need <= (j->head - j->tail)) {
+            pos = j->tail;
+            break;
+        }
+
+        drop_head(j);
+        j->stats.overwritten++;
+        dropped = true;
+    }
+
+    /* Commit the new head before its old records get overwritten. */
+    if (dropped || (start != j->head)) {
+        write_head(j);
+    }
+
+    return pos;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct journal *journal_open(const struct journal_opts *opts, XAcode *err)
+{
+    struct journal *j = NULL;
+    struct stat st;
+    size_t capacity;
+
+    if (!opts || !opts->path) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    capacity = (opts->max_bytes) ? ALIGN8(opts->max_bytes) : DEFAULT_MAX_BYTES;
+    if (capacity < MIN_MAX_BYTES) {
+        capacity = MIN_MAX_BYTES;
+    }
+
+    j = calloc(1, sizeof(struct journal));
+    if (!j) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    j->capacity    = capacity;
+    j->retention_s = opts->retention_s;
+    j->map_len     = DATA_OFFSET + capacity;
+
+    j->fd = open(opts->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (j->fd < 0) {
+        goto FILE_ERROR;
+    }
+
+    if ((0 != fstat(j->fd, &st))
+        || (((size_t) st.st_size != j->map_len) && (0 != ftruncate(j->fd, (off_t) j->map_len))))
+    {
+        goto FILE_ERROR;
+    }
+
+    j->map = mmap(NULL, j->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, j->fd, 0);
+    if (MAP_FAILED == j->map) {
+        j->map = NULL;
+        goto FILE_ERROR;
+    }
+
+    j->slots = (struct slot *) j->map;
+    j->data  = &j->map[DATA_OFFSET];
+
+    recover(j);
+
+    return j;
+
+FILE_ERROR:
+    journal_close(j);
+    xa_set_error(err, XA_FAILED_TO_OPEN_FILE);
+    return NULL;
+}
+
+
+void journal_close(struct journal *j)
+{
+    if (j) {
+        if (j->map) {
+            msync(j->map, j->map_len, MS_SYNC);
+            munmap(j->map, j->map_len);
+        }
+        if (0 <= j->fd) {
+            close(j->fd);
+        }
+        free(j);
+    }
+}
+
+
+XAcode journal_append(struct journal *j, const void *buf, size_t len,
+                      uint64_t now_s, XAcode *err)
+{
+    struct record *r;
+    size_t need;
+    size_t pos;
+
+    if (!j || !buf || !len) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    /* Anything bigger than half the ring would evict nearly everything. */
+    need = record_size(len);
+    if ((UINT32_MAX <= len) || ((j->capacity / 2) < need)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    pos = make_room(j, need);
+
+    r         = record_at(j, pos);
+    r->seq    = j->head_seq + j->count;
+    r->time_s = now_s;
+    r->len    = (uint32_t) len;
+    memcpy(&r[1], buf, len);
+    r->crc = record_crc(j->epoch, r, &r[1]);
+
+    if (0 == j->count) {
+        j->head = pos;
+        write_head(j);
+    }
+    j->tail = pos + need;
+    j->count++;
+
+    j->dirty = true;
+    j->stats.appended++;
+    j->stats.count = j->count;
+
+    return XA_OK;
+}
+
+
+size_t journal_replay(struct journal *j, uint64_t now_s, journal_replay_fn fn,
+                      void *user)
+{
+    size_t taken = 0;
+    bool moved   = false;
+
+    if (!j || !fn) {
+        return 0;
+    }
+
+    while (j->count) {
+        struct record *r = record_at(j, j->head);
+
+        if (j->retention_s && ((r->time_s + j->retention_s) < now_s)) {
+            j->stats.expired++;
+        } else if (fn(user, &r[1], r->len)) {
+            j->stats.replayed++;
+            taken++;
+        } else {
+            break;
+        }
+
+        drop_head(j);
+        moved = true;
+    }
+
+    if (moved) {
+        write_head(j);
+    }
+    j->stats.count = j->count;
+
+    return taken;
+}
+
+
+size_t journal_count(const struct journal *j)
+{
+    return (j) ? j->count : 0;
+}
+
+
+void journal_sync(struct journal *j)
+{
+    if (j && j->dirty) {
+        msync(j->map, j->map_len, MS_ASYNC);
+        j->dirty = false;
+    }
+}
+
+
+void journal_stats(const struct journal *j, struct journal_stats *stats)
+{
+    if (j && stats) {
+        *stats = j->stats;
+    }
+}
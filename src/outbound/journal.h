@@ -0,0 +1,108 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __OUTBOUND_JOURNAL_H__
+#define __OUTBOUND_JOURNAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* A persistent ring of encoded outbound messages, used to hold important
+ * messages while the websocket is down and across agent restarts.
+ *
+ * The ring lives in a memory mapped file, so appending is a memcpy and a
+ * checksum.  Every record carries a sequence number and a CRC32; on open the
+ * ring is recovered by walking forward from the last committed head until a
+ * record is torn, corrupt or out of sequence.  The head is kept in two
+ * alternating header slots so a crash while it is updated loses nothing.
+ *
+ * The ring is size capped: when full, the oldest records are overwritten.
+ * Records older than the retention are discarded instead of replayed.
+ *
+ * Data reaches the page cache immediately and so survives the agent
+ * crashing; journal_sync() bounds what a power loss can take. */
+
+struct journal;
+
+struct journal_opts {
+    const char *path;
+    size_t max_bytes;     /* the ring size, 0 uses the default */
+    uint64_t retention_s; /* 0 keeps records until they are replayed */
+};
+
+struct journal_stats {
+    uint64_t appended;
+    uint64_t replayed;
+    uint64_t overwritten; /* dropped because the ring was full */
+    uint64_t expired;     /* dropped because of the retention */
+    size_t count;         /* records waiting now */
+};
+
+/**
+ *  Called for each record being replayed, oldest first.
+ *
+ *  @return true if the record was taken, false to stop the replay and keep
+ *          it for later
+ */
+typedef bool (*journal_replay_fn)(void *user, const void *buf, size_t len);
+
+
+/**
+ *  Opens (creating if needed) and recovers the journal.  A file that doesn't
+ *  hold a valid journal of the same size is reset.
+ *
+ *  @return the journal or NULL on failure (XA_INVALID_INPUT,
+ *          XA_OUT_OF_MEMORY, XA_FAILED_TO_OPEN_FILE)
+ */
+struct journal *journal_open(const struct journal_opts *opts, XAcode *err);
+
+
+/**
+ *  Syncs and closes the journal.
+ */
+void journal_close(struct journal *j);
+
+
+/**
+ *  Appends a record.
+ *
+ *  @param now_s the wall clock time in seconds, used for the retention
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT if the record is too big
+ */
+XAcode journal_append(struct journal *j, const void *buf, size_t len,
+                      uint64_t now_s, XAcode *err);
+
+
+/**
+ *  Replays the records in order, removing each one that is taken.
+ *
+ *  @param now_s the wall clock time in seconds, used for the retention
+ *
+ *  @return the number of records taken
+ */
+size_t journal_replay(struct journal *j, uint64_t now_s, journal_replay_fn fn,
+                      void *user);
+
+
+/**
+ *  Returns the number of records waiting.
+ */
+size_t journal_count(const struct journal *j);
+
+
+/**
+ *  Starts writing the dirty pages to disk without waiting.
+ */
+void journal_sync(struct journal *j);
+
+
+/**
+ *  Gets the counters.
+ */
+void journal_stats(const struct journal *j, struct journal_stats *stats);
+
+#endif
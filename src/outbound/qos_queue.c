@@ -0,0 +1,387 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qos_queue.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX_BYTES (1024 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct node {
+    struct node *next;
+    size_t len;
+    uint8_t data[];
+};
+
+struct level {
+    struct node *head;
+    struct node *tail;
+    size_t max_bytes;
+    unsigned weight;
+    struct qos_stats stats;
+};
+
+struct qos_queue {
+    struct qos_queue_opts opts;
+    struct event_timer *kick;
+
+    size_t bytes;
+    struct level levels[QOS__COUNT];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* Fractions of the total cap, in percent. */
+static const unsigned default_share[QOS__COUNT] = { 25, 50, 100, 100 };
+
+static const unsigned default_weight[QOS__COUNT] = { 1, 2, 4, 8 };
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static struct node *pop(struct qos_queue *q, struct level *lv)
+{
+    struct node *n = lv->head;
+
+    lv->head = n->next;
+    if (!lv->head) {
+        lv->tail = NULL;
+    }
+
+    lv->stats.depth--;
+    lv->stats.bytes -= n->len;
+    q->bytes -= n->len;
+
+    return n;
+}
+
+
+static void append(struct qos_queue *q, struct level *lv, struct node *n)
+{
+    n->next = NULL;
+    if (lv->tail) {
+        lv->tail->next = n;
+    } else {
+        lv->head = n;
+    }
+    lv->tail = n;
+
+    lv->stats.queued++;
+    lv->stats.depth++;
+    lv->stats.bytes += n->len;
+    q->bytes += n->len;
+}
+
+
+/* Evicts from the least important levels below level until len fits. */
+static bool make_room(struct qos_queue *q, enum qos_level level, size_t len)
+{
+    size_t below = 0;
+
+    if ((q->bytes + len) <= q->opts.max_bytes) {
+        return true;
+    }
+
+    for (int i = QOS__LOW; i < (int) level; i++) {
+        below += q->levels[i].stats.bytes;
+    }
+
+    /* Don't evict anything unless it will be enough. */
+    if (q->opts.max_bytes < ((q->bytes - below) + len)) {
+        return false;
+    }
+
+    for (int i = QOS__LOW; (q->opts.max_bytes < (q->bytes + len)); i++) {
+        struct level *lv = &q->levels[i];
+
+        while (lv->head && (q->opts.max_bytes < (q->bytes + len))) {
+            pool_free(q->opts.pool, pop(q, lv));
+            lv->stats.evicted++;
+        }
+    }
+
+    return true;
+}
+
+
+static void on_kick(struct event_timer *t, void *user)
+{
+    (void) t;
+
+    qos_queue_drain((struct qos_queue *) user);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+enum qos_level qos_level_from_value(int qos)
+{
+    if (qos < 25) {
+        return QOS__LOW;
+    }
+    if (qos < 50) {
+        return QOS__MEDIUM;
+    }
+    if (qos < 75) {
+        return QOS__HIGH;
+    }
+
+    return QOS__CRITICAL;
+}
+
+
+const char *qos_level_to_string(enum qos_level level)
+{
+    switch (level) {
+        case QOS__LOW:      return "low";
+        case QOS__MEDIUM:   return "medium";
+        case QOS__HIGH:     return "high";
+        case QOS__CRITICAL: return "critical";
+        default:
+            break;
+    }
+
+    return "invalid";
+}
+
+
+struct qos_queue *qos_queue_create(const struct qos_queue_opts *opts, XAcode *err)
+{
+    struct qos_queue *q = NULL;
+
+    if (!opts || !opts->loop || !opts->sink) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    q = calloc(1, sizeof(struct qos_queue));
+    if (!q) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    q->opts = *opts;
+    if (0 == q->opts.max_bytes) {
+        q->opts.max_bytes = DEFAULT_MAX_BYTES;
+    }
+
+    for (int i = 0; i < QOS__COUNT; i++) {
+        struct level *lv = &q->levels[i];
+
+        lv->max_bytes = opts->level_max_bytes[i];
+        if (0 == lv->max_bytes) {
+            lv->max_bytes = (q->opts.max_bytes / 100) * default_share[i];
+        }
+        lv->weight = opts->weight[i];
+        if (0 == lv->weight) {
+            lv->weight = default_weight[i];
+        }
+    }
+
+    q->kick = event_timer_create(opts->loop, on_kick, q, err);
+    if (!q->kick) {
+        free(q);
+        return NULL;
+    }
+
+    return q;
+}
+
+
+void qos_queue_destroy(struct qos_queue *q)
+{
+    if (q) {
+        for (int i = 0; i < QOS__COUNT; i++) {
+            while (q->levels[i].head) {
+                pool_free(q->opts.pool, pop(q, &q->levels[i]));
+            }
+        }
+        event_timer_destroy(q->kick);
+        free(q);
+    }
+}
+
+
+/* Makes room for and allocates a node of len bytes at the message's level. */
+static XAcode reserve(struct qos_queue *q, enum qos_level level, size_t len,
+                      struct node **n)
+{
+    struct level *lv = &q->levels[level];
+
+    if ((lv->max_bytes < (lv->stats.bytes + len)) || !make_room(q, level, len)) {
+        lv->stats.dropped++;
+        return XA_INSUFFICIENT_RESOURCES;
+    }
+
+    *n = pool_alloc(q->opts.pool, sizeof(struct node) + len);
+    if (!*n) {
+        lv->stats.dropped++;
+        return XA_OUT_OF_MEMORY;
+    }
+    (*n)->len = len;
+
+    return XA_OK;
+}
+
+
+XAcode qos_queue_push(struct qos_queue *q, const struct wrp_encoder *e,
+                      const struct wrp_out *msg, int qos, XAcode *err)
+{
+    enum qos_level level;
+    struct node *n = NULL;
+    XAcode rv;
+    size_t len;
+
+    if (!q) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    len = wrp_encode(e, msg, NULL, 0);
+    if (0 == len) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    level = qos_level_from_value(qos);
+    rv    = reserve(q, level, len, &n);
+    if (XA_OK != rv) {
+        return xa_set_error(err, rv);
+    }
+    wrp_encode(e, msg, n->data, len);
+
+    append(q, &q->levels[level], n);
+    qos_queue_kick(q);
+
+    return XA_OK;
+}
+
+
+XAcode qos_queue_push_encoded(struct qos_queue *q, const void *buf, size_t len,
+                              int qos, XAcode *err)
+{
+    enum qos_level level;
+    struct node *n = NULL;
+    XAcode rv;
+
+    if (!q || !buf || !len) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    level = qos_level_from_value(qos);
+    rv    = reserve(q, level, len, &n);
+    if (XA_OK != rv) {
+        return xa_set_error(err, rv);
+    }
+    memcpy(n->data, buf, len);
+
+    append(q, &q->levels[level], n);
+    qos_queue_kick(q);
+
+    return XA_OK;
+}
+
+
+void qos_queue_kick(struct qos_queue *q)
+{
+    if (q && !event_timer_is_active(q->kick)) {
+        event_timer_start(q->kick, 0, 0);
+    }
+}
+
+
+size_t qos_queue_drain(struct qos_queue *q)
+{
+    size_t sent = 0;
+    bool more   = true;
+
+    if (!q) {
+        return 0;
+    }
+
+    while (more) {
+        more = false;
+
+        for (int i = QOS__CRITICAL; QOS__LOW <= i; i--) {
+            struct level *lv = &q->levels[i];
+
+            for (unsigned j = 0; lv->head && (j < lv->weight); j++) {
+                if (!q->opts.sink(q->opts.user, (enum qos_level) i, lv->head->data,
+                                  lv->head->len)) {
+                    goto DONE;
+                }
+                pool_free(q->opts.pool, pop(q, lv));
+                lv->stats.sent++;
+                sent++;
+            }
+
+            more = more || (NULL != lv->head);
+        }
+    }
+
+DONE:
+    if (sent && q->opts.on_room) {
+        q->opts.on_room(q->opts.user);
+    }
+
+    return sent;
+}
+
+
+size_t qos_queue_room(const struct qos_queue *q)
+{
+    if (!q || (q->opts.max_bytes <= q->bytes)) {
+        return 0;
+    }
+
+    return q->opts.max_bytes - q->bytes;
+}
+
+
+size_t qos_queue_level_room(const struct qos_queue *q, enum qos_level level)
+{
+    const struct level *lv;
+    size_t kept = 0;
+    size_t room;
+
+    if (!q || (QOS__COUNT <= level)) {
+        return 0;
+    }
+
+    lv = &q->levels[level];
+    if (lv->max_bytes <= lv->stats.bytes) {
+        return 0;
+    }
+    room = lv->max_bytes - lv->stats.bytes;
+
+    /* Everything at this level and above stays; the rest can be evicted. */
+    for (int i = (int) level; i < QOS__COUNT; i++) {
+        kept += q->levels[i].stats.bytes;
+    }
+    if (q->opts.max_bytes <= kept) {
+        return 0;
+    }
+
+    return (room < q->opts.max_bytes - kept) ? room : q->opts.max_bytes - kept;
+}
+
+
+void qos_queue_stats(const struct qos_queue *q, enum qos_level level,
+                     struct qos_stats *stats)
+{
+    if (q && stats && (level < QOS__COUNT)) {
+        *stats = q->levels[level].stats;
+    }
+}
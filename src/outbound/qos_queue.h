@@ -0,0 +1,158 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __OUTBOUND_QOS_QUEUE_H__
+#define __OUTBOUND_QOS_QUEUE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+#include "../pool/pool.h"
+#include "../wrp/wrp_encode.h"
+
+/* Holds outbound messages in one queue per WRP QoS level until the next
+ * stage (the batch) can take them.
+ *
+ * Draining is weighted round robin from the most important level down, so a
+ * backlog of low priority telemetry can slow critical traffic by at most the
+ * low level's weight per round.  Each level has its own memory cap, and the
+ * queue as a whole has a total cap; when the total cap is reached the oldest
+ * messages of the least important levels are evicted first, but never to
+ * make room for a less important message.
+ *
+ * Messages within a level are always sent in the order they were pushed. */
+
+enum qos_level {
+    QOS__LOW = 0, /* WRP qos  0-24 */
+    QOS__MEDIUM,  /* WRP qos 25-49 */
+    QOS__HIGH,    /* WRP qos 50-74 */
+    QOS__CRITICAL /* WRP qos 75-99 */
+};
+
+#define QOS__COUNT 4
+
+struct qos_stats {
+    uint64_t queued;  /* messages accepted */
+    uint64_t sent;    /* messages handed to the sink */
+    uint64_t evicted; /* messages dropped to make room for more important ones */
+    uint64_t dropped; /* messages refused because the level was full */
+    size_t depth;     /* messages waiting now */
+    size_t bytes;     /* bytes waiting now */
+};
+
+/**
+ *  Offers one encoded message (from the given level) to the next stage.
+ *
+ *  @return true if it was taken, false to stop draining for now
+ */
+typedef bool (*qos_sink_fn)(void *user, enum qos_level level, const void *buf,
+                            size_t len);
+
+struct qos_queue_opts {
+    struct event_loop *loop;
+
+    size_t max_bytes;                   /* total cap, 0 uses the default */
+    size_t level_max_bytes[QOS__COUNT]; /* 0 uses the default */
+    unsigned weight[QOS__COUNT];        /* messages per round, 0 uses the default */
+
+    struct pool *pool; /* optional, where queued messages are kept */
+
+    qos_sink_fn sink;
+    void *user;
+
+    /* Optional, called after a drain that handed messages to the sink, so
+     * producers waiting for room can be let go. */
+    void (*on_room)(void *user);
+};
+
+struct qos_queue;
+
+
+/**
+ *  Maps a WRP qos value (0-99) to its level.  Out of range values are clamped.
+ */
+enum qos_level qos_level_from_value(int qos);
+
+
+/**
+ *  Returns the name of the level for logging.
+ */
+const char *qos_level_to_string(enum qos_level level);
+
+
+/**
+ *  Creates the queues.
+ *
+ *  @return the queues or NULL on failure
+ */
+struct qos_queue *qos_queue_create(const struct qos_queue_opts *opts, XAcode *err);
+
+
+/**
+ *  Releases the queues and everything still queued.
+ */
+void qos_queue_destroy(struct qos_queue *q);
+
+
+/**
+ *  Encodes the message into the queue for its qos value.  Draining happens on
+ *  the next loop iteration, so a burst pushed together is drained in priority
+ *  order.
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT if the message can't be
+ *          encoded, XA_INSUFFICIENT_RESOURCES if it was dropped,
+ *          XA_OUT_OF_MEMORY otherwise
+ */
+XAcode qos_queue_push(struct qos_queue *q, const struct wrp_encoder *e,
+                      const struct wrp_out *msg, int qos, XAcode *err);
+
+
+/**
+ *  Copies an already encoded message into the queue for its qos value, for
+ *  example one that a local service sent.
+ *
+ *  @return the same codes as qos_queue_push()
+ */
+XAcode qos_queue_push_encoded(struct qos_queue *q, const void *buf, size_t len,
+                              int qos, XAcode *err);
+
+
+/**
+ *  Asks for a drain on the next loop iteration, for example because the next
+ *  stage made room.
+ */
+void qos_queue_kick(struct qos_queue *q);
+
+
+/**
+ *  Drains into the sink now, until it refuses or the queues are empty.
+ *
+ *  @return the number of messages handed to the sink
+ */
+size_t qos_queue_drain(struct qos_queue *q);
+
+
+/**
+ *  Returns how many more bytes fit under the total cap.
+ */
+size_t qos_queue_room(const struct qos_queue *q);
+
+
+/**
+ *  Returns how many more bytes a message at the level is sure to fit in: the
+ *  room under the level's cap and under the total cap, counting what less
+ *  important levels would give up to it.
+ */
+size_t qos_queue_level_room(const struct qos_queue *q, enum qos_level level);
+
+
+/**
+ *  Gets the counters for a level.
+ */
+void qos_queue_stats(const struct qos_queue *q, enum qos_level level,
+                     struct qos_stats *stats);
+
+#endif
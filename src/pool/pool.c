@@ -0,0 +1,197 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX_CACHED_BYTES (512 * 1024)
+#define OVERSIZE                 POOL_CLASSES
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* Sits in front of every buffer to say where it goes back to. */
+union hdr {
+    size_t cls;
+    long double align; /* keeps the buffer aligned for any type */
+};
+
+/* A cached buffer links to the next one through its own memory. */
+struct free_buf {
+    struct free_buf *next;
+};
+
+struct size_class {
+    struct free_buf *head;
+    size_t max_cached;
+    struct pool_stats stats;
+};
+
+struct pool {
+    struct size_class classes[POOL_CLASSES + 1];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static size_t class_of(size_t len)
+{
+    size_t cls  = 0;
+    size_t size = POOL_MIN_CLASS;
+
+    while ((size < len) && (cls < OVERSIZE)) {
+        size <<= 1;
+        cls++;
+    }
+
+    return cls;
+}
+
+
+static void in_use(struct size_class *sc)
+{
+    sc->stats.allocs++;
+    sc->stats.in_use++;
+    if (sc->stats.high_water < sc->stats.in_use) {
+        sc->stats.high_water = sc->stats.in_use;
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct pool *pool_create(const struct pool_opts *opts, XAcode *err)
+{
+    size_t max_cached = DEFAULT_MAX_CACHED_BYTES;
+    struct pool *p    = calloc(1, sizeof(struct pool));
+
+    if (!p) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    if (opts && opts->max_cached_bytes) {
+        max_cached = opts->max_cached_bytes;
+    }
+
+    for (size_t i = 0; i < POOL_CLASSES; i++) {
+        struct size_class *sc = &p->classes[i];
+
+        sc->stats.size = (size_t) POOL_MIN_CLASS << i;
+        sc->max_cached = max_cached / sc->stats.size;
+    }
+
+    return p;
+}
+
+
+void pool_destroy(struct pool *p)
+{
+    if (p) {
+        for (size_t i = 0; i < POOL_CLASSES; i++) {
+            while (p->classes[i].head) {
+                struct free_buf *f = p->classes[i].head;
+
+                p->classes[i].head = f->next;
+                free(((union hdr *) f) - 1);
+            }
+        }
+        free(p);
+    }
+}
+
+
+void *pool_alloc(struct pool *p, size_t len)
+{
+    struct size_class *sc;
+    union hdr *h;
+    size_t cls;
+
+    if (!p) {
+        return malloc(len);
+    }
+
+    cls = class_of(len);
+    sc  = &p->classes[cls];
+
+    if (sc->head) {
+        struct free_buf *f = sc->head;
+
+        sc->head = f->next;
+        sc->stats.cached--;
+        in_use(sc);
+
+        return f;
+    }
+
+    if (((size_t) -1 - sizeof(union hdr)) < len) {
+        return NULL;
+    }
+
+    h = malloc(sizeof(union hdr) + ((OVERSIZE == cls) ? len : sc->stats.size));
+    if (!h) {
+        return NULL;
+    }
+    h->cls = cls;
+
+    sc->stats.misses++;
+    in_use(sc);
+
+    return h + 1;
+}
+
+
+void pool_free(struct pool *p, void *buf)
+{
+    struct size_class *sc;
+    union hdr *h;
+
+    if (!p) {
+        free(buf);
+        return;
+    }
+
+    if (!buf) {
+        return;
+    }
+
+    h  = ((union hdr *) buf) - 1;
+    sc = &p->classes[h->cls];
+    sc->stats.in_use--;
+
+    if (sc->stats.cached < sc->max_cached) {
+        struct free_buf *f = (struct free_buf *) buf;
+
+        f->next  = sc->head;
+        sc->head = f;
+        sc->stats.cached++;
+        return;
+    }
+
+    free(h);
+}
+
+
+void pool_stats(const struct pool *p, size_t cls, struct pool_stats *stats)
+{
+    if (p && stats && (cls <= OVERSIZE)) {
+        *stats = p->classes[cls].stats;
+    }
+}
@@ -0,0 +1,83 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __POOL_POOL_H__
+#define __POOL_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* Size class buffer pools for the message path, so forwarding a steady
+ * stream of messages doesn't touch the heap at all.
+ *
+ * Requests are rounded up to a power of two class from POOL_MIN_CLASS to
+ * POOL_MAX_CLASS bytes.  Freed buffers are kept on their class's free list
+ * (up to max_cached_bytes per class) and handed out again; larger requests
+ * go straight to malloc() and are counted as oversize.
+ *
+ * Everything is done on the event loop thread, so there is no locking and
+ * no per thread cache.
+ *
+ * A NULL pool is valid everywhere and simply uses malloc() and free(), so
+ * modules can take an optional pool in their options. */
+
+#define POOL_MIN_CLASS 64
+#define POOL_MAX_CLASS (64 * 1024)
+#define POOL_CLASSES   11 /* 64 B to 64 KiB */
+
+struct pool;
+
+struct pool_opts {
+    size_t max_cached_bytes; /* kept on each free list, 0 uses the default */
+};
+
+struct pool_stats {
+    size_t size;       /* the class size, 0 for oversize buffers */
+    size_t in_use;     /* buffers handed out now */
+    size_t high_water; /* the most ever handed out at once */
+    size_t cached;     /* buffers on the free list */
+    uint64_t allocs;   /* requests served */
+    uint64_t misses;   /* requests that had to call malloc() */
+};
+
+
+/**
+ *  Creates an empty pool.
+ *
+ *  @param opts the options, or NULL for the defaults
+ *
+ *  @return the pool or NULL on failure (XA_OUT_OF_MEMORY)
+ */
+struct pool *pool_create(const struct pool_opts *opts, XAcode *err);
+
+
+/**
+ *  Releases the pool and every cached buffer.  Buffers still in use must not
+ *  be freed to the pool afterwards.
+ */
+void pool_destroy(struct pool *p);
+
+
+/**
+ *  Gets a buffer of at least len bytes, aligned for any type.
+ *
+ *  @return the buffer or NULL if out of memory
+ */
+void *pool_alloc(struct pool *p, size_t len);
+
+
+/**
+ *  Returns a buffer from pool_alloc() to the pool it came from.
+ */
+void pool_free(struct pool *p, void *buf);
+
+
+/**
+ *  Gets the counters for a class, 0 to POOL_CLASSES - 1, or POOL_CLASSES for
+ *  the oversize buffers.
+ */
+void pool_stats(const struct pool *p, size_t cls, struct pool_stats *stats);
+
+#endif
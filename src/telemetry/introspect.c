@@ -0,0 +1,642 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _GNU_SOURCE /* accept4() */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "introspect.h"
+#include "json_out.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX_CLIENTS 4
+#define CLIENT_TIMEOUT_MS   5000
+#define SWEEP_MS            1000
+#define REQUEST_MAX         2048
+#define LISTEN_QUEUE        8
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct introspect_state {
+    struct json_out *o;
+    bool first;
+};
+
+/* The Prometheus text format writes HELP and TYPE once per family. */
+struct prom {
+    struct json_out *o;
+    const char *last;
+};
+
+struct json {
+    struct json_out *o;
+    bool first;
+};
+
+struct client {
+    struct client *next;
+    struct client *prev;
+    struct introspect *in;
+
+    int fd;
+    struct event_watch *watch;
+    uint64_t deadline_ms;
+
+    char rx[REQUEST_MAX + 1];
+    size_t rx_used;
+
+    bool answered;
+    struct json_out tx;
+    size_t off;
+};
+
+struct introspect {
+    struct introspect_opts opts;
+    char *path;
+
+    int fd;
+    struct event_watch *watch;
+    struct event_timer *sweep;
+
+    struct client *clients;
+    size_t count;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+/* Writes s with each character in escape preceded by a backslash, and
+ * newlines as \n. */
+static void out_escaped(struct json_out *o, const char *s, const char *escape)
+{
+    const char *run = s;
+
+    for (; *s; s++) {
+        if (('\n' == *s) || strchr(escape, *s)) {
+            json_out_raw(o, run, (size_t) (s - run));
+            if ('\n' == *s) {
+                JSON_OUT_LIT(o, "\\n");
+            } else {
+                json_out_raw(o, "\\", 1);
+                json_out_raw(o, s, 1);
+            }
+            run = s + 1;
+        }
+    }
+    json_out_raw(o, run, (size_t) (s - run));
+}
+
+
+static const char *type_name(enum metric_type type)
+{
+    switch (type) {
+        case METRIC_TYPE__COUNTER:   return "counter";
+        case METRIC_TYPE__GAUGE:     return "gauge";
+        case METRIC_TYPE__HISTOGRAM: return "histogram";
+        default:
+            break;
+    }
+
+    return "untyped";
+}
+
+
+/*------------------------------ Prometheus text ------------------------------*/
+
+/* Writes the labels of a sample, plus le for a histogram bucket. */
+static void prom_labels(struct json_out *o, const struct metric_sample *s, const char *le)
+{
+    if (!s->label && !le) {
+        return;
+    }
+
+    JSON_OUT_LIT(o, "{");
+    if (s->label) {
+        json_out_raw(o, s->label, strlen(s->label));
+        JSON_OUT_LIT(o, "=\"");
+        out_escaped(o, s->label_value, "\\\"");
+        JSON_OUT_LIT(o, "\"");
+    }
+    if (le) {
+        if (s->label) {
+            JSON_OUT_LIT(o, ",");
+        }
+        JSON_OUT_LIT(o, "le=\"");
+        json_out_raw(o, le, strlen(le));
+        JSON_OUT_LIT(o, "\"");
+    }
+    JSON_OUT_LIT(o, "}");
+}
+
+
+/* Buckets are cumulative, and only the ones something landed in are
+ * written, so an idle histogram is three lines instead of 125. */
+static void prom_histogram(struct json_out *o, const struct metric_sample *s)
+{
+    uint64_t total = 0;
+    char le[24];
+
+    for (size_t b = 0; b < METRICS_BUCKETS - 1; b++) {
+        if (s->buckets[b]) {
+            total += s->buckets[b];
+            snprintf(le, sizeof(le), "%llu", (unsigned long long) metrics_bucket_max(b));
+            json_out_fmt(o, "%s_bucket", s->name);
+            prom_labels(o, s, le);
+            json_out_fmt(o, " %llu\n", (unsigned long long) total);
+        }
+    }
+    total += s->buckets[METRICS_BUCKETS - 1];
+
+    /* The count is read apart from the buckets, so it may be a little off;
+     * Prometheus wants them equal. */
+    json_out_fmt(o, "%s_bucket", s->name);
+    prom_labels(o, s, "+Inf");
+    json_out_fmt(o, " %llu\n", (unsigned long long) total);
+
+    json_out_fmt(o, "%s_sum", s->name);
+    prom_labels(o, s, NULL);
+    json_out_fmt(o, " %llu\n", (unsigned long long) s->sum);
+
+    json_out_fmt(o, "%s_count", s->name);
+    prom_labels(o, s, NULL);
+    json_out_fmt(o, " %llu\n", (unsigned long long) total);
+}
+
+
+static void prom_sample(void *user, const struct metric_sample *s)
+{
+    struct prom *p = (struct prom *) user;
+
+    if (!p->last || strcmp(p->last, s->name)) {
+        JSON_OUT_LIT(p->o, "# HELP ");
+        json_out_raw(p->o, s->name, strlen(s->name));
+        JSON_OUT_LIT(p->o, " ");
+        out_escaped(p->o, s->help, "\\");
+        JSON_OUT_LIT(p->o, "\n# TYPE ");
+        json_out_raw(p->o, s->name, strlen(s->name));
+        JSON_OUT_LIT(p->o, " ");
+        json_out_raw(p->o, type_name(s->type), strlen(type_name(s->type)));
+        JSON_OUT_LIT(p->o, "\n");
+        p->last = s->name;
+    }
+
+    if (METRIC_TYPE__HISTOGRAM == s->type) {
+        prom_histogram(p->o, s);
+        return;
+    }
+
+    json_out_raw(p->o, s->name, strlen(s->name));
+    prom_labels(p->o, s, NULL);
+    json_out_fmt(p->o, " %lld\n", (long long) s->value);
+}
+
+
+/*------------------------------------ JSON -----------------------------------*/
+
+static void json_sample(void *user, const struct metric_sample *s)
+{
+    struct json *j     = (struct json *) user;
+    struct json_out *o = j->o;
+    uint64_t total     = 0;
+    bool first         = true;
+
+    if (!j->first) {
+        JSON_OUT_LIT(o, ",");
+    }
+    j->first = false;
+
+    JSON_OUT_LIT(o, "{\"name\":");
+
+    json_out_str(o, s->name);
+    JSON_OUT_LIT(o, ",\"help\":");
+    json_out_str(o, s->help);
+    JSON_OUT_LIT(o, ",\"type\":");
+    json_out_str(o, type_name(s->type));
+    JSON_OUT_LIT(o, ",\"labels\":{");
+    if (s->label) {
+        json_out_str(o, s->label);
+        JSON_OUT_LIT(o, ":");
+        json_out_str(o, s->label_value);
+    }
+    JSON_OUT_LIT(o, "}");
+
+    if (METRIC_TYPE__HISTOGRAM != s->type) {
+        json_out_fmt(o, ",\"value\":%lld}", (long long) s->value);
+        return;
+    }
+
+    json_out_fmt(o, ",\"count\":%llu,\"sum\":%llu,\"buckets\":[",
+                 (unsigned long long) s->count, (unsigned long long) s->sum);
+    for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+        if (!s->buckets[b]) {
+            continue;
+        }
+        total += s->buckets[b];
+        if (!first) {
+            JSON_OUT_LIT(o, ",");
+        }
+        first = false;
+
+        if (METRICS_BUCKETS - 1 == b) {
+            json_out_fmt(o, "{\"le\":\"+Inf\",\"count\":%llu}", (unsigned long long) total);
+        } else {
+            json_out_fmt(o, "{\"le\":%llu,\"count\":%llu}",
+                         (unsigned long long) metrics_bucket_max(b),
+                         (unsigned long long) total);
+        }
+    }
+    JSON_OUT_LIT(o, "]}");
+}
+
+
+static void render_json(struct introspect *in, struct json_out *o)
+{
+    struct introspect_state state = { .o = o, .first = true };
+    struct json j                 = { .o = o, .first = true };
+
+    JSON_OUT_LIT(o, "{\"state\":{");
+    if (in->opts.state) {
+        in->opts.state(in->opts.user, &state);
+    }
+    JSON_OUT_LIT(o, "},\"metrics\":[");
+    metrics_visit(in->opts.metrics, json_sample, &j);
+    JSON_OUT_LIT(o, "]}\n");
+}
+
+
+/*----------------------------------- Clients ---------------------------------*/
+
+static void client_destroy(struct client *c)
+{
+    struct introspect *in = c->in;
+
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else {
+        in->clients = c->next;
+    }
+    if (c->next) {
+        c->next->prev = c->prev;
+    }
+    in->count--;
+
+    if (!in->count) {
+        event_timer_stop(in->sweep);
+    }
+
+    event_watch_remove(c->watch);
+    close(c->fd);
+    free(c->tx.buf);
+    free(c);
+}
+
+
+static void respond(struct client *c, const char *status, const char *type,
+                    const struct json_out *body)
+{
+    json_out_fmt(&c->tx, "HTTP/1.1 %s\r\n", status);
+    if (!strncmp(status, "405", 3)) {
+        JSON_OUT_LIT(&c->tx, "Allow: GET\r\n");
+    }
+    json_out_fmt(&c->tx, "Content-Type: %s\r\n", type);
+    json_out_fmt(&c->tx, "Content-Length: %zu\r\n", body->len);
+    JSON_OUT_LIT(&c->tx, "Connection: close\r\n\r\n");
+    if (body->len) {
+        json_out_raw(&c->tx, body->buf, body->len);
+    }
+}
+
+
+/* Answers the request line; the headers don't matter. */
+static void answer(struct client *c)
+{
+    struct introspect *in = c->in;
+    struct json_out body;
+    const char *path;
+    size_t len;
+
+    memset(&body, 0, sizeof(body));
+    c->answered = true;
+
+    if (strncmp(c->rx, "GET ", 4)) {
+        JSON_OUT_LIT(&body, "only GET is supported\n");
+        respond(c, "405 Method Not Allowed", "text/plain; charset=utf-8", &body);
+        free(body.buf);
+        return;
+    }
+
+    path = &c->rx[4];
+    len  = strcspn(path, " ?\r\n");
+
+    if ((8 == len) && !strncmp(path, "/metrics", len)) {
+        struct prom p = { .o = &body, .last = NULL };
+
+        metrics_visit(in->opts.metrics, prom_sample, &p);
+        respond(c, "200 OK", "text/plain; version=0.0.4; charset=utf-8", &body);
+    } else if ((6 == len) && !strncmp(path, "/state", len)) {
+        render_json(in, &body);
+        respond(c, "200 OK", "application/json", &body);
+    } else {
+        JSON_OUT_LIT(&body, "try /metrics or /state\n");
+        respond(c, "404 Not Found", "text/plain; charset=utf-8", &body);
+    }
+
+    if (body.failed) {
+        c->tx.failed = true;
+    }
+    free(body.buf);
+}
+
+
+/* Reads until the end of the headers.
+ *
+ * @return false if the client should be closed
+ */
+static bool do_read(struct client *c)
+{
+    while (!c->answered) {
+        ssize_t n = recv(c->fd, &c->rx[c->rx_used], REQUEST_MAX - c->rx_used, MSG_DONTWAIT);
+
+        if (n < 0) {
+            return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+        }
+        if (0 == n) {
+            return false;
+        }
+
+        c->rx_used += (size_t) n;
+        c->rx[c->rx_used] = '\0';
+
+        if (strstr(c->rx, "\r\n\r\n") || strstr(c->rx, "\n\n")) {
+            answer(c);
+        } else if (REQUEST_MAX == c->rx_used) {
+            struct json_out body;
+
+            memset(&body, 0, sizeof(body));
+            c->answered = true;
+            respond(c, "431 Request Header Fields Too Large", "text/plain; charset=utf-8", &body);
+        }
+    }
+
+    return !c->tx.failed;
+}
+
+
+/* @return false once the response is written or can't be */
+static bool do_write(struct client *c)
+{
+    while (c->off < c->tx.len) {
+        ssize_t n = send(c->fd, &c->tx.buf[c->off], c->tx.len - c->off,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (n < 0) {
+            return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno);
+        }
+        c->off += (size_t) n;
+    }
+
+    return false;
+}
+
+
+static void on_client(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct client *c = (struct client *) user;
+
+    (void) w;
+    (void) fd;
+
+    if (!c->answered) {
+        if (!do_read(c) || (!c->answered && (events & (EVENT__HANGUP | EVENT__ERROR)))) {
+            client_destroy(c);
+            return;
+        }
+        if (!c->answered) {
+            return;
+        }
+    }
+
+    if (!do_write(c)) {
+        client_destroy(c);
+        return;
+    }
+    event_watch_modify(c->watch, EVENT__WRITABLE, NULL);
+}
+
+
+/* Closes the clients that are taking too long. */
+static void on_sweep(struct event_timer *t, void *user)
+{
+    struct introspect *in = (struct introspect *) user;
+    uint64_t now          = event_loop_now_ms(in->opts.loop);
+    struct client *c      = in->clients;
+
+    (void) t;
+
+    while (c) {
+        struct client *next = c->next;
+
+        if (c->deadline_ms <= now) {
+            client_destroy(c);
+        }
+        c = next;
+    }
+}
+
+
+static void on_accept(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct introspect *in = (struct introspect *) user;
+
+    (void) w;
+    (void) events;
+
+    while (1) {
+        struct client *c;
+        int cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (cfd < 0) {
+            return;
+        }
+
+        /* Busy; the collector will try again. */
+        if (in->opts.max_clients <= in->count) {
+            close(cfd);
+            continue;
+        }
+
+        c = calloc(1, sizeof(struct client));
+        if (c) {
+            c->fd          = cfd;
+            c->in          = in;
+            c->deadline_ms = event_loop_now_ms(in->opts.loop) + CLIENT_TIMEOUT_MS;
+            c->watch       = event_loop_watch(in->opts.loop, cfd, EVENT__READABLE,
+                                              on_client, c, NULL);
+        }
+
+        if (!c || !c->watch) {
+            free(c);
+            close(cfd);
+            continue;
+        }
+
+        c->next = in->clients;
+        if (in->clients) {
+            in->clients->prev = c;
+        }
+        in->clients = c;
+
+        if (!in->count++) {
+            event_timer_start(in->sweep, SWEEP_MS, SWEEP_MS);
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct introspect *introspect_create(const struct introspect_opts *opts,
+                                     XAcode *err)
+{
+    struct sockaddr_un addr;
+    struct introspect *in;
+
+    if (!opts || !opts->loop || !opts->path
+        || (sizeof(addr.sun_path) <= strlen(opts->path)))
+    {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    in = calloc(1, sizeof(struct introspect));
+    if (!in) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    in->opts = *opts;
+    if (!in->opts.max_clients) {
+        in->opts.max_clients = DEFAULT_MAX_CLIENTS;
+    }
+
+    in->path = malloc(strlen(opts->path) + 1);
+    if (!in->path) {
+        free(in);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    strcpy(in->path, opts->path);
+    in->opts.path = in->path;
+
+    in->sweep = event_timer_create(opts->loop, on_sweep, in, err);
+    if (!in->sweep) {
+        free(in->path);
+        free(in);
+        return NULL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, in->path);
+
+    in->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(in->path);
+    if ((in->fd < 0)
+        || (0 != bind(in->fd, (struct sockaddr *) &addr, sizeof(addr)))
+        || (0 != listen(in->fd, LISTEN_QUEUE)))
+    {
+        if (0 <= in->fd) {
+            close(in->fd);
+        }
+        event_timer_destroy(in->sweep);
+        free(in->path);
+        free(in);
+        xa_set_error(err, XA_FAILED_TO_OPEN_FILE);
+        return NULL;
+    }
+
+    in->watch = event_loop_watch(opts->loop, in->fd, EVENT__READABLE, on_accept, in, err);
+    if (!in->watch) {
+        close(in->fd);
+        unlink(in->path);
+        event_timer_destroy(in->sweep);
+        free(in->path);
+        free(in);
+        return NULL;
+    }
+
+    return in;
+}
+
+
+void introspect_destroy(struct introspect *in)
+{
+    if (in) {
+        while (in->clients) {
+            client_destroy(in->clients);
+        }
+        event_watch_remove(in->watch);
+        event_timer_destroy(in->sweep);
+        close(in->fd);
+        unlink(in->path);
+        free(in->path);
+        free(in);
+    }
+}
+
+
+void introspect_str(struct introspect_state *s, const char *key, const char *val)
+{
+    if (!s || !key) {
+        return;
+    }
+
+    if (!s->first) {
+        JSON_OUT_LIT(s->o, ",");
+    }
+    s->first = false;
+
+    json_out_str(s->o, key);
+    JSON_OUT_LIT(s->o, ":");
+    if (val) {
+        json_out_str(s->o, val);
+    } else {
+        JSON_OUT_LIT(s->o, "null");
+    }
+}
+
+
+void introspect_int(struct introspect_state *s, const char *key, int64_t val)
+{
+    if (!s || !key) {
+        return;
+    }
+
+    if (!s->first) {
+        JSON_OUT_LIT(s->o, ",");
+    }
+    s->first = false;
+
+    json_out_str(s->o, key);
+    json_out_fmt(s->o, ":%lld", (long long) val);
+}
@@ -0,0 +1,71 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __TELEMETRY_INTROSPECT_H__
+#define __TELEMETRY_INTROSPECT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+#include "metrics.h"
+
+/* A local unix socket that answers HTTP/1.x GET requests with the metrics
+ * registry and the agent's current state:
+ *
+ *   GET /metrics   the registry in the Prometheus text format
+ *   GET /state     the state and the registry as one JSON object
+ *
+ * so `curl --unix-socket <path> http://agent/state` works, as does any
+ * collector that scrapes over a unix socket.
+ *
+ * Everything happens on the event loop: sockets are non-blocking, a request
+ * is answered in the wakeup its headers arrive in, and whatever the client
+ * doesn't take at once is written as it makes room.  Reading the registry
+ * doesn't stop anyone updating it.  Clients are limited in number and in how
+ * long they may take, and each connection answers one request. */
+
+struct introspect;
+struct introspect_state;
+
+/**
+ *  Called for each /state request to describe the agent with
+ *  introspect_str() and introspect_int().
+ */
+typedef void (*introspect_state_fn)(void *user, struct introspect_state *s);
+
+struct introspect_opts {
+    struct event_loop *loop;
+    const char *path;
+    struct metrics *metrics;   /* optional */
+    introspect_state_fn state; /* optional */
+    void *user;
+    size_t max_clients; /* 0 uses the default */
+};
+
+
+/**
+ *  Starts listening on opts->path, replacing any socket already there.
+ *
+ *  @return the endpoint or NULL on failure (XA_INVALID_INPUT,
+ *          XA_OUT_OF_MEMORY, XA_FAILED_TO_OPEN_FILE, XA_EVENT_LOOP_ERROR)
+ */
+struct introspect *introspect_create(const struct introspect_opts *opts,
+                                     XAcode *err);
+
+
+/**
+ *  Closes every client and the socket, and removes it.
+ */
+void introspect_destroy(struct introspect *in);
+
+
+/**
+ *  Adds a value to the state being written.  Keys are written in the order
+ *  they are added; a NULL val is written as null.
+ */
+void introspect_str(struct introspect_state *s, const char *key, const char *val);
+void introspect_int(struct introspect_state *s, const char *key, int64_t val);
+
+#endif
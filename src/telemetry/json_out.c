@@ -0,0 +1,109 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_out.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define FIRST_CAP 4096
+#define FMT_MAX   128
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+void json_out_raw(struct json_out *o, const char *text, size_t len)
+{
+    if (o->failed) {
+        return;
+    }
+
+    if (o->cap - o->len < len + 1) {
+        size_t cap = (o->cap) ? o->cap : FIRST_CAP;
+        char *buf;
+
+        while (cap - o->len < len + 1) {
+            cap *= 2;
+        }
+        buf = realloc(o->buf, cap);
+        if (!buf) {
+            o->failed = true;
+            return;
+        }
+        o->buf = buf;
+        o->cap = cap;
+    }
+
+    memcpy(&o->buf[o->len], text, len);
+    o->len += len;
+    o->buf[o->len] = '\0';
+}
+
+
+void json_out_fmt(struct json_out *o, const char *format, ...)
+{
+    char buf[FMT_MAX];
+    va_list args;
+    int n;
+
+    va_start(args, format);
+    n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if ((n < 0) || (sizeof(buf) <= (size_t) n)) {
+        o->failed = true;
+        return;
+    }
+    json_out_raw(o, buf, (size_t) n);
+}
+
+
+void json_out_str(struct json_out *o, const char *s)
+{
+    const char *run = s;
+
+    JSON_OUT_LIT(o, "\"");
+    for (; *s; s++) {
+        unsigned char c = (unsigned char) *s;
+
+        if ((c < 0x20) || ('"' == c) || ('\\' == c)) {
+            json_out_raw(o, run, (size_t) (s - run));
+            if ('"' == c) {
+                JSON_OUT_LIT(o, "\\\"");
+            } else if ('\\' == c) {
+                JSON_OUT_LIT(o, "\\\\");
+            } else {
+                json_out_fmt(o, "\\u%04x", c);
+            }
+            run = s + 1;
+        }
+    }
+    json_out_raw(o, run, (size_t) (s - run));
+    JSON_OUT_LIT(o, "\"");
+}
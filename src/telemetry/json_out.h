@@ -0,0 +1,44 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __TELEMETRY_JSON_OUT_H__
+#define __TELEMETRY_JSON_OUT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A growing, always NUL terminated text buffer for writing JSON (and other
+ * text) a piece at a time.  Once an allocation fails the buffer is marked
+ * failed and further writes are ignored, so the writer only has to check at
+ * the end. */
+
+struct json_out {
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool failed;
+};
+
+
+/* Appends a string literal. */
+#define JSON_OUT_LIT(o, lit) json_out_raw((o), (lit), sizeof(lit) - 1)
+
+
+/**
+ *  Appends len bytes of text as they are.
+ */
+void json_out_raw(struct json_out *o, const char *text, size_t len);
+
+
+/**
+ *  Appends printf() formatted text, which must be short (under 128 bytes).
+ */
+void json_out_fmt(struct json_out *o, const char *format, ...);
+
+
+/**
+ *  Appends s as a quoted and escaped JSON string.
+ */
+void json_out_str(struct json_out *o, const char *s);
+
+#endif
@@ -0,0 +1,298 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Needed for posix_memalign() */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_MAX 256
+#define CACHE_LINE  64
+
+#define SUB_BITS   2
+#define SUBS       (1u << SUB_BITS)
+#define RANGE_BITS 32
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct metric {
+    /* Written by the hot path, so alone on the first cache line. */
+    uint64_t value; /* the counter, the gauge, or the histogram's count */
+    uint64_t sum;
+    uint8_t pad0[CACHE_LINE - 16];
+
+    enum metric_type type;
+    const char *name;
+    const char *help;
+    const char *label;
+    char label_value[METRICS_LABEL_MAX + 1];
+
+    metric_read_fn read;
+    void *user;
+
+    uint64_t *buckets;
+};
+
+struct metrics {
+    size_t max;
+    size_t count;
+    struct metric **list;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static size_t bucket_of(uint64_t v)
+{
+    int e;
+
+    if (v < SUBS) {
+        return (size_t) v;
+    }
+
+    e = 63 - __builtin_clzll(v);
+    if (RANGE_BITS <= e) {
+        return METRICS_BUCKETS - 1;
+    }
+
+    return (size_t) (e - SUB_BITS + 1) * SUBS + (size_t) ((v >> (e - SUB_BITS)) & (SUBS - 1));
+}
+
+
+static struct metric *add(struct metrics *m, enum metric_type type,
+                          const char *name, const char *help, const char *label,
+                          const char *label_value)
+{
+    struct metric *x = NULL;
+
+    if (!m || !name || (m->max <= m->count) || (!label != !label_value)
+        || (0 != posix_memalign((void **) &x, CACHE_LINE, sizeof(struct metric))))
+    {
+        return NULL;
+    }
+
+    memset(x, 0, sizeof(*x));
+    x->type  = type;
+    x->name  = name;
+    x->help  = (help) ? help : "";
+    x->label = label;
+    if (label_value) {
+        strncpy(x->label_value, label_value, METRICS_LABEL_MAX);
+    }
+
+    if (METRIC_TYPE__HISTOGRAM == type) {
+        x->buckets = calloc(METRICS_BUCKETS, sizeof(uint64_t));
+        if (!x->buckets) {
+            free(x);
+            return NULL;
+        }
+    }
+
+    m->list[m->count++] = x;
+
+    return x;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct metrics *metrics_create(size_t max, XAcode *err)
+{
+    struct metrics *m = calloc(1, sizeof(struct metrics));
+
+    if (!max) {
+        max = DEFAULT_MAX;
+    }
+
+    if (m) {
+        m->max  = max;
+        m->list = calloc(max, sizeof(struct metric *));
+        if (m->list) {
+            return m;
+        }
+        free(m);
+    }
+
+    xa_set_error(err, XA_OUT_OF_MEMORY);
+    return NULL;
+}
+
+
+void metrics_destroy(struct metrics *m)
+{
+    if (m) {
+        for (size_t i = 0; i < m->count; i++) {
+            free(m->list[i]->buckets);
+            free(m->list[i]);
+        }
+        free(m->list);
+        free(m);
+    }
+}
+
+
+struct metric *metrics_counter(struct metrics *m, const char *name,
+                               const char *help, const char *label,
+                               const char *label_value)
+{
+    return add(m, METRIC_TYPE__COUNTER, name, help, label, label_value);
+}
+
+
+struct metric *metrics_gauge(struct metrics *m, const char *name,
+                             const char *help, const char *label,
+                             const char *label_value)
+{
+    return add(m, METRIC_TYPE__GAUGE, name, help, label, label_value);
+}
+
+
+struct metric *metrics_histogram(struct metrics *m, const char *name,
+                                 const char *help, const char *label,
+                                 const char *label_value)
+{
+    return add(m, METRIC_TYPE__HISTOGRAM, name, help, label, label_value);
+}
+
+
+struct metric *metrics_counter_fn(struct metrics *m, const char *name,
+                                  const char *help, const char *label,
+                                  const char *label_value, metric_read_fn fn,
+                                  void *user)
+{
+    struct metric *x = (fn) ? add(m, METRIC_TYPE__COUNTER, name, help, label, label_value) : NULL;
+
+    if (x) {
+        x->read = fn;
+        x->user = user;
+    }
+
+    return x;
+}
+
+
+struct metric *metrics_gauge_fn(struct metrics *m, const char *name,
+                                const char *help, const char *label,
+                                const char *label_value, metric_read_fn fn,
+                                void *user)
+{
+    struct metric *x = (fn) ? add(m, METRIC_TYPE__GAUGE, name, help, label, label_value) : NULL;
+
+    if (x) {
+        x->read = fn;
+        x->user = user;
+    }
+
+    return x;
+}
+
+
+void metric_add(struct metric *c, uint64_t n)
+{
+    if (c) {
+        __atomic_fetch_add(&c->value, n, __ATOMIC_RELAXED);
+    }
+}
+
+
+void metric_set(struct metric *g, int64_t v)
+{
+    if (g) {
+        __atomic_store_n(&g->value, (uint64_t) v, __ATOMIC_RELAXED);
+    }
+}
+
+
+void metric_move(struct metric *g, int64_t delta)
+{
+    if (g) {
+        __atomic_fetch_add(&g->value, (uint64_t) delta, __ATOMIC_RELAXED);
+    }
+}
+
+
+void metric_observe(struct metric *h, uint64_t v)
+{
+    if (h && h->buckets) {
+        __atomic_fetch_add(&h->buckets[bucket_of(v)], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->sum, v, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->value, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+uint64_t metrics_bucket_max(size_t bucket)
+{
+    size_t e;
+    uint64_t sub;
+
+    if (bucket < SUBS) {
+        return (uint64_t) bucket;
+    }
+    if (METRICS_BUCKETS - 1 <= bucket) {
+        return UINT64_MAX;
+    }
+
+    /* The next bucket's lowest value, less one. */
+    bucket++;
+    e   = bucket / SUBS + SUB_BITS - 1;
+    sub = bucket % SUBS;
+
+    return ((SUBS + sub) << (e - SUB_BITS)) - 1;
+}
+
+
+void metrics_visit(const struct metrics *m, metrics_visit_fn fn, void *user)
+{
+    uint64_t buckets[METRICS_BUCKETS];
+
+    if (!m || !fn) {
+        return;
+    }
+
+    for (size_t i = 0; i < m->count; i++) {
+        const struct metric *x = m->list[i];
+        struct metric_sample s;
+
+        memset(&s, 0, sizeof(s));
+        s.name        = x->name;
+        s.help        = x->help;
+        s.label       = x->label;
+        s.label_value = (x->label) ? x->label_value : NULL;
+        s.type        = x->type;
+
+        if (x->read) {
+            s.value = x->read(x->user);
+        } else if (METRIC_TYPE__HISTOGRAM == x->type) {
+            for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+                buckets[b] = __atomic_load_n(&x->buckets[b], __ATOMIC_RELAXED);
+            }
+            s.count   = __atomic_load_n(&x->value, __ATOMIC_RELAXED);
+            s.sum     = __atomic_load_n(&x->sum, __ATOMIC_RELAXED);
+            s.buckets = buckets;
+        } else {
+            s.value = (int64_t) __atomic_load_n(&x->value, __ATOMIC_RELAXED);
+        }
+
+        fn(user, &s);
+    }
+}
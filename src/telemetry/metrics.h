@@ -0,0 +1,146 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __TELEMETRY_METRICS_H__
+#define __TELEMETRY_METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* A registry of counters, gauges and histograms.
+ *
+ * Metrics are registered up front, which allocates; after that an update is
+ * one or two relaxed atomic operations on a cache line of the metric's own,
+ * so updates from different threads don't contend and never wait.  The
+ * registry can be read (see metrics_visit()) at any time from one thread
+ * without stopping the ones updating it, at the cost that a histogram's
+ * count, sum and buckets may be a few observations apart.
+ *
+ * A metric has a name and optionally one label, so a family such as
+ * connects per interface is one metric per label value with the same name.
+ * Names, help and label keys must be string literals; label values are
+ * copied.  Every update accepts a NULL metric and does nothing, so code can
+ * be instrumented whether or not there is a registry. */
+
+enum metric_type {
+    METRIC_TYPE__COUNTER = 0,
+    METRIC_TYPE__GAUGE,
+    METRIC_TYPE__HISTOGRAM,
+};
+
+/* Histograms are log-linear: 4 buckets per power of 2, so a value lands in
+ * a bucket at most 25% wider than itself, up to 2^32, then one bucket for
+ * everything larger. */
+#define METRICS_BUCKETS 125
+
+#define METRICS_LABEL_MAX 63
+
+struct metrics;
+struct metric;
+
+/**
+ *  Reads a metric kept elsewhere.  Called by whoever calls metrics_visit().
+ */
+typedef int64_t (*metric_read_fn)(void *user);
+
+struct metric_sample {
+    const char *name;
+    const char *help;
+    const char *label; /* the key, NULL if there is none */
+    const char *label_value;
+    enum metric_type type;
+
+    int64_t value; /* counters and gauges */
+
+    /* Histograms, with the count of each bucket (not cumulative). */
+    uint64_t count;
+    uint64_t sum;
+    const uint64_t *buckets;
+};
+
+typedef void (*metrics_visit_fn)(void *user, const struct metric_sample *s);
+
+
+/**
+ *  Creates the registry.
+ *
+ *  @param max the most metrics that can be registered, 0 for the default
+ *
+ *  @return the registry or NULL on failure (XA_OUT_OF_MEMORY)
+ */
+struct metrics *metrics_create(size_t max, XAcode *err);
+
+
+/**
+ *  Releases the registry and every metric in it.
+ */
+void metrics_destroy(struct metrics *m);
+
+
+/**
+ *  Registers a metric.  label and label_value may both be NULL.
+ *
+ *  @return the metric, or NULL if m is NULL, the registry is full or out of
+ *          memory
+ */
+struct metric *metrics_counter(struct metrics *m, const char *name,
+                               const char *help, const char *label,
+                               const char *label_value);
+struct metric *metrics_gauge(struct metrics *m, const char *name,
+                             const char *help, const char *label,
+                             const char *label_value);
+struct metric *metrics_histogram(struct metrics *m, const char *name,
+                                 const char *help, const char *label,
+                                 const char *label_value);
+
+
+/**
+ *  Registers a counter or gauge whose value is read by the function when the
+ *  registry is visited.
+ *
+ *  @return the metric, or NULL on failure
+ */
+struct metric *metrics_counter_fn(struct metrics *m, const char *name,
+                                  const char *help, const char *label,
+                                  const char *label_value, metric_read_fn fn,
+                                  void *user);
+struct metric *metrics_gauge_fn(struct metrics *m, const char *name,
+                                const char *help, const char *label,
+                                const char *label_value, metric_read_fn fn,
+                                void *user);
+
+
+/**
+ *  Adds to a counter.
+ */
+void metric_add(struct metric *c, uint64_t n);
+
+
+/**
+ *  Sets or moves a gauge.
+ */
+void metric_set(struct metric *g, int64_t v);
+void metric_move(struct metric *g, int64_t delta);
+
+
+/**
+ *  Records one value in a histogram.
+ */
+void metric_observe(struct metric *h, uint64_t v);
+
+
+/**
+ *  Gets the largest value that lands in a histogram bucket; UINT64_MAX for
+ *  the last.
+ */
+uint64_t metrics_bucket_max(size_t bucket);
+
+
+/**
+ *  Calls fn for each metric, in the order they were registered.
+ */
+void metrics_visit(const struct metrics *m, metrics_visit_fn fn, void *user);
+
+#endif
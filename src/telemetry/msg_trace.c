@@ -0,0 +1,495 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Needed for clock_gettime() */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "msg_trace.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_SAMPLE_EVERY 100
+#define DEFAULT_SLOW_MS      100
+#define DEFAULT_TIMEOUT_MS   30000
+#define DEFAULT_IN_FLIGHT    64
+#define DEFAULT_RECORDS      256
+
+#define EXPORT_CHUNK 8
+#define CACHE_LINE   64
+#define NS_PER_S     1000000000ull
+#define NS_PER_MS    1000000ull
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct flight {
+    bool used;
+    bool sampled;
+    enum msg_stage last;
+    uint64_t batch_pos;
+    size_t tid_len;
+    struct msg_trace_record r;
+};
+
+struct ring {
+    uint64_t head; /* written by the event loop thread */
+    uint8_t pad0[CACHE_LINE - 8];
+    uint64_t tail; /* written by the reader */
+    uint8_t pad1[CACHE_LINE - 8];
+};
+
+struct msg_trace {
+    struct msg_trace_opts opts;
+    uint64_t slow_ns;
+    uint64_t timeout_ns;
+
+    struct flight *flights;
+    int *free_list;
+    size_t free_count;
+    size_t waiting[MSG_STAGE__COUNT];
+    uint64_t seq;
+
+    /* Positions in the outbound batch, counted in messages. */
+    uint64_t batched;
+    uint64_t sent;
+
+    struct msg_trace_stats stats;
+
+    struct ring ring;
+    struct msg_trace_record *records; /* opts.records, a power of 2 */
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* The span for each stage covers the time since the stage before it. */
+static const char *stage_name[] = {
+    "receive", "decode", "route", "local delivery", "response", "encode", "send",
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_S + (uint64_t) ts.tv_nsec;
+}
+
+
+static struct flight *get(const struct msg_trace *mt, int h)
+{
+    if (!mt || (h < 0) || (mt->opts.in_flight <= (size_t) h) || !mt->flights[h].used) {
+        return NULL;
+    }
+
+    return &mt->flights[h];
+}
+
+
+static void copy_str(char *to, size_t max, const char *from, size_t len)
+{
+    if (!from) {
+        len = 0;
+    }
+    if (max < len) {
+        len = max;
+    }
+    if (len) {
+        memcpy(to, from, len);
+    }
+    to[len] = '\0';
+}
+
+
+static void reach(struct msg_trace *mt, struct flight *f, enum msg_stage stage,
+                  uint64_t now)
+{
+    mt->waiting[f->last]--;
+    mt->waiting[stage]++;
+    f->last           = stage;
+    f->r.at_ns[stage] = now;
+}
+
+
+static void keep(struct msg_trace *mt, const struct msg_trace_record *r)
+{
+    size_t mask   = mt->opts.records - 1;
+    uint64_t head = mt->ring.head;
+
+    if (mt->opts.records <= head - __atomic_load_n(&mt->ring.tail, __ATOMIC_ACQUIRE)) {
+        mt->stats.dropped++;
+        return;
+    }
+
+    mt->records[head & mask] = *r;
+    __atomic_store_n(&mt->ring.head, head + 1, __ATOMIC_RELEASE);
+    mt->stats.kept++;
+}
+
+
+static void finish(struct msg_trace *mt, int h, struct flight *f, XAcode code,
+                   bool expired)
+{
+    /* One that never finished took at least until now. */
+    uint64_t last = (expired) ? now_ns() : f->r.at_ns[f->last];
+
+    f->r.code    = code;
+    f->r.expired = expired;
+    f->r.slow    = (mt->slow_ns <= last - f->r.at_ns[MSG_STAGE__RECEIVE]);
+
+    if (f->sampled || f->r.slow) {
+        keep(mt, &f->r);
+    }
+
+    mt->waiting[f->last]--;
+    f->used                         = false;
+    mt->free_list[mt->free_count++] = h;
+}
+
+
+static void export_one(struct trace *t, const struct msg_trace_record *r)
+{
+    struct trace_span *stages[MSG_STAGE__COUNT] = { NULL };
+    struct trace_span *root;
+    uint64_t from = r->at_ns[MSG_STAGE__RECEIVE];
+    uint64_t end  = from;
+
+    root = trace_span_root(t, "wrp message", TRACE_KIND__SERVER);
+    if (!root) {
+        return;
+    }
+    trace_span_start_at(root, from);
+    trace_span_int(root, "wrp.msg_type", r->msg_type);
+    trace_span_str(root, "wrp.dest", r->dest);
+    if (r->transaction_uuid[0]) {
+        trace_span_str(root, "wrp.transaction_uuid", r->transaction_uuid);
+    }
+    trace_span_str(root, "xa.kept_for", (r->slow) ? "latency" : "sample");
+
+    /* Every span has to exist before any ends, or a full batch could export
+     * the root before its children are made. */
+    for (int i = MSG_STAGE__DECODE; i < MSG_STAGE__COUNT; i++) {
+        if (r->at_ns[i]) {
+            stages[i] = trace_span_child(root, stage_name[i], TRACE_KIND__INTERNAL);
+            trace_span_start_at(stages[i], from);
+            from = r->at_ns[i];
+            end  = from;
+        }
+    }
+
+    if (XA_OK != r->code) {
+        trace_span_error(root, r->code, xa_error_to_string(r->code));
+    } else if (r->expired) {
+        trace_span_error(root, XA_OK, "gave up waiting for the next stage");
+    }
+
+    for (int i = MSG_STAGE__DECODE; i < MSG_STAGE__COUNT; i++) {
+        trace_span_end_at(stages[i], r->at_ns[i]);
+    }
+    trace_span_end_at(root, end);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct msg_trace *msg_trace_create(const struct msg_trace_opts *opts, XAcode *err)
+{
+    struct msg_trace *mt;
+    size_t records = DEFAULT_RECORDS;
+
+    if (!opts || ((size_t) INT32_MAX < opts->in_flight)) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    mt = calloc(1, sizeof(struct msg_trace));
+    if (!mt) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    mt->opts = *opts;
+    if (!mt->opts.sample_every) {
+        mt->opts.sample_every = DEFAULT_SAMPLE_EVERY;
+    }
+    if (!mt->opts.slow_ms) {
+        mt->opts.slow_ms = DEFAULT_SLOW_MS;
+    }
+    if (!mt->opts.timeout_ms) {
+        mt->opts.timeout_ms = DEFAULT_TIMEOUT_MS;
+    }
+    if (!mt->opts.in_flight) {
+        mt->opts.in_flight = DEFAULT_IN_FLIGHT;
+    }
+    if (opts->records) {
+        records = 1;
+        while (records < opts->records) {
+            records *= 2;
+        }
+    }
+    mt->opts.records = records;
+    mt->slow_ns      = mt->opts.slow_ms * NS_PER_MS;
+    mt->timeout_ns   = mt->opts.timeout_ms * NS_PER_MS;
+
+    mt->flights   = calloc(mt->opts.in_flight, sizeof(struct flight));
+    mt->free_list = calloc(mt->opts.in_flight, sizeof(int));
+    mt->records   = calloc(mt->opts.records, sizeof(struct msg_trace_record));
+    if (!mt->flights || !mt->free_list || !mt->records) {
+        msg_trace_destroy(mt);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    /* Handed out from the front first. */
+    for (size_t i = 0; i < mt->opts.in_flight; i++) {
+        mt->free_list[i] = (int) (mt->opts.in_flight - 1 - i);
+    }
+    mt->free_count = mt->opts.in_flight;
+
+    return mt;
+}
+
+
+void msg_trace_destroy(struct msg_trace *mt)
+{
+    if (mt) {
+        free(mt->records);
+        free(mt->free_list);
+        free(mt->flights);
+        free(mt);
+    }
+}
+
+
+int msg_trace_begin(struct msg_trace *mt)
+{
+    struct flight *f;
+    int h;
+
+    if (!mt) {
+        return -1;
+    }
+
+    if (!mt->free_count) {
+        mt->stats.untracked++;
+        return -1;
+    }
+
+    h = mt->free_list[--mt->free_count];
+    f = &mt->flights[h];
+    memset(f, 0, sizeof(*f));
+    f->used    = true;
+    f->last    = MSG_STAGE__RECEIVE;
+    f->sampled = (0 == (mt->seq++ % mt->opts.sample_every));
+
+    f->r.at_ns[MSG_STAGE__RECEIVE] = now_ns();
+
+    mt->waiting[MSG_STAGE__RECEIVE]++;
+    mt->stats.followed++;
+
+    return h;
+}
+
+
+void msg_trace_stamp(struct msg_trace *mt, int h, enum msg_stage stage)
+{
+    struct flight *f = get(mt, h);
+
+    if (f && (MSG_STAGE__RECEIVE < stage) && (stage < MSG_STAGE__COUNT)) {
+        reach(mt, f, stage, now_ns());
+    }
+}
+
+
+void msg_trace_describe(struct msg_trace *mt, int h, int msg_type,
+                        const char *dest, size_t dest_len)
+{
+    struct flight *f = get(mt, h);
+
+    if (f) {
+        f->r.msg_type = msg_type;
+        copy_str(f->r.dest, MSG_TRACE_DEST_MAX, dest, dest_len);
+    }
+}
+
+
+void msg_trace_await(struct msg_trace *mt, int h, const char *tid, size_t len)
+{
+    struct flight *f = get(mt, h);
+
+    if (!f) {
+        return;
+    }
+
+    if (!tid || !len) {
+        finish(mt, h, f, XA_OK, false);
+        return;
+    }
+
+    copy_str(f->r.transaction_uuid, MSG_TRACE_TID_MAX, tid, len);
+    f->tid_len = len;
+}
+
+
+bool msg_trace_waiting(const struct msg_trace *mt, enum msg_stage stage)
+{
+    return mt && (stage < MSG_STAGE__COUNT) && mt->waiting[stage];
+}
+
+
+int msg_trace_find(const struct msg_trace *mt, enum msg_stage stage,
+                   const char *tid, size_t len)
+{
+    size_t cmp = (MSG_TRACE_TID_MAX < len) ? MSG_TRACE_TID_MAX : len;
+
+    if (!msg_trace_waiting(mt, stage) || !tid || !len) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < mt->opts.in_flight; i++) {
+        const struct flight *f = &mt->flights[i];
+
+        if (f->used && (stage == f->last) && (len == f->tid_len)
+            && (0 == memcmp(f->r.transaction_uuid, tid, cmp)))
+        {
+            return (int) i;
+        }
+    }
+
+    return -1;
+}
+
+
+void msg_trace_batched(struct msg_trace *mt, int h)
+{
+    struct flight *f = get(mt, h);
+
+    if (!mt) {
+        return;
+    }
+
+    if (f) {
+        f->batch_pos = mt->batched;
+        reach(mt, f, MSG_STAGE__ENCODE, now_ns());
+    }
+    mt->batched++;
+}
+
+
+void msg_trace_sent(struct msg_trace *mt, size_t count)
+{
+    uint64_t now;
+
+    if (!mt || !count) {
+        return;
+    }
+
+    mt->sent += count;
+    if (!mt->waiting[MSG_STAGE__ENCODE]) {
+        return;
+    }
+
+    now = now_ns();
+    for (size_t i = 0; i < mt->opts.in_flight; i++) {
+        struct flight *f = &mt->flights[i];
+
+        if (f->used && (MSG_STAGE__ENCODE == f->last) && (f->batch_pos < mt->sent)) {
+            reach(mt, f, MSG_STAGE__SEND, now);
+            finish(mt, (int) i, f, XA_OK, false);
+        }
+    }
+}
+
+
+void msg_trace_end(struct msg_trace *mt, int h, XAcode code)
+{
+    struct flight *f = get(mt, h);
+
+    if (f) {
+        finish(mt, h, f, code, false);
+    }
+}
+
+
+void msg_trace_expire(struct msg_trace *mt)
+{
+    uint64_t now;
+
+    if (!mt || (mt->free_count == mt->opts.in_flight)) {
+        return;
+    }
+
+    now = now_ns();
+    for (size_t i = 0; i < mt->opts.in_flight; i++) {
+        struct flight *f = &mt->flights[i];
+
+        if (f->used && (mt->timeout_ns < now - f->r.at_ns[f->last])) {
+            finish(mt, (int) i, f, XA_OK, true);
+        }
+    }
+}
+
+
+size_t msg_trace_read(struct msg_trace *mt, struct msg_trace_record *out,
+                      size_t max)
+{
+    uint64_t tail;
+    uint64_t head;
+    size_t n = 0;
+
+    if (!mt || !out) {
+        return 0;
+    }
+
+    tail = __atomic_load_n(&mt->ring.tail, __ATOMIC_RELAXED);
+    head = __atomic_load_n(&mt->ring.head, __ATOMIC_ACQUIRE);
+    for (; (n < max) && (tail != head); n++, tail++) {
+        out[n] = mt->records[tail & (mt->opts.records - 1)];
+    }
+    __atomic_store_n(&mt->ring.tail, tail, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+
+void msg_trace_export(struct msg_trace *mt, struct trace *t)
+{
+    struct msg_trace_record r[EXPORT_CHUNK];
+    size_t n;
+
+    if (!t) {
+        return;
+    }
+
+    while (0 < (n = msg_trace_read(mt, r, EXPORT_CHUNK))) {
+        for (size_t i = 0; i < n; i++) {
+            export_one(t, &r[i]);
+        }
+    }
+}
+
+
+void msg_trace_stats(const struct msg_trace *mt, struct msg_trace_stats *stats)
+{
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        if (mt) {
+            *stats = mt->stats;
+        }
+    }
+}
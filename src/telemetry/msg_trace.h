@@ -0,0 +1,182 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __TELEMETRY_MSG_TRACE_H__
+#define __TELEMETRY_MSG_TRACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "trace.h"
+
+/* Follows WRP messages through the agent: a request from the server is
+ * timed as it is decoded, routed and delivered to a local service, and its
+ * response is timed on the way back through the outbound batch to the
+ * websocket.
+ *
+ * Every message is timed, since it only costs a clock read per stage, but
+ * only 1 in sample_every of them, plus every one that took slow_ms or more,
+ * is kept.  Kept messages go into a single producer, single consumer
+ * lock-free ring until they are read, usually by msg_trace_export(), which
+ * turns each into a span with a child span per stage.
+ *
+ * Messages are referred to by a handle; -1 means the message isn't being
+ * followed, and every function accepts it (and a NULL msg_trace) and does
+ * nothing.  Everything but msg_trace_read() belongs to the event loop
+ * thread. */
+
+enum msg_stage {
+    MSG_STAGE__RECEIVE = 0, /* the websocket message is complete */
+    MSG_STAGE__DECODE,      /* the WRP message is decoded */
+    MSG_STAGE__ROUTE,       /* a local service was found for it */
+    MSG_STAGE__DELIVER,     /* it was handed to the local service */
+    MSG_STAGE__RESPONSE,    /* the local service responded */
+    MSG_STAGE__ENCODE,      /* the response is in the outbound batch */
+    MSG_STAGE__SEND,        /* the response went out on the websocket */
+    MSG_STAGE__COUNT
+};
+
+#define MSG_TRACE_DEST_MAX 63
+#define MSG_TRACE_TID_MAX  63
+
+struct msg_trace_record {
+    uint64_t at_ns[MSG_STAGE__COUNT]; /* CLOCK_MONOTONIC, 0 if not reached */
+    int msg_type;
+    XAcode code;
+    bool slow;    /* kept for the time it took rather than sampled */
+    bool expired; /* gave up waiting for the next stage */
+    char dest[MSG_TRACE_DEST_MAX + 1];
+    char transaction_uuid[MSG_TRACE_TID_MAX + 1];
+};
+
+struct msg_trace_opts {
+    uint32_t sample_every; /* keep 1 in N, 0 uses the default */
+    uint64_t slow_ms;      /* keep any this slow, 0 uses the default */
+    uint64_t timeout_ms;   /* wait this long for the next stage, 0 uses the default */
+    size_t in_flight;      /* messages followed at once, 0 uses the default */
+    size_t records;        /* kept messages waiting to be read, 0 uses the default */
+};
+
+struct msg_trace;
+
+struct msg_trace_stats {
+    uint64_t followed;  /* messages timed */
+    uint64_t untracked; /* not timed because too many were in flight */
+    uint64_t kept;      /* put in the ring */
+    uint64_t dropped;   /* kept, but the ring was full */
+};
+
+
+/**
+ *  Creates the message tracer.
+ *
+ *  @return the tracer or NULL on failure (XA_INVALID_INPUT or
+ *          XA_OUT_OF_MEMORY)
+ */
+struct msg_trace *msg_trace_create(const struct msg_trace_opts *opts, XAcode *err);
+
+
+/**
+ *  Releases the tracer.  Messages in flight or not yet read are lost.
+ */
+void msg_trace_destroy(struct msg_trace *mt);
+
+
+/**
+ *  Starts following a message that was just received.
+ *
+ *  @return the handle, or -1 if too many are in flight
+ */
+int msg_trace_begin(struct msg_trace *mt);
+
+
+/**
+ *  Notes that the message reached a stage now.
+ */
+void msg_trace_stamp(struct msg_trace *mt, int h, enum msg_stage stage);
+
+
+/**
+ *  Keeps what the message is with it.  The strings don't need to be nul
+ *  terminated and are cut short if too long.
+ */
+void msg_trace_describe(struct msg_trace *mt, int h, int msg_type,
+                        const char *dest, size_t dest_len);
+
+
+/**
+ *  Keeps following the delivered message until its response (with the same
+ *  transaction uuid) is found with msg_trace_find().  Without a transaction
+ *  uuid the message ends here.
+ */
+void msg_trace_await(struct msg_trace *mt, int h, const char *tid, size_t len);
+
+
+/**
+ *  Checks if any message has reached the stage but gone no further, so
+ *  callers can skip the work of looking one up.
+ */
+bool msg_trace_waiting(const struct msg_trace *mt, enum msg_stage stage);
+
+
+/**
+ *  Finds the message with the transaction uuid that has reached the stage
+ *  but gone no further.
+ *
+ *  @return the handle, or -1 if there isn't one
+ */
+int msg_trace_find(const struct msg_trace *mt, enum msg_stage stage,
+                   const char *tid, size_t len);
+
+
+/**
+ *  Notes a message going into the outbound batch, in order, whether or not
+ *  it is being followed (h is -1).  A followed message reaches
+ *  MSG_STAGE__ENCODE.
+ */
+void msg_trace_batched(struct msg_trace *mt, int h);
+
+
+/**
+ *  Notes that count messages (from the front) left the outbound batch.  The
+ *  followed ones among them reach MSG_STAGE__SEND and end.
+ */
+void msg_trace_sent(struct msg_trace *mt, size_t count);
+
+
+/**
+ *  Stops following the message.  It is kept if it was sampled or slow.
+ */
+void msg_trace_end(struct msg_trace *mt, int h, XAcode code);
+
+
+/**
+ *  Ends every message that has waited longer than timeout_ms for its next
+ *  stage.
+ */
+void msg_trace_expire(struct msg_trace *mt);
+
+
+/**
+ *  Takes kept messages out of the ring.  May be called from any one thread.
+ *
+ *  @return the number of records filled in
+ */
+size_t msg_trace_read(struct msg_trace *mt, struct msg_trace_record *out,
+                      size_t max);
+
+
+/**
+ *  Reads every kept message and adds it to the tracer as spans.
+ */
+void msg_trace_export(struct msg_trace *mt, struct trace *t);
+
+
+/**
+ *  Gets the counts so far.
+ */
+void msg_trace_stats(const struct msg_trace *mt, struct msg_trace_stats *stats);
+
+#endif
@@ -0,0 +1,531 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Needed for clock_gettime() */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json_out.h"
+#include "trace.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_SERVICE     "xmidt-agent"
+#define DEFAULT_MAX_SPANS   256
+#define DEFAULT_BATCH_SPANS 64
+
+#define ATTRS_MAX 16
+#define STRS_MAX  384 /* room for the copied strings of one span */
+#define NO_STR    ((size_t) -1)
+#define NS_PER_S  1000000000ull
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+enum attr_type {
+    ATTR__STR = 0,
+    ATTR__INT,
+    ATTR__DOUBLE,
+};
+
+struct attr {
+    const char *key;
+    enum attr_type type;
+    union {
+        size_t str; /* offset into strs */
+        int64_t i;
+        double d;
+    } v;
+};
+
+enum span_state {
+    SPAN__FREE = 0,
+    SPAN__OPEN,
+    SPAN__ENDED,
+};
+
+struct trace_span {
+    struct trace *t;
+    enum span_state state;
+
+    uint64_t trace_hi;
+    uint64_t trace_lo;
+    uint64_t id;
+    uint64_t parent; /* 0 for a root */
+
+    const char *name;
+    enum trace_kind kind;
+    uint64_t start_ns;
+    uint64_t end_ns;
+
+    bool failed;
+    size_t message; /* offset into strs */
+
+    size_t attr_count;
+    struct attr attrs[ATTRS_MAX];
+
+    size_t strs_used;
+    char strs[STRS_MAX];
+};
+
+struct trace {
+    struct trace_opts opts;
+    char *service;
+
+    struct trace_span *spans;
+    struct trace_span **free_list;
+    size_t free_count;
+    size_t ended;
+    uint64_t dropped;
+
+    uint64_t rng;
+    int64_t realtime_offset_ns;
+
+    struct json_out out;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_S + (uint64_t) ts.tv_nsec;
+}
+
+
+/* Monotonic, so durations are right, but on the real time scale. */
+static uint64_t to_real_ns(const struct trace *t, uint64_t mono_ns)
+{
+    return mono_ns + (uint64_t) t->realtime_offset_ns;
+}
+
+
+static uint64_t now_ns(const struct trace *t)
+{
+    return to_real_ns(t, clock_ns(CLOCK_MONOTONIC));
+}
+
+
+static uint64_t seed(void)
+{
+    uint64_t s = 0;
+    FILE *f    = fopen("/dev/urandom", "rb");
+
+    if (f) {
+        if (1 != fread(&s, sizeof(s), 1, f)) {
+            s = 0;
+        }
+        fclose(f);
+    }
+    if (!s) {
+        s = clock_ns(CLOCK_REALTIME) ^ ((uint64_t) getpid() << 32);
+    }
+
+    return s;
+}
+
+
+/* splitmix64; ids only need to be unique, not secret. */
+static uint64_t next_id(struct trace *t)
+{
+    uint64_t z = (t->rng += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z = z ^ (z >> 31);
+
+    /* An all zero id is invalid. */
+    return (z) ? z : 1;
+}
+
+
+static struct trace_span *span_new(struct trace *t, const char *name,
+                                   enum trace_kind kind)
+{
+    struct trace_span *s;
+
+    if (!t->free_count) {
+        t->dropped++;
+        return NULL;
+    }
+
+    s = t->free_list[--t->free_count];
+    memset(s, 0, sizeof(*s));
+    s->t        = t;
+    s->state    = SPAN__OPEN;
+    s->id       = next_id(t);
+    s->name     = name;
+    s->kind     = kind;
+    s->message  = NO_STR;
+    s->start_ns = now_ns(t);
+
+    return s;
+}
+
+
+static void span_free(struct trace_span *s)
+{
+    s->state                            = SPAN__FREE;
+    s->t->free_list[s->t->free_count++] = s;
+}
+
+
+/**
+ *  Copies a string into the span, cut short if there isn't room.
+ *
+ *  @return the offset, or NO_STR if there is no room at all
+ */
+static size_t keep_str(struct trace_span *s, const char *val)
+{
+    size_t len;
+    size_t at = s->strs_used;
+
+    if (!val || (STRS_MAX - 1 <= at)) {
+        return NO_STR;
+    }
+
+    len = strlen(val);
+    if (STRS_MAX - 1 - at < len) {
+        len = STRS_MAX - 1 - at;
+    }
+    memcpy(&s->strs[at], val, len);
+    s->strs[at + len] = '\0';
+    s->strs_used += len + 1;
+
+    return at;
+}
+
+
+static struct attr *add_attr(struct trace_span *s, const char *key,
+                             enum attr_type type)
+{
+    struct attr *a;
+
+    if (!s || !key || (SPAN__OPEN != s->state) || (ATTRS_MAX <= s->attr_count)) {
+        return NULL;
+    }
+
+    a       = &s->attrs[s->attr_count++];
+    a->key  = key;
+    a->type = type;
+
+    return a;
+}
+
+
+/*---------------------------------- OTLP/JSON --------------------------------*/
+
+static void out_attr(struct json_out *o, const struct trace_span *s,
+                     const struct attr *a)
+{
+    JSON_OUT_LIT(o, "{\"key\":");
+    json_out_str(o, a->key);
+
+    switch (a->type) {
+        case ATTR__STR:
+            JSON_OUT_LIT(o, ",\"value\":{\"stringValue\":");
+            json_out_str(o, (NO_STR == a->v.str) ? "" : &s->strs[a->v.str]);
+            break;
+        case ATTR__INT:
+            /* 64 bit integers are strings in OTLP/JSON. */
+            json_out_fmt(o, ",\"value\":{\"intValue\":\"%lld\"", (long long) a->v.i);
+            break;
+        default:
+            /* Only finite values are JSON numbers; the rest are strings. */
+            if (0.0 == a->v.d - a->v.d) {
+                json_out_fmt(o, ",\"value\":{\"doubleValue\":%.9g", a->v.d);
+            } else {
+                json_out_fmt(o, ",\"value\":{\"doubleValue\":\"%s\"",
+                        (a->v.d != a->v.d) ? "NaN" : (0 < a->v.d) ? "Infinity" : "-Infinity");
+            }
+            break;
+    }
+    JSON_OUT_LIT(o, "}}");
+}
+
+
+static void out_span(struct json_out *o, const struct trace_span *s)
+{
+    json_out_fmt(o, "{\"traceId\":\"%016llx%016llx\",\"spanId\":\"%016llx\"",
+            (unsigned long long) s->trace_hi, (unsigned long long) s->trace_lo,
+            (unsigned long long) s->id);
+    if (s->parent) {
+        json_out_fmt(o, ",\"parentSpanId\":\"%016llx\"", (unsigned long long) s->parent);
+    }
+    JSON_OUT_LIT(o, ",\"name\":");
+    json_out_str(o, s->name);
+    json_out_fmt(o, ",\"kind\":%d,\"startTimeUnixNano\":\"%llu\",\"endTimeUnixNano\":\"%llu\"",
+            (int) s->kind, (unsigned long long) s->start_ns,
+            (unsigned long long) s->end_ns);
+
+    JSON_OUT_LIT(o, ",\"attributes\":[");
+    for (size_t i = 0; i < s->attr_count; i++) {
+        if (i) {
+            JSON_OUT_LIT(o, ",");
+        }
+        out_attr(o, s, &s->attrs[i]);
+    }
+    JSON_OUT_LIT(o, "]");
+
+    if (s->failed) {
+        JSON_OUT_LIT(o, ",\"status\":{\"code\":2,\"message\":");
+        json_out_str(o, (NO_STR == s->message) ? "" : &s->strs[s->message]);
+        JSON_OUT_LIT(o, "}");
+    }
+    JSON_OUT_LIT(o, "}");
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct trace *trace_create(const struct trace_opts *opts, XAcode *err)
+{
+    struct trace *t;
+    const char *service;
+
+    if (!opts || !opts->export) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    t = calloc(1, sizeof(struct trace));
+    if (!t) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    t->opts = *opts;
+    if (!t->opts.max_spans) {
+        t->opts.max_spans = DEFAULT_MAX_SPANS;
+    }
+    if (!t->opts.batch_spans || (t->opts.max_spans < t->opts.batch_spans)) {
+        t->opts.batch_spans = (DEFAULT_BATCH_SPANS < t->opts.max_spans)
+                                  ? DEFAULT_BATCH_SPANS
+                                  : t->opts.max_spans;
+    }
+
+    service      = (opts->service) ? opts->service : DEFAULT_SERVICE;
+    t->service   = malloc(strlen(service) + 1);
+    t->spans     = calloc(t->opts.max_spans, sizeof(struct trace_span));
+    t->free_list = calloc(t->opts.max_spans, sizeof(struct trace_span *));
+    if (!t->service || !t->spans || !t->free_list) {
+        free(t->free_list);
+        free(t->spans);
+        free(t->service);
+        free(t);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    strcpy(t->service, service);
+    t->opts.service = t->service;
+
+    /* Handed out from the front first. */
+    for (size_t i = 0; i < t->opts.max_spans; i++) {
+        t->free_list[i] = &t->spans[t->opts.max_spans - 1 - i];
+    }
+    t->free_count = t->opts.max_spans;
+
+    t->rng                = seed();
+    t->realtime_offset_ns = (int64_t) (clock_ns(CLOCK_REALTIME) - clock_ns(CLOCK_MONOTONIC));
+
+    return t;
+}
+
+
+void trace_destroy(struct trace *t)
+{
+    if (t) {
+        trace_flush(t);
+        free(t->out.buf);
+        free(t->free_list);
+        free(t->spans);
+        free(t->service);
+        free(t);
+    }
+}
+
+
+struct trace_span *trace_span_root(struct trace *t, const char *name,
+                                   enum trace_kind kind)
+{
+    struct trace_span *s;
+
+    if (!t || !name) {
+        return NULL;
+    }
+
+    s = span_new(t, name, kind);
+    if (s) {
+        s->trace_hi = next_id(t);
+        s->trace_lo = next_id(t);
+    }
+
+    return s;
+}
+
+
+struct trace_span *trace_span_child(const struct trace_span *parent,
+                                    const char *name, enum trace_kind kind)
+{
+    struct trace_span *s;
+
+    if (!parent || !name || (SPAN__FREE == parent->state)) {
+        return NULL;
+    }
+
+    s = span_new(parent->t, name, kind);
+    if (s) {
+        s->trace_hi = parent->trace_hi;
+        s->trace_lo = parent->trace_lo;
+        s->parent   = parent->id;
+    }
+
+    return s;
+}
+
+
+void trace_span_str(struct trace_span *s, const char *key, const char *val)
+{
+    struct attr *a = add_attr(s, key, ATTR__STR);
+
+    if (a) {
+        a->v.str = keep_str(s, val);
+    }
+}
+
+
+void trace_span_int(struct trace_span *s, const char *key, int64_t val)
+{
+    struct attr *a = add_attr(s, key, ATTR__INT);
+
+    if (a) {
+        a->v.i = val;
+    }
+}
+
+
+void trace_span_double(struct trace_span *s, const char *key, double val)
+{
+    struct attr *a = add_attr(s, key, ATTR__DOUBLE);
+
+    if (a) {
+        a->v.d = val;
+    }
+}
+
+
+void trace_span_error(struct trace_span *s, XAcode code, const char *message)
+{
+    if (!s || (SPAN__OPEN != s->state)) {
+        return;
+    }
+
+    if (!s->failed) {
+        s->failed  = true;
+        s->message = keep_str(s, message);
+    }
+    if (XA_OK != code) {
+        trace_span_int(s, "xa.code", (int64_t) code);
+    }
+}
+
+
+void trace_span_end(struct trace_span *s)
+{
+    if (s) {
+        trace_span_end_at(s, clock_ns(CLOCK_MONOTONIC));
+    }
+}
+
+
+void trace_span_start_at(struct trace_span *s, uint64_t mono_ns)
+{
+    if (s && (SPAN__OPEN == s->state)) {
+        s->start_ns = to_real_ns(s->t, mono_ns);
+    }
+}
+
+
+void trace_span_end_at(struct trace_span *s, uint64_t mono_ns)
+{
+    struct trace *t;
+
+    if (!s || (SPAN__OPEN != s->state)) {
+        return;
+    }
+
+    t         = s->t;
+    s->end_ns = to_real_ns(t, mono_ns);
+    s->state  = SPAN__ENDED;
+    t->ended++;
+
+    if (t->opts.batch_spans <= t->ended) {
+        trace_flush(t);
+    }
+}
+
+
+void trace_flush(struct trace *t)
+{
+    struct json_out *o;
+    bool first = true;
+
+    if (!t || !t->ended) {
+        return;
+    }
+
+    o         = &t->out;
+    o->len    = 0;
+    o->failed = false;
+
+    JSON_OUT_LIT(o, "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\","
+               "\"value\":{\"stringValue\":");
+    json_out_str(o, t->service);
+    JSON_OUT_LIT(o, "}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"xmidt-agent\"},\"spans\":[");
+
+    for (size_t i = 0; i < t->opts.max_spans; i++) {
+        struct trace_span *s = &t->spans[i];
+
+        if (SPAN__ENDED == s->state) {
+            if (!first) {
+                JSON_OUT_LIT(o, ",");
+            }
+            first = false;
+            out_span(o, s);
+            span_free(s);
+        }
+    }
+    JSON_OUT_LIT(o, "]}]}]}");
+    t->ended = 0;
+
+    if (!o->failed) {
+        t->opts.export(t->opts.user, o->buf, o->len);
+    }
+}
+
+
+uint64_t trace_dropped(const struct trace *t)
+{
+    return (t) ? t->dropped : 0;
+}
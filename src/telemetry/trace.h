@@ -0,0 +1,121 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __TELEMETRY_TRACE_H__
+#define __TELEMETRY_TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+
+/* Spans in the OpenTelemetry model, exported in batches as OTLP/JSON (one
+ * ExportTraceServiceRequest per batch), which a collector can read from a
+ * file or receive over HTTP.
+ *
+ * Spans come from a fixed pool in the tracer, so starting one never
+ * allocates; when the pool is used up the span is dropped and counted.
+ * Every function accepts a NULL tracer or span and does nothing, so code can
+ * be instrumented whether or not tracing is turned on.  A child of a dropped
+ * span is dropped too, rather than becoming a trace of its own.
+ *
+ * Span names and attribute keys must be string literals; string values are
+ * copied.  The tracer isn't thread safe; it belongs to the event loop
+ * thread. */
+
+enum trace_kind {
+    TRACE_KIND__INTERNAL = 1,
+    TRACE_KIND__SERVER   = 2,
+    TRACE_KIND__CLIENT   = 3,
+};
+
+struct trace;
+struct trace_span;
+
+/**
+ *  Takes one batch.  The JSON is only valid for the duration of the call.
+ */
+typedef void (*trace_export_fn)(void *user, const char *json, size_t len);
+
+struct trace_opts {
+    const char *service; /* service.name, NULL for "xmidt-agent" */
+    size_t max_spans;    /* open or waiting to be exported, 0 uses the default */
+    size_t batch_spans;  /* export once this many have ended, 0 uses the default */
+
+    trace_export_fn export;
+    void *user;
+};
+
+
+/**
+ *  Creates the tracer.
+ *
+ *  @return the tracer or NULL on failure (XA_INVALID_INPUT or
+ *          XA_OUT_OF_MEMORY)
+ */
+struct trace *trace_create(const struct trace_opts *opts, XAcode *err);
+
+
+/**
+ *  Exports the spans that have ended and releases the tracer.  Spans still
+ *  open are lost.
+ */
+void trace_destroy(struct trace *t);
+
+
+/**
+ *  Starts a span in a new trace.
+ *
+ *  @return the span, or NULL if the pool is used up
+ */
+struct trace_span *trace_span_root(struct trace *t, const char *name,
+                                   enum trace_kind kind);
+
+
+/**
+ *  Starts a span under another one.  The parent may end first.
+ *
+ *  @return the span, or NULL if parent is NULL or the pool is used up
+ */
+struct trace_span *trace_span_child(const struct trace_span *parent,
+                                    const char *name, enum trace_kind kind);
+
+
+void trace_span_str(struct trace_span *s, const char *key, const char *val);
+void trace_span_int(struct trace_span *s, const char *key, int64_t val);
+void trace_span_double(struct trace_span *s, const char *key, double val);
+
+
+/**
+ *  Marks the span as failed, with the code as the xa.code attribute.
+ */
+void trace_span_error(struct trace_span *s, XAcode code, const char *message);
+
+
+/**
+ *  Ends the span; it may not be used after this.  Exports a batch if
+ *  enough spans have ended.
+ */
+void trace_span_end(struct trace_span *s);
+
+
+/**
+ *  The same as starting or ending the span at an earlier CLOCK_MONOTONIC
+ *  time, for work that was timed before it was known to be worth a span.
+ */
+void trace_span_start_at(struct trace_span *s, uint64_t mono_ns);
+void trace_span_end_at(struct trace_span *s, uint64_t mono_ns);
+
+
+/**
+ *  Exports every span that has ended.
+ */
+void trace_flush(struct trace *t);
+
+
+/**
+ *  Gets the number of spans dropped because the pool was used up.
+ */
+uint64_t trace_dropped(const struct trace *t);
+
+#endif
@@ -0,0 +1,467 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "deflate.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define EXTENSION_NAME "permessage-deflate"
+#define MIN_OUT_SIZE   256
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct deflate_ctx {
+    struct deflate_params params;
+
+    z_stream tx;
+    z_stream rx;
+
+    uint8_t *out;
+    size_t out_size;
+};
+
+struct token {
+    const char *s;
+    size_t len;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* Every compressed message ends with an empty stored block that is removed
+ * before sending and put back before decompressing. */
+static const uint8_t tail[4] = { 0x00, 0x00, 0xff, 0xff };
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static int window_bits(int bits)
+{
+    if (bits < DEFLATE_MIN_WINDOW_BITS || DEFLATE_MAX_WINDOW_BITS < bits) {
+        return DEFLATE_MAX_WINDOW_BITS;
+    }
+    return bits;
+}
+
+
+static struct token trim(const char *s, size_t len)
+{
+    struct token t = { .s = s, .len = len };
+
+    while (t.len && isspace((unsigned char) t.s[0])) {
+        t.s++;
+        t.len--;
+    }
+    while (t.len && isspace((unsigned char) t.s[t.len - 1])) {
+        t.len--;
+    }
+
+    return t;
+}
+
+
+static bool token_is(const struct token *t, const char *s)
+{
+    return (strlen(s) == t->len) && (0 == memcmp(t->s, s, t->len));
+}
+
+
+/* Finds the next delimited token starting at *s, advancing *s past it. */
+static bool next_token(const char **s, const char *end, char delim,
+                       struct token *t)
+{
+    const char *p = *s;
+
+    if (end <= p) {
+        return false;
+    }
+
+    while (p < end && *p != delim) {
+        p++;
+    }
+
+    *t = trim(*s, (size_t) (p - *s));
+    *s = (p < end) ? p + 1 : end;
+
+    return true;
+}
+
+
+/* Parses "8" through "15", optionally quoted. */
+static int parse_bits(const struct token *value)
+{
+    struct token v = *value;
+    int bits       = 0;
+
+    if ((2 <= v.len) && ('"' == v.s[0]) && ('"' == v.s[v.len - 1])) {
+        v.s++;
+        v.len -= 2;
+    }
+
+    if (!v.len || 2 < v.len) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < v.len; i++) {
+        if (!isdigit((unsigned char) v.s[i])) {
+            return -1;
+        }
+        bits = bits * 10 + (v.s[i] - '0');
+    }
+
+    return (8 <= bits && bits <= DEFLATE_MAX_WINDOW_BITS) ? bits : -1;
+}
+
+
+/* Applies the parameters of one permessage-deflate element. */
+static XAcode parse_element(const struct deflate_params *want, const char *s,
+                            const char *end, struct deflate_params *got)
+{
+    unsigned seen = 0;
+    struct token param;
+
+    while (next_token(&s, end, ';', &param)) {
+        const char *p = param.s;
+        struct token name;
+        struct token value = { .s = NULL, .len = 0 };
+        unsigned bit       = 0;
+        int bits;
+
+        next_token(&p, param.s + param.len, '=', &name);
+        if (p < param.s + param.len) {
+            value = trim(p, (size_t) (param.s + param.len - p));
+        }
+
+        if (token_is(&name, "server_no_context_takeover") && !value.s) {
+            bit                             = 1;
+            got->server_no_context_takeover = true;
+        } else if (token_is(&name, "client_no_context_takeover") && !value.s) {
+            bit                             = 2;
+            got->client_no_context_takeover = true;
+        } else if (token_is(&name, "server_max_window_bits") && value.s) {
+            bit  = 4;
+            bits = parse_bits(&value);
+            if (bits < 0 || window_bits(want->server_max_window_bits) < bits) {
+                return XA_WEBSOCKET_ERROR;
+            }
+            got->server_max_window_bits = bits;
+        } else if (token_is(&name, "client_max_window_bits") && value.s) {
+            bit  = 8;
+            bits = parse_bits(&value);
+
+            /* zlib can't compress with an 8 bit window. */
+            if (bits < DEFLATE_MIN_WINDOW_BITS
+                || window_bits(want->client_max_window_bits) < bits)
+            {
+                return XA_WEBSOCKET_ERROR;
+            }
+            got->client_max_window_bits = bits;
+        } else {
+            return XA_WEBSOCKET_ERROR;
+        }
+
+        if (seen & bit) {
+            return XA_WEBSOCKET_ERROR;
+        }
+        seen |= bit;
+    }
+
+    return XA_OK;
+}
+
+
+static bool grow(struct deflate_ctx *ctx, size_t want)
+{
+    size_t size = (ctx->out_size) ? ctx->out_size : MIN_OUT_SIZE;
+    uint8_t *p;
+
+    while (size < want) {
+        size *= 2;
+    }
+
+    if (size == ctx->out_size) {
+        return true;
+    }
+
+    p = realloc(ctx->out, size);
+    if (!p) {
+        return false;
+    }
+    ctx->out      = p;
+    ctx->out_size = size;
+
+    return true;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+size_t deflate_offer(const struct deflate_params *want, char *buf, size_t len)
+{
+    int rv;
+
+    if (!want) {
+        return 0;
+    }
+
+    rv = snprintf(buf, len,
+                  "Sec-WebSocket-Extensions: " EXTENSION_NAME
+                  "; client_max_window_bits=%d; server_max_window_bits=%d%s%s",
+                  window_bits(want->client_max_window_bits),
+                  window_bits(want->server_max_window_bits),
+                  (want->client_no_context_takeover) ? "; client_no_context_takeover" : "",
+                  (want->server_no_context_takeover) ? "; server_no_context_takeover" : "");
+
+    return (rv < 0) ? 0 : (size_t) rv;
+}
+
+
+XAcode deflate_accept(const struct deflate_params *want, const char *response,
+                      struct deflate_params *got, XAcode *err)
+{
+    const char *s;
+    const char *end;
+    struct token element;
+
+    if (!want || !got) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    memset(got, 0, sizeof(struct deflate_params));
+    got->client_max_window_bits     = window_bits(want->client_max_window_bits);
+    got->server_max_window_bits     = DEFLATE_MAX_WINDOW_BITS;
+    got->client_no_context_takeover = want->client_no_context_takeover;
+
+    if (!response) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    s   = response;
+    end = response + strlen(response);
+
+    while (next_token(&s, end, ',', &element)) {
+        const char *p = element.s;
+        struct token name;
+
+        next_token(&p, element.s + element.len, ';', &name);
+        if (token_is(&name, EXTENSION_NAME)) {
+            XAcode rv = parse_element(want, p, element.s + element.len, got);
+
+            /* Our own choice not to take over stands regardless. */
+            got->client_no_context_takeover |= want->client_no_context_takeover;
+
+            return xa_set_error(err, rv);
+        }
+    }
+
+    return xa_set_error(err, XA_INVALID_INPUT);
+}
+
+
+struct deflate_ctx *deflate_ctx_create(const struct deflate_params *params,
+                                       int level, XAcode *err)
+{
+    struct deflate_ctx *ctx;
+    int rx_bits;
+
+    if (!params || level < -1 || 9 < level) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    ctx = calloc(1, sizeof(struct deflate_ctx));
+    if (!ctx) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    ctx->params = *params;
+
+    /* Negative bits select a raw deflate stream without a zlib header.  An 8
+     * bit window from the server fits in the smallest window zlib offers. */
+    rx_bits = params->server_max_window_bits;
+    if (rx_bits < DEFLATE_MIN_WINDOW_BITS || DEFLATE_MAX_WINDOW_BITS < rx_bits) {
+        rx_bits = (8 == rx_bits) ? DEFLATE_MIN_WINDOW_BITS : DEFLATE_MAX_WINDOW_BITS;
+    }
+
+    if (Z_OK != deflateInit2(&ctx->tx, level, Z_DEFLATED,
+                             -window_bits(params->client_max_window_bits), 8,
+                             Z_DEFAULT_STRATEGY))
+    {
+        free(ctx);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    if (Z_OK != inflateInit2(&ctx->rx, -rx_bits)) {
+        deflateEnd(&ctx->tx);
+        free(ctx);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    if (!grow(ctx, MIN_OUT_SIZE)) {
+        deflate_ctx_destroy(ctx);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+
+void deflate_ctx_destroy(struct deflate_ctx *ctx)
+{
+    if (ctx) {
+        deflateEnd(&ctx->tx);
+        inflateEnd(&ctx->rx);
+        free(ctx->out);
+        free(ctx);
+    }
+}
+
+
+XAcode deflate_compress(struct deflate_ctx *ctx, const void *buf, size_t len,
+                        const void **out, size_t *out_len, XAcode *err)
+{
+    size_t used = 0;
+    int rv;
+
+    if (!ctx || (!buf && len) || !out || !out_len || UINT_MAX < len) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (!grow(ctx, deflateBound(&ctx->tx, (uLong) len) + 16)) {
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+
+    ctx->tx.next_in  = (Bytef *) buf;
+    ctx->tx.avail_in = (uInt) len;
+
+    do {
+        if (used == ctx->out_size && !grow(ctx, ctx->out_size * 2)) {
+            deflateReset(&ctx->tx);
+            return xa_set_error(err, XA_OUT_OF_MEMORY);
+        }
+
+        ctx->tx.next_out  = ctx->out + used;
+        ctx->tx.avail_out = (uInt) (ctx->out_size - used);
+
+        rv   = deflate(&ctx->tx, Z_SYNC_FLUSH);
+        used = ctx->out_size - ctx->tx.avail_out;
+        if (Z_OK != rv && Z_BUF_ERROR != rv) {
+            deflateReset(&ctx->tx);
+            return xa_set_error(err, XA_INVALID_INPUT);
+        }
+
+        /* The flush is complete once zlib stops filling the buffer. */
+    } while (0 == ctx->tx.avail_out);
+
+    if (4 <= used && 0 == memcmp(&ctx->out[used - 4], tail, sizeof(tail))) {
+        used -= 4;
+    }
+
+    /* An empty message is sent as an empty stored block (RFC 7692 7.2.3.6). */
+    if (0 == used) {
+        ctx->out[used++] = 0x00;
+    }
+
+    if (ctx->params.client_no_context_takeover) {
+        deflateReset(&ctx->tx);
+    }
+
+    *out     = ctx->out;
+    *out_len = used;
+
+    return XA_OK;
+}
+
+
+XAcode deflate_decompress(struct deflate_ctx *ctx, const void *buf, size_t len,
+                          size_t max_len, const void **out, size_t *out_len,
+                          XAcode *err)
+{
+    size_t used  = 0;
+    bool in_tail = false;
+    bool done    = false;
+    XAcode code  = XA_OK;
+
+    if (!ctx || (!buf && len) || !out || !out_len || UINT_MAX < len) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    ctx->rx.next_in  = (Bytef *) buf;
+    ctx->rx.avail_in = (uInt) len;
+
+    while (!done) {
+        int rv;
+
+        if (0 == ctx->rx.avail_in && !in_tail) {
+            ctx->rx.next_in  = (Bytef *) tail;
+            ctx->rx.avail_in = sizeof(tail);
+            in_tail          = true;
+        }
+
+        if (used == ctx->out_size) {
+            if (max_len < used) {
+                code = XA_INSUFFICIENT_RESOURCES;
+                break;
+            }
+            if (!grow(ctx, ctx->out_size * 2)) {
+                code = XA_OUT_OF_MEMORY;
+                break;
+            }
+        }
+
+        ctx->rx.next_out  = ctx->out + used;
+        ctx->rx.avail_out = (uInt) (ctx->out_size - used);
+
+        rv   = inflate(&ctx->rx, Z_SYNC_FLUSH);
+        used = ctx->out_size - ctx->rx.avail_out;
+
+        if (Z_STREAM_END == rv) {
+            /* The sender ended the stream; the next message starts anew. */
+            inflateReset(&ctx->rx);
+            done = true;
+        } else if (Z_OK == rv || Z_BUF_ERROR == rv) {
+            done = in_tail && (0 == ctx->rx.avail_in) && (0 != ctx->rx.avail_out);
+        } else {
+            code = XA_INVALID_INPUT;
+            break;
+        }
+    }
+
+    if (XA_OK == code && max_len < used) {
+        code = XA_INSUFFICIENT_RESOURCES;
+    }
+
+    if (XA_OK != code || ctx->params.server_no_context_takeover) {
+        inflateReset(&ctx->rx);
+    }
+
+    if (XA_OK != code) {
+        return xa_set_error(err, code);
+    }
+
+    *out     = ctx->out;
+    *out_len = used;
+
+    return XA_OK;
+}
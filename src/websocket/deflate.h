@@ -0,0 +1,108 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __WEBSOCKET_DEFLATE_H__
+#define __WEBSOCKET_DEFLATE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../error/codes.h"
+
+/* The permessage-deflate websocket extension (RFC 7692).
+ *
+ * Our upstream traffic is msgpack with the same keys, the same source and
+ * similar payloads over and over, so most of the win comes from context
+ * takeover: the LZ77 window is kept between messages and acts as a shared
+ * dictionary that later messages refer back to.  Turning context takeover
+ * off trades that away for a fresh compressor per message (and no memory
+ * held between messages).
+ *
+ * The window bits bound the memory each side holds for the context:
+ * roughly 2^(bits + 2) bytes for the compressor and 2^bits bytes for the
+ * decompressor. */
+
+#define DEFLATE_MIN_WINDOW_BITS 9
+#define DEFLATE_MAX_WINDOW_BITS 15
+
+struct deflate_params {
+    /* Applies to the messages we send. */
+    int client_max_window_bits;       /* 0 means 15 */
+    bool client_no_context_takeover;
+
+    /* Applies to the messages we receive. */
+    int server_max_window_bits;       /* 0 means 15 */
+    bool server_no_context_takeover;
+};
+
+struct deflate_ctx;
+
+
+/**
+ *  Writes the Sec-WebSocket-Extensions header offering the extension with
+ *  the given parameters.
+ *
+ *  @return the length of the header (excluding the trailing '\0'), a value
+ *          >= len means the buffer was too small
+ */
+size_t deflate_offer(const struct deflate_params *want, char *buf, size_t len);
+
+
+/**
+ *  Checks the Sec-WebSocket-Extensions value the server answered with
+ *  against what was offered and fills in the parameters to use.
+ *
+ *  @param want     the parameters that were offered
+ *  @param response the header value (without the header name)
+ *  @param got      the parameters to use for the connection
+ *
+ *  @return XA_OK if the extension is in use, XA_INVALID_INPUT if the server
+ *          did not accept it (the connection must then be uncompressed), or
+ *          XA_WEBSOCKET_ERROR if the answer violates the offer
+ */
+XAcode deflate_accept(const struct deflate_params *want, const char *response,
+                      struct deflate_params *got, XAcode *err);
+
+
+/**
+ *  Creates the compression and decompression contexts for one connection.
+ *
+ *  @param level the zlib compression level (0-9), or -1 for the default
+ */
+struct deflate_ctx *deflate_ctx_create(const struct deflate_params *params,
+                                       int level, XAcode *err);
+
+
+/**
+ *  Releases the contexts.
+ */
+void deflate_ctx_destroy(struct deflate_ctx *ctx);
+
+
+/**
+ *  Compresses one message payload.
+ *
+ *  @param out     set to the compressed payload, valid until the next call
+ *  @param out_len set to the length of the compressed payload
+ *
+ *  @return XA_OK on success, XA_OUT_OF_MEMORY or XA_INVALID_INPUT otherwise
+ */
+XAcode deflate_compress(struct deflate_ctx *ctx, const void *buf, size_t len,
+                        const void **out, size_t *out_len, XAcode *err);
+
+
+/**
+ *  Decompresses one message payload that had RSV1 set.
+ *
+ *  @param max_len the largest message that will be accepted
+ *  @param out     set to the message, valid until the next call
+ *  @param out_len set to the length of the message
+ *
+ *  @return XA_OK on success, XA_INSUFFICIENT_RESOURCES if the message is
+ *          larger than max_len, XA_INVALID_INPUT if it is corrupt
+ */
+XAcode deflate_decompress(struct deflate_ctx *ctx, const void *buf, size_t len,
+                          size_t max_len, const void **out, size_t *out_len,
+                          XAcode *err);
+
+#endif
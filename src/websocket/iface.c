@@ -0,0 +1,136 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iface.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define FIRST_PENALTY_MS 1000
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static int by_cost(const void *a, const void *b)
+{
+    const struct iface_health *x = (const struct iface_health *) a;
+    const struct iface_health *y = (const struct iface_health *) b;
+
+    if (x->cost != y->cost) {
+        return (x->cost < y->cost) ? -1 : 1;
+    }
+
+    /* Keep the order stable between runs for equal costs. */
+    if (!x->name || !y->name) {
+        return (x->name ? 1 : 0) - (y->name ? 1 : 0);
+    }
+    return strcmp(x->name, y->name);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+XAcode iface_set_init(struct iface_set *s, const struct interface *ifaces,
+                      size_t count, XAcode *err)
+{
+    size_t n = (0 < count) ? count : 1;
+
+    memset(s, 0, sizeof(struct iface_set));
+
+    s->list = calloc(n, sizeof(struct iface_health));
+    if (!s->list) {
+        return xa_set_error(err, XA_OUT_OF_MEMORY);
+    }
+    s->count = n;
+
+    for (size_t i = 0; i < count; i++) {
+        s->list[i].name = ifaces[i].name.s;
+        s->list[i].cost = ifaces[i].cost;
+    }
+
+    if (1 < count) {
+        qsort(s->list, count, sizeof(struct iface_health), by_cost);
+    }
+
+    return XA_OK;
+}
+
+
+void iface_set_destroy(struct iface_set *s)
+{
+    if (s) {
+        free(s->list);
+        s->list  = NULL;
+        s->count = 0;
+    }
+}
+
+
+struct iface_health *iface_set_pick(struct iface_set *s, uint64_t now_ms)
+{
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->list[i].retry_at_ms <= now_ms) {
+            return &s->list[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+uint64_t iface_set_next_retry(const struct iface_set *s)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->list[i].retry_at_ms < next) {
+            next = s->list[i].retry_at_ms;
+        }
+    }
+
+    return next;
+}
+
+
+void iface_mark_failure(struct iface_health *h, uint64_t now_ms,
+                        uint64_t backoff_max_ms)
+{
+    uint64_t penalty = FIRST_PENALTY_MS;
+
+    for (unsigned i = 0; (i < h->failures) && (penalty < backoff_max_ms); i++) {
+        penalty *= 2;
+    }
+    if (backoff_max_ms < penalty) {
+        penalty = backoff_max_ms;
+    }
+
+    h->failures++;
+    h->retry_at_ms = now_ms + penalty;
+}
+
+
+void iface_mark_success(struct iface_health *h)
+{
+    h->failures    = 0;
+    h->retry_at_ms = 0;
+    h->connects++;
+}
@@ -0,0 +1,77 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __WEBSOCKET_IFACE_H__
+#define __WEBSOCKET_IFACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../config/config.h"
+#include "../error/codes.h"
+
+/* Tracks the health of each network interface the websocket may use so the
+ * connection manager can always pick the cheapest one that is believed to
+ * work.  A failure only penalizes the interface it happened on, so failing
+ * over to the next interface is immediate. */
+
+struct iface_health {
+    const char *name; /* NULL means let the OS pick the route. */
+    int cost;
+
+    unsigned failures;    /* consecutive failures */
+    uint64_t retry_at_ms; /* not eligible until this monotonic time */
+    uint64_t connects;    /* successful connections */
+};
+
+struct iface_set {
+    size_t count;
+    struct iface_health *list; /* sorted by cost, cheapest first */
+};
+
+
+/**
+ *  Builds the set from the configured interfaces.  The names are borrowed
+ *  from the config and must outlive the set.  If no interfaces are configured
+ *  a single default route entry is used.
+ *
+ *  @return XA_OK on success, XA_OUT_OF_MEMORY otherwise
+ */
+XAcode iface_set_init(struct iface_set *s, const struct interface *ifaces,
+                      size_t count, XAcode *err);
+
+
+/**
+ *  Releases the resources held by the set.
+ */
+void iface_set_destroy(struct iface_set *s);
+
+
+/**
+ *  Picks the cheapest interface that is eligible at now_ms.
+ *
+ *  @return the interface or NULL if all of them are backing off
+ */
+struct iface_health *iface_set_pick(struct iface_set *s, uint64_t now_ms);
+
+
+/**
+ *  Returns the earliest time any interface becomes eligible again.
+ */
+uint64_t iface_set_next_retry(const struct iface_set *s);
+
+
+/**
+ *  Records a failed (or lost) connection on the interface.  The interface is
+ *  skipped for an exponentially growing period capped at backoff_max_ms.
+ */
+void iface_mark_failure(struct iface_health *h, uint64_t now_ms,
+                        uint64_t backoff_max_ms);
+
+
+/**
+ *  Records a successful connection on the interface.
+ */
+void iface_mark_success(struct iface_health *h);
+
+#endif
@@ -0,0 +1,79 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include "keepalive.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void on_expire(struct wheel_timer *t, void *user)
+{
+    struct keepalive *ka = (struct keepalive *) user;
+    uint64_t now         = timer_wheel_now(ka->wheel);
+    uint64_t deadline    = ka->last_seen + ka->timeout;
+
+    if (now < deadline) {
+        wheel_timer_set(ka->wheel, t, deadline - now);
+        return;
+    }
+
+    ka->on_dead(ka->user);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+void keepalive_init(struct keepalive *ka, struct timer_wheel *wheel,
+                    uint64_t timeout_ms, void (*on_dead)(void *user),
+                    void *user)
+{
+    uint64_t tick_ms = timer_wheel_tick_ms(wheel);
+
+    ka->wheel     = wheel;
+    ka->timeout   = (timeout_ms + tick_ms - 1) / tick_ms;
+    ka->last_seen = 0;
+    ka->on_dead   = on_dead;
+    ka->user      = user;
+
+    wheel_timer_init(&ka->timer, on_expire, ka);
+}
+
+
+void keepalive_start(struct keepalive *ka)
+{
+    wheel_timer_set(ka->wheel, &ka->timer, ka->timeout);
+    ka->last_seen = timer_wheel_now(ka->wheel);
+}
+
+
+void keepalive_seen(struct keepalive *ka)
+{
+    ka->last_seen = timer_wheel_now(ka->wheel);
+}
+
+
+void keepalive_stop(struct keepalive *ka)
+{
+    wheel_timer_cancel(&ka->timer);
+}
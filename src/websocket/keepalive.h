@@ -0,0 +1,56 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __WEBSOCKET_KEEPALIVE_H__
+#define __WEBSOCKET_KEEPALIVE_H__
+
+#include <stdint.h>
+
+#include "../event_loop/timer_wheel.h"
+
+/* Declares a connection dead when nothing (frame or ping) has been received
+ * for the timeout.
+ *
+ * Seeing traffic only records the current wheel tick; the wheel timer is not
+ * moved.  When the timer fires it compares against the last time traffic was
+ * seen and either re-arms for the remainder or reports the connection dead,
+ * so a dead link is detected to within one tick of the timeout no matter how
+ * busy the connection is. */
+
+struct keepalive {
+    struct timer_wheel *wheel;
+    struct wheel_timer timer;
+    uint64_t timeout;   /* in ticks */
+    uint64_t last_seen; /* in ticks */
+
+    void (*on_dead)(void *user);
+    void *user;
+};
+
+
+/**
+ *  Prepares the keepalive.  The timeout is rounded up to whole ticks.
+ */
+void keepalive_init(struct keepalive *ka, struct timer_wheel *wheel,
+                    uint64_t timeout_ms, void (*on_dead)(void *user),
+                    void *user);
+
+
+/**
+ *  Starts watching, counting from now.
+ */
+void keepalive_start(struct keepalive *ka);
+
+
+/**
+ *  Records that something was received.  Cheap enough to call per frame.
+ */
+void keepalive_seen(struct keepalive *ka);
+
+
+/**
+ *  Stops watching.
+ */
+void keepalive_stop(struct keepalive *ka);
+
+#endif
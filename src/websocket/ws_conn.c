@@ -0,0 +1,701 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+#include <curlws/curlws.h>
+#include <cutils/printf.h>
+
+#include "../logging/log.h"
+#include "iface.h"
+#include "keepalive.h"
+#include "ws_conn.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DEFAULT_BACKOFF_MAX_S  300
+#define DEFAULT_PING_TIMEOUT_S 180
+#define MS_PER_S               1000
+#define CLOSE_WAIT_MS          1000 /* for the server to answer our close */
+#define CLOSE_POLL_MS          100
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* Per interface, in the same order as ifaces.list. */
+struct iface_metrics {
+    const struct ws_conn *conn;
+    const struct iface_health *iface;
+
+    struct metric *attempts;
+    struct metric *connects;
+    struct metric *failures;
+    struct metric *disconnects;
+    struct metric *connect_ms;
+};
+
+struct ws_conn {
+    struct ws_conn_opts opts;
+
+    enum ws_state state;
+    struct iface_set ifaces;
+    struct iface_health *active;
+    uint64_t backoff_max_ms;
+    bool refresh_token;
+    bool waiting_token;
+    bool closing; /* sent a close on stop, waiting for it to complete */
+    struct keepalive keepalive;
+
+    CWS *ws;
+    CURL *easy;
+    struct curl_slist *headers;
+
+    /* The trace of the attempt in progress, if any. */
+    struct trace_span *attempt;
+    struct trace_span *handshake;
+
+    struct iface_metrics *metrics;
+    uint64_t attempt_ms;
+
+    /* Used to (re)connect outside of any curl callback. */
+    struct event_timer *retry;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void connect_next(struct ws_conn *c);
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static const char *iface_name(const struct iface_health *h)
+{
+    return (h && h->name) ? h->name : "(default)";
+}
+
+
+static struct iface_metrics *metrics_of(const struct ws_conn *c)
+{
+    if (!c->metrics || !c->active) {
+        return NULL;
+    }
+
+    return &c->metrics[c->active - c->ifaces.list];
+}
+
+
+static int64_t read_state(void *user)
+{
+    return (int64_t) ((const struct ws_conn *) user)->state;
+}
+
+
+static int64_t read_in_use(void *user)
+{
+    const struct iface_metrics *im = (const struct iface_metrics *) user;
+
+    return (im->conn->active == im->iface) ? 1 : 0;
+}
+
+
+/**
+ *  Registers each metric family for every interface in turn, so the
+ *  families stay together.
+ */
+static bool register_metrics(struct ws_conn *c, struct metrics *m)
+{
+    size_t count = c->ifaces.count;
+
+    c->metrics = calloc(count, sizeof(struct iface_metrics));
+    if (!c->metrics) {
+        return false;
+    }
+
+    metrics_gauge_fn(m, "xa_ws_state",
+                     "0 stopped, 1 connecting, 2 connected, 3 waiting for an interface.",
+                     NULL, NULL, read_state, c);
+
+    for (size_t i = 0; i < count; i++) {
+        c->metrics[i].conn  = c;
+        c->metrics[i].iface = &c->ifaces.list[i];
+        metrics_gauge_fn(m, "xa_ws_interface_in_use",
+                         "1 for the interface in use or being tried.",
+                         "interface", iface_name(&c->ifaces.list[i]), read_in_use,
+                         &c->metrics[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        c->metrics[i].attempts = metrics_counter(m, "xa_ws_connect_attempts_total",
+                                                 "Websocket connection attempts.",
+                                                 "interface", iface_name(&c->ifaces.list[i]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        c->metrics[i].connects = metrics_counter(m, "xa_ws_connects_total",
+                                                 "Websocket connections established.",
+                                                 "interface", iface_name(&c->ifaces.list[i]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        c->metrics[i].failures = metrics_counter(m, "xa_ws_connect_failures_total",
+                                                 "Websocket connection attempts that failed.",
+                                                 "interface", iface_name(&c->ifaces.list[i]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        c->metrics[i].disconnects = metrics_counter(m, "xa_ws_disconnects_total",
+                                                    "Established websocket connections lost.",
+                                                    "interface", iface_name(&c->ifaces.list[i]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        c->metrics[i].connect_ms = metrics_histogram(m, "xa_ws_connect_ms",
+                                                     "Time from the start of an attempt to connected.",
+                                                     "interface", iface_name(&c->ifaces.list[i]));
+    }
+
+    return true;
+}
+
+
+static bool append_header(struct curl_slist **list, const char *key,
+                          const char *val)
+{
+    struct curl_slist *tmp = NULL;
+    char *header           = NULL;
+
+    if (!val) {
+        return true;
+    }
+
+    header = maprintf("%s: %s", key, val);
+    if (header) {
+        tmp = curl_slist_append(*list, header);
+        free(header);
+    }
+
+    if (!tmp) {
+        return false;
+    }
+    *list = tmp;
+
+    return true;
+}
+
+
+/**
+ *  Ends the spans of the attempt in progress, as failed if there is a reason.
+ */
+static void end_spans(struct ws_conn *c, const char *reason)
+{
+    if (reason) {
+        trace_span_error(c->handshake, XA_WEBSOCKET_ERROR, reason);
+        trace_span_error(c->attempt, XA_WEBSOCKET_ERROR, reason);
+    }
+    trace_span_end(c->handshake);
+    trace_span_end(c->attempt);
+
+    c->handshake = NULL;
+    c->attempt   = NULL;
+}
+
+
+static void teardown(struct ws_conn *c)
+{
+    if (c->waiting_token) {
+        c->waiting_token = false;
+        if (c->opts.cancel_token) {
+            c->opts.cancel_token(c->opts.user);
+        }
+    }
+
+    end_spans(c, "stopped");
+    keepalive_stop(&c->keepalive);
+
+    if (c->ws) {
+        if (c->easy) {
+            curl_loop_untrack(c->opts.curl, c->easy);
+        }
+        cws_multi_remove_handle(curl_loop_multi(c->opts.curl), c->ws);
+        cws_destroy(c->ws);
+    }
+    curl_slist_free_all(c->headers);
+
+    c->ws      = NULL;
+    c->easy    = NULL;
+    c->headers = NULL;
+}
+
+
+/**
+ *  Marks the active interface as failed and schedules the next attempt.  The
+ *  teardown and reconnect are deferred so this is safe to call from inside
+ *  any curl or curlws callback.
+ */
+static void failed(struct ws_conn *c, const char *reason)
+{
+    bool was_connected = (WS_STATE__CONNECTED == c->state);
+
+    /* However it ended, the close we sent is as done as it will get. */
+    if (c->closing) {
+        c->closing = false;
+        return;
+    }
+
+    if ((WS_STATE__CONNECTING != c->state) && !was_connected) {
+        return;
+    }
+
+    log_warn("websocket %s on interface %s: %s",
+             (was_connected) ? "lost" : "failed to connect",
+             iface_name(c->active), reason);
+    end_spans(c, reason);
+    if (metrics_of(c)) {
+        metric_add((was_connected) ? metrics_of(c)->disconnects : metrics_of(c)->failures, 1);
+    }
+
+    iface_mark_failure(c->active, event_loop_now_ms(c->opts.loop),
+                       c->backoff_max_ms);
+    c->state = WS_STATE__WAITING;
+    keepalive_stop(&c->keepalive);
+
+    if (was_connected && c->opts.on_disconnect) {
+        c->opts.on_disconnect(c->opts.user);
+    }
+
+    /* Fail over right away, connect_next() decides if we need to wait. */
+    event_timer_start(c->retry, 0, 0);
+}
+
+
+static void on_dead(void *user)
+{
+    failed((struct ws_conn *) user, "nothing received within the ping timeout");
+}
+
+
+/*----------------------------- curlws callbacks -----------------------------*/
+
+static CURLcode on_configure(void *user, CWS *handle, CURL *easy)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+    long ip_resolve   = CURL_IPRESOLVE_WHATEVER;
+    CURLcode rv       = CURLE_OK;
+
+    (void) handle;
+
+    if (4 == c->opts.config->behavior.force_ip) {
+        ip_resolve = CURL_IPRESOLVE_V4;
+    } else if (6 == c->opts.config->behavior.force_ip) {
+        ip_resolve = CURL_IPRESOLVE_V6;
+    }
+
+    rv = curl_easy_setopt(easy, CURLOPT_IPRESOLVE, ip_resolve);
+    if ((CURLE_OK == rv) && c->active->name) {
+        rv = curl_easy_setopt(easy, CURLOPT_INTERFACE, c->active->name);
+    }
+
+    c->easy = easy;
+
+    return rv;
+}
+
+
+static void on_connect(void *user, CWS *handle, const char *protocols)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+
+    (void) handle;
+    (void) protocols;
+
+    c->state = WS_STATE__CONNECTED;
+    iface_mark_success(c->active);
+    keepalive_start(&c->keepalive);
+    end_spans(c, NULL);
+    if (metrics_of(c)) {
+        metric_add(metrics_of(c)->connects, 1);
+        metric_observe(metrics_of(c)->connect_ms,
+                       event_loop_now_ms(c->opts.loop) - c->attempt_ms);
+    }
+
+    log_info("websocket connected on interface %s", iface_name(c->active));
+
+    if (c->opts.on_connect) {
+        c->opts.on_connect(c->opts.user, c->active->name);
+    }
+}
+
+
+static void on_binary(void *user, CWS *handle, const void *buf, size_t len)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+
+    (void) handle;
+
+    keepalive_seen(&c->keepalive);
+
+    if (c->opts.on_binary) {
+        c->opts.on_binary(c->opts.user, buf, len);
+    }
+}
+
+
+static void on_ping(void *user, CWS *handle, const void *buf, size_t len)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+
+    keepalive_seen(&c->keepalive);
+    cws_pong(handle, buf, len);
+}
+
+
+static void on_pong(void *user, CWS *handle, const void *buf, size_t len)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+
+    (void) handle;
+    (void) buf;
+    (void) len;
+
+    keepalive_seen(&c->keepalive);
+}
+
+
+static void on_close(void *user, CWS *handle, int code, const char *reason,
+                     size_t len)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+
+    (void) handle;
+    (void) reason;
+    (void) len;
+
+    log_info("websocket closed by the server (%d)", code);
+    failed(c, "closed by the server");
+}
+
+
+static void on_done(CURL *easy, CURLcode result, void *user)
+{
+    struct ws_conn *c = (struct ws_conn *) user;
+    long status       = 0;
+
+    if (CURLE_OK == curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status)) {
+        if ((401 == status) || (403 == status)) {
+            c->refresh_token = true;
+        }
+    }
+
+    failed(c, curl_easy_strerror(result));
+}
+
+
+/*-------------------------------- Connecting --------------------------------*/
+
+static bool build_headers(struct ws_conn *c, const char *token)
+{
+    const config_t *cfg = c->opts.config;
+    char *auth          = NULL;
+    bool rv             = false;
+
+    if (token) {
+        auth = maprintf("Bearer %s", token);
+        if (!auth) {
+            return false;
+        }
+    }
+
+    rv = append_header(&c->headers, "Authorization", auth)
+         && append_header(&c->headers, "X-Webpa-Device-Name", cfg->identity.device_id.s)
+         && append_header(&c->headers, "X-Webpa-Interface-Used", c->active->name);
+
+    if (auth) {
+        free(auth);
+    }
+
+    return rv;
+}
+
+
+static void start_websocket(struct ws_conn *c, const char *token)
+{
+    struct cws_config cfg;
+
+    if (!build_headers(c, token)) {
+        failed(c, "out of memory building the headers");
+        return;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.url           = c->opts.config->behavior.url.s;
+    cfg.extra_headers = c->headers;
+    cfg.user          = c;
+    cfg.on_connect    = on_connect;
+    cfg.on_binary     = on_binary;
+    cfg.on_ping       = on_ping;
+    cfg.on_pong       = on_pong;
+    cfg.on_close      = on_close;
+    cfg.configure     = on_configure;
+
+    c->handshake = trace_span_child(c->attempt, "websocket handshake",
+                                    TRACE_KIND__CLIENT);
+
+    c->ws = cws_create(&cfg);
+    if (!c->ws) {
+        failed(c, "unable to create the websocket");
+        return;
+    }
+
+    if (!c->easy
+        || (XA_OK != curl_loop_track(c->opts.curl, c->easy, on_done, c, NULL))
+        || (CURLM_OK != cws_multi_add_handle(curl_loop_multi(c->opts.curl), c->ws)))
+    {
+        failed(c, "unable to start the websocket");
+    }
+}
+
+
+static void connect_next(struct ws_conn *c)
+{
+    uint64_t now = event_loop_now_ms(c->opts.loop);
+    bool refresh = false;
+
+    teardown(c);
+
+    c->active = iface_set_pick(&c->ifaces, now);
+    if (!c->active) {
+        uint64_t next = iface_set_next_retry(&c->ifaces);
+
+        log_info("all interfaces are backing off, retrying in %llu ms",
+                 (unsigned long long) (next - now));
+        c->state = WS_STATE__WAITING;
+        event_timer_start(c->retry, next - now, 0);
+        return;
+    }
+
+    c->state      = WS_STATE__CONNECTING;
+    c->attempt_ms = now;
+    if (metrics_of(c)) {
+        metric_add(metrics_of(c)->attempts, 1);
+    }
+    log_info("websocket connecting to '%s' on interface %s (cost %d)",
+             c->opts.config->behavior.url.s, iface_name(c->active),
+             c->active->cost);
+
+    c->attempt = trace_span_root(c->opts.trace, "connect", TRACE_KIND__INTERNAL);
+    trace_span_str(c->attempt, "interface", iface_name(c->active));
+    trace_span_int(c->attempt, "interface.cost", c->active->cost);
+    trace_span_str(c->attempt, "url.full", c->opts.config->behavior.url.s);
+    trace_span_int(c->attempt, "refresh_token", c->refresh_token);
+
+    if (!c->opts.get_token) {
+        start_websocket(c, NULL);
+        return;
+    }
+
+    /* The rest happens in ws_conn_set_token(), which may be right away. */
+    c->waiting_token = true;
+    refresh          = c->refresh_token;
+    c->refresh_token = false;
+    c->opts.get_token(c->opts.user, c, c->active->name, refresh, c->attempt);
+}
+
+
+static void on_retry(struct event_timer *t, void *user)
+{
+    (void) t;
+
+    connect_next((struct ws_conn *) user);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct ws_conn *ws_conn_create(const struct ws_conn_opts *opts, XAcode *err)
+{
+    const config_t *cfg = NULL;
+    struct ws_conn *c   = NULL;
+    uint64_t ping_ms    = (uint64_t) DEFAULT_PING_TIMEOUT_S * MS_PER_S;
+
+    if (!opts || !opts->loop || !opts->curl || !opts->wheel || !opts->config
+        || !opts->config->behavior.url.s)
+    {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+    cfg = opts->config;
+
+    c = calloc(1, sizeof(struct ws_conn));
+    if (!c) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+    c->opts = *opts;
+
+    c->backoff_max_ms = (uint64_t) DEFAULT_BACKOFF_MAX_S * MS_PER_S;
+    if (0 < cfg->behavior.backoff_max) {
+        c->backoff_max_ms = (uint64_t) cfg->behavior.backoff_max * MS_PER_S;
+    }
+
+    if (0 < cfg->behavior.ping_timeout) {
+        ping_ms = (uint64_t) cfg->behavior.ping_timeout * MS_PER_S;
+    }
+    keepalive_init(&c->keepalive, opts->wheel, ping_ms, on_dead, c);
+
+    if (XA_OK != iface_set_init(&c->ifaces, cfg->behavior.interfaces,
+                                cfg->behavior.interface_count, err))
+    {
+        free(c);
+        return NULL;
+    }
+
+    if (opts->metrics && !register_metrics(c, opts->metrics)) {
+        iface_set_destroy(&c->ifaces);
+        free(c);
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    c->retry = event_timer_create(opts->loop, on_retry, c, err);
+    if (!c->retry) {
+        free(c->metrics);
+        iface_set_destroy(&c->ifaces);
+        free(c);
+        return NULL;
+    }
+
+    return c;
+}
+
+
+void ws_conn_destroy(struct ws_conn *c)
+{
+    if (c) {
+        ws_conn_stop(c);
+        event_timer_destroy(c->retry);
+        free(c->metrics);
+        iface_set_destroy(&c->ifaces);
+        free(c);
+    }
+}
+
+
+XAcode ws_conn_start(struct ws_conn *c, XAcode *err)
+{
+    if (!c) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (WS_STATE__STOPPED == c->state) {
+        c->state = WS_STATE__WAITING;
+        event_timer_start(c->retry, 0, 0);
+    }
+
+    return XA_OK;
+}
+
+
+void ws_conn_stop(struct ws_conn *c)
+{
+    if (c) {
+        event_timer_stop(c->retry);
+        if (c->ws && (WS_STATE__CONNECTED == c->state)) {
+            uint64_t deadline = event_loop_now_ms(c->opts.loop) + CLOSE_WAIT_MS;
+
+            /* Give the close frame a chance to go out and be answered. */
+            c->closing = true;
+            cws_close(c->ws, CWS_CLOSE_REASON_NORMAL, NULL, 0);
+            while (c->closing && (event_loop_now_ms(c->opts.loop) < deadline)) {
+                if (XA_OK != event_loop_run_once(c->opts.loop, CLOSE_POLL_MS, NULL)) {
+                    break;
+                }
+            }
+            c->closing = false;
+        }
+        teardown(c);
+        c->state = WS_STATE__STOPPED;
+    }
+}
+
+
+void ws_conn_set_token(struct ws_conn *c, const char *token)
+{
+    if (c && c->waiting_token) {
+        c->waiting_token = false;
+        start_websocket(c, token);
+    }
+}
+
+
+void ws_conn_fail(struct ws_conn *c, const char *reason)
+{
+    if (c) {
+        failed(c, reason);
+    }
+}
+
+
+XAcode ws_conn_send(struct ws_conn *c, const void *buf, size_t len, XAcode *err)
+{
+    if (!c || (!buf && len)) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    if (WS_STATE__CONNECTED != c->state) {
+        return xa_set_error(err, XA_NOT_CONNECTED);
+    }
+
+    if (CURLE_OK != cws_send_blk_binary(c->ws, buf, len)) {
+        return xa_set_error(err, XA_WEBSOCKET_ERROR);
+    }
+
+    return XA_OK;
+}
+
+
+size_t ws_conn_sendv(struct ws_conn *c, const struct iovec *msgs, size_t count)
+{
+    size_t sent = 0;
+
+    while ((sent < count)
+           && (XA_OK == ws_conn_send(c, msgs[sent].iov_base, msgs[sent].iov_len, NULL)))
+    {
+        sent++;
+    }
+
+    return sent;
+}
+
+
+enum ws_state ws_conn_state(const struct ws_conn *c)
+{
+    return c->state;
+}
+
+
+const char *ws_conn_interface(const struct ws_conn *c)
+{
+    return (c->active) ? c->active->name : NULL;
+}
+
+
+const char *ws_state_to_string(enum ws_state state)
+{
+    switch (state) {
+        case WS_STATE__STOPPED:    return "stopped";
+        case WS_STATE__CONNECTING: return "connecting";
+        case WS_STATE__CONNECTED:  return "connected";
+        case WS_STATE__WAITING:    return "waiting";
+        default:
+            break;
+    }
+
+    return "invalid";
+}
@@ -0,0 +1,153 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __WS_CONN_H__
+#define __WS_CONN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "../config/config.h"
+#include "../curl_loop/curl_loop.h"
+#include "../error/codes.h"
+#include "../event_loop/event_loop.h"
+#include "../event_loop/timer_wheel.h"
+#include "../telemetry/metrics.h"
+#include "../telemetry/trace.h"
+
+/* The websocket connection manager keeps the agent connected to
+ * behavior.url.  It always connects using the cheapest interface that is
+ * believed to be healthy, and when a connection attempt fails (or an
+ * established connection is lost) it immediately moves on to the next
+ * interface in cost order.  Only when every interface is backing off does it
+ * wait.
+ *
+ * A connection that receives nothing (not even a ping) for
+ * behavior.ping_timeout is treated as lost.
+ *
+ * With a tracer, each attempt is a "connect" trace: the token fetch and the
+ * websocket handshake are its children, and the outcome is its status.
+ *
+ * With a metrics registry, attempts, connects, failures, disconnects and the
+ * time to connect are counted per interface, and the state and the interface
+ * in use are gauges. */
+
+enum ws_state {
+    WS_STATE__STOPPED = 0,
+    WS_STATE__CONNECTING,
+    WS_STATE__CONNECTED,
+    WS_STATE__WAITING /* for an interface to be eligible again */
+};
+
+struct ws_conn;
+
+struct ws_conn_opts {
+    struct event_loop *loop;
+    struct curl_loop *curl;
+    struct timer_wheel *wheel; /* used for the keepalive */
+    const config_t *config; /* must outlive the connection */
+    struct trace *trace;    /* optional */
+    struct metrics *metrics; /* optional, registered into on create */
+
+    void *user;
+
+    /* Asks for the auth token to present for the interface; the answer,
+     * NULL for none, is given to ws_conn_set_token() either right away or
+     * later from the loop, and the attempt waits until then.  refresh is true
+     * if the server rejected the previous token.  Any request made for it can
+     * be traced under parent, which may be NULL. */
+    void (*get_token)(void *user, struct ws_conn *c, const char *interface,
+                      bool refresh, struct trace_span *parent);
+
+    /* Abandons the get_token() in progress; ws_conn_set_token() must not be
+     * called for it anymore.  Optional. */
+    void (*cancel_token)(void *user);
+
+    /* Optional notifications. */
+    void (*on_connect)(void *user, const char *interface);
+    void (*on_disconnect)(void *user);
+
+    /* Called for each complete binary message.  The buffer is only valid for
+     * the duration of the call. */
+    void (*on_binary)(void *user, const void *buf, size_t len);
+};
+
+
+/**
+ *  Creates the connection manager.  Nothing happens until ws_conn_start().
+ *
+ *  @return the connection manager or NULL on failure
+ */
+struct ws_conn *ws_conn_create(const struct ws_conn_opts *opts, XAcode *err);
+
+
+/**
+ *  Stops and releases the connection manager.
+ */
+void ws_conn_destroy(struct ws_conn *c);
+
+
+/**
+ *  Starts connecting and keeps the connection up until ws_conn_stop().
+ */
+XAcode ws_conn_start(struct ws_conn *c, XAcode *err);
+
+
+/**
+ *  Closes the connection (if any) and stops reconnecting.  An open connection
+ *  is closed cleanly: the loop is run until the server answers the close or a
+ *  second passes, so don't call this from a loop callback.
+ */
+void ws_conn_stop(struct ws_conn *c);
+
+
+/**
+ *  Gives the connection the token asked for by get_token(), NULL for none,
+ *  and carries on with the attempt.  Ignored if no token is being waited on.
+ */
+void ws_conn_set_token(struct ws_conn *c, const char *token);
+
+
+/**
+ *  Declares the current connection dead (for example because the keepalive
+ *  expired) and fails over to the next interface.
+ */
+void ws_conn_fail(struct ws_conn *c, const char *reason);
+
+
+/**
+ *  Sends a binary message.
+ *
+ *  @return XA_OK on success, XA_NOT_CONNECTED or XA_WEBSOCKET_ERROR otherwise
+ */
+XAcode ws_conn_send(struct ws_conn *c, const void *buf, size_t len, XAcode *err);
+
+
+/**
+ *  Sends each iovec as its own binary message, back to back, stopping at the
+ *  first failure.
+ *
+ *  @return the number of messages sent
+ */
+size_t ws_conn_sendv(struct ws_conn *c, const struct iovec *msgs, size_t count);
+
+
+/**
+ *  Returns the current state of the connection.
+ */
+enum ws_state ws_conn_state(const struct ws_conn *c);
+
+
+/**
+ *  Returns the interface in use (or being tried), NULL for the default route.
+ */
+const char *ws_conn_interface(const struct ws_conn *c);
+
+
+/**
+ *  Returns the name of the state for logging.
+ */
+const char *ws_state_to_string(enum ws_state state);
+
+#endif
@@ -0,0 +1,311 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wrp_encode.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* A key encoded ahead of time: the fixstr header byte and the characters. */
+#define KEY(encoded) { sizeof(encoded) - 1, encoded }
+
+#define MAX_DEVICE_ID  512
+#define MAX_KEY_HEADER 7 /* "\xa6source" */
+#define MAX_STR_HEADER 5
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct key {
+    size_t len;
+    const char *bytes;
+};
+
+struct writer {
+    uint8_t *p;
+    uint8_t *end;
+    size_t need;
+};
+
+struct wrp_encoder {
+    /* Points at the end of the source entry. */
+    const uint8_t *device_id;
+    size_t device_id_len;
+
+    /* The complete "source" entry used when there is no service. */
+    size_t source_len;
+    uint8_t source[];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* clang-format off */
+static const struct key k_source           = KEY("\xa6" "source");
+static const struct key k_dest             = KEY("\xa4" "dest");
+static const struct key k_transaction_uuid = KEY("\xb0" "transaction_uuid");
+static const struct key k_content_type     = KEY("\xac" "content_type");
+static const struct key k_path             = KEY("\xa4" "path");
+static const struct key k_status           = KEY("\xa6" "status");
+static const struct key k_payload          = KEY("\xa7" "payload");
+/* clang-format on */
+
+/* "msg_type" followed by the positive fixint type. */
+static const uint8_t msg_type_entry[] = { 0xa8, 'm', 's', 'g', '_', 't', 'y', 'p', 'e' };
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void put(struct writer *w, const void *p, size_t len)
+{
+    if (!len) {
+        return;
+    }
+
+    if (len <= (size_t) (w->end - w->p)) {
+        memcpy(w->p, p, len);
+        w->p += len;
+    } else {
+        /* Stop writing but keep counting. */
+        w->p = w->end;
+    }
+    w->need += len;
+}
+
+
+static void put_byte(struct writer *w, uint8_t b)
+{
+    put(w, &b, 1);
+}
+
+
+static void put_be(struct writer *w, uint8_t type, uint64_t val, int bytes)
+{
+    uint8_t b[9];
+
+    b[0] = type;
+    for (int i = bytes; 0 < i; i--) {
+        b[i] = (uint8_t) (val & 0xff);
+        val >>= 8;
+    }
+    put(w, b, (size_t) bytes + 1);
+}
+
+
+static void put_key(struct writer *w, const struct key *k)
+{
+    put(w, k->bytes, k->len);
+}
+
+
+static void put_str_header(struct writer *w, size_t len)
+{
+    if (len < 32) {
+        put_byte(w, (uint8_t) (0xa0 | len));
+    } else if (len <= UINT8_MAX) {
+        put_be(w, 0xd9, len, 1);
+    } else if (len <= UINT16_MAX) {
+        put_be(w, 0xda, len, 2);
+    } else {
+        put_be(w, 0xdb, len, 4);
+    }
+}
+
+
+static void put_bin_header(struct writer *w, size_t len)
+{
+    if (len <= UINT8_MAX) {
+        put_be(w, 0xc4, len, 1);
+    } else if (len <= UINT16_MAX) {
+        put_be(w, 0xc5, len, 2);
+    } else {
+        put_be(w, 0xc6, len, 4);
+    }
+}
+
+
+static void put_int(struct writer *w, int64_t i)
+{
+    if ((0 <= i) && (i <= 127)) {
+        put_byte(w, (uint8_t) i);
+    } else if ((-32 <= i) && (i < 0)) {
+        put_byte(w, (uint8_t) (int8_t) i);
+    } else if ((INT16_MIN <= i) && (i <= INT16_MAX)) {
+        put_be(w, 0xd1, (uint64_t) i, 2);
+    } else if ((INT32_MIN <= i) && (i <= INT32_MAX)) {
+        put_be(w, 0xd2, (uint64_t) i, 4);
+    } else {
+        put_be(w, 0xd3, (uint64_t) i, 8);
+    }
+}
+
+
+static void put_str_entry(struct writer *w, const struct key *k,
+                          const struct xa_const_string *s)
+{
+    if (s->s) {
+        put_key(w, k);
+        put_str_header(w, s->len);
+        put(w, s->s, s->len);
+    }
+}
+
+
+static void put_source(struct writer *w, const struct wrp_encoder *e,
+                       const struct xa_const_string *service)
+{
+    if (!service->s) {
+        put(w, e->source, e->source_len);
+        return;
+    }
+
+    put_key(w, &k_source);
+    put_str_header(w, e->device_id_len + 1 + service->len);
+    put(w, e->device_id, e->device_id_len);
+    put_byte(w, '/');
+    put(w, service->s, service->len);
+}
+
+
+static bool is_crud(enum wrp_msg_type type)
+{
+    return (WRP_MSG_TYPE__CREATE == type) || (WRP_MSG_TYPE__RETRIEVE == type)
+           || (WRP_MSG_TYPE__UPDATE == type) || (WRP_MSG_TYPE__DELETE == type);
+}
+
+
+static unsigned count_entries(const struct wrp_out *msg)
+{
+    /* msg_type, source and dest are always present */
+    unsigned count = 3;
+
+    if (WRP_MSG_TYPE__EVENT != msg->msg_type) {
+        count++; /* transaction_uuid */
+    }
+    if (msg->content_type.s) {
+        count++;
+    }
+    if (is_crud(msg->msg_type) && msg->path.s) {
+        count++;
+    }
+    if (msg->has_status) {
+        count++;
+    }
+    if (msg->payload) {
+        count++;
+    }
+
+    return count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+struct wrp_encoder *wrp_encoder_create(const char *device_id, XAcode *err)
+{
+    struct wrp_encoder *e = NULL;
+    struct writer w;
+    size_t len;
+
+    if (!device_id || !*device_id) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    len = strlen(device_id);
+    if (MAX_DEVICE_ID < len) {
+        xa_set_error(err, XA_INVALID_INPUT);
+        return NULL;
+    }
+
+    e = calloc(1, sizeof(struct wrp_encoder) + MAX_KEY_HEADER + MAX_STR_HEADER + len);
+    if (!e) {
+        xa_set_error(err, XA_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    w.p    = e->source;
+    w.end  = e->source + MAX_KEY_HEADER + MAX_STR_HEADER + len;
+    w.need = 0;
+    put_key(&w, &k_source);
+    put_str_header(&w, len);
+    put(&w, device_id, len);
+
+    e->source_len    = w.need;
+    e->device_id     = &e->source[w.need - len];
+    e->device_id_len = len;
+
+    return e;
+}
+
+
+void wrp_encoder_destroy(struct wrp_encoder *e)
+{
+    free(e);
+}
+
+
+size_t wrp_encode(const struct wrp_encoder *e, const struct wrp_out *msg,
+                  void *buf, size_t len)
+{
+    struct writer w;
+
+    if (!e || !msg || (!buf && len) || !msg->dest.s) {
+        return 0;
+    }
+
+    if ((WRP_MSG_TYPE__REQ != msg->msg_type)
+        && (WRP_MSG_TYPE__EVENT != msg->msg_type) && !is_crud(msg->msg_type))
+    {
+        return 0;
+    }
+
+    if ((WRP_MSG_TYPE__EVENT != msg->msg_type) && !msg->transaction_uuid.s) {
+        return 0;
+    }
+
+    w.p    = (uint8_t *) buf;
+    w.end  = (buf) ? w.p + len : w.p;
+    w.need = 0;
+
+    /* At most 8 entries, so the map is always a fixmap. */
+    put_byte(&w, (uint8_t) (0x80 | count_entries(msg)));
+
+    put(&w, msg_type_entry, sizeof(msg_type_entry));
+    put_byte(&w, (uint8_t) msg->msg_type);
+
+    put_source(&w, e, &msg->service);
+    put_str_entry(&w, &k_dest, &msg->dest);
+
+    if (WRP_MSG_TYPE__EVENT != msg->msg_type) {
+        put_str_entry(&w, &k_transaction_uuid, &msg->transaction_uuid);
+    }
+
+    put_str_entry(&w, &k_content_type, &msg->content_type);
+
+    if (is_crud(msg->msg_type)) {
+        put_str_entry(&w, &k_path, &msg->path);
+    }
+
+    if (msg->has_status) {
+        put_key(&w, &k_status);
+        put_int(&w, msg->status);
+    }
+
+    if (msg->payload) {
+        put_key(&w, &k_payload);
+        put_bin_header(&w, msg->payload_len);
+        put(&w, msg->payload, msg->payload_len);
+    }
+
+    return w.need;
+}
@@ -0,0 +1,77 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __WRP_ENCODE_H__
+#define __WRP_ENCODE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "../string.h"
+#include "wrp_view.h"
+
+/* A msgpack encoder specialized for the messages this agent sends: events,
+ * simple request-response and CRUD messages.  Each message type has a fixed
+ * set of keys, so the keys (and the msg_type entry) are constant bytes that
+ * are copied rather than encoded, and the agent's source (derived from
+ * identity.device_id) is prepared once up front.
+ *
+ * The output is a regular WRP map and decodes with any msgpack WRP decoder,
+ * including wrp_view_decode(). */
+
+struct wrp_encoder;
+
+/* An outbound message.  Strings with a NULL s are omitted. */
+struct wrp_out {
+    enum wrp_msg_type msg_type; /* REQ, EVENT, CREATE, RETRIEVE, UPDATE, DELETE */
+
+    /* The source is "<device_id>/<service>", or just the device id if no
+     * service is given. */
+    struct xa_const_string service;
+
+    struct xa_const_string dest;
+    struct xa_const_string transaction_uuid; /* required except for events */
+    struct xa_const_string content_type;
+    struct xa_const_string path; /* CRUD only */
+
+    bool has_status;
+    int64_t status;
+
+    const void *payload;
+    size_t payload_len;
+};
+
+
+/**
+ *  Creates an encoder for the given device id.
+ *
+ *  @return the encoder or NULL on failure
+ */
+struct wrp_encoder *wrp_encoder_create(const char *device_id, XAcode *err);
+
+
+/**
+ *  Releases the encoder.
+ */
+void wrp_encoder_destroy(struct wrp_encoder *e);
+
+
+/**
+ *  Encodes the message into the buffer.  Like snprintf(), the full encoded
+ *  length is returned even if it doesn't fit, so calling with a NULL buffer
+ *  first gives the exact size to allocate.
+ *
+ *  @param e   the encoder
+ *  @param msg the message to encode
+ *  @param buf the buffer to write into (may be NULL if len is 0)
+ *  @param len the size of the buffer
+ *
+ *  @return the encoded length (the message only fits if it is <= len), or 0
+ *          if the message is invalid
+ */
+size_t wrp_encode(const struct wrp_encoder *e, const struct wrp_out *msg,
+                  void *buf, size_t len);
+
+#endif
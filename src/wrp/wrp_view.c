@@ -0,0 +1,360 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stddef.h>
+#include <string.h>
+
+#include <mpack.h>
+
+#include "wrp_view.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define FIELD(name, kind, member) \
+    { name, sizeof(name) - 1, kind, offsetof(struct wrp_view, member), 0 }
+
+#define OPT_INT_FIELD(name, member, has)                                   \
+    { name, sizeof(name) - 1, FIELD__OPT_INT,                              \
+      offsetof(struct wrp_view, member), offsetof(struct wrp_view, has) }
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+enum field_kind {
+    FIELD__MSG_TYPE,
+    FIELD__STRING,
+    FIELD__INT,
+    FIELD__OPT_INT, /* an int with a has_ flag */
+    FIELD__STRINGS,
+    FIELD__PAIRS,
+    FIELD__BYTES,
+};
+
+struct field {
+    const char *name;
+    size_t len;
+    enum field_kind kind;
+    size_t offset;
+    size_t has_offset;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* clang-format off */
+static const struct field fields[] = {
+    FIELD("msg_type",         FIELD__MSG_TYPE, msg_type),
+    FIELD("source",           FIELD__STRING,   source),
+    FIELD("dest",             FIELD__STRING,   dest),
+    FIELD("transaction_uuid", FIELD__STRING,   transaction_uuid),
+    FIELD("content_type",     FIELD__STRING,   content_type),
+    FIELD("accept",           FIELD__STRING,   accept),
+    FIELD("session_id",       FIELD__STRING,   session_id),
+    FIELD("path",             FIELD__STRING,   path),
+    FIELD("service_name",     FIELD__STRING,   service_name),
+    FIELD("url",              FIELD__STRING,   url),
+    OPT_INT_FIELD("status", status, has_status),
+    OPT_INT_FIELD("rdr",    rdr,    has_rdr),
+    FIELD("qos",              FIELD__INT,      qos),
+    FIELD("headers",          FIELD__STRINGS,  headers),
+    FIELD("metadata",         FIELD__PAIRS,    metadata),
+    FIELD("partner_ids",      FIELD__STRINGS,  partner_ids),
+    FIELD("payload",          FIELD__BYTES,    payload),
+};
+/* clang-format on */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static bool read_str(mpack_reader_t *r, struct xa_const_string *s)
+{
+    mpack_tag_t tag = mpack_read_tag(r);
+
+    if (mpack_type_str != mpack_tag_type(&tag)) {
+        mpack_reader_flag_error(r, mpack_error_type);
+        return false;
+    }
+
+    s->len = mpack_tag_str_length(&tag);
+    s->s   = mpack_read_bytes_inplace(r, s->len);
+    mpack_done_str(r);
+
+    return (mpack_ok == mpack_reader_error(r));
+}
+
+
+static bool read_int(mpack_reader_t *r, int64_t *val)
+{
+    mpack_tag_t tag = mpack_read_tag(r);
+
+    if (mpack_type_int == mpack_tag_type(&tag)) {
+        *val = mpack_tag_int_value(&tag);
+        return true;
+    }
+
+    if ((mpack_type_uint == mpack_tag_type(&tag))
+        && (mpack_tag_uint_value(&tag) <= INT64_MAX))
+    {
+        *val = (int64_t) mpack_tag_uint_value(&tag);
+        return true;
+    }
+
+    mpack_reader_flag_error(r, mpack_error_type);
+    return false;
+}
+
+
+/* Payloads are normally bin, but some producers send str. */
+static bool read_bytes(mpack_reader_t *r, struct wrp_view_bytes *b)
+{
+    mpack_tag_t tag = mpack_read_tag(r);
+
+    switch (mpack_tag_type(&tag)) {
+        case mpack_type_bin:
+            b->len  = mpack_tag_bin_length(&tag);
+            b->data = mpack_read_bytes_inplace(r, b->len);
+            mpack_done_bin(r);
+            break;
+        case mpack_type_str:
+            b->len  = mpack_tag_str_length(&tag);
+            b->data = mpack_read_bytes_inplace(r, b->len);
+            mpack_done_str(r);
+            break;
+        case mpack_type_nil:
+            break;
+        default:
+            mpack_reader_flag_error(r, mpack_error_type);
+            return false;
+    }
+
+    return (mpack_ok == mpack_reader_error(r));
+}
+
+
+/* Checks the list only holds strings and remembers where it is encoded. */
+static bool read_list(mpack_reader_t *r, struct wrp_view_list *l, bool pairs)
+{
+    struct xa_const_string ignore;
+    mpack_tag_t tag = mpack_read_tag(r);
+    size_t items    = 0;
+    const char *end = NULL;
+
+    if (pairs && (mpack_type_map == mpack_tag_type(&tag))) {
+        l->count = mpack_tag_map_count(&tag);
+        items    = 2 * l->count;
+    } else if (!pairs && (mpack_type_array == mpack_tag_type(&tag))) {
+        l->count = mpack_tag_array_count(&tag);
+        items    = l->count;
+    } else {
+        mpack_reader_flag_error(r, mpack_error_type);
+        return false;
+    }
+
+    mpack_reader_remaining(r, &l->raw);
+    for (size_t i = 0; i < items; i++) {
+        if (!read_str(r, &ignore)) {
+            return false;
+        }
+    }
+    mpack_reader_remaining(r, &end);
+    l->len = (size_t) (end - l->raw);
+
+    if (pairs) {
+        mpack_done_map(r);
+    } else {
+        mpack_done_array(r);
+    }
+
+    return true;
+}
+
+
+static bool read_field(mpack_reader_t *r, struct wrp_view *v,
+                       const struct xa_const_string *key)
+{
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        const struct field *f = &fields[i];
+        void *p               = ((char *) v) + f->offset;
+        int64_t val           = 0;
+
+        if ((f->len != key->len) || (0 != memcmp(f->name, key->s, key->len))) {
+            continue;
+        }
+
+        switch (f->kind) {
+            case FIELD__MSG_TYPE:
+                if (!read_int(r, &val)) {
+                    return false;
+                }
+                if ((val < WRP_MSG_TYPE__AUTH) || (WRP_MSG_TYPE__UNKNOWN < val)) {
+                    return false;
+                }
+                v->msg_type = (enum wrp_msg_type) val;
+                return true;
+            case FIELD__STRING:
+                return read_str(r, (struct xa_const_string *) p);
+            case FIELD__INT:
+                return read_int(r, (int64_t *) p);
+            case FIELD__OPT_INT:
+                *(bool *) (((char *) v) + f->has_offset) = true;
+                return read_int(r, (int64_t *) p);
+            case FIELD__STRINGS:
+                return read_list(r, (struct wrp_view_list *) p, false);
+            case FIELD__PAIRS:
+                return read_list(r, (struct wrp_view_list *) p, true);
+            case FIELD__BYTES:
+                return read_bytes(r, (struct wrp_view_bytes *) p);
+        }
+    }
+
+    mpack_discard(r);
+
+    return (mpack_ok == mpack_reader_error(r));
+}
+
+
+static bool is_valid(const struct wrp_view *v)
+{
+    switch (v->msg_type) {
+        case WRP_MSG_TYPE__AUTH:
+            return v->has_status;
+        case WRP_MSG_TYPE__REQ:
+        case WRP_MSG_TYPE__CREATE:
+        case WRP_MSG_TYPE__RETRIEVE:
+        case WRP_MSG_TYPE__UPDATE:
+        case WRP_MSG_TYPE__DELETE:
+            if (!v->transaction_uuid.s) {
+                return false;
+            }
+            /* fall through */
+        case WRP_MSG_TYPE__EVENT:
+            return v->source.s && v->dest.s;
+        case WRP_MSG_TYPE__SVC_REG:
+            return v->service_name.s && v->url.s;
+        case WRP_MSG_TYPE__SVC_ALIVE:
+        case WRP_MSG_TYPE__UNKNOWN:
+            return true;
+        default:
+            break;
+    }
+
+    return false;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+XAcode wrp_view_decode(struct wrp_view *v, const void *buf, size_t len,
+                       XAcode *err)
+{
+    mpack_reader_t r;
+    mpack_tag_t tag;
+    uint32_t count;
+    bool ok = true;
+
+    if (!v || !buf || !len) {
+        return xa_set_error(err, XA_INVALID_INPUT);
+    }
+
+    memset(v, 0, sizeof(struct wrp_view));
+
+    mpack_reader_init_data(&r, (const char *) buf, len);
+
+    tag = mpack_read_tag(&r);
+    if (mpack_type_map != mpack_tag_type(&tag)) {
+        mpack_reader_destroy(&r);
+        return xa_set_error(err, XA_INVALID_WRP);
+    }
+
+    count = mpack_tag_map_count(&tag);
+    for (uint32_t i = 0; ok && (i < count); i++) {
+        struct xa_const_string key;
+
+        ok = read_str(&r, &key) && read_field(&r, v, &key);
+    }
+    mpack_done_map(&r);
+
+    if ((mpack_ok != mpack_reader_destroy(&r)) || !ok || !is_valid(v)) {
+        return xa_set_error(err, XA_INVALID_WRP);
+    }
+
+    return XA_OK;
+}
+
+
+void wrp_view_iter_init(struct wrp_view_iter *it, const struct wrp_view_list *l)
+{
+    it->p    = l->raw;
+    it->len  = l->len;
+    it->left = l->count;
+}
+
+
+bool wrp_view_next_string(struct wrp_view_iter *it, struct xa_const_string *s)
+{
+    mpack_reader_t r;
+    bool rv;
+
+    if (0 == it->left) {
+        return false;
+    }
+
+    /* The list was validated by the decoder, so this can't fail. */
+    mpack_reader_init_data(&r, it->p, it->len);
+    rv = read_str(&r, s);
+    it->len = mpack_reader_remaining(&r, &it->p);
+    mpack_reader_destroy(&r);
+
+    it->left--;
+
+    return rv;
+}
+
+
+bool wrp_view_next_pair(struct wrp_view_iter *it, struct xa_const_string *key,
+                        struct xa_const_string *val)
+{
+    mpack_reader_t r;
+    bool rv;
+
+    if (0 == it->left) {
+        return false;
+    }
+
+    mpack_reader_init_data(&r, it->p, it->len);
+    rv = read_str(&r, key) && read_str(&r, val);
+    it->len = mpack_reader_remaining(&r, &it->p);
+    mpack_reader_destroy(&r);
+
+    it->left--;
+
+    return rv;
+}
+
+
+const char *wrp_msg_type_to_string(enum wrp_msg_type type)
+{
+    switch (type) {
+        case WRP_MSG_TYPE__AUTH:      return "auth";
+        case WRP_MSG_TYPE__REQ:       return "req";
+        case WRP_MSG_TYPE__EVENT:     return "event";
+        case WRP_MSG_TYPE__CREATE:    return "create";
+        case WRP_MSG_TYPE__RETRIEVE:  return "retrieve";
+        case WRP_MSG_TYPE__UPDATE:    return "update";
+        case WRP_MSG_TYPE__DELETE:    return "delete";
+        case WRP_MSG_TYPE__SVC_REG:   return "svc_reg";
+        case WRP_MSG_TYPE__SVC_ALIVE: return "svc_alive";
+        case WRP_MSG_TYPE__UNKNOWN:   return "unknown";
+        default:
+            break;
+    }
+
+    return "invalid";
+}
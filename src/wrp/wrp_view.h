@@ -0,0 +1,122 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef __WRP_VIEW_H__
+#define __WRP_VIEW_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../error/codes.h"
+#include "../string.h"
+
+/* Decodes a msgpack encoded WRP message without copying anything.  Every
+ * string, list and the payload in the view points into the buffer that was
+ * decoded, so the view is only valid as long as that buffer is (for inbound
+ * traffic: the duration of the websocket callback).  Anything that must
+ * outlive the buffer has to be copied by its consumer. */
+
+enum wrp_msg_type {
+    WRP_MSG_TYPE__UNSET      = 0,
+    WRP_MSG_TYPE__AUTH       = 2,
+    WRP_MSG_TYPE__REQ        = 3,
+    WRP_MSG_TYPE__EVENT      = 4,
+    WRP_MSG_TYPE__CREATE     = 5,
+    WRP_MSG_TYPE__RETRIEVE   = 6,
+    WRP_MSG_TYPE__UPDATE     = 7,
+    WRP_MSG_TYPE__DELETE     = 8,
+    WRP_MSG_TYPE__SVC_REG    = 9,
+    WRP_MSG_TYPE__SVC_ALIVE  = 10,
+    WRP_MSG_TYPE__UNKNOWN    = 11,
+};
+
+/* A list that is still encoded.  Use the wrp_view_iter functions to walk it. */
+struct wrp_view_list {
+    size_t count;
+    const char *raw;
+    size_t len;
+};
+
+struct wrp_view_bytes {
+    const void *data;
+    size_t len;
+};
+
+struct wrp_view {
+    enum wrp_msg_type msg_type;
+
+    struct xa_const_string source;
+    struct xa_const_string dest;
+    struct xa_const_string transaction_uuid;
+    struct xa_const_string content_type;
+    struct xa_const_string accept;
+    struct xa_const_string session_id;
+    struct xa_const_string path;
+    struct xa_const_string service_name;
+    struct xa_const_string url;
+
+    bool has_status;
+    int64_t status;
+    bool has_rdr;
+    int64_t rdr;
+    int64_t qos;
+
+    struct wrp_view_list headers;     /* strings */
+    struct wrp_view_list metadata;    /* string key/value pairs */
+    struct wrp_view_list partner_ids; /* strings */
+
+    struct wrp_view_bytes payload;
+};
+
+struct wrp_view_iter {
+    const char *p;
+    size_t len;
+    size_t left;
+};
+
+
+/**
+ *  Decodes the message into the view.  Unknown keys are skipped.  Strings are
+ *  not nul terminated; use the len.
+ *
+ *  @param v   the view to fill in
+ *  @param buf the encoded message
+ *  @param len the length of the encoded message
+ *  @param err the error code if there was a failure
+ *
+ *  @return XA_OK on success, XA_INVALID_INPUT or XA_INVALID_WRP otherwise
+ */
+XAcode wrp_view_decode(struct wrp_view *v, const void *buf, size_t len,
+                       XAcode *err);
+
+
+/**
+ *  Starts walking a list from the view.
+ */
+void wrp_view_iter_init(struct wrp_view_iter *it, const struct wrp_view_list *l);
+
+
+/**
+ *  Gets the next string from a list of strings.
+ *
+ *  @return true if s was set, false at the end of the list
+ */
+bool wrp_view_next_string(struct wrp_view_iter *it, struct xa_const_string *s);
+
+
+/**
+ *  Gets the next key/value pair from the metadata.
+ *
+ *  @return true if key and val were set, false at the end of the list
+ */
+bool wrp_view_next_pair(struct wrp_view_iter *it, struct xa_const_string *key,
+                        struct xa_const_string *val);
+
+
+/**
+ *  Returns the name of the message type for logging.
+ */
+const char *wrp_msg_type_to_string(enum wrp_msg_type type);
+
+#endif
@@ -0,0 +1,350 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/event_loop/event_loop.h"
+#include "../src/outbound/batch.h"
+#include "../src/wrp/wrp_encode.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct transport {
+    size_t accept; /* messages to accept per call */
+    int calls;
+    size_t seen;
+    char dests[32][8];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static struct event_loop *loop;
+static struct wrp_encoder *enc;
+static size_t msg_len; /* every test message encodes to this size */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void make_msg(struct wrp_out *msg, char *dest, int i)
+{
+    snprintf(dest, 8, "d%d", i);
+
+    memset(msg, 0, sizeof(struct wrp_out));
+    msg->msg_type = WRP_MSG_TYPE__EVENT;
+    msg->dest.s   = dest;
+    msg->dest.len = strlen(dest);
+}
+
+
+static size_t send_fn(void *user, const struct iovec *msgs, size_t count)
+{
+    struct transport *t = (struct transport *) user;
+    size_t n            = (count < t->accept) ? count : t->accept;
+
+    t->calls++;
+
+    for (size_t i = 0; i < n; i++) {
+        struct wrp_out msg;
+        uint8_t want[64];
+        char dest[8];
+        size_t len;
+
+        /* Verify the bytes survived compaction by re-encoding. */
+        make_msg(&msg, dest, (int) t->seen);
+        len = wrp_encode(enc, &msg, want, sizeof(want));
+        CU_ASSERT(len == msgs[i].iov_len);
+        CU_ASSERT(0 == memcmp(want, msgs[i].iov_base, len));
+
+        strcpy(t->dests[t->seen], dest);
+        t->seen++;
+    }
+
+    return n;
+}
+
+
+static void add(struct batch *b, int i, XAcode expect)
+{
+    struct wrp_out msg;
+    char dest[8];
+
+    make_msg(&msg, dest, i);
+    CU_ASSERT(expect == batch_add(b, enc, &msg, NULL));
+}
+
+
+static struct batch *make(struct transport *t, uint64_t window_ms,
+                          size_t max_bytes, size_t max_msgs)
+{
+    struct batch_opts opts = {
+        .loop      = loop,
+        .window_ms = window_ms,
+        .max_bytes = max_bytes,
+        .max_msgs  = max_msgs,
+        .send      = send_fn,
+        .user      = t,
+    };
+
+    memset(t, 0, sizeof(struct transport));
+    t->accept = 100;
+
+    return batch_create(&opts, NULL);
+}
+
+
+void test_window()
+{
+    struct transport t;
+    struct batch *b = make(&t, 5, 0, 0);
+
+    CU_ASSERT_FATAL(NULL != b);
+
+    add(b, 0, XA_OK);
+    add(b, 1, XA_OK);
+    add(b, 2, XA_OK);
+    CU_ASSERT(0 == t.calls);
+    CU_ASSERT(3 == batch_pending(b));
+
+    while (0 == t.calls) {
+        event_loop_run_once(loop, 100, NULL);
+    }
+
+    /* One hand off, in order. */
+    CU_ASSERT(1 == t.calls);
+    CU_ASSERT(3 == t.seen);
+    CU_ASSERT(0 == batch_pending(b));
+
+    batch_destroy(b);
+}
+
+
+void test_budgets()
+{
+    struct transport t;
+    struct batch *b;
+
+    /* 3 messages fill the arena. */
+    b = make(&t, 10000, 3 * msg_len, 0);
+    CU_ASSERT_FATAL(NULL != b);
+    add(b, 0, XA_OK);
+    add(b, 1, XA_OK);
+    CU_ASSERT(0 == t.calls);
+    add(b, 2, XA_OK);
+    CU_ASSERT(1 == t.calls);
+    CU_ASSERT(3 == t.seen);
+    batch_destroy(b);
+
+    b = make(&t, 10000, 0, 2);
+    CU_ASSERT_FATAL(NULL != b);
+    add(b, 0, XA_OK);
+    add(b, 1, XA_OK);
+    add(b, 2, XA_OK);
+    CU_ASSERT(1 == t.calls);
+    CU_ASSERT(1 == batch_pending(b));
+    batch_destroy(b);
+}
+
+
+void test_partial()
+{
+    struct transport t;
+    struct batch *b = make(&t, 10000, 3 * msg_len, 0);
+
+    CU_ASSERT_FATAL(NULL != b);
+
+    t.accept = 1;
+    add(b, 0, XA_OK);
+    add(b, 1, XA_OK);
+    add(b, 2, XA_OK);
+    CU_ASSERT(1 == t.seen);
+    CU_ASSERT(2 == batch_pending(b));
+
+    /* The transport is down. */
+    t.accept = 0;
+    add(b, 3, XA_OK);
+    add(b, 4, XA_INSUFFICIENT_RESOURCES);
+    CU_ASSERT(3 == batch_pending(b));
+
+    /* It comes back; everything arrives in order. */
+    t.accept = 100;
+    CU_ASSERT(0 == batch_flush(b));
+    CU_ASSERT(4 == t.seen);
+    CU_ASSERT_STRING_EQUAL(t.dests[3], "d3");
+
+    batch_destroy(b);
+}
+
+
+void test_partial_window()
+{
+    struct transport t;
+    struct batch *b = make(&t, 5, 0, 0);
+
+    CU_ASSERT_FATAL(NULL != b);
+
+    t.accept = 1;
+    add(b, 0, XA_OK);
+    add(b, 1, XA_OK);
+    add(b, 2, XA_OK);
+
+    while (0 == t.calls) {
+        event_loop_run_once(loop, 100, NULL);
+    }
+    CU_ASSERT(1 == t.seen);
+    CU_ASSERT(2 == batch_pending(b));
+
+    /* Nothing else is added; the leftovers still go out a window later. */
+    t.accept = 100;
+    for (int i = 0; (i < 10) && (1 == t.calls); i++) {
+        event_loop_run_once(loop, 100, NULL);
+    }
+    CU_ASSERT(2 == t.calls);
+    CU_ASSERT(3 == t.seen);
+    CU_ASSERT(0 == batch_pending(b));
+    CU_ASSERT_STRING_EQUAL(t.dests[2], "d2");
+
+    batch_destroy(b);
+}
+
+
+void test_transport_down()
+{
+    struct transport t;
+    struct batch *b = make(&t, 0, 0, 0);
+
+    CU_ASSERT_FATAL(NULL != b);
+
+    t.accept = 0;
+    add(b, 0, XA_OK);
+    add(b, 1, XA_OK);
+    while (0 == t.calls) {
+        event_loop_run_once(loop, 100, NULL);
+    }
+
+    /* Nothing was taken, so nothing is retried until asked. */
+    for (int i = 0; i < 5; i++) {
+        event_loop_run_once(loop, 10, NULL);
+    }
+    CU_ASSERT(1 == t.calls);
+    CU_ASSERT(2 == batch_pending(b));
+
+    t.accept = 100;
+    CU_ASSERT(0 == batch_flush(b));
+    CU_ASSERT(2 == t.calls);
+    CU_ASSERT(2 == t.seen);
+
+    batch_destroy(b);
+}
+
+
+void test_encoded()
+{
+    struct transport t;
+    struct batch *b = make(&t, 10000, 0, 2);
+    struct wrp_out msg;
+    uint8_t buf[64];
+    char dest[8];
+    size_t len;
+
+    CU_ASSERT_FATAL(NULL != b);
+
+    for (int i = 0; i < 2; i++) {
+        make_msg(&msg, dest, i);
+        len = wrp_encode(enc, &msg, buf, sizeof(buf));
+        CU_ASSERT(XA_OK == batch_add_encoded(b, buf, len, NULL));
+    }
+    CU_ASSERT(2 == t.seen);
+
+    CU_ASSERT(XA_INVALID_INPUT == batch_add_encoded(b, NULL, 1, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == batch_add_encoded(b, buf, 0, NULL));
+
+    batch_destroy(b);
+}
+
+
+void test_bad_inputs()
+{
+    struct batch_opts opts = { .loop = loop, .send = NULL };
+    struct transport t;
+    struct wrp_out msg;
+    struct batch *b;
+    XAcode err = XA_OK;
+
+    CU_ASSERT(NULL == batch_create(NULL, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == batch_create(&opts, NULL));
+
+    b = make(&t, 10, 0, 0);
+    CU_ASSERT_FATAL(NULL != b);
+
+    memset(&msg, 0, sizeof(msg));
+    CU_ASSERT(XA_INVALID_INPUT == batch_add(b, enc, &msg, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == batch_add(NULL, enc, &msg, NULL));
+    CU_ASSERT(0 == batch_flush(NULL));
+    CU_ASSERT(0 == batch_pending(NULL));
+
+    batch_destroy(b);
+    batch_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("batch.c tests", NULL, NULL);
+    CU_add_test(*suite, "Window Test", test_window);
+    CU_add_test(*suite, "Budgets Test", test_budgets);
+    CU_add_test(*suite, "Partial Test", test_partial);
+    CU_add_test(*suite, "Partial Window Test", test_partial_window);
+    CU_add_test(*suite, "Transport Down Test", test_transport_down);
+    CU_add_test(*suite, "Encoded Test", test_encoded);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    loop = event_loop_create(NULL);
+    enc  = wrp_encoder_create("mac:112233445566", NULL);
+    if (!loop || !enc) {
+        return 1;
+    }
+    msg_len = wrp_encode(enc, &(struct wrp_out) { .msg_type = WRP_MSG_TYPE__EVENT,
+                                                  .dest     = { 2, "d0" } },
+                         NULL, 0);
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    wrp_encoder_destroy(enc);
+    event_loop_destroy(loop);
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,291 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/logging/binlog.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static uint8_t stream[4096];
+static size_t stream_len;
+static uint32_t next_id;
+
+
+static void stream_reset(void)
+{
+    stream_len = binlog_put_header(stream, sizeof(stream));
+    next_id    = 0;
+}
+
+
+/* Appends the format and args records for one call, the way the writer
+ * does. */
+static bool record(const char *format, ...)
+{
+    uint8_t args[256];
+    size_t len = 0;
+    va_list ap;
+    bool ok;
+
+    va_start(ap, format);
+    ok = binlog_encode_args(args, sizeof(args), &len, format, ap);
+    va_end(ap);
+
+    if (ok) {
+        stream_len += binlog_put_format(&stream[stream_len], sizeof(stream) - stream_len,
+                                        next_id, format);
+        stream_len += binlog_put_args(&stream[stream_len], sizeof(stream) - stream_len,
+                                      next_id, 2, 1234000000000ull, args, len);
+        next_id++;
+    }
+
+    return ok;
+}
+
+
+/* Reads every line in the stream, checking each against the expected text. */
+static void check(const char **want, size_t count)
+{
+    struct binlog_reader *r  = binlog_reader_create(NULL);
+    struct binlog_line *line = malloc(sizeof(struct binlog_line));
+    size_t at                = 0;
+    size_t lines             = 0;
+
+    CU_ASSERT_FATAL(NULL != r);
+    CU_ASSERT_FATAL(NULL != line);
+
+    while (at < stream_len) {
+        size_t used = 0;
+
+        CU_ASSERT_FATAL(XA_OK == binlog_reader_next(r, &stream[at], stream_len - at,
+                                                    &used, line, NULL));
+        CU_ASSERT_FATAL(0 < used);
+        at += used;
+
+        if (line->valid) {
+            CU_ASSERT_FATAL(lines < count);
+            CU_ASSERT(line->len == strlen(line->text));
+            CU_ASSERT_STRING_EQUAL(line->text, want[lines]);
+            if (0 != strcmp(line->text, want[lines])) {
+                printf("\ngot:  '%s'\nwant: '%s'\n", line->text, want[lines]);
+            }
+            lines++;
+        }
+    }
+    CU_ASSERT(count == lines);
+
+    free(line);
+    binlog_reader_destroy(r);
+}
+
+
+void test_round_trip()
+{
+    const char *s = "abcdef";
+    char want[12][128];
+    const char *wants[12];
+
+    stream_reset();
+
+    CU_ASSERT(record("plain text, 100%% literal"));
+    snprintf(want[0], 128, "plain text, 100%% literal");
+
+    CU_ASSERT(record("%d %i %u %x %X %o", -42, 7, 42u, 255u, 255u, 8u));
+    snprintf(want[1], 128, "%d %i %u %x %X %o", -42, 7, 42u, 255u, 255u, 8u);
+
+    CU_ASSERT(record("%ld %llu %zu %zd %hhd %hu", -1L, 18446744073709551615ull,
+                     (size_t) 12345, (size_t) 99, -3, 65535));
+    snprintf(want[2], 128, "%ld %llu %zu %zd %hhd %hu", -1L, 18446744073709551615ull,
+             (size_t) 12345, (size_t) 99, -3, 65535);
+
+    CU_ASSERT(record("%-*s|%*s|%.*s|", 10, "left", 8, "right", 3, s));
+    snprintf(want[3], 128, "%-*s|%*s|%.*s|", 10, "left", 8, "right", 3, s);
+
+    CU_ASSERT(record("%6zu|%-6d|%06d|%+d", (size_t) 5, 12, 34, 56));
+    snprintf(want[4], 128, "%6zu|%-6d|%06d|%+d", (size_t) 5, 12, 34, 56);
+
+    CU_ASSERT(record("%f %.2f %e %g", 3.5, 2.0 / 3.0, 12345.678, 0.0001));
+    snprintf(want[5], 128, "%f %.2f %e %g", 3.5, 2.0 / 3.0, 12345.678, 0.0001);
+
+    CU_ASSERT(record("%c%c '%s' %.2s", 'o', 'k', "", s));
+    snprintf(want[6], 128, "%c%c '%s' %.2s", 'o', 'k', "", s);
+
+    CU_ASSERT(record("%s", (const char *) NULL));
+    snprintf(want[7], 128, "(null)");
+
+    CU_ASSERT(record("%*d|%.*d", -5, 1, -1, 2));
+    snprintf(want[8], 128, "%*d|%.*d", -5, 1, -1, 2);
+
+    for (size_t i = 0; i < 9; i++) {
+        wants[i] = want[i];
+    }
+    check(wants, 9);
+}
+
+
+void test_text_records()
+{
+    const char *want[] = { "already formatted", "second" };
+
+    stream_reset();
+    stream_len += binlog_put_text(&stream[stream_len], sizeof(stream) - stream_len,
+                                  4, 1, want[0], strlen(want[0]));
+
+    /* A second stream appended to the first starts over. */
+    stream_len += binlog_put_header(&stream[stream_len], sizeof(stream) - stream_len);
+    next_id = 0;
+    CU_ASSERT(record("%s", "second"));
+
+    check(want, 2);
+}
+
+
+void test_not_encodable()
+{
+    stream_reset();
+    CU_ASSERT(!record("%ls", L"wide"));
+    CU_ASSERT(!record("%q", 1));
+    CU_ASSERT(!record("trailing %"));
+
+    /* Too big for the buffer. */
+    CU_ASSERT(!record("%s %s %s", "this string is long enough to need more",
+                      "room than the args buffer that record() uses has, once",
+                      "all three are in it, which is 256 bytes and no more than "
+                      "that, so it has to say no, and the caller logs text....."
+                      "................................................"));
+    CU_ASSERT(BINLOG_HEADER_LEN == stream_len);
+}
+
+
+void test_partial()
+{
+    struct binlog_reader *r  = binlog_reader_create(NULL);
+    struct binlog_line *line = malloc(sizeof(struct binlog_line));
+    size_t at                = 0;
+    size_t lines             = 0;
+
+    CU_ASSERT_FATAL(NULL != r);
+    CU_ASSERT_FATAL(NULL != line);
+
+    stream_reset();
+    CU_ASSERT(record("%s=%d", "x", 1));
+    CU_ASSERT(record("%s=%d", "y", 2));
+
+    /* Feed it one more byte at a time; it waits until a record is whole. */
+    for (size_t end = 1; end <= stream_len; end++) {
+        size_t used = 0;
+
+        CU_ASSERT_FATAL(XA_OK == binlog_reader_next(r, &stream[at], end - at,
+                                                    &used, line, NULL));
+        at += used;
+        if (used && line->valid) {
+            lines++;
+        }
+    }
+    CU_ASSERT(stream_len == at);
+    CU_ASSERT(2 == lines);
+
+    free(line);
+    binlog_reader_destroy(r);
+}
+
+
+void test_corrupt()
+{
+    struct binlog_reader *r;
+    struct binlog_line *line = malloc(sizeof(struct binlog_line));
+    uint8_t bad[]            = { 'A', 5, 2, 0, 0 };
+    size_t at                = 0;
+    XAcode rv                = XA_OK;
+    size_t used;
+    XAcode err;
+
+    CU_ASSERT_FATAL(NULL != line);
+
+    /* Not a stream at all. */
+    r = binlog_reader_create(NULL);
+    CU_ASSERT(XA_INVALID_INPUT == binlog_reader_next(r, (const uint8_t *) "hello", 5, &used, line, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    binlog_reader_destroy(r);
+
+    /* A format id that was never defined. */
+    r = binlog_reader_create(NULL);
+    stream_reset();
+    memcpy(&stream[stream_len], bad, sizeof(bad));
+    stream_len += sizeof(bad);
+    CU_ASSERT(XA_OK == binlog_reader_next(r, stream, stream_len, &used, line, NULL));
+    CU_ASSERT(BINLOG_HEADER_LEN == used);
+    CU_ASSERT(XA_INVALID_INPUT == binlog_reader_next(r, &stream[used], stream_len - used, &used, line, NULL));
+    binlog_reader_destroy(r);
+
+    /* Arguments that don't match the format. */
+    r = binlog_reader_create(NULL);
+    stream_reset();
+    CU_ASSERT(record("%d", 1));
+    stream[stream_len - 2] = 2;    /* the args length */
+    stream[stream_len - 1] = 0x80; /* a varint that never ends */
+    stream[stream_len++]   = 0x80;
+    while ((XA_OK == rv) && (at < stream_len)) {
+        rv = binlog_reader_next(r, &stream[at], stream_len - at, &used, line, NULL);
+        if (!used) {
+            break;
+        }
+        at += used;
+    }
+    CU_ASSERT(XA_INVALID_INPUT == rv);
+    binlog_reader_destroy(r);
+
+    CU_ASSERT(XA_INVALID_INPUT == binlog_reader_next(NULL, stream, stream_len, &used, line, NULL));
+    CU_ASSERT_STRING_EQUAL("INFO ", binlog_level_name(2));
+    CU_ASSERT_STRING_EQUAL("?????", binlog_level_name(6));
+
+    free(line);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("binlog.c tests", NULL, NULL);
+    CU_add_test(*suite, "Round trip Test", test_round_trip);
+    CU_add_test(*suite, "Text records Test", test_text_records);
+    CU_add_test(*suite, "Not encodable Test", test_not_encodable);
+    CU_add_test(*suite, "Partial Test", test_partial);
+    CU_add_test(*suite, "Corrupt Test", test_corrupt);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
@@ -35,16 +35,47 @@ void test_error_to_string(void)
     TEST(XA_CLI_ERROR);
     TEST(XA_CONFIG_FILE_ERROR);
     TEST(XA_INSUFFICIENT_RESOURCES);
+    TEST(XA_EVENT_LOOP_ERROR);
+    TEST(XA_WEBSOCKET_ERROR);
+    TEST(XA_NOT_CONNECTED);
+    TEST(XA_INVALID_WRP);
+    TEST(XA_NO_ROUTE);
 
     CU_ASSERT_STRING_EQUAL(xa_error_to_string((XAcode) -1), "XAcode is out of bounds");
     CU_ASSERT_STRING_EQUAL(xa_error_to_string((XAcode) 1000), "XAcode is out of bounds");
 }
 
 
+void test_error_count(void)
+{
+    XAcode err = XA_OK;
+
+    CU_ASSERT(0 == xa_error_count(XA_NO_ROUTE));
+    CU_ASSERT(XA_NO_ROUTE == xa_set_error(&err, XA_NO_ROUTE));
+    xa_set_error(NULL, XA_NO_ROUTE);
+    CU_ASSERT(2 == xa_error_count(XA_NO_ROUTE));
+
+    /* Handing an error on doesn't count it again. */
+    err = XA_OK;
+    CU_ASSERT(XA_NO_ROUTE == xa_pass_error(&err, XA_NO_ROUTE));
+    CU_ASSERT(XA_NO_ROUTE == err);
+    xa_pass_error(NULL, XA_NO_ROUTE);
+    CU_ASSERT(2 == xa_error_count(XA_NO_ROUTE));
+
+    /* Success isn't counted, and neither is nonsense. */
+    xa_set_error(&err, XA_OK);
+    xa_set_error(&err, XA_LAST);
+    CU_ASSERT(0 == xa_error_count(XA_OK));
+    CU_ASSERT(0 == xa_error_count(XA_LAST));
+    CU_ASSERT(0 == xa_error_count((XAcode) -1));
+}
+
+
 void add_suites(CU_pSuite *suite)
 {
     *suite = CU_add_suite("codes.c tests", NULL, NULL);
     CU_add_test(*suite, "xa_error_to_string() Tests", test_error_to_string);
+    CU_add_test(*suite, "xa_error_count() Tests", test_error_count);
 }
 
 
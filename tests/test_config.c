@@ -123,13 +123,37 @@ void test_simple(const char *dir)
 
     CU_ASSERT_STRING_EQUAL(c->behavior.url.s, "URL");
     CU_ASSERT(c->behavior.ping_timeout == 90);
+    CU_ASSERT(c->behavior.ping_tick == 100);
     CU_ASSERT(c->behavior.backoff_max == 250);
     CU_ASSERT(c->behavior.force_ip == 4);
+    CU_ASSERT(c->behavior.verbosity_level == 1);
     CU_ASSERT(c->behavior.interface_count == 2);
 
     CU_ASSERT_STRING_EQUAL(c->behavior.dns_txt.base_fqdn.s, "xmidt.example.com");
     CU_ASSERT_STRING_EQUAL(c->behavior.dns_txt.jwt.keys_dir.s, "keys_dir");
     CU_ASSERT_STRING_EQUAL(c->behavior.issuer.url.s, "issuer.example.com");
+    CU_ASSERT_STRING_EQUAL(c->behavior.ipc.path.s, "/var/run/xmidt-agent.sock");
+    CU_ASSERT(c->behavior.outbound.batch_window == 5);
+    CU_ASSERT(c->behavior.outbound.batch_bytes == 32768);
+    CU_ASSERT(c->behavior.outbound.queue_bytes == 1048576);
+    CU_ASSERT_STRING_EQUAL(c->behavior.outbound.journal_path.s, "/var/lib/xmidt-agent/outbound.journal");
+    CU_ASSERT(c->behavior.outbound.journal_bytes == 4194304);
+    CU_ASSERT(c->behavior.outbound.journal_retention == 86400);
+    CU_ASSERT(c->behavior.logging.async_lines == 1024);
+    CU_ASSERT(c->behavior.logging.overflow == LOG_OVERFLOW__BLOCK);
+    CU_ASSERT(c->behavior.logging.format == LOG_FORMAT__BINARY);
+    CU_ASSERT(c->behavior.logging.subsecond_digits == 3);
+    CU_ASSERT(c->behavior.logging.rate_limit == 5);
+    CU_ASSERT(c->behavior.logging.rate_burst == 20);
+    CU_ASSERT(c->behavior.logging.repeats == LOG_REPEATS__COLLAPSE);
+    CU_ASSERT(c->behavior.logging.sink == LOG_SINK__JOURNALD);
+    CU_ASSERT_STRING_EQUAL(c->behavior.logging.sink_path.s, "/run/systemd/journal/socket");
+    CU_ASSERT_STRING_EQUAL(c->behavior.tracing.path.s, "/var/log/xmidt-agent/traces.jsonl");
+    CU_ASSERT(c->behavior.tracing.export_interval == 30);
+    CU_ASSERT(c->behavior.tracing.max_spans == 512);
+    CU_ASSERT(c->behavior.tracing.sample_every == 1000);
+    CU_ASSERT(c->behavior.tracing.slow_ms == 250);
+    CU_ASSERT_STRING_EQUAL(c->behavior.introspection.path.s, "/var/run/xmidt-agent-introspect.sock");
 
     config_destroy(c);
     free(path);
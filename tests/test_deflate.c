@@ -0,0 +1,277 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/websocket/deflate.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* The far end of the connection sees the parameters mirrored. */
+static struct deflate_params mirror(const struct deflate_params *p)
+{
+    struct deflate_params m = {
+        .client_max_window_bits     = p->server_max_window_bits,
+        .client_no_context_takeover = p->server_no_context_takeover,
+        .server_max_window_bits     = p->client_max_window_bits,
+        .server_no_context_takeover = p->client_no_context_takeover,
+    };
+
+    return m;
+}
+
+
+static size_t make_msg(int id, char *buf, size_t len)
+{
+    int rv = snprintf(buf, len,
+                      "\x85\xa8msg_type\x04\xa6source\xb4mac:112233445566/cfg"
+                      "\xa4" "dest\xbd" "event:device-status/online/%d"
+                      "\xa7payload\xc4\x10{\"uptime\":%05d}",
+                      id % 10, id);
+
+    return (size_t) rv;
+}
+
+
+static void roundtrip(const struct deflate_params *p, size_t *first, size_t *last)
+{
+    struct deflate_params peer = mirror(p);
+    struct deflate_ctx *tx     = deflate_ctx_create(p, -1, NULL);
+    struct deflate_ctx *rx     = deflate_ctx_create(&peer, -1, NULL);
+
+    CU_ASSERT_FATAL(NULL != tx);
+    CU_ASSERT_FATAL(NULL != rx);
+
+    for (int i = 0; i < 50; i++) {
+        char msg[256];
+        size_t len = make_msg(i, msg, sizeof(msg));
+        const void *z, *out;
+        size_t z_len, out_len;
+
+        CU_ASSERT_FATAL(XA_OK == deflate_compress(tx, msg, len, &z, &z_len, NULL));
+        if (0 == i) {
+            *first = z_len;
+        }
+        *last = z_len;
+
+        CU_ASSERT_FATAL(XA_OK == deflate_decompress(rx, z, z_len, 1024, &out, &out_len, NULL));
+        CU_ASSERT_FATAL(len == out_len);
+        CU_ASSERT(0 == memcmp(msg, out, len));
+    }
+
+    deflate_ctx_destroy(tx);
+    deflate_ctx_destroy(rx);
+}
+
+
+void test_context_takeover()
+{
+    struct deflate_params p;
+    size_t first, last;
+
+    memset(&p, 0, sizeof(p));
+    roundtrip(&p, &first, &last);
+
+    /* Later messages refer back to the earlier ones. */
+    CU_ASSERT(last * 2 < first);
+
+    p.client_max_window_bits = 9;
+    p.server_max_window_bits = 10;
+    roundtrip(&p, &first, &last);
+    CU_ASSERT(last * 2 < first);
+}
+
+
+void test_no_context_takeover()
+{
+    struct deflate_params p;
+    size_t first, last;
+
+    memset(&p, 0, sizeof(p));
+    p.client_no_context_takeover = true;
+    p.server_no_context_takeover = true;
+    roundtrip(&p, &first, &last);
+
+    /* Every message stands alone. */
+    CU_ASSERT(first - 2 <= last);
+}
+
+
+void test_large_and_empty()
+{
+    struct deflate_params p;
+    struct deflate_ctx *ctx;
+    uint8_t *big = malloc(256 * 1024);
+    const void *z, *out;
+    size_t z_len, out_len;
+
+    CU_ASSERT_FATAL(NULL != big);
+    for (size_t i = 0; i < 256 * 1024; i++) {
+        big[i] = (uint8_t) ((i * 7919) >> 3);
+    }
+
+    memset(&p, 0, sizeof(p));
+    ctx = deflate_ctx_create(&p, 6, NULL);
+    CU_ASSERT_FATAL(NULL != ctx);
+
+    CU_ASSERT_FATAL(XA_OK == deflate_compress(ctx, big, 256 * 1024, &z, &z_len, NULL));
+
+    /* Decompress with the same context; the parameters are symmetric. */
+    {
+        uint8_t *copy = malloc(z_len);
+        CU_ASSERT_FATAL(NULL != copy);
+        memcpy(copy, z, z_len);
+
+        CU_ASSERT(XA_INSUFFICIENT_RESOURCES
+                  == deflate_decompress(ctx, copy, z_len, 1024, &out, &out_len, NULL));
+        CU_ASSERT(XA_OK == deflate_decompress(ctx, copy, z_len, 256 * 1024, &out, &out_len, NULL));
+        CU_ASSERT(256 * 1024 == out_len);
+        CU_ASSERT(0 == memcmp(big, out, out_len));
+        free(copy);
+    }
+
+    CU_ASSERT(XA_OK == deflate_compress(ctx, NULL, 0, &z, &z_len, NULL));
+    CU_ASSERT(1 == z_len);
+    CU_ASSERT(XA_OK == deflate_decompress(ctx, "\x00", 1, 10, &out, &out_len, NULL));
+    CU_ASSERT(0 == out_len);
+    CU_ASSERT(XA_INVALID_INPUT == deflate_decompress(ctx, "\xff\xff\xff", 3, 10, &out, &out_len, NULL));
+
+    deflate_ctx_destroy(ctx);
+    free(big);
+}
+
+
+void test_offer()
+{
+    struct deflate_params p;
+    char buf[256];
+
+    memset(&p, 0, sizeof(p));
+    CU_ASSERT(strlen("Sec-WebSocket-Extensions: permessage-deflate; "
+                     "client_max_window_bits=15; server_max_window_bits=15")
+              == deflate_offer(&p, buf, sizeof(buf)));
+    CU_ASSERT_STRING_EQUAL(buf, "Sec-WebSocket-Extensions: permessage-deflate; "
+                                "client_max_window_bits=15; server_max_window_bits=15");
+
+    p.client_max_window_bits     = 10;
+    p.server_max_window_bits     = 3;
+    p.client_no_context_takeover = true;
+    deflate_offer(&p, buf, sizeof(buf));
+    CU_ASSERT_STRING_EQUAL(buf, "Sec-WebSocket-Extensions: permessage-deflate; "
+                                "client_max_window_bits=10; server_max_window_bits=15; "
+                                "client_no_context_takeover");
+
+    CU_ASSERT(10 < deflate_offer(&p, buf, 10));
+    CU_ASSERT(0 == deflate_offer(NULL, buf, sizeof(buf)));
+}
+
+
+void test_accept()
+{
+    struct deflate_params want;
+    struct deflate_params got;
+    XAcode err = XA_OK;
+
+    memset(&want, 0, sizeof(want));
+    want.client_max_window_bits = 12;
+    want.server_max_window_bits = 11;
+
+    CU_ASSERT(XA_OK == deflate_accept(&want, "permessage-deflate", &got, NULL));
+    CU_ASSERT(12 == got.client_max_window_bits);
+    CU_ASSERT(15 == got.server_max_window_bits);
+    CU_ASSERT(false == got.client_no_context_takeover);
+    CU_ASSERT(false == got.server_no_context_takeover);
+
+    CU_ASSERT(XA_OK == deflate_accept(&want, "x-foo; a=1, permessage-deflate ; "
+                                             "server_max_window_bits=\"10\"; "
+                                             "client_max_window_bits=9;"
+                                             "server_no_context_takeover; "
+                                             "client_no_context_takeover",
+                                      &got, NULL));
+    CU_ASSERT(9 == got.client_max_window_bits);
+    CU_ASSERT(10 == got.server_max_window_bits);
+    CU_ASSERT(true == got.client_no_context_takeover);
+    CU_ASSERT(true == got.server_no_context_takeover);
+
+    /* Not accepted. */
+    CU_ASSERT(XA_INVALID_INPUT == deflate_accept(&want, "x-foo", &got, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(XA_INVALID_INPUT == deflate_accept(&want, NULL, &got, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == deflate_accept(NULL, "permessage-deflate", &got, NULL));
+
+    /* Violations of the offer. */
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; server_max_window_bits=12", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; client_max_window_bits=13", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; client_max_window_bits=8", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; client_max_window_bits", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; server_max_window_bits=1x", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; server_no_context_takeover; server_no_context_takeover", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; server_no_context_takeover=1", &got, NULL));
+    CU_ASSERT(XA_WEBSOCKET_ERROR == deflate_accept(&want, "permessage-deflate; unknown", &got, NULL));
+}
+
+
+void test_bad_inputs()
+{
+    struct deflate_params p;
+    const void *out;
+    size_t len;
+    XAcode err = XA_OK;
+
+    memset(&p, 0, sizeof(p));
+    CU_ASSERT(NULL == deflate_ctx_create(NULL, -1, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == deflate_ctx_create(&p, 10, NULL));
+
+    CU_ASSERT(XA_INVALID_INPUT == deflate_compress(NULL, "a", 1, &out, &len, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == deflate_decompress(NULL, "a", 1, 1, &out, &len, NULL));
+    deflate_ctx_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("deflate.c tests", NULL, NULL);
+    CU_add_test(*suite, "Context takeover Test", test_context_takeover);
+    CU_add_test(*suite, "No context takeover Test", test_no_context_takeover);
+    CU_add_test(*suite, "Large and empty Test", test_large_and_empty);
+    CU_add_test(*suite, "Offer Test", test_offer);
+    CU_add_test(*suite, "Accept Test", test_accept);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
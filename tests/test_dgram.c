@@ -0,0 +1,236 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L /* mkdtemp() */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../src/logging/dgram.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static char dir[64];
+static char path[96];
+
+
+/* Stands in for the daemon. */
+static int daemon_open(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    CU_ASSERT(0 <= fd);
+    CU_ASSERT(0 == bind(fd, (struct sockaddr *) &addr, sizeof(addr)));
+
+    return fd;
+}
+
+
+static ssize_t daemon_read(int fd, char *buf, size_t size)
+{
+    ssize_t n = recv(fd, buf, size - 1, MSG_DONTWAIT);
+
+    buf[(0 < n) ? n : 0] = '\0';
+    return n;
+}
+
+
+static void paths(void)
+{
+    strcpy(dir, "/tmp/test_dgram.XXXXXX");
+    CU_ASSERT_FATAL(NULL != mkdtemp(dir));
+    snprintf(path, sizeof(path), "%s/socket", dir);
+}
+
+
+void test_journald()
+{
+    struct log_dgram_opts opts = { .proto = LOG_DGRAM__JOURNALD };
+    struct log_record r        = {
+        .level = LOG_LEVEL__ERROR,
+        .file  = "../src/websocket/ws_conn.c",
+        .line  = 42,
+        .code  = XA_WEBSOCKET_ERROR,
+        .text  = "Unable to connect",
+        .len   = 17,
+    };
+    struct log_dgram *d;
+    char buf[2048];
+    char want[512];
+    ssize_t n;
+    int fd;
+
+    paths();
+    opts.path = path;
+
+    /* Nothing is listening yet. */
+    CU_ASSERT(NULL == log_dgram_create(&opts, NULL));
+    CU_ASSERT(NULL == log_dgram_create(NULL, NULL));
+
+    fd = daemon_open();
+    d  = log_dgram_create(&opts, NULL);
+    CU_ASSERT_FATAL(NULL != d);
+
+    CU_ASSERT(log_dgram_send(&r, d));
+    CU_ASSERT(0 < daemon_read(fd, buf, sizeof(buf)));
+    snprintf(want, sizeof(want),
+             "PRIORITY=3\n"
+             "SYSLOG_IDENTIFIER=xmidt-agent\n"
+             "CODE_FILE=../src/websocket/ws_conn.c\n"
+             "CODE_LINE=42\n"
+             "XA_MODULE=ws_conn\n"
+             "XA_CODE=%d\n"
+             "XA_ERROR=%s\n"
+             "MESSAGE=Unable to connect\n",
+             (int) XA_WEBSOCKET_ERROR, xa_error_to_string(XA_WEBSOCKET_ERROR));
+    CU_ASSERT_STRING_EQUAL(buf, want);
+
+    /* No call site or code, and a line break in the text. */
+    r.level = LOG_LEVEL__INFO;
+    r.file  = NULL;
+    r.code  = XA_OK;
+    r.text  = "two\nlines";
+    r.len   = 9;
+    CU_ASSERT(log_dgram_send(&r, d));
+    n = daemon_read(fd, buf, sizeof(buf));
+    CU_ASSERT(49 + 8 + 9 + 1 == n);
+    CU_ASSERT(0 == memcmp(buf, "PRIORITY=6\nSYSLOG_IDENTIFIER=xmidt-agent\nMESSAGE\n", 49));
+    CU_ASSERT(9 == buf[49]);
+    CU_ASSERT(0 == memcmp(&buf[57], "two\nlines\n", 10));
+
+    log_dgram_destroy(d);
+    close(fd);
+    unlink(path);
+    rmdir(dir);
+}
+
+
+void test_syslog()
+{
+    struct log_dgram_opts opts = { .proto = LOG_DGRAM__SYSLOG, .ident = "agent" };
+    struct log_record r        = {
+        .level   = LOG_LEVEL__WARN,
+        .when_ns = 1000000000ull * 86400 + 123456789,
+        .file    = "dns_txt.c",
+        .line    = 7,
+        .code    = XA_DNS_NAME_ERROR,
+        .text    = "lookup failed",
+        .len     = 13,
+    };
+    struct log_dgram *d;
+    char buf[2048];
+    char want[512];
+    int fd;
+
+    paths();
+    opts.path = path;
+    fd        = daemon_open();
+    d         = log_dgram_create(&opts, NULL);
+    CU_ASSERT_FATAL(NULL != d);
+
+    CU_ASSERT(log_dgram_send(&r, d));
+    CU_ASSERT(0 < daemon_read(fd, buf, sizeof(buf)));
+    snprintf(want, sizeof(want),
+             "<28>1 1970-01-02T00:00:00.123456Z - agent %d - [xa@32473 level=\"warn\""
+             " module=\"dns_txt\" file=\"dns_txt.c\" line=\"7\" code=\"%d\" error=\"%s\"]"
+             " lookup failed",
+             (int) getpid(), (int) XA_DNS_NAME_ERROR, xa_error_to_string(XA_DNS_NAME_ERROR));
+    CU_ASSERT_STRING_EQUAL(buf, want);
+
+    /* Values are escaped. */
+    r.file = "a\"b]c.c";
+    r.code = XA_OK;
+    CU_ASSERT(log_dgram_send(&r, d));
+    CU_ASSERT(0 < daemon_read(fd, buf, sizeof(buf)));
+    CU_ASSERT(NULL != strstr(buf, " module=\"a\\\"b\\]c\" file=\"a\\\"b\\]c.c\" line=\"7\"]"));
+
+    log_dgram_destroy(d);
+    close(fd);
+    unlink(path);
+    rmdir(dir);
+}
+
+
+void test_full_and_restart()
+{
+    struct log_dgram_opts opts = { .proto = LOG_DGRAM__JOURNALD };
+    struct log_record r        = { .level = LOG_LEVEL__INFO, .text = "x", .len = 1 };
+    struct log_dgram *d;
+    char buf[256];
+    int sent = 0;
+    int fd;
+
+    paths();
+    opts.path = path;
+    fd        = daemon_open();
+    d         = log_dgram_create(&opts, NULL);
+    CU_ASSERT_FATAL(NULL != d);
+
+    /* Nobody reads, so it fills up and says so instead of blocking. */
+    while ((sent < 100000) && log_dgram_send(&r, d)) {
+        sent++;
+    }
+    CU_ASSERT(0 < sent);
+    CU_ASSERT(sent < 100000);
+
+    /* The daemon restarts. */
+    close(fd);
+    fd = daemon_open();
+    CU_ASSERT(log_dgram_send(&r, d));
+    CU_ASSERT(0 < daemon_read(fd, buf, sizeof(buf)));
+
+    log_dgram_destroy(d);
+    close(fd);
+    unlink(path);
+    rmdir(dir);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("dgram.c tests", NULL, NULL);
+    CU_add_test(*suite, "journald Test", test_journald);
+    CU_add_test(*suite, "syslog Test", test_syslog);
+    CU_add_test(*suite, "Full and restart Test", test_full_and_restart);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
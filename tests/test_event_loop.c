@@ -0,0 +1,329 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/event_loop/event_loop.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct order {
+    struct event_loop *loop;
+    int seen[8];
+    int count;
+    int stop_after;
+};
+
+struct fired {
+    struct order *o;
+    int id;
+};
+
+struct post_ctx {
+    struct event_loop *loop;
+    pthread_t loop_thread;
+    int on_loop_thread;
+    int count;
+};
+
+struct pipe_ctx {
+    struct event_loop *loop;
+    int fds[2];
+    struct event_watch *w;
+    struct event_watch *other;
+    int count;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void record(struct event_timer *t, void *user)
+{
+    struct fired *f = (struct fired *) user;
+
+    (void) t;
+
+    f->o->seen[f->o->count] = f->id;
+    f->o->count++;
+    if (f->o->count == f->o->stop_after) {
+        event_loop_stop(f->o->loop);
+    }
+}
+
+
+void test_timer_order(void)
+{
+    struct order o;
+    struct fired f[3];
+    struct event_timer *t[3];
+    uint64_t delays[3] = { 30, 10, 20 };
+    XAcode rv          = XA_OK;
+
+    memset(&o, 0, sizeof(o));
+    o.loop       = event_loop_create(&rv);
+    o.stop_after = 3;
+    CU_ASSERT_FATAL(NULL != o.loop);
+
+    for (int i = 0; i < 3; i++) {
+        f[i].o  = &o;
+        f[i].id = i;
+        t[i]    = event_timer_create(o.loop, record, &f[i], &rv);
+        CU_ASSERT_FATAL(NULL != t[i]);
+        event_timer_start(t[i], delays[i], 0);
+        CU_ASSERT(event_timer_is_active(t[i]));
+    }
+
+    CU_ASSERT(XA_OK == event_loop_run(o.loop, &rv));
+    CU_ASSERT(3 == o.count);
+    CU_ASSERT(1 == o.seen[0]);
+    CU_ASSERT(2 == o.seen[1]);
+    CU_ASSERT(0 == o.seen[2]);
+    CU_ASSERT(!event_timer_is_active(t[0]));
+
+    /* Leave one timer for the loop to clean up. */
+    event_timer_destroy(t[0]);
+    event_timer_destroy(t[1]);
+    event_loop_destroy(o.loop);
+}
+
+
+void test_timer_periodic_and_stop(void)
+{
+    struct order o;
+    struct fired f[2];
+    struct event_timer *periodic = NULL;
+    struct event_timer *never    = NULL;
+    XAcode rv                    = XA_OK;
+
+    memset(&o, 0, sizeof(o));
+    o.loop       = event_loop_create(&rv);
+    o.stop_after = 4;
+    CU_ASSERT_FATAL(NULL != o.loop);
+
+    f[0].o   = &o;
+    f[0].id  = 5;
+    f[1].o   = &o;
+    f[1].id  = 6;
+    periodic = event_timer_create(o.loop, record, &f[0], &rv);
+    never    = event_timer_create(o.loop, record, &f[1], &rv);
+
+    event_timer_start(never, 5, 0);
+    event_timer_start(periodic, 1, 2);
+    event_timer_stop(never);
+    CU_ASSERT(!event_timer_is_active(never));
+
+    CU_ASSERT(XA_OK == event_loop_run(o.loop, &rv));
+    CU_ASSERT(4 == o.count);
+    for (int i = 0; i < 4; i++) {
+        CU_ASSERT(5 == o.seen[i]);
+    }
+    CU_ASSERT(event_timer_is_active(periodic));
+
+    event_timer_destroy(periodic);
+    event_timer_destroy(never);
+    event_timer_destroy(NULL);
+    event_loop_destroy(o.loop);
+}
+
+
+static void on_readable(struct event_watch *w, int fd, unsigned events, void *user)
+{
+    struct pipe_ctx *p = (struct pipe_ctx *) user;
+    char buf[16];
+    ssize_t n;
+
+    CU_ASSERT(w == p->w);
+    CU_ASSERT(EVENT__READABLE & events);
+
+    n = read(fd, buf, sizeof(buf));
+    CU_ASSERT(0 < n);
+    p->count++;
+
+    /* Remove the other watch even though it may be pending in this pass. */
+    event_watch_remove(p->other);
+    p->other = NULL;
+
+    event_loop_stop(p->loop);
+}
+
+
+void test_watch(void)
+{
+    struct pipe_ctx a;
+    struct pipe_ctx b;
+    XAcode rv               = XA_OK;
+    struct event_loop *loop = event_loop_create(&rv);
+
+    CU_ASSERT_FATAL(NULL != loop);
+
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    CU_ASSERT_FATAL(0 == pipe(a.fds));
+    CU_ASSERT_FATAL(0 == pipe(b.fds));
+    a.loop = loop;
+    b.loop = loop;
+
+    a.w = event_loop_watch(loop, a.fds[0], EVENT__READABLE, on_readable, &a, &rv);
+    b.w = event_loop_watch(loop, b.fds[0], EVENT__READABLE, on_readable, &b, &rv);
+    CU_ASSERT_FATAL(NULL != a.w);
+    CU_ASSERT_FATAL(NULL != b.w);
+    a.other = b.w;
+    b.other = a.w;
+
+    CU_ASSERT(EVENT__READABLE == event_watch_events(a.w));
+
+    CU_ASSERT(1 == write(a.fds[1], "a", 1));
+    CU_ASSERT(1 == write(b.fds[1], "b", 1));
+
+    CU_ASSERT(XA_OK == event_loop_run(loop, &rv));
+
+    /* Only one of the two may run, the other was removed. */
+    CU_ASSERT(1 == (a.count + b.count));
+
+    /* Pausing means nothing is delivered. */
+    if (a.count) {
+        CU_ASSERT(XA_OK == event_watch_modify(a.w, 0, &rv));
+        CU_ASSERT(1 == write(a.fds[1], "a", 1));
+    } else {
+        CU_ASSERT(XA_OK == event_watch_modify(b.w, 0, &rv));
+        CU_ASSERT(1 == write(b.fds[1], "b", 1));
+    }
+    CU_ASSERT(XA_OK == event_loop_run_once(loop, 10, &rv));
+    CU_ASSERT(1 == (a.count + b.count));
+
+    event_loop_destroy(loop);
+    close(a.fds[0]);
+    close(a.fds[1]);
+    close(b.fds[0]);
+    close(b.fds[1]);
+}
+
+
+static void posted(void *user)
+{
+    struct post_ctx *p = (struct post_ctx *) user;
+
+    if (pthread_equal(pthread_self(), p->loop_thread)) {
+        p->on_loop_thread++;
+    }
+    p->count++;
+    if (2 == p->count) {
+        event_loop_stop(p->loop);
+    }
+}
+
+
+static void *poster(void *user)
+{
+    struct post_ctx *p = (struct post_ctx *) user;
+
+    event_loop_post(p->loop, posted, p, NULL);
+    event_loop_post(p->loop, posted, p, NULL);
+
+    return NULL;
+}
+
+
+void test_post(void)
+{
+    struct post_ctx p;
+    pthread_t thread;
+    XAcode rv = XA_OK;
+
+    memset(&p, 0, sizeof(p));
+    p.loop        = event_loop_create(&rv);
+    p.loop_thread = pthread_self();
+    CU_ASSERT_FATAL(NULL != p.loop);
+
+    CU_ASSERT_FATAL(0 == pthread_create(&thread, NULL, poster, &p));
+    CU_ASSERT(XA_OK == event_loop_run(p.loop, &rv));
+    pthread_join(thread, NULL);
+
+    CU_ASSERT(2 == p.count);
+    CU_ASSERT(2 == p.on_loop_thread);
+
+    /* Anything not yet run is discarded on destroy. */
+    event_loop_post(p.loop, posted, &p, NULL);
+    event_loop_destroy(p.loop);
+}
+
+
+void test_bad_inputs(void)
+{
+    XAcode rv               = XA_OK;
+    struct event_loop *loop = event_loop_create(&rv);
+
+    CU_ASSERT_FATAL(NULL != loop);
+
+    CU_ASSERT(XA_INVALID_INPUT == event_loop_run(NULL, &rv));
+    CU_ASSERT(XA_INVALID_INPUT == event_loop_run_once(NULL, 0, &rv));
+    CU_ASSERT(XA_INVALID_INPUT == event_loop_post(loop, NULL, NULL, &rv));
+    CU_ASSERT(NULL == event_loop_watch(loop, -1, EVENT__READABLE, on_readable, NULL, &rv));
+    CU_ASSERT(XA_INVALID_INPUT == rv);
+    CU_ASSERT(NULL == event_timer_create(loop, NULL, NULL, &rv));
+    CU_ASSERT(XA_INVALID_INPUT == event_watch_modify(NULL, 0, &rv));
+
+    /* Not a pollable fd. */
+    rv = XA_OK;
+    CU_ASSERT(NULL == event_loop_watch(loop, 1000, EVENT__READABLE, on_readable, NULL, &rv));
+    CU_ASSERT(XA_EVENT_LOOP_ERROR == rv);
+
+    /* Nothing to do, but shouldn't fail. */
+    CU_ASSERT(XA_OK == event_loop_run_once(loop, 0, &rv));
+
+    event_watch_remove(NULL);
+    event_loop_stop(NULL);
+    event_loop_wakeup(NULL);
+    event_loop_destroy(loop);
+    event_loop_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("event_loop.c tests", NULL, NULL);
+    CU_add_test(*suite, "Timer order Test", test_timer_order);
+    CU_add_test(*suite, "Periodic timer Test", test_timer_periodic_and_stop);
+    CU_add_test(*suite, "Watch Test", test_watch);
+    CU_add_test(*suite, "Post Test", test_post);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/websocket/iface.h"
+
+
+void test_default_route()
+{
+    struct iface_set s;
+
+    CU_ASSERT(XA_OK == iface_set_init(&s, NULL, 0, NULL));
+    CU_ASSERT(1 == s.count);
+    CU_ASSERT(NULL == s.list[0].name);
+    CU_ASSERT(&s.list[0] == iface_set_pick(&s, 0));
+
+    iface_set_destroy(&s);
+    CU_ASSERT(NULL == s.list);
+}
+
+
+void test_sorted_by_cost()
+{
+    struct interface in[] = {
+        { .name = { .s = "wlan0" }, .cost = 20 },
+        { .name = { .s = "lte0" }, .cost = 50 },
+        { .name = { .s = "eth1" }, .cost = 10 },
+        { .name = { .s = "eth0" }, .cost = 10 },
+    };
+    struct iface_set s;
+
+    CU_ASSERT(XA_OK == iface_set_init(&s, in, 4, NULL));
+    CU_ASSERT(4 == s.count);
+    CU_ASSERT_STRING_EQUAL(s.list[0].name, "eth0");
+    CU_ASSERT_STRING_EQUAL(s.list[1].name, "eth1");
+    CU_ASSERT_STRING_EQUAL(s.list[2].name, "wlan0");
+    CU_ASSERT_STRING_EQUAL(s.list[3].name, "lte0");
+
+    iface_set_destroy(&s);
+}
+
+
+void test_failover()
+{
+    struct interface in[] = {
+        { .name = { .s = "lte0" }, .cost = 50 },
+        { .name = { .s = "eth0" }, .cost = 10 },
+    };
+    struct iface_set s;
+    struct iface_health *h;
+
+    CU_ASSERT(XA_OK == iface_set_init(&s, in, 2, NULL));
+
+    h = iface_set_pick(&s, 100);
+    CU_ASSERT_STRING_EQUAL(h->name, "eth0");
+
+    /* A failure moves to the next interface immediately. */
+    iface_mark_failure(h, 100, 60000);
+    h = iface_set_pick(&s, 100);
+    CU_ASSERT_STRING_EQUAL(h->name, "lte0");
+
+    iface_mark_failure(h, 100, 60000);
+    CU_ASSERT(NULL == iface_set_pick(&s, 100));
+    CU_ASSERT(1100 == iface_set_next_retry(&s));
+
+    /* Once the penalty expires the cheaper interface is preferred again. */
+    h = iface_set_pick(&s, 1100);
+    CU_ASSERT_STRING_EQUAL(h->name, "eth0");
+
+    iface_mark_success(h);
+    CU_ASSERT(0 == h->failures);
+    CU_ASSERT(1 == h->connects);
+
+    iface_set_destroy(&s);
+}
+
+
+void test_backoff()
+{
+    struct iface_health h;
+
+    memset(&h, 0, sizeof(h));
+
+    iface_mark_failure(&h, 0, 5000);
+    CU_ASSERT(1000 == h.retry_at_ms);
+    iface_mark_failure(&h, 0, 5000);
+    CU_ASSERT(2000 == h.retry_at_ms);
+    iface_mark_failure(&h, 0, 5000);
+    CU_ASSERT(4000 == h.retry_at_ms);
+    iface_mark_failure(&h, 0, 5000);
+    CU_ASSERT(5000 == h.retry_at_ms);
+    iface_mark_failure(&h, 0, 5000);
+    CU_ASSERT(5000 == h.retry_at_ms);
+    CU_ASSERT(5 == h.failures);
+
+    iface_mark_success(&h);
+    CU_ASSERT(0 == h.retry_at_ms);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("iface.c tests", NULL, NULL);
+    CU_add_test(*suite, "Default route Test", test_default_route);
+    CU_add_test(*suite, "Sorted by cost Test", test_sorted_by_cost);
+    CU_add_test(*suite, "Failover Test", test_failover);
+    CU_add_test(*suite, "Backoff Test", test_backoff);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _GNU_SOURCE /* MSG_DONTWAIT */
+
+#include <CUnit/Basic.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../src/event_loop/event_loop.h"
+#include "../src/telemetry/introspect.h"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static struct event_loop *loop;
+static char path[64];
+static char got[16384];
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void spin(int times)
+{
+    for (int i = 0; i < times; i++) {
+        event_loop_run_once(loop, 5, NULL);
+    }
+}
+
+
+static int dial(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    CU_ASSERT(0 == connect(fd, (struct sockaddr *) &addr, sizeof(addr)));
+
+    return fd;
+}
+
+
+/* Reads until the server closes the connection. */
+static size_t read_reply(int fd)
+{
+    size_t len = 0;
+
+    for (int i = 0; i < 100; i++) {
+        ssize_t n;
+
+        spin(1);
+        n = recv(fd, &got[len], sizeof(got) - 1 - len, MSG_DONTWAIT);
+        if (0 == n) {
+            break;
+        }
+        if (0 < n) {
+            len += (size_t) n;
+        }
+    }
+    got[len] = '\0';
+
+    return len;
+}
+
+
+static size_t request(const char *req)
+{
+    int fd = dial();
+    size_t len;
+
+    CU_ASSERT((ssize_t) strlen(req) == send(fd, req, strlen(req), 0));
+    len = read_reply(fd);
+    close(fd);
+
+    return len;
+}
+
+
+static void describe(void *user, struct introspect_state *s)
+{
+    (void) user;
+
+    introspect_str(s, "websocket.state", "connected");
+    introspect_str(s, "websocket.interface", NULL);
+    introspect_int(s, "queue.low.depth", 3);
+}
+
+
+void test_prometheus()
+{
+    struct introspect_opts opts;
+    struct metrics *m = metrics_create(0, NULL);
+    struct introspect *in;
+    struct metric *h;
+
+    CU_ASSERT_FATAL(NULL != m);
+    metric_add(metrics_counter(m, "xa_connects_total", "Connects\\done.", "interface", "eth\"0"), 2);
+    metric_add(metrics_counter(m, "xa_connects_total", "Connects\\done.", "interface", "wlan0"), 1);
+    metric_set(metrics_gauge(m, "xa_depth", NULL, NULL, NULL), -4);
+    h = metrics_histogram(m, "xa_connect_ms", "Time to connect.", NULL, NULL);
+    metric_observe(h, 2);
+    metric_observe(h, 9);
+    metric_observe(h, 8);
+
+    memset(&opts, 0, sizeof(opts));
+    opts.loop    = loop;
+    opts.path    = path;
+    opts.metrics = m;
+    in           = introspect_create(&opts, NULL);
+    CU_ASSERT_FATAL(NULL != in);
+
+    CU_ASSERT(0 < request("GET /metrics HTTP/1.1\r\nHost: agent\r\n\r\n"));
+    CU_ASSERT(got == strstr(got, "HTTP/1.1 200 OK\r\n"));
+    CU_ASSERT(NULL != strstr(got, "Content-Type: text/plain; version=0.0.4"));
+    CU_ASSERT(NULL != strstr(got, "\r\n\r\n# HELP xa_connects_total Connects\\\\done.\n"
+                                  "# TYPE xa_connects_total counter\n"
+                                  "xa_connects_total{interface=\"eth\\\"0\"} 2\n"
+                                  "xa_connects_total{interface=\"wlan0\"} 1\n"
+                                  "# HELP xa_depth \n"
+                                  "# TYPE xa_depth gauge\n"
+                                  "xa_depth -4\n"));
+    CU_ASSERT(NULL != strstr(got, "# TYPE xa_connect_ms histogram\n"
+                                  "xa_connect_ms_bucket{le=\"2\"} 1\n"
+                                  "xa_connect_ms_bucket{le=\"9\"} 3\n"
+                                  "xa_connect_ms_bucket{le=\"+Inf\"} 3\n"
+                                  "xa_connect_ms_sum 19\n"
+                                  "xa_connect_ms_count 3\n"));
+
+    /* HTTP/1.0 and bare newlines are fine too. */
+    CU_ASSERT(0 < request("GET /metrics?x=1 HTTP/1.0\n\n"));
+    CU_ASSERT(got == strstr(got, "HTTP/1.1 200 OK\r\n"));
+
+    introspect_destroy(in);
+    metrics_destroy(m);
+}
+
+
+void test_json()
+{
+    struct introspect_opts opts;
+    struct metrics *m = metrics_create(0, NULL);
+    struct introspect *in;
+    struct metric *h;
+
+    CU_ASSERT_FATAL(NULL != m);
+    metric_add(metrics_counter(m, "xa_connects_total", "Connects.", "interface", "eth0"), 2);
+    h = metrics_histogram(m, "xa_connect_ms", NULL, NULL, NULL);
+    metric_observe(h, 1);
+    metric_observe(h, 0x100000000ull);
+
+    memset(&opts, 0, sizeof(opts));
+    opts.loop    = loop;
+    opts.path    = path;
+    opts.metrics = m;
+    opts.state   = describe;
+    in           = introspect_create(&opts, NULL);
+    CU_ASSERT_FATAL(NULL != in);
+
+    CU_ASSERT(0 < request("GET /state HTTP/1.1\r\n\r\n"));
+    CU_ASSERT(got == strstr(got, "HTTP/1.1 200 OK\r\n"));
+    CU_ASSERT(NULL != strstr(got, "Content-Type: application/json\r\n"));
+    CU_ASSERT(NULL != strstr(got, "\r\n\r\n{\"state\":{\"websocket.state\":\"connected\","
+                                  "\"websocket.interface\":null,\"queue.low.depth\":3},"
+                                  "\"metrics\":[{\"name\":\"xa_connects_total\","
+                                  "\"help\":\"Connects.\",\"type\":\"counter\","
+                                  "\"labels\":{\"interface\":\"eth0\"},\"value\":2},"
+                                  "{\"name\":\"xa_connect_ms\",\"help\":\"\",\"type\":\"histogram\","
+                                  "\"labels\":{},\"count\":2,\"sum\":4294967297,"
+                                  "\"buckets\":[{\"le\":1,\"count\":1},{\"le\":\"+Inf\",\"count\":2}]}]}\n"));
+
+    introspect_destroy(in);
+    metrics_destroy(m);
+}
+
+
+void test_requests()
+{
+    struct introspect_opts opts;
+    struct introspect *in;
+    int fds[3];
+
+    memset(&opts, 0, sizeof(opts));
+    opts.loop        = loop;
+    opts.path        = path;
+    opts.max_clients = 2;
+    in               = introspect_create(&opts, NULL);
+    CU_ASSERT_FATAL(NULL != in);
+
+    /* No registry and no state is still an answer. */
+    CU_ASSERT(0 < request("GET /state HTTP/1.1\r\n\r\n"));
+    CU_ASSERT(NULL != strstr(got, "\r\n\r\n{\"state\":{},\"metrics\":[]}\n"));
+
+    CU_ASSERT(0 < request("GET /nope HTTP/1.1\r\n\r\n"));
+    CU_ASSERT(got == strstr(got, "HTTP/1.1 404 Not Found\r\n"));
+
+    CU_ASSERT(0 < request("POST /metrics HTTP/1.1\r\n\r\n"));
+    CU_ASSERT(got == strstr(got, "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\n"));
+
+    /* Only two at a time; the third is turned away. */
+    for (int i = 0; i < 3; i++) {
+        fds[i] = dial();
+    }
+    CU_ASSERT(0 == read_reply(fds[2]));
+    CU_ASSERT(4 == send(fds[0], "GET ", 4, 0));
+    spin(2);
+    CU_ASSERT(19 == send(fds[0], "/metrics HTTP/1.1\n\n", 19, 0));
+    CU_ASSERT(0 < read_reply(fds[0]));
+    CU_ASSERT(got == strstr(got, "HTTP/1.1 200 OK\r\n"));
+    for (int i = 0; i < 3; i++) {
+        close(fds[i]);
+    }
+
+    CU_ASSERT(NULL == introspect_create(NULL, NULL));
+    opts.path = NULL;
+    CU_ASSERT(NULL == introspect_create(&opts, NULL));
+    introspect_str(NULL, "x", "y");
+    introspect_int(NULL, "x", 1);
+
+    introspect_destroy(in);
+    CU_ASSERT(0 != access(path, F_OK));
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("introspect.c tests", NULL, NULL);
+    CU_add_test(*suite, "Prometheus Test", test_prometheus);
+    CU_add_test(*suite, "JSON Test", test_json);
+    CU_add_test(*suite, "Requests Test", test_requests);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    snprintf(path, sizeof(path), "/tmp/test_introspect_%d.sock", (int) getpid());
+
+    loop = event_loop_create(NULL);
+    if (!loop) {
+        return 1;
+    }
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    event_loop_destroy(loop);
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,599 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _GNU_SOURCE /* memfd_create() */
+
+#include <CUnit/Basic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../src/event_loop/event_loop.h"
+#include "../src/ipc/ipc.h"
+#include "../src/ipc/shm_ring.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define BIG_SIZE (200 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct state {
+    int connects;
+    int closes;
+    int msgs;
+    size_t bytes;
+    bool echo;
+    bool close_on_msg;
+    struct ipc_client *client;
+    uint8_t last[BIG_SIZE];
+    size_t last_len;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static struct event_loop *loop;
+static struct pool *pool;
+static struct state st;
+static char path[64];
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void on_connect(void *user, struct ipc_client *c)
+{
+    (void) user;
+
+    st.connects++;
+    st.client = c;
+}
+
+
+static void on_close(void *user, struct ipc_client *c)
+{
+    (void) user;
+    (void) c;
+
+    st.closes++;
+    st.client = NULL;
+}
+
+
+static void on_message(void *user, struct ipc_client *c, const void *buf, size_t len)
+{
+    (void) user;
+
+    st.msgs++;
+    st.bytes += len;
+    if (len <= sizeof(st.last)) {
+        memcpy(st.last, buf, len);
+        st.last_len = len;
+    }
+
+    if (st.echo) {
+        CU_ASSERT(XA_OK == ipc_client_send(c, buf, len, NULL));
+    }
+    if (st.close_on_msg) {
+        ipc_client_close(c);
+        CU_ASSERT(XA_NOT_CONNECTED == ipc_client_send(c, buf, len, NULL));
+    }
+}
+
+
+static struct ipc_server *make(size_t max_msg, size_t max_pending)
+{
+    struct ipc_server_opts opts;
+
+    memset(&st, 0, sizeof(st));
+    memset(&opts, 0, sizeof(opts));
+    opts.loop              = loop;
+    opts.path              = path;
+    opts.max_msg_bytes     = max_msg;
+    opts.max_pending_bytes = max_pending;
+    opts.pool              = pool;
+    opts.on_connect        = on_connect;
+    opts.on_close          = on_close;
+    opts.on_message        = on_message;
+
+    return ipc_server_create(&opts, NULL);
+}
+
+
+static int dial(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    CU_ASSERT(0 == connect(fd, (struct sockaddr *) &addr, sizeof(addr)));
+
+    return fd;
+}
+
+
+static void spin(int times)
+{
+    for (int i = 0; i < times; i++) {
+        event_loop_run_once(loop, 5, NULL);
+    }
+}
+
+
+static size_t frame(uint8_t *buf, const char *s, uint32_t flags)
+{
+    uint32_t len = (uint32_t) strlen(s) | flags;
+
+    buf[0] = (uint8_t) (len >> 24);
+    buf[1] = (uint8_t) (len >> 16);
+    buf[2] = (uint8_t) (len >> 8);
+    buf[3] = (uint8_t) len;
+    memcpy(&buf[4], s, strlen(s));
+
+    return 4 + strlen(s);
+}
+
+
+static void send_with_fds(int sock, const void *buf, size_t len,
+                          const int *fds, size_t count)
+{
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    struct iovec iov = { .iov_base = (void *) buf, .iov_len = len };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctrl, 0, sizeof(ctrl));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl.buf;
+    msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+    cmsg             = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+
+    CU_ASSERT((ssize_t) len == sendmsg(sock, &msg, 0));
+}
+
+
+static void send_with_fd(int sock, const void *buf, size_t len, int fd)
+{
+    send_with_fds(sock, buf, len, &fd, 1);
+}
+
+
+/* Reads exactly len bytes, collecting any passed descriptor. */
+static void read_all(int sock, uint8_t *buf, size_t len, int *fd)
+{
+    size_t got = 0;
+
+    while (got < len) {
+        union {
+            char buf[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } ctrl;
+        struct iovec iov = { .iov_base = &buf[got], .iov_len = len - got };
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+        ssize_t n;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+
+        n = recvmsg(sock, &msg, MSG_DONTWAIT);
+        if (n < 0 && EAGAIN == errno) {
+            spin(1);
+            continue;
+        }
+        CU_ASSERT_FATAL(0 < n);
+        got += (size_t) n;
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && fd) {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+}
+
+
+void test_inline()
+{
+    struct ipc_server *s = make(0, 0);
+    uint8_t buf[256];
+    size_t len = 0;
+    int sock;
+
+    CU_ASSERT_FATAL(NULL != s);
+
+    sock = dial();
+    spin(2);
+    CU_ASSERT(1 == st.connects);
+    CU_ASSERT(1 == ipc_server_clients(s));
+
+    /* Several frames in one write, the last split across two. */
+    st.echo = true;
+    len += frame(&buf[len], "one", 0);
+    len += frame(&buf[len], "", 0);
+    len += frame(&buf[len], "three", 0);
+    CU_ASSERT((ssize_t) (len - 2) == write(sock, buf, len - 2));
+    spin(2);
+    CU_ASSERT(2 == st.msgs);
+    CU_ASSERT((ssize_t) 2 == write(sock, &buf[len - 2], 2));
+    spin(2);
+    CU_ASSERT(3 == st.msgs);
+    CU_ASSERT(8 == st.bytes);
+    CU_ASSERT(5 == st.last_len);
+    CU_ASSERT(0 == memcmp("three", st.last, 5));
+
+    /* The echoes come back in order. */
+    {
+        uint8_t got[256];
+
+        struct pool_stats ps;
+
+        read_all(sock, got, len, NULL);
+        CU_ASSERT(0 == memcmp(buf, got, len));
+        CU_ASSERT(0 == ipc_client_pending(st.client));
+
+        /* The queued sends came from the pool and went back. */
+        pool_stats(pool, 0, &ps);
+        CU_ASSERT(0 < ps.high_water);
+        CU_ASSERT(0 == ps.in_use);
+    }
+
+    close(sock);
+    spin(2);
+    CU_ASSERT(1 == st.closes);
+    CU_ASSERT(0 == ipc_server_clients(s));
+
+    ipc_server_destroy(s);
+}
+
+
+void test_memfd()
+{
+    struct ipc_server *s = make(0, 0);
+    uint8_t *big         = malloc(BIG_SIZE);
+    uint8_t hdr[8];
+    int sock, fd;
+
+    CU_ASSERT_FATAL(NULL != s);
+    CU_ASSERT_FATAL(NULL != big);
+    for (size_t i = 0; i < BIG_SIZE; i++) {
+        big[i] = (uint8_t) (i * 31);
+    }
+
+    sock = dial();
+    spin(2);
+
+    /* A large message from the client, passed as a memfd. */
+    fd = memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    CU_ASSERT_FATAL(0 <= fd);
+    CU_ASSERT(BIG_SIZE == write(fd, big, BIG_SIZE));
+    CU_ASSERT(0 == fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_WRITE));
+    hdr[0] = 0x80;
+    hdr[1] = (uint8_t) (BIG_SIZE >> 16);
+    hdr[2] = (uint8_t) (BIG_SIZE >> 8);
+    hdr[3] = (uint8_t) BIG_SIZE;
+    send_with_fd(sock, hdr, 4, fd);
+    close(fd);
+
+    st.echo = true;
+    spin(2);
+    CU_ASSERT(1 == st.msgs);
+    CU_ASSERT(BIG_SIZE == st.last_len);
+    CU_ASSERT(0 == memcmp(big, st.last, BIG_SIZE));
+
+    /* The echo is large enough to come back as a sealed memfd. */
+    fd = -1;
+    read_all(sock, hdr, 4, &fd);
+    CU_ASSERT(0x80 == hdr[0]);
+    CU_ASSERT(BIG_SIZE == (((size_t) hdr[1] << 16) | ((size_t) hdr[2] << 8) | hdr[3]));
+    CU_ASSERT_FATAL(0 <= fd);
+    CU_ASSERT(F_SEAL_WRITE & fcntl(fd, F_GET_SEALS));
+    {
+        void *p = mmap(NULL, BIG_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+
+        CU_ASSERT_FATAL(MAP_FAILED != p);
+        CU_ASSERT(0 == memcmp(big, p, BIG_SIZE));
+        munmap(p, BIG_SIZE);
+    }
+    close(fd);
+
+    /* A memfd header without a descriptor is a protocol error. */
+    CU_ASSERT(4 == write(sock, hdr, 4));
+    spin(2);
+    CU_ASSERT(1 == st.closes);
+    close(sock);
+
+    /* So is a memfd the client could still change. */
+    sock = dial();
+    spin(2);
+    fd = memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    CU_ASSERT_FATAL(0 <= fd);
+    CU_ASSERT(BIG_SIZE == write(fd, big, BIG_SIZE));
+    CU_ASSERT(0 == fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK));
+    send_with_fd(sock, hdr, 4, fd);
+    close(fd);
+    spin(2);
+    CU_ASSERT(1 == st.msgs);
+    CU_ASSERT(2 == st.closes);
+    close(sock);
+
+    /* And a file that can't be sealed at all. */
+    sock = dial();
+    spin(2);
+    {
+        FILE *f = tmpfile();
+
+        CU_ASSERT_FATAL(NULL != f);
+        CU_ASSERT(1 == fwrite(big, BIG_SIZE, 1, f));
+        CU_ASSERT(0 == fflush(f));
+        send_with_fd(sock, hdr, 4, fileno(f));
+        fclose(f);
+    }
+    spin(2);
+    CU_ASSERT(1 == st.msgs);
+    CU_ASSERT(3 == st.closes);
+
+    close(sock);
+    free(big);
+    ipc_server_destroy(s);
+}
+
+
+void test_ring()
+{
+    struct ipc_server *s = make(0, 0);
+    struct shm_ring *r   = shm_ring_create(0, NULL);
+    uint8_t hdr[4]       = { 0x40, 0, 0, 0 };
+    int fds[2];
+    int sock;
+
+    CU_ASSERT_FATAL(NULL != s);
+    CU_ASSERT_FATAL(NULL != r);
+
+    sock = dial();
+    spin(2);
+
+    /* Messages written before the handover are not lost. */
+    CU_ASSERT(XA_OK == shm_ring_write(r, "early", 5, NULL));
+
+    fds[0] = shm_ring_memfd(r);
+    fds[1] = shm_ring_eventfd(r);
+    send_with_fds(sock, hdr, 4, fds, 2);
+    spin(3);
+    CU_ASSERT(1 == st.msgs);
+    CU_ASSERT(5 == st.last_len);
+    CU_ASSERT(0 == memcmp("early", st.last, 5));
+
+    /* Once the agent sleeps, the doorbell wakes it. */
+    for (int i = 0; i < 1000; i++) {
+        while (XA_INSUFFICIENT_RESOURCES == shm_ring_write(r, "ring", 4, NULL)) {
+            spin(1);
+        }
+    }
+    CU_ASSERT(XA_OK == shm_ring_write(r, "last", 4, NULL));
+    spin(10);
+    CU_ASSERT(1002 == st.msgs);
+    CU_ASSERT(0 == memcmp("last", st.last, 4));
+
+    /* A second ring is a protocol error. */
+    send_with_fds(sock, hdr, 4, fds, 2);
+    spin(2);
+    CU_ASSERT(1 == st.closes);
+
+    close(sock);
+    shm_ring_destroy(r);
+    ipc_server_destroy(s);
+}
+
+
+void test_credit()
+{
+    struct ipc_server *s = make(0, 0);
+    struct shm_ring *r   = shm_ring_create(0, NULL);
+    uint8_t hdr[4]       = { 0x40, 0, 0, 0 };
+    uint8_t buf[64];
+    size_t len = 0;
+    int fds[2];
+    int sock;
+
+    CU_ASSERT_FATAL(NULL != s);
+    CU_ASSERT_FATAL(NULL != r);
+    CU_ASSERT(IPC_CREDIT_UNLIMITED == ipc_server_credit(s));
+
+    sock = dial();
+    fds[0] = shm_ring_memfd(r);
+    fds[1] = shm_ring_eventfd(r);
+    send_with_fds(sock, hdr, 4, fds, 2);
+    spin(2);
+
+    /* The second message overshoots the credit, the third waits. */
+    ipc_server_set_credit(s, 10);
+    len += frame(&buf[len], "aaaaaaaa", 0);
+    len += frame(&buf[len], "bbbbbbbb", 0);
+    len += frame(&buf[len], "cccccccc", 0);
+    CU_ASSERT((ssize_t) len == write(sock, buf, len));
+    spin(3);
+    CU_ASSERT(2 == st.msgs);
+    CU_ASSERT(0 == ipc_server_credit(s));
+
+    /* The ring waits too. */
+    CU_ASSERT(XA_OK == shm_ring_write(r, "ring", 4, NULL));
+    spin(3);
+    CU_ASSERT(2 == st.msgs);
+
+    /* Topping up resumes both, in whatever order, without losing anything. */
+    ipc_server_set_credit(s, 10);
+    spin(3);
+    CU_ASSERT(4 == st.msgs);
+    CU_ASSERT(0 == ipc_server_credit(s));
+
+    /* A client that hangs up while paused is still drained. */
+    len = frame(buf, "dddd", 0);
+    CU_ASSERT((ssize_t) len == write(sock, buf, len));
+    CU_ASSERT(XA_OK == shm_ring_write(r, "last", 4, NULL));
+    close(sock);
+    spin(3);
+    CU_ASSERT(6 == st.msgs);
+    CU_ASSERT(1 == st.closes);
+
+    shm_ring_destroy(r);
+    ipc_server_destroy(s);
+}
+
+
+void test_limits()
+{
+    struct ipc_server *s = make(16, 64);
+    uint8_t buf[64];
+    char data[64];
+    size_t len;
+    int sock;
+
+    CU_ASSERT_FATAL(NULL != s);
+    memset(data, 'x', sizeof(data));
+
+    sock = dial();
+    spin(2);
+    CU_ASSERT_FATAL(NULL != st.client);
+
+    /* The backlog is capped. */
+    CU_ASSERT(XA_OK == ipc_client_send(st.client, data, 40, NULL));
+    CU_ASSERT(XA_INSUFFICIENT_RESOURCES == ipc_client_send(st.client, data, 40, NULL));
+    CU_ASSERT(40 == ipc_client_pending(st.client));
+    spin(2);
+    CU_ASSERT(0 == ipc_client_pending(st.client));
+    read_all(sock, buf, 44, NULL);
+
+    /* Messages larger than the limit disconnect the client. */
+    len = frame(buf, "0123456789abcdefg", 0);
+    CU_ASSERT((ssize_t) len == write(sock, buf, len));
+    spin(2);
+    CU_ASSERT(0 == st.msgs);
+    CU_ASSERT(1 == st.closes);
+    close(sock);
+
+    /* Closing from inside the callback. */
+    sock = dial();
+    spin(2);
+    st.close_on_msg = true;
+    len = frame(buf, "hi", 0);
+    len += frame(&buf[len], "hi", 0);
+    CU_ASSERT((ssize_t) len == write(sock, buf, len));
+    spin(2);
+    CU_ASSERT(1 == st.msgs);
+    CU_ASSERT(2 == st.closes);
+    CU_ASSERT(0 == read(sock, buf, sizeof(buf)));
+    close(sock);
+
+    /* Destroying the server disconnects everyone. */
+    sock = dial();
+    spin(2);
+    CU_ASSERT(1 == ipc_server_clients(s));
+    ipc_server_destroy(s);
+    CU_ASSERT(3 == st.closes);
+    CU_ASSERT(0 == read(sock, buf, sizeof(buf)));
+    CU_ASSERT(0 != access(path, F_OK));
+    close(sock);
+}
+
+
+void test_bad_inputs()
+{
+    struct ipc_server_opts opts;
+    XAcode err = XA_OK;
+
+    memset(&opts, 0, sizeof(opts));
+    CU_ASSERT(NULL == ipc_server_create(NULL, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == ipc_server_create(&opts, &err));
+
+    opts.loop       = loop;
+    opts.on_message = on_message;
+    opts.path       = "/proc/nope/socket";
+    CU_ASSERT(NULL == ipc_server_create(&opts, &err));
+    CU_ASSERT(XA_FAILED_TO_OPEN_FILE == err);
+
+    CU_ASSERT(XA_INVALID_INPUT == ipc_client_send(NULL, "a", 1, NULL));
+    CU_ASSERT(0 == ipc_client_pending(NULL));
+    CU_ASSERT(0 == ipc_server_clients(NULL));
+    CU_ASSERT(0 == ipc_server_credit(NULL));
+    ipc_server_set_credit(NULL, 1);
+    ipc_client_close(NULL);
+    ipc_server_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("ipc.c tests", NULL, NULL);
+    CU_add_test(*suite, "Inline Test", test_inline);
+    CU_add_test(*suite, "Memfd Test", test_memfd);
+    CU_add_test(*suite, "Ring Test", test_ring);
+    CU_add_test(*suite, "Credit Test", test_credit);
+    CU_add_test(*suite, "Limits Test", test_limits);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    snprintf(path, sizeof(path), "/tmp/test_ipc_%d.sock", (int) getpid());
+
+    loop = event_loop_create(NULL);
+    pool = pool_create(NULL, NULL);
+    if (!loop || !pool) {
+        return 1;
+    }
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    event_loop_destroy(loop);
+    pool_destroy(pool);
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,309 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/outbound/journal.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct seen {
+    size_t limit;
+    size_t count;
+    int ids[256];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static char path[] = "/tmp/test_journal_XXXXXX";
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static struct journal *open_j(size_t max_bytes, uint64_t retention_s)
+{
+    struct journal_opts opts = {
+        .path        = path,
+        .max_bytes   = max_bytes,
+        .retention_s = retention_s,
+    };
+
+    return journal_open(&opts, NULL);
+}
+
+
+/* Records are an int id followed by filler. */
+static void append(struct journal *j, int id, size_t len, uint64_t now)
+{
+    uint8_t buf[1024];
+
+    memset(buf, id & 0xff, sizeof(buf));
+    memcpy(buf, &id, sizeof(id));
+
+    CU_ASSERT(XA_OK == journal_append(j, buf, len, now, NULL));
+}
+
+
+static bool take(void *user, const void *buf, size_t len)
+{
+    struct seen *s = (struct seen *) user;
+    int id;
+
+    if (s->count == s->limit) {
+        return false;
+    }
+
+    memcpy(&id, buf, sizeof(id));
+    for (size_t i = sizeof(id); i < len; i++) {
+        CU_ASSERT(((const uint8_t *) buf)[i] == (id & 0xff));
+    }
+    s->ids[s->count++] = id;
+
+    return true;
+}
+
+
+static void reset_seen(struct seen *s)
+{
+    memset(s, 0, sizeof(struct seen));
+    s->limit = 256;
+}
+
+
+void test_persistence()
+{
+    struct journal_stats stats;
+    struct journal *j;
+    struct seen s;
+
+    j = open_j(0, 0);
+    CU_ASSERT_FATAL(NULL != j);
+    CU_ASSERT(0 == journal_count(j));
+
+    for (int i = 0; i < 10; i++) {
+        append(j, i, 10 + i, 1000);
+    }
+    CU_ASSERT(10 == journal_count(j));
+
+    /* Take a few, then "restart". */
+    reset_seen(&s);
+    s.limit = 3;
+    CU_ASSERT(3 == journal_replay(j, 1000, take, &s));
+    journal_close(j);
+
+    j = open_j(0, 0);
+    CU_ASSERT_FATAL(NULL != j);
+    CU_ASSERT(7 == journal_count(j));
+
+    append(j, 10, 40, 1000);
+
+    reset_seen(&s);
+    CU_ASSERT(8 == journal_replay(j, 1000, take, &s));
+    for (int i = 0; i < 8; i++) {
+        CU_ASSERT((3 + i) == s.ids[i]);
+    }
+    CU_ASSERT(0 == journal_count(j));
+
+    journal_stats(j, &stats);
+    CU_ASSERT(1 == stats.appended);
+    CU_ASSERT(8 == stats.replayed);
+    CU_ASSERT(0 == stats.count);
+
+    journal_close(j);
+}
+
+
+void test_wrap_and_overwrite()
+{
+    struct journal_stats stats;
+    struct journal *j;
+    struct seen s;
+
+    /* Smallest ring; 10 records of 500 bytes don't fit. */
+    j = open_j(4096, 0);
+    CU_ASSERT_FATAL(NULL != j);
+
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 10; i++) {
+            append(j, round * 100 + i, 500, 1000);
+        }
+        CU_ASSERT(journal_count(j) < 10);
+
+        /* Survives a restart at any point in the ring. */
+        journal_close(j);
+        j = open_j(4096, 0);
+        CU_ASSERT_FATAL(NULL != j);
+
+        /* Only the newest survive, in order. */
+        reset_seen(&s);
+        CU_ASSERT(0 < journal_replay(j, 1000, take, &s));
+        CU_ASSERT((round * 100 + 9) == s.ids[s.count - 1]);
+        for (size_t i = 1; i < s.count; i++) {
+            CU_ASSERT(s.ids[i - 1] + 1 == s.ids[i]);
+        }
+
+        /* Leave some records behind for the next round. */
+        append(j, round * 100 + 50, 300, 1000);
+        append(j, round * 100 + 51, 300, 1000);
+        reset_seen(&s);
+        s.limit = 1;
+        CU_ASSERT(1 == journal_replay(j, 1000, take, &s));
+    }
+
+    journal_stats(j, &stats);
+    CU_ASSERT(0 == stats.expired);
+
+    /* Too big for the ring. */
+    CU_ASSERT(XA_INVALID_INPUT == journal_append(j, path, 4000, 1000, NULL));
+
+    journal_close(j);
+}
+
+
+void test_corruption()
+{
+    struct journal *j;
+    struct seen s;
+    uint8_t junk = 0x5a;
+    int fd;
+
+    unlink(path);
+    j = open_j(8192, 0);
+    CU_ASSERT_FATAL(NULL != j);
+    for (int i = 0; i < 5; i++) {
+        append(j, i, 100, 1000);
+    }
+    journal_close(j);
+
+    /* Damage the payload of the 3rd record (each takes 128 bytes). */
+    fd = open(path, O_RDWR);
+    CU_ASSERT_FATAL(0 <= fd);
+    CU_ASSERT(1 == pwrite(fd, &junk, 1, 4096 + 2 * 128 + 60));
+    close(fd);
+
+    j = open_j(8192, 0);
+    CU_ASSERT_FATAL(NULL != j);
+    CU_ASSERT(2 == journal_count(j));
+
+    /* Appending carries on after the good records. */
+    append(j, 7, 100, 1000);
+    reset_seen(&s);
+    CU_ASSERT(3 == journal_replay(j, 1000, take, &s));
+    CU_ASSERT(0 == s.ids[0]);
+    CU_ASSERT(1 == s.ids[1]);
+    CU_ASSERT(7 == s.ids[2]);
+    journal_close(j);
+
+    /* A different size resets the journal. */
+    j = open_j(8192, 0);
+    append(j, 1, 100, 1000);
+    journal_close(j);
+    j = open_j(16384, 0);
+    CU_ASSERT_FATAL(NULL != j);
+    CU_ASSERT(0 == journal_count(j));
+    journal_close(j);
+}
+
+
+void test_retention()
+{
+    struct journal_stats stats;
+    struct journal *j;
+    struct seen s;
+
+    unlink(path);
+    j = open_j(0, 60);
+    CU_ASSERT_FATAL(NULL != j);
+
+    append(j, 1, 10, 1000);
+    append(j, 2, 10, 1050);
+    append(j, 3, 10, 1100);
+
+    reset_seen(&s);
+    CU_ASSERT(2 == journal_replay(j, 1100, take, &s));
+    CU_ASSERT(2 == s.ids[0]);
+    CU_ASSERT(3 == s.ids[1]);
+
+    journal_stats(j, &stats);
+    CU_ASSERT(1 == stats.expired);
+
+    journal_close(j);
+}
+
+
+void test_bad_inputs()
+{
+    struct journal_opts opts = { .path = "/proc/not/a/place" };
+    XAcode err = XA_OK;
+
+    CU_ASSERT(NULL == journal_open(NULL, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == journal_open(&opts, &err));
+    CU_ASSERT(XA_FAILED_TO_OPEN_FILE == err);
+
+    CU_ASSERT(XA_INVALID_INPUT == journal_append(NULL, path, 1, 0, NULL));
+    CU_ASSERT(0 == journal_replay(NULL, 0, take, NULL));
+    CU_ASSERT(0 == journal_count(NULL));
+    journal_sync(NULL);
+    journal_close(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("journal.c tests", NULL, NULL);
+    CU_add_test(*suite, "Persistence Test", test_persistence);
+    CU_add_test(*suite, "Wrap and overwrite Test", test_wrap_and_overwrite);
+    CU_add_test(*suite, "Corruption Test", test_corruption);
+    CU_add_test(*suite, "Retention Test", test_retention);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    unlink(path);
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,13 +1,101 @@
 /* SPDX-FileCopyrightText: 2021-2022 Comcast Cable Communications Management, LLC */
 /* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L /* fileno() */
+
 #include <CUnit/Basic.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "../src/logging/binlog.h"
 #include "../src/logging/log.h"
 
+#define THREADS          4
+#define LINES_PER_THREAD 2000
+
+struct reader {
+    pthread_t thread;
+    int fd;
+    size_t lines;
+    size_t notices;
+    char *seen; /* which "line N" lines arrived */
+};
+
+
+static void *read_lines(void *arg)
+{
+    struct reader *r = (struct reader *) arg;
+    char line[LOG_LINE_MAX + 128];
+    size_t len = 0;
+    char c;
+
+    while (1 == read(r->fd, &c, 1)) {
+        if ('\n' != c) {
+            if (len < sizeof(line) - 1) {
+                line[len++] = c;
+            }
+            continue;
+        }
+        line[len] = '\0';
+        len       = 0;
+
+        if (strstr(line, "log lines dropped")) {
+            r->notices++;
+        } else {
+            const char *p = strstr(line, "line ");
+            unsigned n;
+
+            r->lines++;
+            if (p && (1 == sscanf(p, "line %u", &n))
+                && (n < THREADS * LINES_PER_THREAD))
+            {
+                r->seen[n]++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+static void reader_start(struct reader *r, int fd)
+{
+    memset(r, 0, sizeof(*r));
+    r->fd   = fd;
+    r->seen = calloc(THREADS * LINES_PER_THREAD, 1);
+    pthread_create(&r->thread, NULL, read_lines, r);
+}
+
+
+static void *log_lines(void *arg)
+{
+    unsigned first = *(unsigned *) arg;
+
+    for (unsigned i = 0; i < LINES_PER_THREAD; i++) {
+        log_info("line %u", first + i);
+    }
+
+    return NULL;
+}
+
+
+static void log_from_threads(void)
+{
+    pthread_t threads[THREADS];
+    unsigned first[THREADS];
+
+    for (int i = 0; i < THREADS; i++) {
+        first[i] = (unsigned) i * LINES_PER_THREAD;
+        pthread_create(&threads[i], NULL, log_lines, &first[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
 
 void test_most(void)
 {
@@ -21,10 +109,442 @@ void test_most(void)
 }
 
 
+void test_async_block(void)
+{
+    struct log_async_opts opts = {
+        .lines    = 8,
+        .overflow = LOG_OVERFLOW__BLOCK,
+    };
+    struct reader r;
+    uint64_t dropped = log_dropped();
+    XAcode err;
+    int fds[2];
+    size_t missing = 0;
+
+    CU_ASSERT_FATAL(0 == pipe(fds));
+    opts.fd = fds[1];
+    reader_start(&r, fds[0]);
+
+    CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == log_async_start(&opts, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+
+    log_from_threads();
+    log_async_stop();
+    log_async_stop();
+
+    close(fds[1]);
+    pthread_join(r.thread, NULL);
+    close(fds[0]);
+
+    /* Every line arrives exactly once, and nothing is dropped. */
+    for (size_t i = 0; i < THREADS * LINES_PER_THREAD; i++) {
+        if (1 != r.seen[i]) {
+            missing++;
+        }
+    }
+    CU_ASSERT(0 == missing);
+    CU_ASSERT(THREADS * LINES_PER_THREAD == r.lines);
+    CU_ASSERT(0 == r.notices);
+    CU_ASSERT(dropped == log_dropped());
+    free(r.seen);
+
+    /* Back to synchronous logging. */
+    log_info("Hello, world.");
+}
+
+
+void test_async_drop(void)
+{
+    struct log_async_opts opts = { .lines = 4 };
+    struct reader r;
+    uint64_t dropped = log_dropped();
+    int fds[2];
+
+    CU_ASSERT_FATAL(0 == pipe(fds));
+    opts.fd = fds[1];
+
+    /* Nobody reads the pipe yet, so the writer soon blocks on it and the
+     * ring fills up. */
+    CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+    log_from_threads();
+
+    dropped = log_dropped() - dropped;
+    CU_ASSERT(0 < dropped);
+
+    reader_start(&r, fds[0]);
+    log_async_stop();
+
+    close(fds[1]);
+    pthread_join(r.thread, NULL);
+    close(fds[0]);
+
+    CU_ASSERT(THREADS * LINES_PER_THREAD == r.lines + dropped);
+    CU_ASSERT(0 < r.notices);
+    free(r.seen);
+}
+
+
+void test_async_long_line(void)
+{
+    struct log_async_opts opts = { .lines = 2 };
+    struct reader r;
+    char *big = malloc(3 * LOG_LINE_MAX);
+    int fds[2];
+
+    CU_ASSERT_FATAL(NULL != big);
+    memset(big, 'x', 3 * LOG_LINE_MAX - 1);
+    big[3 * LOG_LINE_MAX - 1] = '\0';
+
+    CU_ASSERT_FATAL(0 == pipe(fds));
+    opts.fd = fds[1];
+    reader_start(&r, fds[0]);
+
+    CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+    log_fatal("%s", big);
+    log_async_stop();
+
+    close(fds[1]);
+    pthread_join(r.thread, NULL);
+    close(fds[0]);
+
+    /* Truncated, but still one whole line. */
+    CU_ASSERT(1 == r.lines);
+    free(r.seen);
+    free(big);
+}
+
+
+void test_async_binary(void)
+{
+    struct log_async_opts opts = { .format = LOG_FORMAT__BINARY };
+    struct binlog_line *line   = malloc(sizeof(struct binlog_line));
+    struct binlog_reader *r    = binlog_reader_create(NULL);
+    FILE *f                    = tmpfile();
+    uint8_t *buf               = malloc(64 * 1024);
+    size_t at                  = 0;
+    int lines                  = 0;
+    size_t len;
+
+    CU_ASSERT_FATAL(line && r && f && buf);
+    opts.fd = fileno(f);
+
+    CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+    for (int i = 0; i < 100; i++) {
+        log_debug("%-*s: %d", 10, "value", i);
+    }
+    log_warn("%ls", L"wide strings are sent as text");
+    log_async_stop();
+
+    rewind(f);
+    len = fread(buf, 1, 64 * 1024, f);
+    CU_ASSERT(0 < len);
+
+    while (at < len) {
+        char want[64];
+        size_t used = 0;
+
+        CU_ASSERT_FATAL(XA_OK == binlog_reader_next(r, &buf[at], len - at, &used, line, NULL));
+        CU_ASSERT_FATAL(0 < used);
+        at += used;
+
+        if (!line->valid) {
+            continue;
+        }
+        if (lines < 100) {
+            snprintf(want, sizeof(want), "%-*s: %d", 10, "value", lines);
+            CU_ASSERT_STRING_EQUAL(line->text, want);
+            CU_ASSERT(1 == line->level);
+        } else {
+            CU_ASSERT(3 == line->level);
+        }
+        lines++;
+    }
+    CU_ASSERT(101 == lines);
+
+    fclose(f);
+    free(buf);
+    free(line);
+    binlog_reader_destroy(r);
+}
+
+
+void test_levels(void)
+{
+    int calls = 0;
+
+    CU_ASSERT(LOG_LEVEL__TRACE == log_get_level());
+
+    /* Filtered out lines don't even evaluate their arguments. */
+    log_set_level(LOG_LEVEL__WARN);
+    CU_ASSERT(LOG_LEVEL__WARN == log_get_level());
+    log_trace("%d", calls++);
+    log_debug("%d", calls++);
+    log_info("%d", calls++);
+    CU_ASSERT(0 == calls);
+
+    log_fatal("%d", calls++);
+    CU_ASSERT(1 == calls);
+
+    log_set_level((enum log_level) 42);
+    CU_ASSERT(LOG_LEVEL__WARN == log_get_level());
+
+    log_set_level(LOG_LEVEL__TRACE);
+}
+
+
+void test_subsecond(void)
+{
+    struct log_async_opts opts = { .lines = 16 };
+    FILE *f                    = tmpfile();
+    char line[256];
+    const char *ts;
+    const int digits[] = { 0, 3, 9, 42 };
+    const size_t zs[]  = { 19, 23, 29, 29 };
+
+    CU_ASSERT_FATAL(NULL != f);
+    opts.fd = fileno(f);
+
+    /* The writer renders the time, so each setting gets its own run. */
+    for (int i = 0; i < 4; i++) {
+        log_set_subsecond(digits[i]);
+        CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+        log_info("digits: %d", digits[i]);
+        log_async_stop();
+    }
+    log_set_subsecond(0);
+
+    rewind(f);
+    for (int i = 0; i < 4; i++) {
+        CU_ASSERT_FATAL(NULL != fgets(line, sizeof(line), f));
+
+        /* Skip the color codes in front of the timestamp. */
+        ts = strchr(line, 'm');
+        ts = (ts) ? strchr(ts + 1, 'm') : NULL;
+        CU_ASSERT_FATAL(NULL != ts);
+        ts++;
+
+        CU_ASSERT('-' == ts[4]);
+        CU_ASSERT(':' == ts[16]);
+        CU_ASSERT('Z' == ts[zs[i]]);
+        if (0 < digits[i]) {
+            CU_ASSERT('.' == ts[19]);
+            for (size_t j = 20; j < zs[i]; j++) {
+                CU_ASSERT(('0' <= ts[j]) && (ts[j] <= '9'));
+            }
+        }
+    }
+
+    fclose(f);
+}
+
+
+/* Reads every line of the file into lines, returning how many there were. */
+static size_t read_all(FILE *f, char lines[][256], size_t max)
+{
+    size_t count = 0;
+
+    rewind(f);
+    while ((count < max) && fgets(lines[count], 256, f)) {
+        count++;
+    }
+
+    return count;
+}
+
+
+static void lookup_failed(const char *name)
+{
+    log_error("lookup failed: %s", name);
+}
+
+
+void test_rate_limit(void)
+{
+    struct log_async_opts opts = { .lines = 256, .overflow = LOG_OVERFLOW__BLOCK };
+    struct log_limits limits   = { .rate = 1, .burst = 5 };
+    struct log_stats before, after;
+    FILE *f = tmpfile();
+    char lines[16][256];
+    size_t count;
+
+    CU_ASSERT_FATAL(NULL != f);
+    opts.fd = fileno(f);
+
+    log_get_stats(&before);
+    log_set_limits(&limits);
+    CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+
+    for (int i = 0; i < 100; i++) {
+        log_warn("attempt %d", i);
+    }
+    /* Fatal lines always get through. */
+    log_fatal("fatal");
+    log_flush_suppressed();
+
+    log_async_stop();
+    log_set_limits(NULL);
+    log_get_stats(&after);
+
+    count = read_all(f, lines, 16);
+    CU_ASSERT_FATAL(7 == count);
+    for (int i = 0; i < 5; i++) {
+        char want[32];
+
+        snprintf(want, sizeof(want), "attempt %d", i);
+        CU_ASSERT(NULL != strstr(lines[i], want));
+    }
+    CU_ASSERT(NULL != strstr(lines[5], "fatal"));
+    CU_ASSERT(NULL != strstr(lines[6], ": 95 lines over the rate limit suppressed"));
+    CU_ASSERT(95 == after.limited - before.limited);
+    CU_ASSERT(after.repeated == before.repeated);
+
+    fclose(f);
+}
+
+
+void test_repeats(void)
+{
+    struct log_async_opts opts = { .lines = 256, .overflow = LOG_OVERFLOW__BLOCK };
+    struct log_limits limits   = { .repeats = LOG_REPEATS__COLLAPSE };
+    struct log_stats before, after;
+    FILE *f = tmpfile();
+    char lines[16][256];
+    size_t count;
+
+    CU_ASSERT_FATAL(NULL != f);
+    opts.fd = fileno(f);
+
+    log_get_stats(&before);
+    log_set_limits(&limits);
+    CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+
+    for (int i = 0; i < 10; i++) {
+        lookup_failed("a");
+    }
+    lookup_failed("b");
+    for (int i = 0; i < 3; i++) {
+        lookup_failed("b");
+    }
+    log_flush_suppressed();
+
+    /* Nothing is pending, so this adds nothing. */
+    log_flush_suppressed();
+
+    log_async_stop();
+    log_set_limits(NULL);
+    log_get_stats(&after);
+
+    count = read_all(f, lines, 16);
+    CU_ASSERT_FATAL(4 == count);
+    CU_ASSERT(NULL != strstr(lines[0], "lookup failed: a"));
+    CU_ASSERT(NULL != strstr(lines[1], ": last line repeated 9 more times"));
+    CU_ASSERT(NULL != strstr(lines[1], "test_log.c:"));
+    CU_ASSERT(NULL != strstr(lines[1], "ERROR"));
+    CU_ASSERT(NULL != strstr(lines[2], "lookup failed: b"));
+    CU_ASSERT(NULL != strstr(lines[3], ": last line repeated 3 more times"));
+    CU_ASSERT(12 == after.repeated - before.repeated);
+    CU_ASSERT(after.limited == before.limited);
+
+    fclose(f);
+}
+
+
+struct caught {
+    size_t count;
+    enum log_level level[4];
+    const char *file[4];
+    int line[4];
+    XAcode code[4];
+    char text[4][64];
+};
+
+
+static bool catch_line(const struct log_record *r, void *user)
+{
+    struct caught *c = (struct caught *) user;
+    size_t i         = c->count;
+
+    if (4 <= i) {
+        return false;
+    }
+    c->count++;
+    c->level[i] = r->level;
+    c->file[i]  = r->file;
+    c->line[i]  = r->line;
+    c->code[i]  = r->code;
+    snprintf(c->text[i], sizeof(c->text[i]), "%.*s", (int) r->len, r->text);
+
+    return true;
+}
+
+
+static void check_caught(const struct caught *c)
+{
+    CU_ASSERT_FATAL(4 == c->count);
+    CU_ASSERT(LOG_LEVEL__ERROR == c->level[0]);
+    CU_ASSERT(NULL != strstr(c->file[0], "test_log.c"));
+    CU_ASSERT(0 < c->line[0]);
+    CU_ASSERT(XA_NOT_CONNECTED == c->code[0]);
+    CU_ASSERT_STRING_EQUAL(c->text[0], "send failed: 3");
+
+    CU_ASSERT(LOG_LEVEL__INFO == c->level[1]);
+    CU_ASSERT(c->line[0] < c->line[1]);
+    CU_ASSERT(XA_OK == c->code[1]);
+    CU_ASSERT_STRING_EQUAL(c->text[1], "plain");
+
+    /* The functions don't know their call site. */
+    CU_ASSERT(NULL == c->file[2]);
+    CU_ASSERT_STRING_EQUAL(c->text[2], "function");
+}
+
+
+void test_sink(void)
+{
+    struct log_async_opts opts = { .lines = 16, .format = LOG_FORMAT__BINARY };
+    struct log_stats before, after;
+    struct caught c;
+
+    log_get_stats(&before);
+
+    for (int async = 0; async < 2; async++) {
+        memset(&c, 0, sizeof(c));
+        CU_ASSERT(XA_OK == log_set_sink(catch_line, &c, NULL));
+        if (async) {
+            /* The sink gets text even though binary was asked for. */
+            CU_ASSERT(XA_OK == log_async_start(&opts, NULL));
+            CU_ASSERT(XA_INVALID_INPUT == log_set_sink(NULL, NULL, NULL));
+        }
+
+        log_error_code(XA_NOT_CONNECTED, "send failed: %d", 3);
+        log_info("plain");
+        (log_warn)("function");
+        log_warn("also");
+        log_warn("one too many");
+
+        log_async_stop();
+        CU_ASSERT(XA_OK == log_set_sink(NULL, NULL, NULL));
+        check_caught(&c);
+    }
+
+    log_get_stats(&after);
+    CU_ASSERT(2 == after.unsent - before.unsent);
+}
+
+
 void add_suites(CU_pSuite *suite)
 {
     *suite = CU_add_suite("log.c tests", NULL, NULL);
     CU_add_test(*suite, "log_*() Tests", test_most);
+    CU_add_test(*suite, "levels Test", test_levels);
+    CU_add_test(*suite, "async block Test", test_async_block);
+    CU_add_test(*suite, "async drop Test", test_async_drop);
+    CU_add_test(*suite, "async long line Test", test_async_long_line);
+    CU_add_test(*suite, "async binary Test", test_async_binary);
+    CU_add_test(*suite, "subsecond Test", test_subsecond);
+    CU_add_test(*suite, "rate limit Test", test_rate_limit);
+    CU_add_test(*suite, "repeats Test", test_repeats);
+    CU_add_test(*suite, "sink Test", test_sink);
 }
 
 
@@ -0,0 +1,252 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/telemetry/metrics.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+#define THREADS 4
+#define ADDS    100000
+
+struct seen {
+    int count;
+    struct metric_sample s[8];
+    uint64_t buckets[METRICS_BUCKETS];
+};
+
+
+static void collect(void *user, const struct metric_sample *s)
+{
+    struct seen *seen = (struct seen *) user;
+
+    if (seen->count < 8) {
+        seen->s[seen->count] = *s;
+        if (s->buckets) {
+            memcpy(seen->buckets, s->buckets, sizeof(seen->buckets));
+            seen->s[seen->count].buckets = seen->buckets;
+        }
+    }
+    seen->count++;
+}
+
+
+static int64_t read_answer(void *user)
+{
+    return *(int64_t *) user;
+}
+
+
+static void *adder(void *arg)
+{
+    struct metric *c = (struct metric *) arg;
+
+    for (int i = 0; i < ADDS; i++) {
+        metric_add(c, 1);
+    }
+
+    return NULL;
+}
+
+
+void test_counters_and_gauges()
+{
+    struct metrics *m = metrics_create(0, NULL);
+    struct metric *eth0;
+    struct metric *wlan0;
+    struct metric *depth;
+    struct seen seen;
+    int64_t answer = 42;
+
+    CU_ASSERT_FATAL(NULL != m);
+
+    eth0  = metrics_counter(m, "xa_connects_total", "Connects.", "interface", "eth0");
+    wlan0 = metrics_counter(m, "xa_connects_total", "Connects.", "interface", "wlan0");
+    depth = metrics_gauge(m, "xa_depth", NULL, NULL, NULL);
+    CU_ASSERT(NULL != metrics_gauge_fn(m, "xa_answer", "Read.", NULL, NULL, read_answer, &answer));
+    CU_ASSERT_FATAL(NULL != eth0);
+    CU_ASSERT_FATAL(NULL != wlan0);
+    CU_ASSERT_FATAL(NULL != depth);
+
+    /* A label needs a value, and a function metric needs the function. */
+    CU_ASSERT(NULL == metrics_counter(m, "x", NULL, "interface", NULL));
+    CU_ASSERT(NULL == metrics_counter_fn(m, "x", NULL, NULL, NULL, NULL, NULL));
+
+    metric_add(eth0, 3);
+    metric_add(wlan0, 1);
+    metric_add(eth0, 1);
+    metric_set(depth, 10);
+    metric_move(depth, -12);
+    answer = 43;
+
+    memset(&seen, 0, sizeof(seen));
+    metrics_visit(m, collect, &seen);
+    CU_ASSERT_FATAL(4 == seen.count);
+
+    CU_ASSERT_STRING_EQUAL(seen.s[0].name, "xa_connects_total");
+    CU_ASSERT_STRING_EQUAL(seen.s[0].help, "Connects.");
+    CU_ASSERT_STRING_EQUAL(seen.s[0].label, "interface");
+    CU_ASSERT_STRING_EQUAL(seen.s[0].label_value, "eth0");
+    CU_ASSERT(METRIC_TYPE__COUNTER == seen.s[0].type);
+    CU_ASSERT(4 == seen.s[0].value);
+    CU_ASSERT_STRING_EQUAL(seen.s[1].label_value, "wlan0");
+    CU_ASSERT(1 == seen.s[1].value);
+
+    CU_ASSERT(METRIC_TYPE__GAUGE == seen.s[2].type);
+    CU_ASSERT(NULL == seen.s[2].label);
+    CU_ASSERT(NULL == seen.s[2].label_value);
+    CU_ASSERT_STRING_EQUAL(seen.s[2].help, "");
+    CU_ASSERT(-2 == seen.s[2].value);
+
+    CU_ASSERT(43 == seen.s[3].value);
+
+    /* None of these mind a NULL. */
+    metric_add(NULL, 1);
+    metric_set(NULL, 1);
+    metric_move(NULL, 1);
+    metric_observe(NULL, 1);
+    metrics_visit(NULL, collect, &seen);
+    CU_ASSERT(NULL == metrics_counter(NULL, "x", NULL, NULL, NULL));
+
+    metrics_destroy(m);
+}
+
+
+void test_histogram()
+{
+    struct metrics *m = metrics_create(1, NULL);
+    struct metric *h;
+    struct seen seen;
+    uint64_t total = 0;
+
+    CU_ASSERT_FATAL(NULL != m);
+    h = metrics_histogram(m, "xa_latency_us", "Latency.", "stage", "send");
+    CU_ASSERT_FATAL(NULL != h);
+
+    /* Full. */
+    CU_ASSERT(NULL == metrics_counter(m, "x", NULL, NULL, NULL));
+
+    /* The bucket edges only go up, and are at most 25% apart. */
+    for (size_t b = 1; b < METRICS_BUCKETS; b++) {
+        uint64_t lo = metrics_bucket_max(b - 1);
+        uint64_t hi = metrics_bucket_max(b);
+
+        CU_ASSERT(lo < hi);
+        if ((4 <= b) && (b < METRICS_BUCKETS - 1)) {
+            CU_ASSERT((hi - lo) * 4 <= lo + 1);
+        }
+    }
+    CU_ASSERT(3 == metrics_bucket_max(3));
+    CU_ASSERT(4 == metrics_bucket_max(4));
+    CU_ASSERT(9 == metrics_bucket_max(8));
+    CU_ASSERT(0xffffffffull == metrics_bucket_max(METRICS_BUCKETS - 2));
+    CU_ASSERT(UINT64_MAX == metrics_bucket_max(METRICS_BUCKETS - 1));
+
+    metric_observe(h, 0);
+    metric_observe(h, 9);
+    metric_observe(h, 10);
+    metric_observe(h, 1000);
+    metric_observe(h, 0xffffffffull);
+    metric_observe(h, 0x100000000ull);
+
+    memset(&seen, 0, sizeof(seen));
+    metrics_visit(m, collect, &seen);
+    CU_ASSERT_FATAL(1 == seen.count);
+    CU_ASSERT_FATAL(NULL != seen.s[0].buckets);
+    CU_ASSERT(METRIC_TYPE__HISTOGRAM == seen.s[0].type);
+    CU_ASSERT(6 == seen.s[0].count);
+    CU_ASSERT(0x1ffffffffull + 1019 == seen.s[0].sum);
+
+    CU_ASSERT(1 == seen.buckets[0]);
+    CU_ASSERT(1 == seen.buckets[8]);  /* 8 and 9 */
+    CU_ASSERT(1 == seen.buckets[9]);  /* 10 and 11 */
+    CU_ASSERT(1 == seen.buckets[METRICS_BUCKETS - 2]);
+    CU_ASSERT(1 == seen.buckets[METRICS_BUCKETS - 1]);
+
+    /* Each value lands in the bucket whose edges hold it. */
+    CU_ASSERT(metrics_bucket_max(34) < 1000);
+    CU_ASSERT(1000 <= metrics_bucket_max(35));
+    CU_ASSERT(1 == seen.buckets[35]);
+    for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+        total += seen.buckets[b];
+    }
+    CU_ASSERT(6 == total);
+
+    metrics_destroy(m);
+}
+
+
+void test_threads()
+{
+    struct metrics *m = metrics_create(0, NULL);
+    struct metric *c;
+    pthread_t t[THREADS];
+    struct seen seen;
+
+    CU_ASSERT_FATAL(NULL != m);
+    c = metrics_counter(m, "xa_adds_total", NULL, NULL, NULL);
+
+    for (int i = 0; i < THREADS; i++) {
+        CU_ASSERT_FATAL(0 == pthread_create(&t[i], NULL, adder, c));
+    }
+
+    /* Reading while they add is fine. */
+    memset(&seen, 0, sizeof(seen));
+    metrics_visit(m, collect, &seen);
+    CU_ASSERT(seen.s[0].value <= THREADS * ADDS);
+
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(t[i], NULL);
+    }
+
+    memset(&seen, 0, sizeof(seen));
+    metrics_visit(m, collect, &seen);
+    CU_ASSERT(THREADS * ADDS == seen.s[0].value);
+
+    metrics_destroy(m);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("metrics.c tests", NULL, NULL);
+    CU_add_test(*suite, "Counters and gauges Test", test_counters_and_gauges);
+    CU_add_test(*suite, "Histogram Test", test_histogram);
+    CU_add_test(*suite, "Threads Test", test_threads);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L /* nanosleep() */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/telemetry/msg_trace.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static char exported[16384];
+
+
+static void capture(void *user, const char *json, size_t len)
+{
+    (void) user;
+    (void) len;
+
+    snprintf(exported, sizeof(exported), "%s", json);
+}
+
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = ms * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+
+void test_round_trip()
+{
+    struct msg_trace_opts opts = { .sample_every = 1 };
+    struct msg_trace *mt       = msg_trace_create(&opts, NULL);
+    struct msg_trace_record r;
+    int h;
+
+    CU_ASSERT_FATAL(NULL != mt);
+
+    h = msg_trace_begin(mt);
+    CU_ASSERT_FATAL(0 <= h);
+    msg_trace_stamp(mt, h, MSG_STAGE__DECODE);
+    msg_trace_describe(mt, h, 3, "mac:112233445566/config/x", 25);
+    msg_trace_stamp(mt, h, MSG_STAGE__ROUTE);
+    msg_trace_stamp(mt, h, MSG_STAGE__DELIVER);
+    msg_trace_await(mt, h, "tid-1xxx", 5);
+
+    /* The response comes back. */
+    CU_ASSERT(msg_trace_waiting(mt, MSG_STAGE__DELIVER));
+    CU_ASSERT(-1 == msg_trace_find(mt, MSG_STAGE__DELIVER, "tid-2", 5));
+    CU_ASSERT(-1 == msg_trace_find(mt, MSG_STAGE__RESPONSE, "tid-1", 5));
+    CU_ASSERT(h == msg_trace_find(mt, MSG_STAGE__DELIVER, "tid-1", 5));
+    msg_trace_stamp(mt, h, MSG_STAGE__RESPONSE);
+    CU_ASSERT(!msg_trace_waiting(mt, MSG_STAGE__DELIVER));
+    CU_ASSERT(msg_trace_waiting(mt, MSG_STAGE__RESPONSE));
+
+    /* It goes into the batch behind another message. */
+    msg_trace_batched(mt, -1);
+    msg_trace_batched(mt, h);
+    CU_ASSERT(msg_trace_waiting(mt, MSG_STAGE__ENCODE));
+
+    /* Only the first one went out. */
+    msg_trace_sent(mt, 1);
+    CU_ASSERT(0 == msg_trace_read(mt, &r, 1));
+    msg_trace_sent(mt, 1);
+    CU_ASSERT(!msg_trace_waiting(mt, MSG_STAGE__ENCODE));
+
+    CU_ASSERT_FATAL(1 == msg_trace_read(mt, &r, 1));
+    for (int i = MSG_STAGE__DECODE; i < MSG_STAGE__COUNT; i++) {
+        CU_ASSERT(r.at_ns[i - 1] <= r.at_ns[i]);
+    }
+    CU_ASSERT(0 != r.at_ns[MSG_STAGE__RECEIVE]);
+    CU_ASSERT(3 == r.msg_type);
+    CU_ASSERT(XA_OK == r.code);
+    CU_ASSERT(!r.expired);
+    CU_ASSERT_STRING_EQUAL(r.dest, "mac:112233445566/config/x");
+    CU_ASSERT_STRING_EQUAL(r.transaction_uuid, "tid-1");
+
+    /* Ended, so the handle is stale. */
+    msg_trace_stamp(mt, h, MSG_STAGE__SEND);
+    CU_ASSERT(0 == msg_trace_read(mt, &r, 1));
+
+    msg_trace_destroy(mt);
+}
+
+
+void test_sampling()
+{
+    struct msg_trace_opts opts = { .sample_every = 3, .slow_ms = 5 };
+    struct msg_trace *mt       = msg_trace_create(&opts, NULL);
+    struct msg_trace_record r[8];
+    struct msg_trace_stats stats;
+    int h;
+
+    CU_ASSERT_FATAL(NULL != mt);
+
+    /* The 1st and 4th are sampled. */
+    for (int i = 0; i < 6; i++) {
+        h = msg_trace_begin(mt);
+        msg_trace_stamp(mt, h, MSG_STAGE__DECODE);
+        msg_trace_end(mt, h, (XAcode) i);
+    }
+    CU_ASSERT(2 == msg_trace_read(mt, r, 8));
+    CU_ASSERT(XA_OK == r[0].code);
+    CU_ASSERT(3 == r[1].code);
+    CU_ASSERT(!r[0].slow);
+
+    /* The 8th isn't sampled, but it is slow; the 9th is neither. */
+    for (int i = 0; i < 3; i++) {
+        h = msg_trace_begin(mt);
+        if (1 == i) {
+            sleep_ms(10);
+        }
+        msg_trace_stamp(mt, h, MSG_STAGE__DECODE);
+        msg_trace_end(mt, h, (1 == i) ? XA_INVALID_WRP : XA_OK);
+    }
+    CU_ASSERT(2 == msg_trace_read(mt, r, 8));
+    CU_ASSERT(!r[0].slow);
+    CU_ASSERT(r[1].slow);
+    CU_ASSERT(XA_INVALID_WRP == r[1].code);
+
+    msg_trace_stats(mt, &stats);
+    CU_ASSERT(9 == stats.followed);
+    CU_ASSERT(4 == stats.kept);
+    CU_ASSERT(0 == stats.dropped);
+
+    msg_trace_destroy(mt);
+}
+
+
+void test_limits()
+{
+    struct msg_trace_opts opts = {
+        .sample_every = 1,
+        .timeout_ms   = 1,
+        .in_flight    = 1,
+        .records      = 2,
+    };
+    struct msg_trace *mt = msg_trace_create(&opts, NULL);
+    struct msg_trace_record r[4];
+    struct msg_trace_stats stats;
+    int h;
+
+    CU_ASSERT_FATAL(NULL != mt);
+
+    /* One in flight at a time. */
+    h = msg_trace_begin(mt);
+    CU_ASSERT(0 <= h);
+    CU_ASSERT(-1 == msg_trace_begin(mt));
+    msg_trace_stamp(mt, h, MSG_STAGE__DELIVER);
+    msg_trace_await(mt, h, "t", 1);
+
+    /* The response never comes. */
+    sleep_ms(5);
+    msg_trace_expire(mt);
+    CU_ASSERT_FATAL(1 == msg_trace_read(mt, r, 4));
+    CU_ASSERT(r[0].expired);
+    CU_ASSERT(0 == r[0].at_ns[MSG_STAGE__RESPONSE]);
+
+    /* No tid, so it ends as it is delivered; the ring holds 2. */
+    for (int i = 0; i < 3; i++) {
+        h = msg_trace_begin(mt);
+        msg_trace_await(mt, h, NULL, 0);
+    }
+    CU_ASSERT(2 == msg_trace_read(mt, r, 4));
+
+    msg_trace_stats(mt, &stats);
+    CU_ASSERT(1 == stats.untracked);
+    CU_ASSERT(1 == stats.dropped);
+
+    /* None of these mind a NULL or a bad handle. */
+    CU_ASSERT(-1 == msg_trace_begin(NULL));
+    msg_trace_stamp(mt, 7, MSG_STAGE__DECODE);
+    msg_trace_stamp(NULL, 0, MSG_STAGE__DECODE);
+    msg_trace_end(mt, -1, XA_OK);
+    msg_trace_batched(NULL, 0);
+    msg_trace_sent(NULL, 1);
+    msg_trace_expire(NULL);
+    CU_ASSERT(!msg_trace_waiting(NULL, MSG_STAGE__DELIVER));
+    CU_ASSERT(0 == msg_trace_read(NULL, r, 4));
+    CU_ASSERT(NULL == msg_trace_create(NULL, NULL));
+
+    msg_trace_destroy(mt);
+}
+
+
+void test_export()
+{
+    struct msg_trace_opts mopts = { .sample_every = 1 };
+    struct trace_opts topts     = { .export = capture };
+    struct msg_trace *mt        = msg_trace_create(&mopts, NULL);
+    struct trace *t             = trace_create(&topts, NULL);
+    int h;
+
+    CU_ASSERT_FATAL(NULL != mt);
+    CU_ASSERT_FATAL(NULL != t);
+
+    h = msg_trace_begin(mt);
+    msg_trace_stamp(mt, h, MSG_STAGE__DECODE);
+    msg_trace_describe(mt, h, 3, "dns:svc", 7);
+    msg_trace_stamp(mt, h, MSG_STAGE__ROUTE);
+    msg_trace_stamp(mt, h, MSG_STAGE__DELIVER);
+    msg_trace_end(mt, h, XA_OK);
+
+    msg_trace_export(mt, t);
+    trace_flush(t);
+
+    CU_ASSERT(NULL != strstr(exported, "\"name\":\"wrp message\",\"kind\":2,"));
+    CU_ASSERT(NULL != strstr(exported, "\"name\":\"decode\",\"kind\":1,"));
+    CU_ASSERT(NULL != strstr(exported, "\"name\":\"route\""));
+    CU_ASSERT(NULL != strstr(exported, "\"name\":\"local delivery\""));
+    CU_ASSERT(NULL == strstr(exported, "\"name\":\"response\""));
+    CU_ASSERT(NULL != strstr(exported, "{\"key\":\"wrp.dest\",\"value\":{\"stringValue\":\"dns:svc\"}}"));
+    CU_ASSERT(NULL != strstr(exported, "{\"key\":\"xa.kept_for\",\"value\":{\"stringValue\":\"sample\"}}"));
+    CU_ASSERT(NULL == strstr(exported, "\"status\""));
+
+    trace_destroy(t);
+    msg_trace_destroy(mt);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("msg_trace.c tests", NULL, NULL);
+    CU_add_test(*suite, "Round trip Test", test_round_trip);
+    CU_add_test(*suite, "Sampling Test", test_sampling);
+    CU_add_test(*suite, "Limits Test", test_limits);
+    CU_add_test(*suite, "Export Test", test_export);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/pool/pool.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+void test_classes()
+{
+    struct pool *p = pool_create(NULL, NULL);
+    struct pool_stats stats;
+    void *a, *b, *c, *d;
+
+    CU_ASSERT_FATAL(NULL != p);
+
+    a = pool_alloc(p, 0);
+    b = pool_alloc(p, 64);
+    c = pool_alloc(p, 65);
+    d = pool_alloc(p, POOL_MAX_CLASS);
+    CU_ASSERT_FATAL(a && b && c && d);
+    memset(d, 0xa5, POOL_MAX_CLASS);
+
+    /* Aligned for anything. */
+    CU_ASSERT(0 == ((uintptr_t) a % sizeof(long double)));
+
+    pool_stats(p, 0, &stats);
+    CU_ASSERT(64 == stats.size);
+    CU_ASSERT(2 == stats.in_use);
+    CU_ASSERT(2 == stats.misses);
+
+    pool_stats(p, 1, &stats);
+    CU_ASSERT(128 == stats.size);
+    CU_ASSERT(1 == stats.in_use);
+
+    pool_stats(p, POOL_CLASSES - 1, &stats);
+    CU_ASSERT(POOL_MAX_CLASS == stats.size);
+    CU_ASSERT(1 == stats.in_use);
+
+    pool_free(p, a);
+    pool_free(p, b);
+    pool_free(p, c);
+    pool_free(p, d);
+    pool_free(p, NULL);
+
+    pool_stats(p, 0, &stats);
+    CU_ASSERT(0 == stats.in_use);
+    CU_ASSERT(2 == stats.high_water);
+    CU_ASSERT(2 == stats.cached);
+
+    pool_destroy(p);
+}
+
+
+void test_reuse()
+{
+    struct pool *p = pool_create(NULL, NULL);
+    struct pool_stats stats;
+    void *bufs[8];
+
+    CU_ASSERT_FATAL(NULL != p);
+
+    /* Warm up, then a steady state that never calls malloc(). */
+    for (int i = 0; i < 8; i++) {
+        bufs[i] = pool_alloc(p, 1000);
+    }
+    for (int i = 0; i < 8; i++) {
+        pool_free(p, bufs[i]);
+    }
+
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 8; i++) {
+            bufs[i] = pool_alloc(p, 700 + (size_t) i * 40);
+            CU_ASSERT_FATAL(NULL != bufs[i]);
+            memset(bufs[i], i, 700);
+        }
+        for (int i = 7; 0 <= i; i--) {
+            pool_free(p, bufs[i]);
+        }
+    }
+
+    pool_stats(p, 4, &stats);
+    CU_ASSERT(1024 == stats.size);
+    CU_ASSERT(8 == stats.misses);
+    CU_ASSERT(808 == stats.allocs);
+    CU_ASSERT(8 == stats.high_water);
+    CU_ASSERT(8 == stats.cached);
+
+    pool_destroy(p);
+}
+
+
+void test_limits()
+{
+    struct pool_opts opts = { .max_cached_bytes = 256 };
+    struct pool *p        = pool_create(&opts, NULL);
+    struct pool_stats stats;
+    void *bufs[6];
+    void *big;
+
+    CU_ASSERT_FATAL(NULL != p);
+
+    /* Only 4 of the 64 byte buffers are kept. */
+    for (int i = 0; i < 6; i++) {
+        bufs[i] = pool_alloc(p, 10);
+    }
+    for (int i = 0; i < 6; i++) {
+        pool_free(p, bufs[i]);
+    }
+    pool_stats(p, 0, &stats);
+    CU_ASSERT(4 == stats.cached);
+    CU_ASSERT(6 == stats.high_water);
+
+    /* Classes larger than the budget keep nothing. */
+    pool_free(p, pool_alloc(p, 1000));
+    pool_stats(p, 4, &stats);
+    CU_ASSERT(0 == stats.cached);
+
+    /* Too big for any class. */
+    big = pool_alloc(p, POOL_MAX_CLASS + 1);
+    CU_ASSERT_FATAL(NULL != big);
+    memset(big, 0, POOL_MAX_CLASS + 1);
+    pool_stats(p, POOL_CLASSES, &stats);
+    CU_ASSERT(0 == stats.size);
+    CU_ASSERT(1 == stats.in_use);
+    pool_free(p, big);
+    pool_stats(p, POOL_CLASSES, &stats);
+    CU_ASSERT(0 == stats.in_use);
+    CU_ASSERT(0 == stats.cached);
+
+    CU_ASSERT(NULL == pool_alloc(p, SIZE_MAX));
+
+    pool_destroy(p);
+}
+
+
+void test_no_pool()
+{
+    struct pool_stats stats = { .size = 42 };
+    void *buf               = pool_alloc(NULL, 100);
+
+    CU_ASSERT_FATAL(NULL != buf);
+    memset(buf, 0, 100);
+    pool_free(NULL, buf);
+
+    pool_stats(NULL, 0, &stats);
+    CU_ASSERT(42 == stats.size);
+    pool_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("pool.c tests", NULL, NULL);
+    CU_add_test(*suite, "Classes Test", test_classes);
+    CU_add_test(*suite, "Reuse Test", test_reuse);
+    CU_add_test(*suite, "Limits Test", test_limits);
+    CU_add_test(*suite, "No pool Test", test_no_pool);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
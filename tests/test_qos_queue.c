@@ -0,0 +1,377 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/event_loop/event_loop.h"
+#include "../src/outbound/qos_queue.h"
+#include "../src/wrp/wrp_encode.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct sink {
+    size_t accept;
+    size_t count;
+    int rooms; /* on_room calls */
+    int order[64]; /* the ids of the messages received */
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static struct event_loop *loop;
+static struct wrp_encoder *enc;
+static size_t msg_len; /* every test message encodes to this size */
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static size_t encode_id(int id, uint8_t *buf, size_t len)
+{
+    struct wrp_out msg;
+    char dest[8];
+
+    snprintf(dest, sizeof(dest), "d%03d", id);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = WRP_MSG_TYPE__EVENT;
+    msg.dest.s   = dest;
+    msg.dest.len = strlen(dest);
+
+    return wrp_encode(enc, &msg, buf, len);
+}
+
+
+static bool sink_fn(void *user, enum qos_level level, const void *buf, size_t len)
+{
+    struct sink *s = (struct sink *) user;
+    uint8_t want[64];
+
+    (void) level;
+
+    if (s->count == s->accept) {
+        return false;
+    }
+
+    for (int id = 0; id < 1000; id++) {
+        if ((len == encode_id(id, want, sizeof(want)))
+            && (0 == memcmp(want, buf, len)))
+        {
+            s->order[s->count++] = id;
+            return true;
+        }
+    }
+
+    CU_FAIL("unknown message");
+    return false;
+}
+
+
+static void on_room(void *user)
+{
+    ((struct sink *) user)->rooms++;
+}
+
+
+static XAcode push(struct qos_queue *q, int id, int qos)
+{
+    struct wrp_out msg;
+    char dest[8];
+
+    snprintf(dest, sizeof(dest), "d%03d", id);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = WRP_MSG_TYPE__EVENT;
+    msg.dest.s   = dest;
+    msg.dest.len = strlen(dest);
+
+    return qos_queue_push(q, enc, &msg, qos, NULL);
+}
+
+
+static struct qos_queue *make(struct sink *s, struct qos_queue_opts *opts)
+{
+    memset(s, 0, sizeof(struct sink));
+    s->accept = 64;
+
+    opts->loop = loop;
+    opts->sink = sink_fn;
+    opts->user = s;
+
+    return qos_queue_create(opts, NULL);
+}
+
+
+void test_levels()
+{
+    CU_ASSERT(QOS__LOW == qos_level_from_value(-5));
+    CU_ASSERT(QOS__LOW == qos_level_from_value(0));
+    CU_ASSERT(QOS__LOW == qos_level_from_value(24));
+    CU_ASSERT(QOS__MEDIUM == qos_level_from_value(25));
+    CU_ASSERT(QOS__MEDIUM == qos_level_from_value(49));
+    CU_ASSERT(QOS__HIGH == qos_level_from_value(50));
+    CU_ASSERT(QOS__HIGH == qos_level_from_value(74));
+    CU_ASSERT(QOS__CRITICAL == qos_level_from_value(75));
+    CU_ASSERT(QOS__CRITICAL == qos_level_from_value(200));
+
+    CU_ASSERT_STRING_EQUAL(qos_level_to_string(QOS__CRITICAL), "critical");
+    CU_ASSERT_STRING_EQUAL(qos_level_to_string((enum qos_level) 9), "invalid");
+}
+
+
+void test_priority()
+{
+    struct qos_queue_opts opts = { .max_bytes = 0 };
+    struct qos_stats stats;
+    struct sink s;
+    struct qos_queue *q = make(&s, &opts);
+    uint8_t raw[64];
+    size_t len;
+
+    CU_ASSERT_FATAL(NULL != q);
+
+    for (int i = 0; i < 5; i++) {
+        CU_ASSERT(XA_OK == push(q, i, 0));
+    }
+    CU_ASSERT(XA_OK == push(q, 100, 99));
+    CU_ASSERT(XA_OK == push(q, 101, 80));
+
+    /* Already encoded messages are queued the same way. */
+    len = encode_id(102, raw, sizeof(raw));
+    CU_ASSERT(XA_OK == qos_queue_push_encoded(q, raw, len, 60, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == qos_queue_push_encoded(q, NULL, len, 60, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == qos_queue_push_encoded(NULL, raw, len, 60, NULL));
+
+    /* The drain happens on the loop. */
+    CU_ASSERT(0 == s.count);
+    event_loop_run_once(loop, 0, NULL);
+    CU_ASSERT(8 == s.count);
+
+    CU_ASSERT(100 == s.order[0]);
+    CU_ASSERT(101 == s.order[1]);
+    CU_ASSERT(102 == s.order[2]);
+    for (int i = 0; i < 5; i++) {
+        CU_ASSERT(i == s.order[3 + i]);
+    }
+
+    qos_queue_stats(q, QOS__LOW, &stats);
+    CU_ASSERT(5 == stats.queued);
+    CU_ASSERT(5 == stats.sent);
+    CU_ASSERT(0 == stats.depth);
+    CU_ASSERT(0 == stats.bytes);
+
+    qos_queue_destroy(q);
+}
+
+
+void test_weighted()
+{
+    struct qos_queue_opts opts = { .weight = { 1, 2, 0, 0 } };
+    int expect[] = { 10, 11, 0, 12, 13, 1, 14, 2, 3 };
+    struct sink s;
+    struct qos_queue *q = make(&s, &opts);
+
+    CU_ASSERT_FATAL(NULL != q);
+
+    for (int i = 0; i < 4; i++) {
+        CU_ASSERT(XA_OK == push(q, i, 10));
+    }
+    for (int i = 10; i < 15; i++) {
+        CU_ASSERT(XA_OK == push(q, i, 30));
+    }
+
+    CU_ASSERT(9 == qos_queue_drain(q));
+    for (size_t i = 0; i < sizeof(expect) / sizeof(expect[0]); i++) {
+        CU_ASSERT(expect[i] == s.order[i]);
+    }
+
+    qos_queue_destroy(q);
+}
+
+
+void test_backpressure()
+{
+    struct qos_queue_opts opts = { .max_bytes = 0 };
+    struct qos_stats stats;
+    struct sink s;
+    struct pool *pool = pool_create(NULL, NULL);
+    struct pool_stats ps;
+    struct qos_queue *q;
+    size_t room;
+
+    /* Messages are kept in the pool and go back to it once sent. */
+    opts.on_room = on_room;
+    opts.pool    = pool;
+    q            = make(&s, &opts);
+    CU_ASSERT_FATAL(NULL != q);
+    room = qos_queue_room(q);
+    CU_ASSERT(0 < room);
+
+    s.accept = 2;
+    for (int i = 0; i < 4; i++) {
+        CU_ASSERT(XA_OK == push(q, i, 60));
+    }
+    CU_ASSERT(room - 4 * msg_len == qos_queue_room(q));
+    CU_ASSERT(2 == qos_queue_drain(q));
+    CU_ASSERT(1 == s.rooms);
+    CU_ASSERT(room - 2 * msg_len == qos_queue_room(q));
+
+    qos_queue_stats(q, QOS__HIGH, &stats);
+    CU_ASSERT(2 == stats.depth);
+    CU_ASSERT(2 * msg_len == stats.bytes);
+
+    /* Nothing taken, nobody told. */
+    s.accept = 2;
+    CU_ASSERT(0 == qos_queue_drain(q));
+    CU_ASSERT(1 == s.rooms);
+
+    s.accept = 64;
+    CU_ASSERT(2 == qos_queue_drain(q));
+    CU_ASSERT(3 == s.order[3]);
+    CU_ASSERT(2 == s.rooms);
+    CU_ASSERT(room == qos_queue_room(q));
+
+    qos_queue_destroy(q);
+
+    pool_stats(pool, 0, &ps);
+    CU_ASSERT(4 == ps.high_water);
+    CU_ASSERT(0 == ps.in_use);
+    CU_ASSERT(4 == ps.cached);
+    pool_destroy(pool);
+}
+
+
+void test_eviction()
+{
+    struct qos_queue_opts opts = {
+        .max_bytes       = 4 * msg_len,
+        .level_max_bytes = { 3 * msg_len, 0, 0, 4 * msg_len },
+    };
+    struct qos_stats stats;
+    struct sink s;
+    struct qos_queue *q = make(&s, &opts);
+
+    CU_ASSERT_FATAL(NULL != q);
+    CU_ASSERT(3 * msg_len == qos_queue_level_room(q, QOS__LOW));
+    CU_ASSERT(4 * msg_len == qos_queue_level_room(q, QOS__CRITICAL));
+
+    /* The low level is capped at 3 messages. */
+    CU_ASSERT(XA_OK == push(q, 0, 0));
+    CU_ASSERT(XA_OK == push(q, 1, 0));
+    CU_ASSERT(XA_OK == push(q, 2, 0));
+    CU_ASSERT(0 == qos_queue_level_room(q, QOS__LOW));
+    CU_ASSERT(XA_INSUFFICIENT_RESOURCES == push(q, 3, 0));
+    CU_ASSERT(4 * msg_len == qos_queue_level_room(q, QOS__CRITICAL));
+
+    /* Critical traffic evicts the oldest low priority messages. */
+    CU_ASSERT(XA_OK == push(q, 10, 90));
+    CU_ASSERT(XA_OK == push(q, 11, 90));
+    CU_ASSERT(XA_OK == push(q, 12, 90));
+
+    qos_queue_stats(q, QOS__LOW, &stats);
+    CU_ASSERT(2 == stats.evicted);
+    CU_ASSERT(1 == stats.dropped);
+    CU_ASSERT(1 == stats.depth);
+
+    /* Low priority can't push out critical. */
+    CU_ASSERT(0 == qos_queue_level_room(q, QOS__LOW));
+    CU_ASSERT(XA_INSUFFICIENT_RESOURCES == push(q, 4, 0));
+    CU_ASSERT(msg_len == qos_queue_level_room(q, QOS__CRITICAL));
+    CU_ASSERT(XA_OK == push(q, 13, 90));
+    CU_ASSERT(0 == qos_queue_level_room(q, QOS__CRITICAL));
+    CU_ASSERT(XA_INSUFFICIENT_RESOURCES == push(q, 14, 90));
+
+    CU_ASSERT(4 == qos_queue_drain(q));
+    CU_ASSERT(10 == s.order[0]);
+    CU_ASSERT(13 == s.order[3]);
+
+    qos_queue_destroy(q);
+}
+
+
+void test_bad_inputs()
+{
+    struct qos_queue_opts opts = { .loop = NULL };
+    struct wrp_out msg;
+    struct sink s;
+    struct qos_queue *q;
+    XAcode err = XA_OK;
+
+    CU_ASSERT(NULL == qos_queue_create(NULL, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == qos_queue_create(&opts, NULL));
+
+    q = make(&s, &opts);
+    CU_ASSERT_FATAL(NULL != q);
+
+    memset(&msg, 0, sizeof(msg));
+    CU_ASSERT(XA_INVALID_INPUT == qos_queue_push(q, enc, &msg, 0, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == qos_queue_push(NULL, enc, &msg, 0, NULL));
+    CU_ASSERT(0 == qos_queue_drain(NULL));
+    CU_ASSERT(0 == qos_queue_room(NULL));
+    CU_ASSERT(0 == qos_queue_level_room(NULL, QOS__LOW));
+    qos_queue_kick(NULL);
+
+    /* Destroying with messages queued releases them. */
+    CU_ASSERT(XA_OK == push(q, 1, 0));
+    qos_queue_destroy(q);
+    qos_queue_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("qos_queue.c tests", NULL, NULL);
+    CU_add_test(*suite, "Levels Test", test_levels);
+    CU_add_test(*suite, "Priority Test", test_priority);
+    CU_add_test(*suite, "Weighted Test", test_weighted);
+    CU_add_test(*suite, "Backpressure Test", test_backpressure);
+    CU_add_test(*suite, "Eviction Test", test_eviction);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    loop = event_loop_create(NULL);
+    enc  = wrp_encoder_create("mac:112233445566", NULL);
+    if (!loop || !enc) {
+        return 1;
+    }
+    msg_len = encode_id(0, NULL, 0);
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    wrp_encoder_destroy(enc);
+    event_loop_destroy(loop);
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
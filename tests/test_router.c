@@ -0,0 +1,267 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/inbound/router.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct endpoint {
+    int calls;
+    const struct wrp_view *last;
+    const void *buf;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void on_msg(void *user, const struct wrp_view *msg, const void *buf, size_t len)
+{
+    struct endpoint *e = (struct endpoint *) user;
+
+    (void) len;
+
+    e->calls++;
+    e->last = msg;
+    e->buf  = buf;
+}
+
+
+static void count_msg(void *user, const struct wrp_view *msg, const void *buf, size_t len)
+{
+    (void) msg;
+    (void) buf;
+    (void) len;
+
+    (*(int *) user)++;
+}
+
+
+static void set_dest(struct wrp_view *msg, const char *dest)
+{
+    memset(msg, 0, sizeof(struct wrp_view));
+    msg->dest.s   = dest;
+    msg->dest.len = (dest) ? strlen(dest) : 0;
+}
+
+
+void test_dest_service()
+{
+    struct {
+        const char *dest;
+        const char *want;
+    } tests[] = {
+        { "mac:112233445566/config/foo/bar", "config" },
+        { "mac:112233445566/config", "config" },
+        { "dns:example.com/telemetry/", "telemetry" },
+        { "mac:112233445566", "" },
+        { "mac:112233445566/", "" },
+        { "", "" },
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        struct xa_const_string in = { .len = strlen(tests[i].dest), .s = tests[i].dest };
+        struct xa_const_string got = router_dest_service(&in);
+
+        CU_ASSERT(strlen(tests[i].want) == got.len);
+        CU_ASSERT(0 == strncmp(tests[i].want, got.s, got.len));
+    }
+
+    CU_ASSERT(0 == router_dest_service(NULL).len);
+}
+
+
+void test_dispatch()
+{
+    struct endpoint config, wifi, other;
+    struct router *r = router_create(NULL);
+    struct wrp_view msg;
+    XAcode err = XA_OK;
+    char buf[] = "raw";
+
+    memset(&config, 0, sizeof(config));
+    memset(&wifi, 0, sizeof(wifi));
+    memset(&other, 0, sizeof(other));
+
+    CU_ASSERT_FATAL(NULL != r);
+
+    /* Nothing registered. */
+    set_dest(&msg, "mac:112233445566/config");
+    CU_ASSERT(XA_NO_ROUTE == router_dispatch(r, &msg, buf, 3, &err));
+    CU_ASSERT(XA_NO_ROUTE == err);
+
+    CU_ASSERT(XA_OK == router_register(r, "config", on_msg, &config, NULL));
+    CU_ASSERT(XA_OK == router_register(r, "wifi", on_msg, &wifi, NULL));
+    CU_ASSERT(2 == router_count(r));
+
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    CU_ASSERT(1 == config.calls);
+    CU_ASSERT(&msg == config.last);
+    CU_ASSERT(buf == config.buf);
+
+    set_dest(&msg, "mac:112233445566/wifi/radio/1");
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    CU_ASSERT(1 == wifi.calls);
+
+    /* A prefix of a service is not the service. */
+    set_dest(&msg, "mac:112233445566/conf/x");
+    CU_ASSERT(XA_NO_ROUTE == router_dispatch(r, &msg, buf, 3, NULL));
+
+    /* The wildcard catches everything else. */
+    CU_ASSERT(XA_OK == router_register(r, ROUTER_WILDCARD, on_msg, &other, NULL));
+    CU_ASSERT(2 == router_count(r));
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    set_dest(&msg, "mac:112233445566");
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    set_dest(&msg, NULL);
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    CU_ASSERT(3 == other.calls);
+    CU_ASSERT(1 == config.calls);
+
+    /* Unregistering falls back to the wildcard. */
+    CU_ASSERT(true == router_unregister(r, "config"));
+    CU_ASSERT(false == router_unregister(r, "config"));
+    CU_ASSERT(1 == router_count(r));
+    set_dest(&msg, "mac:112233445566/config");
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    CU_ASSERT(4 == other.calls);
+
+    CU_ASSERT(true == router_unregister(r, ROUTER_WILDCARD));
+    CU_ASSERT(false == router_unregister(r, ROUTER_WILDCARD));
+    CU_ASSERT(XA_NO_ROUTE == router_dispatch(r, &msg, buf, 3, NULL));
+
+    /* And it can come back. */
+    CU_ASSERT(XA_OK == router_register(r, "config", on_msg, &config, NULL));
+    CU_ASSERT(XA_OK == router_dispatch(r, &msg, buf, 3, NULL));
+    CU_ASSERT(2 == config.calls);
+
+    /* Everything belonging to one endpoint goes at once. */
+    CU_ASSERT(XA_OK == router_register(r, "config2", on_msg, &config, NULL));
+    CU_ASSERT(XA_OK == router_register(r, ROUTER_WILDCARD, on_msg, &config, NULL));
+    CU_ASSERT(3 == router_count(r));
+    CU_ASSERT(3 == router_unregister_user(r, &config));
+    CU_ASSERT(1 == router_count(r));
+    CU_ASSERT(XA_NO_ROUTE == router_dispatch(r, &msg, buf, 3, NULL));
+    CU_ASSERT(0 == router_unregister_user(r, &config));
+    CU_ASSERT(0 == router_unregister_user(NULL, &config));
+
+    router_destroy(r);
+}
+
+
+void test_many()
+{
+    struct router *r = router_create(NULL);
+    int calls[200];
+    char name[32];
+    struct wrp_view msg;
+    char dest[64];
+
+    CU_ASSERT_FATAL(NULL != r);
+    memset(calls, 0, sizeof(calls));
+
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "svc-%d", i);
+        CU_ASSERT(XA_OK == router_register(r, name, count_msg, &calls[i], NULL));
+    }
+    CU_ASSERT(200 == router_count(r));
+
+    for (int i = 0; i < 200; i += 2) {
+        snprintf(name, sizeof(name), "svc-%d", i);
+        CU_ASSERT(true == router_unregister(r, name));
+    }
+    CU_ASSERT(100 == router_count(r));
+
+    for (int i = 0; i < 200; i++) {
+        snprintf(dest, sizeof(dest), "mac:112233445566/svc-%d/x", i);
+        set_dest(&msg, dest);
+        if (i % 2) {
+            CU_ASSERT(XA_OK == router_dispatch(r, &msg, NULL, 0, NULL));
+        } else {
+            CU_ASSERT(XA_NO_ROUTE == router_dispatch(r, &msg, NULL, 0, NULL));
+        }
+    }
+
+    /* Each message reached exactly its own service. */
+    for (int i = 0; i < 200; i++) {
+        CU_ASSERT((i % 2) == calls[i]);
+    }
+
+    router_destroy(r);
+}
+
+
+void test_bad_inputs()
+{
+    struct router *r = router_create(NULL);
+    struct endpoint e;
+    struct wrp_view msg;
+
+    CU_ASSERT_FATAL(NULL != r);
+
+    CU_ASSERT(XA_INVALID_INPUT == router_register(NULL, "a", on_msg, &e, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_register(r, NULL, on_msg, &e, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_register(r, "a", NULL, &e, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_register(r, "", on_msg, &e, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_register(r, "a/b", on_msg, &e, NULL));
+
+    CU_ASSERT(XA_OK == router_register(r, "a", on_msg, &e, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_register(r, "a", on_msg, &e, NULL));
+    CU_ASSERT(XA_OK == router_register(r, ROUTER_WILDCARD, on_msg, &e, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_register(r, ROUTER_WILDCARD, on_msg, &e, NULL));
+
+    set_dest(&msg, "x");
+    CU_ASSERT(XA_INVALID_INPUT == router_dispatch(NULL, &msg, NULL, 0, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == router_dispatch(r, NULL, NULL, 0, NULL));
+    CU_ASSERT(false == router_unregister(NULL, "a"));
+    CU_ASSERT(false == router_unregister(r, NULL));
+    CU_ASSERT(0 == router_count(NULL));
+
+    router_destroy(r);
+    router_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("router.c tests", NULL, NULL);
+    CU_add_test(*suite, "Dest service Test", test_dest_service);
+    CU_add_test(*suite, "Dispatch Test", test_dispatch);
+    CU_add_test(*suite, "Many services Test", test_many);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
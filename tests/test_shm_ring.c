@@ -0,0 +1,352 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _GNU_SOURCE /* memfd_create() */
+
+#include <CUnit/Basic.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/ipc/shm_ring.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct seen {
+    size_t count;
+    size_t bytes;
+    uint32_t next;
+    bool in_order;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static bool collect(void *user, const void *buf, size_t len)
+{
+    struct seen *s = (struct seen *) user;
+    uint32_t v;
+
+    s->count++;
+    s->bytes += len;
+
+    if (sizeof(v) <= len) {
+        memcpy(&v, buf, sizeof(v));
+        if (v != s->next) {
+            s->in_order = false;
+        }
+        s->next++;
+    }
+
+    return true;
+}
+
+
+/* Takes only as many messages as it has room for. */
+static bool limited(void *user, const void *buf, size_t len)
+{
+    size_t *room = (size_t *) user;
+
+    (void) buf;
+    (void) len;
+
+    if (!*room) {
+        return false;
+    }
+    (*room)--;
+
+    return true;
+}
+
+
+/* The consumer side of a ring, as the agent would see it. */
+static struct shm_ring *attach(struct shm_ring *r)
+{
+    return shm_ring_attach(dup(shm_ring_memfd(r)), dup(shm_ring_eventfd(r)), NULL);
+}
+
+
+static bool doorbell(struct shm_ring *r)
+{
+    uint64_t v = 0;
+
+    return (sizeof(v) == read(shm_ring_eventfd(r), &v, sizeof(v))) && (0 < v);
+}
+
+
+void test_basic()
+{
+    struct shm_ring *p = shm_ring_create(0, NULL);
+    struct shm_ring *c;
+    struct seen seen = { .in_order = true };
+    uint8_t msg[100];
+    size_t count;
+
+    CU_ASSERT_FATAL(NULL != p);
+    CU_ASSERT(SHM_RING_MIN_BYTES / 2 - 8 == shm_ring_max_msg(p));
+
+    c = attach(p);
+    CU_ASSERT_FATAL(NULL != c);
+
+    /* Nothing to read. */
+    CU_ASSERT(XA_OK == shm_ring_read(c, 10, collect, &seen, &count, NULL));
+    CU_ASSERT(0 == count);
+
+    /* Several sizes, including empty, drained in order. */
+    for (uint32_t i = 0; i < 10; i++) {
+        memset(msg, 0, sizeof(msg));
+        memcpy(msg, &i, sizeof(i));
+        CU_ASSERT(XA_OK == shm_ring_write(p, msg, 4 + i * 9, NULL));
+    }
+    CU_ASSERT(XA_OK == shm_ring_write(p, NULL, 0, NULL));
+
+    CU_ASSERT(XA_OK == shm_ring_read(c, 4, collect, &seen, &count, NULL));
+    CU_ASSERT(4 == count);
+    CU_ASSERT(XA_OK == shm_ring_read(c, 100, collect, &seen, &count, NULL));
+    CU_ASSERT(7 == count);
+    CU_ASSERT(11 == seen.count);
+    CU_ASSERT(40 + 9 * 45 == seen.bytes);
+    CU_ASSERT(seen.in_order);
+
+    /* A refused message stays in the ring for next time. */
+    for (uint32_t i = 0; i < 3; i++) {
+        CU_ASSERT(XA_OK == shm_ring_write(p, msg, 8, NULL));
+    }
+    {
+        size_t room = 2;
+
+        CU_ASSERT(XA_OK == shm_ring_read(c, 10, limited, &room, &count, NULL));
+        CU_ASSERT(2 == count);
+        CU_ASSERT(XA_OK == shm_ring_read(c, 10, limited, &room, &count, NULL));
+        CU_ASSERT(0 == count);
+        room = 5;
+        CU_ASSERT(XA_OK == shm_ring_read(c, 10, limited, &room, &count, NULL));
+        CU_ASSERT(1 == count);
+    }
+
+    shm_ring_destroy(c);
+    shm_ring_destroy(p);
+}
+
+
+void test_wrap_and_full()
+{
+    struct shm_ring *p = shm_ring_create(1, NULL);
+    struct shm_ring *c = attach(p);
+    struct seen seen   = { .in_order = true };
+    uint8_t msg[SHM_RING_MIN_BYTES];
+    uint32_t sent = 0;
+    size_t count;
+
+    CU_ASSERT_FATAL(NULL != c);
+
+    /* Odd sized messages, so the records wrap at every position. */
+    for (int round = 0; round < 50; round++) {
+        int burst = 0;
+
+        while (1) {
+            memset(msg, (int) sent, sizeof(msg));
+            memcpy(msg, &sent, sizeof(sent));
+            if (XA_OK != shm_ring_write(p, msg, 100 + (sent * 37) % 600, NULL)) {
+                break;
+            }
+            sent++;
+            burst++;
+        }
+        CU_ASSERT(0 < burst);
+
+        /* Full until the consumer catches up. */
+        CU_ASSERT(XA_INSUFFICIENT_RESOURCES == shm_ring_write(p, msg, 700, NULL));
+
+        CU_ASSERT(XA_OK == shm_ring_read(c, 1000, collect, &seen, &count, NULL));
+        CU_ASSERT((size_t) burst == count);
+    }
+    CU_ASSERT(sent == seen.count);
+    CU_ASSERT(seen.in_order);
+
+    /* Too big to ever fit. */
+    CU_ASSERT(XA_INVALID_INPUT == shm_ring_write(p, msg, shm_ring_max_msg(p) + 1, NULL));
+    CU_ASSERT(XA_OK == shm_ring_write(p, msg, shm_ring_max_msg(p), NULL));
+
+    shm_ring_destroy(c);
+    shm_ring_destroy(p);
+}
+
+
+void test_doorbell()
+{
+    struct shm_ring *p = shm_ring_create(0, NULL);
+    struct shm_ring *c = attach(p);
+    struct seen seen   = { .in_order = true };
+    uint32_t v         = 0;
+    size_t count;
+
+    CU_ASSERT_FATAL(NULL != c);
+
+    /* No doorbell unless the consumer is waiting. */
+    CU_ASSERT(XA_OK == shm_ring_write(p, &v, sizeof(v), NULL));
+    CU_ASSERT(!doorbell(c));
+
+    /* Arming notices the message that is already there. */
+    CU_ASSERT(shm_ring_arm(c));
+    CU_ASSERT(XA_OK == shm_ring_read(c, 10, collect, &seen, &count, NULL));
+    CU_ASSERT(1 == count);
+    CU_ASSERT(!shm_ring_arm(c));
+
+    /* Only the first write after arming rings. */
+    v = 1;
+    CU_ASSERT(XA_OK == shm_ring_write(p, &v, sizeof(v), NULL));
+    v = 2;
+    CU_ASSERT(XA_OK == shm_ring_write(p, &v, sizeof(v), NULL));
+    CU_ASSERT(doorbell(c));
+    CU_ASSERT(!doorbell(c));
+
+    CU_ASSERT(XA_OK == shm_ring_read(c, 10, collect, &seen, &count, NULL));
+    CU_ASSERT(2 == count);
+    CU_ASSERT(seen.in_order);
+
+    shm_ring_destroy(c);
+    shm_ring_destroy(p);
+}
+
+
+void test_corrupt()
+{
+    struct shm_ring *p = shm_ring_create(0, NULL);
+    struct shm_ring *c = attach(p);
+    struct seen seen   = { .in_order = true };
+    uint32_t v         = 0;
+    uint64_t head;
+    uint8_t *base;
+    size_t count;
+
+    CU_ASSERT_FATAL(NULL != c);
+
+    /* Poke at the shared memory the way a misbehaving producer could. */
+    base = mmap(NULL, 4096 + SHM_RING_MIN_BYTES, PROT_READ | PROT_WRITE,
+                MAP_SHARED, shm_ring_memfd(p), 0);
+    CU_ASSERT_FATAL(MAP_FAILED != base);
+
+    CU_ASSERT(XA_OK == shm_ring_write(p, &v, sizeof(v), NULL));
+
+    /* A length running past the published head. */
+    v = 100;
+    memcpy(&base[4096], &v, sizeof(v));
+    CU_ASSERT(XA_INVALID_INPUT == shm_ring_read(c, 10, collect, &seen, &count, NULL));
+    CU_ASSERT(0 == seen.count);
+
+    /* A head further ahead than the ring is long. */
+    memcpy(&head, &base[64], sizeof(head));
+    head += 2 * SHM_RING_MIN_BYTES;
+    memcpy(&base[64], &head, sizeof(head));
+    CU_ASSERT(XA_INVALID_INPUT == shm_ring_read(c, 10, collect, &seen, &count, NULL));
+    CU_ASSERT(0 == seen.count);
+
+    munmap(base, 4096 + SHM_RING_MIN_BYTES);
+    shm_ring_destroy(c);
+    shm_ring_destroy(p);
+}
+
+
+void test_attach()
+{
+    struct shm_ring *p = shm_ring_create(10000, NULL);
+    XAcode err         = XA_OK;
+    int fd;
+
+    CU_ASSERT_FATAL(NULL != p);
+    CU_ASSERT(16384 / 2 - 8 == shm_ring_max_msg(p));
+
+    /* Unsealed memory could shrink under the consumer. */
+    fd = memfd_create("test", MFD_CLOEXEC);
+    CU_ASSERT(0 == ftruncate(fd, 4096 + SHM_RING_MIN_BYTES));
+    CU_ASSERT(NULL == shm_ring_attach(fd, eventfd(0, 0), &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+
+    /* Sealed, but not a ring. */
+    fd = memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    CU_ASSERT(0 == ftruncate(fd, 4096 + SHM_RING_MIN_BYTES));
+    CU_ASSERT(0 == fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW));
+    err = XA_OK;
+    CU_ASSERT(NULL == shm_ring_attach(fd, eventfd(0, 0), &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+
+    /* A valid ring in a file that can't be sealed, so could still shrink. */
+    {
+        FILE *f = tmpfile();
+        struct stat st;
+        void *ring;
+
+        CU_ASSERT_FATAL(NULL != f);
+        CU_ASSERT_FATAL(0 == fstat(shm_ring_memfd(p), &st));
+        ring = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, shm_ring_memfd(p), 0);
+        CU_ASSERT_FATAL(MAP_FAILED != ring);
+        CU_ASSERT(1 == fwrite(ring, (size_t) st.st_size, 1, f));
+        CU_ASSERT(0 == fflush(f));
+        munmap(ring, (size_t) st.st_size);
+
+        err = XA_OK;
+        CU_ASSERT(NULL == shm_ring_attach(dup(fileno(f)), eventfd(0, 0), &err));
+        CU_ASSERT(XA_INVALID_INPUT == err);
+        fclose(f);
+    }
+
+    CU_ASSERT(NULL == shm_ring_attach(-1, -1, &err));
+    CU_ASSERT(NULL == shm_ring_create(((size_t) 1 << 30) + 1, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(XA_INVALID_INPUT == shm_ring_write(NULL, "a", 1, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == shm_ring_read(NULL, 1, collect, NULL, NULL, NULL));
+    CU_ASSERT(!shm_ring_arm(NULL));
+    CU_ASSERT(-1 == shm_ring_memfd(NULL));
+    CU_ASSERT(0 == shm_ring_max_msg(NULL));
+    shm_ring_destroy(NULL);
+
+    shm_ring_destroy(p);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("shm_ring.c tests", NULL, NULL);
+    CU_add_test(*suite, "Basic Test", test_basic);
+    CU_add_test(*suite, "Wrap and full Test", test_wrap_and_full);
+    CU_add_test(*suite, "Doorbell Test", test_doorbell);
+    CU_add_test(*suite, "Corrupt Test", test_corrupt);
+    CU_add_test(*suite, "Attach Test", test_attach);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
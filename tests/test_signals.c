@@ -0,0 +1,106 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/cli/signals.h"
+
+static int seen[4];
+static int total;
+
+
+static void handler(enum signals_command cmd)
+{
+    seen[cmd]++;
+    total++;
+}
+
+
+static void deliver(struct event_loop *loop, int sig)
+{
+    XAcode rv = XA_OK;
+
+    CU_ASSERT(0 == raise(sig));
+    CU_ASSERT(XA_OK == event_loop_run_once(loop, 100, &rv));
+}
+
+
+void test_signals(void)
+{
+    XAcode rv               = XA_OK;
+    struct event_loop *loop = event_loop_create(&rv);
+
+    CU_ASSERT_FATAL(NULL != loop);
+    CU_ASSERT(XA_INVALID_INPUT == signals_config(NULL, handler, &rv));
+    CU_ASSERT_FATAL(XA_OK == signals_config(loop, handler, &rv));
+
+    deliver(loop, SIGINT);
+    CU_ASSERT(1 == seen[SIG_EVENT__STOP]);
+
+    deliver(loop, SIGQUIT);
+    CU_ASSERT(2 == seen[SIG_EVENT__STOP]);
+
+    deliver(loop, SIGTERM);
+    CU_ASSERT(1 == seen[SIG_EVENT__TERMINATE]);
+
+    deliver(loop, SIGUSR1);
+    CU_ASSERT(1 == seen[SIG_EVENT__SYSTEM_IS_RESTARTING]);
+
+    deliver(loop, SIGHUP);
+    CU_ASSERT(1 == seen[SIG_EVENT__RELOAD]);
+
+    /* Ignored signals are consumed without calling the handler. */
+    deliver(loop, SIGUSR2);
+    deliver(loop, SIGCHLD);
+    deliver(loop, SIGALRM);
+    CU_ASSERT(0 == raise(SIGPIPE));
+    CU_ASSERT(5 == total);
+
+    signals_cleanup();
+    signals_cleanup();
+    event_loop_destroy(loop);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("signals.c tests", NULL, NULL);
+    CU_add_test(*suite, "signals_config() Tests", test_signals);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
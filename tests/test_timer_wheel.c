@@ -0,0 +1,236 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/event_loop/event_loop.h"
+#include "../src/event_loop/timer_wheel.h"
+#include "../src/websocket/keepalive.h"
+
+#define TICK_MS 10
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct fired {
+    struct timer_wheel *w;
+    uint64_t at;
+    int count;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static struct event_loop *loop;
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void record(struct wheel_timer *t, void *user)
+{
+    struct fired *f = (struct fired *) user;
+
+    (void) t;
+
+    f->at = timer_wheel_now(f->w);
+    f->count++;
+}
+
+
+static void rearm(struct wheel_timer *t, void *user)
+{
+    struct fired *f = (struct fired *) user;
+
+    record(t, user);
+    if (f->count < 3) {
+        wheel_timer_set(f->w, t, 100);
+    }
+}
+
+
+static void advance_to(struct timer_wheel *w, uint64_t tick)
+{
+    timer_wheel_advance(w, tick * TICK_MS);
+}
+
+
+void test_expiry_ticks()
+{
+    uint64_t delays[] = { 1, 5, 63, 64, 65, 100, 4095, 4096, 4097, 262143, 262144, 300000 };
+    size_t count      = sizeof(delays) / sizeof(delays[0]);
+    struct wheel_timer t[12];
+    struct fired f[12];
+    struct timer_wheel *w;
+
+    w = timer_wheel_create(loop, TICK_MS, NULL);
+    CU_ASSERT_FATAL(NULL != w);
+
+    /* Start away from 0 so the slots are not all aligned. */
+    advance_to(w, 77);
+    CU_ASSERT(77 == timer_wheel_now(w));
+
+    for (size_t i = 0; i < count; i++) {
+        memset(&f[i], 0, sizeof(f[i]));
+        f[i].w = w;
+        wheel_timer_init(&t[i], record, &f[i]);
+        wheel_timer_set(w, &t[i], delays[i]);
+        CU_ASSERT(wheel_timer_is_active(&t[i]));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        advance_to(w, 77 + delays[i] - 1);
+        CU_ASSERT(0 == f[i].count);
+        advance_to(w, 77 + delays[i]);
+        CU_ASSERT(1 == f[i].count);
+        CU_ASSERT(77 + delays[i] == f[i].at);
+        CU_ASSERT(!wheel_timer_is_active(&t[i]));
+    }
+
+    timer_wheel_destroy(w);
+}
+
+
+void test_rearm_and_cancel()
+{
+    struct wheel_timer a, b;
+    struct fired fa, fb;
+    struct timer_wheel *w;
+
+    w = timer_wheel_create(loop, TICK_MS, NULL);
+    CU_ASSERT_FATAL(NULL != w);
+
+    memset(&fa, 0, sizeof(fa));
+    memset(&fb, 0, sizeof(fb));
+    fa.w = w;
+    fb.w = w;
+
+    wheel_timer_init(&a, rearm, &fa);
+    wheel_timer_init(&b, record, &fb);
+
+    wheel_timer_set(w, &a, 100);
+    wheel_timer_set(w, &b, 50);
+
+    /* Moving a timer is just a re-set. */
+    wheel_timer_set(w, &b, 200);
+    advance_to(w, 150);
+    CU_ASSERT(0 == fb.count);
+
+    wheel_timer_cancel(&b);
+    wheel_timer_cancel(&b);
+    CU_ASSERT(!wheel_timer_is_active(&b));
+
+    advance_to(w, 1000);
+    CU_ASSERT(0 == fb.count);
+    CU_ASSERT(3 == fa.count);
+    CU_ASSERT(300 == fa.at);
+
+    /* An armed timer is simply dropped when the wheel goes away. */
+    wheel_timer_set(w, &b, 10);
+    timer_wheel_destroy(w);
+    CU_ASSERT(!wheel_timer_is_active(&b));
+}
+
+
+static void dead(void *user)
+{
+    (*(int *) user)++;
+}
+
+
+void test_keepalive()
+{
+    struct timer_wheel *w;
+    struct keepalive ka;
+    int died = 0;
+
+    w = timer_wheel_create(loop, TICK_MS, NULL);
+    CU_ASSERT_FATAL(NULL != w);
+
+    /* 95ms rounds up to 10 ticks. */
+    keepalive_init(&ka, w, 95, dead, &died);
+    keepalive_start(&ka);
+
+    advance_to(w, 5);
+    keepalive_seen(&ka);
+    advance_to(w, 12);
+    keepalive_seen(&ka);
+
+    advance_to(w, 21);
+    CU_ASSERT(0 == died);
+    advance_to(w, 22);
+    CU_ASSERT(1 == died);
+
+    /* Nothing further once dead. */
+    advance_to(w, 100);
+    CU_ASSERT(1 == died);
+
+    keepalive_start(&ka);
+    keepalive_stop(&ka);
+    advance_to(w, 200);
+    CU_ASSERT(1 == died);
+
+    timer_wheel_destroy(w);
+}
+
+
+void test_bad_inputs()
+{
+    XAcode err = XA_OK;
+
+    CU_ASSERT(NULL == timer_wheel_create(NULL, TICK_MS, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == timer_wheel_create(loop, 0, NULL));
+
+    timer_wheel_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("timer_wheel.c tests", NULL, NULL);
+    CU_add_test(*suite, "Expiry ticks Test", test_expiry_ticks);
+    CU_add_test(*suite, "Re-arm and cancel Test", test_rearm_and_cancel);
+    CU_add_test(*suite, "Keepalive Test", test_keepalive);
+    CU_add_test(*suite, "Bad input Test", test_bad_inputs);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    loop = event_loop_create(NULL);
+    if (!loop) {
+        return 1;
+    }
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    event_loop_destroy(loop);
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/telemetry/trace.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static char exported[8192];
+static int exports;
+
+
+static void capture(void *user, const char *json, size_t len)
+{
+    (void) user;
+
+    CU_ASSERT(len == strlen(json));
+    CU_ASSERT(len < sizeof(exported));
+    snprintf(exported, sizeof(exported), "%s", json);
+    exports++;
+}
+
+
+/* Copies the 16 hex digits of an id that follows the key. */
+static void id_after(const char *json, const char *key, char *id)
+{
+    const char *p = strstr(json, key);
+
+    id[0] = '\0';
+    if (p) {
+        snprintf(id, 17, "%s", p + strlen(key));
+    }
+}
+
+
+void test_spans()
+{
+    struct trace_opts opts = { .service = "svc", .export = capture };
+    struct trace *t        = trace_create(&opts, NULL);
+    struct trace_span *root;
+    struct trace_span *child;
+    const char *c;
+    char root_id[17];
+    char parent_id[17];
+
+    CU_ASSERT_FATAL(NULL != t);
+    exports = 0;
+
+    root  = trace_span_root(t, "connect", TRACE_KIND__INTERNAL);
+    child = trace_span_child(root, "issuer request", TRACE_KIND__CLIENT);
+    CU_ASSERT_FATAL(NULL != root);
+    CU_ASSERT_FATAL(NULL != child);
+
+    trace_span_str(root, "interface", "eth\"0");
+    trace_span_int(child, "http.status_code", 503);
+    trace_span_double(child, "curl.total_s", 0.25);
+    trace_span_error(child, XA_NOT_CONNECTED, "bad\ngateway");
+    trace_span_end(child);
+    trace_span_end(root);
+
+    /* Nothing goes out until the batch is full or it is flushed. */
+    CU_ASSERT(0 == exports);
+    trace_flush(t);
+    CU_ASSERT(1 == exports);
+
+    CU_ASSERT(exported == strstr(exported, "{\"resourceSpans\":[{\"resource\":{\"attributes\":"
+                                           "[{\"key\":\"service.name\",\"value\":{\"stringValue\":\"svc\"}}]}"));
+    CU_ASSERT(NULL != strstr(exported, "{\"key\":\"interface\",\"value\":{\"stringValue\":\"eth\\\"0\"}}"));
+    CU_ASSERT(NULL != strstr(exported, "{\"key\":\"http.status_code\",\"value\":{\"intValue\":\"503\"}}"));
+    CU_ASSERT(NULL != strstr(exported, "{\"key\":\"curl.total_s\",\"value\":{\"doubleValue\":0.25}}"));
+    CU_ASSERT(NULL != strstr(exported, "\"status\":{\"code\":2,\"message\":\"bad\\u000agateway\"}"));
+    CU_ASSERT(NULL != strstr(exported, "\"name\":\"issuer request\",\"kind\":3,"));
+    CU_ASSERT(0 == strcmp(&exported[strlen(exported) - 6], "]}]}]}"));
+
+    /* The spans go out in pool order, so the root is first. */
+    c = strstr(exported, "\"name\":\"connect\"");
+    CU_ASSERT_FATAL(NULL != c);
+    id_after(exported, "\"spanId\":\"", root_id);
+    id_after(exported, "\"parentSpanId\":\"", parent_id);
+    CU_ASSERT_STRING_EQUAL(parent_id, root_id);
+    CU_ASSERT(16 == strlen(root_id));
+
+    /* Flushing again has nothing to send. */
+    trace_flush(t);
+    CU_ASSERT(1 == exports);
+
+    trace_destroy(t);
+}
+
+
+void test_pool()
+{
+    struct trace_opts opts = { .max_spans = 2, .batch_spans = 2, .export = capture };
+    struct trace *t        = trace_create(&opts, NULL);
+    struct trace_span *a;
+    struct trace_span *b;
+
+    CU_ASSERT_FATAL(NULL != t);
+    exports = 0;
+
+    a = trace_span_root(t, "a", TRACE_KIND__INTERNAL);
+    b = trace_span_child(a, "b", TRACE_KIND__INTERNAL);
+    CU_ASSERT(NULL != b);
+
+    /* Used up: dropped, and so is anything under it. */
+    CU_ASSERT(NULL == trace_span_root(t, "c", TRACE_KIND__INTERNAL));
+    CU_ASSERT(NULL == trace_span_child(NULL, "d", TRACE_KIND__INTERNAL));
+    CU_ASSERT(1 == trace_dropped(t));
+
+    /* None of these mind a NULL. */
+    trace_span_str(NULL, "k", "v");
+    trace_span_int(NULL, "k", 1);
+    trace_span_double(NULL, "k", 1.0);
+    trace_span_error(NULL, XA_OK, NULL);
+    trace_span_end(NULL);
+    trace_flush(NULL);
+    CU_ASSERT(NULL == trace_span_root(NULL, "e", TRACE_KIND__INTERNAL));
+
+    /* The second to end fills the batch. */
+    trace_span_end(a);
+    CU_ASSERT(0 == exports);
+    trace_span_end(b);
+    CU_ASSERT(1 == exports);
+
+    /* The pool has room again. */
+    a = trace_span_root(t, "f", TRACE_KIND__INTERNAL);
+    CU_ASSERT(NULL != a);
+    trace_span_end(a);
+
+    /* What is left goes out on the way down. */
+    trace_destroy(t);
+    CU_ASSERT(2 == exports);
+    CU_ASSERT(NULL != strstr(exported, "\"name\":\"f\""));
+
+    CU_ASSERT(NULL == trace_create(NULL, NULL));
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("trace.c tests", NULL, NULL);
+    CU_add_test(*suite, "Spans Test", test_spans);
+    CU_add_test(*suite, "Pool Test", test_pool);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/wrp/wrp_encode.h"
+#include "../src/wrp/wrp_view.h"
+
+#define STR(x) \
+    { sizeof(x) - 1, x }
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static bool is_str(struct xa_const_string s, const char *want)
+{
+    return (s.len == strlen(want)) && (0 == memcmp(s.s, want, s.len));
+}
+
+
+void test_event_bytes()
+{
+    const uint8_t expect[] = {
+        0x83,
+        0xa8, 'm', 's', 'g', '_', 't', 'y', 'p', 'e', 0x04,
+        0xa6, 's', 'o', 'u', 'r', 'c', 'e', 0xa3, 'm', 'a', 'c',
+        0xa4, 'd', 'e', 's', 't', 0xa2, 'e', 'v',
+    };
+    struct wrp_out msg = {
+        .msg_type = WRP_MSG_TYPE__EVENT,
+        .dest     = STR("ev"),
+    };
+    struct wrp_encoder *e;
+    uint8_t buf[64];
+
+    e = wrp_encoder_create("mac", NULL);
+    CU_ASSERT_FATAL(NULL != e);
+
+    CU_ASSERT(sizeof(expect) == wrp_encode(e, &msg, NULL, 0));
+    CU_ASSERT(sizeof(expect) == wrp_encode(e, &msg, buf, sizeof(buf)));
+    CU_ASSERT(0 == memcmp(expect, buf, sizeof(expect)));
+
+    /* Too small is reported, not overrun. */
+    memset(buf, 0xff, sizeof(buf));
+    CU_ASSERT(sizeof(expect) == wrp_encode(e, &msg, buf, 10));
+    CU_ASSERT(0xff == buf[10]);
+
+    wrp_encoder_destroy(e);
+}
+
+
+static void round_trip(struct wrp_encoder *e, const struct wrp_out *msg,
+                       struct wrp_view *v, uint8_t **buf)
+{
+    size_t len = wrp_encode(e, msg, NULL, 0);
+
+    CU_ASSERT_FATAL(0 < len);
+    *buf = malloc(len);
+    CU_ASSERT_FATAL(NULL != *buf);
+    CU_ASSERT(len == wrp_encode(e, msg, *buf, len));
+    CU_ASSERT_FATAL(XA_OK == wrp_view_decode(v, *buf, len, NULL));
+}
+
+
+void test_round_trip()
+{
+    uint8_t payload[1000];
+    struct wrp_out req = {
+        .msg_type         = WRP_MSG_TYPE__REQ,
+        .service          = STR("config"),
+        .dest             = STR("dns:talaria.example.com/api/v2/device"),
+        .transaction_uuid = STR("c2bb1f16-09c8-11e7-93ae-92361f002671"),
+        .content_type     = STR("application/json"),
+        .has_status       = true,
+        .status           = 200,
+        .payload          = payload,
+        .payload_len      = sizeof(payload),
+    };
+    struct wrp_out crud = {
+        .msg_type         = WRP_MSG_TYPE__RETRIEVE,
+        .dest             = STR("mac:112233445566/config"),
+        .transaction_uuid = STR("1"),
+        .path             = STR("/a/b"),
+        .has_status       = true,
+        .status           = -70000,
+    };
+    struct wrp_encoder *e;
+    struct wrp_view v;
+    uint8_t *buf = NULL;
+
+    memset(payload, 0xa5, sizeof(payload));
+
+    e = wrp_encoder_create("mac:112233445566", NULL);
+    CU_ASSERT_FATAL(NULL != e);
+
+    round_trip(e, &req, &v, &buf);
+    CU_ASSERT(WRP_MSG_TYPE__REQ == v.msg_type);
+    CU_ASSERT(is_str(v.source, "mac:112233445566/config"));
+    CU_ASSERT(is_str(v.dest, "dns:talaria.example.com/api/v2/device"));
+    CU_ASSERT(is_str(v.transaction_uuid, "c2bb1f16-09c8-11e7-93ae-92361f002671"));
+    CU_ASSERT(is_str(v.content_type, "application/json"));
+    CU_ASSERT(v.has_status && (200 == v.status));
+    CU_ASSERT(sizeof(payload) == v.payload.len);
+    CU_ASSERT(0 == memcmp(payload, v.payload.data, sizeof(payload)));
+    free(buf);
+
+    round_trip(e, &crud, &v, &buf);
+    CU_ASSERT(WRP_MSG_TYPE__RETRIEVE == v.msg_type);
+    CU_ASSERT(is_str(v.source, "mac:112233445566"));
+    CU_ASSERT(is_str(v.path, "/a/b"));
+    CU_ASSERT(v.has_status && (-70000 == v.status));
+    CU_ASSERT(NULL == v.payload.data);
+    free(buf);
+
+    wrp_encoder_destroy(e);
+}
+
+
+void test_invalid()
+{
+    struct wrp_out msg = {
+        .msg_type = WRP_MSG_TYPE__REQ,
+        .dest     = STR("ev"),
+    };
+    struct wrp_encoder *e;
+    XAcode err = XA_OK;
+
+    CU_ASSERT(NULL == wrp_encoder_create(NULL, &err));
+    CU_ASSERT(XA_INVALID_INPUT == err);
+    CU_ASSERT(NULL == wrp_encoder_create("", NULL));
+
+    e = wrp_encoder_create("mac:112233445566", NULL);
+    CU_ASSERT_FATAL(NULL != e);
+
+    /* Requests need a transaction_uuid */
+    CU_ASSERT(0 == wrp_encode(e, &msg, NULL, 0));
+
+    msg.msg_type = WRP_MSG_TYPE__SVC_ALIVE;
+    CU_ASSERT(0 == wrp_encode(e, &msg, NULL, 0));
+
+    msg.msg_type = WRP_MSG_TYPE__EVENT;
+    msg.dest.s   = NULL;
+    CU_ASSERT(0 == wrp_encode(e, &msg, NULL, 0));
+
+    CU_ASSERT(0 == wrp_encode(NULL, &msg, NULL, 0));
+    CU_ASSERT(0 == wrp_encode(e, NULL, NULL, 0));
+
+    wrp_encoder_destroy(e);
+    wrp_encoder_destroy(NULL);
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("wrp_encode.c tests", NULL, NULL);
+    CU_add_test(*suite, "Event bytes Test", test_event_bytes);
+    CU_add_test(*suite, "Round trip Test", test_round_trip);
+    CU_add_test(*suite, "Invalid Test", test_invalid);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}
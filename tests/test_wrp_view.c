@@ -0,0 +1,293 @@
+/* SPDX-FileCopyrightText: 2022 Comcast Cable Communications Management, LLC */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/wrp/wrp_view.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct buf {
+    uint8_t data[1024];
+    size_t len;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void put(struct buf *b, const void *p, size_t len)
+{
+    memcpy(&b->data[b->len], p, len);
+    b->len += len;
+}
+
+
+static void put_byte(struct buf *b, uint8_t c)
+{
+    put(b, &c, 1);
+}
+
+
+static void put_map(struct buf *b, uint8_t count)
+{
+    put_byte(b, 0x80 | count);
+}
+
+
+static void put_array(struct buf *b, uint8_t count)
+{
+    put_byte(b, 0x90 | count);
+}
+
+
+static void put_str(struct buf *b, const char *s)
+{
+    size_t len = strlen(s);
+
+    if (len < 32) {
+        put_byte(b, 0xa0 | (uint8_t) len);
+    } else {
+        put_byte(b, 0xd9);
+        put_byte(b, (uint8_t) len);
+    }
+    put(b, s, len);
+}
+
+
+static void put_bin(struct buf *b, const void *p, uint8_t len)
+{
+    put_byte(b, 0xc4);
+    put_byte(b, len);
+    put(b, p, len);
+}
+
+
+static void put_int(struct buf *b, int8_t i)
+{
+    if (0 <= i) {
+        put_byte(b, (uint8_t) i);
+    } else {
+        put_byte(b, 0xd0);
+        put_byte(b, (uint8_t) i);
+    }
+}
+
+
+static bool is_str(struct xa_const_string s, const char *want)
+{
+    return (s.len == strlen(want)) && (0 == memcmp(s.s, want, s.len));
+}
+
+
+static bool is_inside(const void *p, const struct buf *b)
+{
+    return (b->data <= (const uint8_t *) p) && ((const uint8_t *) p < &b->data[b->len]);
+}
+
+
+void test_event()
+{
+    struct buf b = { .len = 0 };
+    struct wrp_view v;
+
+    put_map(&b, 4);
+    put_str(&b, "msg_type");
+    put_int(&b, 4);
+    put_str(&b, "source");
+    put_str(&b, "mac:112233445566/service");
+    put_str(&b, "dest");
+    put_str(&b, "event:device-status/mac:112233445566/online");
+    put_str(&b, "payload");
+    put_bin(&b, "\x00\x01\x02\x03", 4);
+
+    CU_ASSERT_FATAL(XA_OK == wrp_view_decode(&v, b.data, b.len, NULL));
+    CU_ASSERT(WRP_MSG_TYPE__EVENT == v.msg_type);
+    CU_ASSERT(is_str(v.source, "mac:112233445566/service"));
+    CU_ASSERT(is_str(v.dest, "event:device-status/mac:112233445566/online"));
+    CU_ASSERT(NULL == v.transaction_uuid.s);
+    CU_ASSERT(!v.has_status);
+    CU_ASSERT(4 == v.payload.len);
+
+    /* Nothing is copied. */
+    CU_ASSERT(is_inside(v.source.s, &b));
+    CU_ASSERT(is_inside(v.dest.s, &b));
+    CU_ASSERT(is_inside(v.payload.data, &b));
+    CU_ASSERT(0 == memcmp(v.payload.data, "\x00\x01\x02\x03", 4));
+
+    CU_ASSERT_STRING_EQUAL(wrp_msg_type_to_string(v.msg_type), "event");
+}
+
+
+void test_req_with_lists()
+{
+    struct buf b = { .len = 0 };
+    struct xa_const_string s, k, val;
+    struct wrp_view_iter it;
+    struct wrp_view v;
+
+    put_map(&b, 11);
+    put_str(&b, "msg_type");
+    put_int(&b, 3);
+    put_str(&b, "source");
+    put_str(&b, "dns:talaria");
+    put_str(&b, "dest");
+    put_str(&b, "mac:112233445566/config");
+    put_str(&b, "transaction_uuid");
+    put_str(&b, "1234");
+    put_str(&b, "status");
+    put_int(&b, -1);
+    put_str(&b, "headers");
+    put_array(&b, 2);
+    put_str(&b, "a");
+    put_str(&b, "bb");
+    put_str(&b, "metadata");
+    put_map(&b, 1);
+    put_str(&b, "key");
+    put_str(&b, "value");
+    put_str(&b, "partner_ids");
+    put_array(&b, 0);
+    /* Unknown keys are skipped, whatever they hold. */
+    put_str(&b, "something_new");
+    put_map(&b, 1);
+    put_str(&b, "x");
+    put_array(&b, 2);
+    put_int(&b, 1);
+    put_bin(&b, "zz", 2);
+    put_str(&b, "content_type");
+    put_str(&b, "application/json");
+    put_str(&b, "payload");
+    put_str(&b, "{}");
+
+    CU_ASSERT_FATAL(XA_OK == wrp_view_decode(&v, b.data, b.len, NULL));
+    CU_ASSERT(WRP_MSG_TYPE__REQ == v.msg_type);
+    CU_ASSERT(is_str(v.transaction_uuid, "1234"));
+    CU_ASSERT(is_str(v.content_type, "application/json"));
+    CU_ASSERT(v.has_status);
+    CU_ASSERT(-1 == v.status);
+    CU_ASSERT(!v.has_rdr);
+    CU_ASSERT(2 == v.payload.len);
+
+    CU_ASSERT(2 == v.headers.count);
+    wrp_view_iter_init(&it, &v.headers);
+    CU_ASSERT(wrp_view_next_string(&it, &s));
+    CU_ASSERT(is_str(s, "a"));
+    CU_ASSERT(wrp_view_next_string(&it, &s));
+    CU_ASSERT(is_str(s, "bb"));
+    CU_ASSERT(is_inside(s.s, &b));
+    CU_ASSERT(!wrp_view_next_string(&it, &s));
+
+    CU_ASSERT(1 == v.metadata.count);
+    wrp_view_iter_init(&it, &v.metadata);
+    CU_ASSERT(wrp_view_next_pair(&it, &k, &val));
+    CU_ASSERT(is_str(k, "key"));
+    CU_ASSERT(is_str(val, "value"));
+    CU_ASSERT(!wrp_view_next_pair(&it, &k, &val));
+
+    CU_ASSERT(0 == v.partner_ids.count);
+    wrp_view_iter_init(&it, &v.partner_ids);
+    CU_ASSERT(!wrp_view_next_string(&it, &s));
+}
+
+
+void test_invalid()
+{
+    struct buf b = { .len = 0 };
+    struct wrp_view v;
+    XAcode err = XA_OK;
+
+    CU_ASSERT(XA_INVALID_INPUT == wrp_view_decode(NULL, b.data, 1, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == wrp_view_decode(&v, NULL, 1, NULL));
+    CU_ASSERT(XA_INVALID_INPUT == wrp_view_decode(&v, b.data, 0, NULL));
+
+    /* Not a map */
+    put_array(&b, 0);
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len, &err));
+    CU_ASSERT(XA_INVALID_WRP == err);
+
+    /* An event without a dest */
+    b.len = 0;
+    put_map(&b, 2);
+    put_str(&b, "msg_type");
+    put_int(&b, 4);
+    put_str(&b, "source");
+    put_str(&b, "mac:112233445566");
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len, NULL));
+
+    /* Truncated */
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len - 3, NULL));
+
+    /* Wrong type for a string */
+    b.len = 0;
+    put_map(&b, 1);
+    put_str(&b, "source");
+    put_int(&b, 4);
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len, NULL));
+
+    /* Non-string header */
+    b.len = 0;
+    put_map(&b, 2);
+    put_str(&b, "msg_type");
+    put_int(&b, 10);
+    put_str(&b, "headers");
+    put_array(&b, 1);
+    put_int(&b, 4);
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len, NULL));
+
+    /* Unsupported msg_type */
+    b.len = 0;
+    put_map(&b, 1);
+    put_str(&b, "msg_type");
+    put_int(&b, 42);
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len, NULL));
+
+    /* Missing msg_type */
+    b.len = 0;
+    put_map(&b, 0);
+    CU_ASSERT(XA_INVALID_WRP == wrp_view_decode(&v, b.data, b.len, NULL));
+    CU_ASSERT_STRING_EQUAL(wrp_msg_type_to_string(WRP_MSG_TYPE__UNSET), "invalid");
+}
+
+
+void add_suites(CU_pSuite *suite)
+{
+    *suite = CU_add_suite("wrp_view.c tests", NULL, NULL);
+    CU_add_test(*suite, "Event Test", test_event);
+    CU_add_test(*suite, "Request with lists Test", test_req_with_lists);
+    CU_add_test(*suite, "Invalid Test", test_invalid);
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main(void)
+{
+    unsigned rv     = 1;
+    CU_pSuite suite = NULL;
+
+    if (CUE_SUCCESS == CU_initialize_registry()) {
+        add_suites(&suite);
+
+        if (NULL != suite) {
+            CU_basic_set_mode(CU_BRM_VERBOSE);
+            CU_basic_run_tests();
+            printf("\n");
+            CU_basic_show_failures(CU_get_failure_list());
+            printf("\n\n");
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+    }
+
+    if (0 != rv) {
+        return 1;
+    }
+
+    return 0;
+}